@@ -1,5 +1,7 @@
 //{{{ Includes
 
+#define _DEFAULT_SOURCE // POSIX & BSD declarations (mmap flags etc), hidden by --std=c2x
+#include <assert.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -9,9 +11,25 @@
 #include <stdlib.h>
 #include <math.h>
 #include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include "include/eyr.h"
 #include "eyr.internal.h"
 
+#if defined(__x86_64__) && defined(__linux__) && !defined(NO_JIT)
+#define JIT // The baseline JIT. Build with NO_JIT to turn it off
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NO_SIMD)
+#define LEX_SIMD // SSE2/AVX2 scanning in the lexer. Build with NO_SIMD to turn it off
+#include <immintrin.h>
+#endif
+
 //}}}
 //{{{ Language definition
 //{{{ Lexical structure
@@ -277,61 +295,110 @@ static ParserFn const PARSE_TABLE[countSyntaxForms] = {
 //}}}
 //{{{ Runtime (virtual machine)
 
-typedef struct Interpreter Interpreter;
 #define RT Interpreter* restrict rt
 private Unt runPlus(Ulong instr, Unt ip, RT);
 private Unt runMinus(Ulong instr, Unt ip, RT);
 private Unt runTimes(Ulong instr, Unt ip, RT);
 private Unt runDivBy(Ulong instr, Unt ip, RT);
+private Unt runPlusConst(Ulong instr, Unt ip, RT);
+private Unt runMinusConst(Ulong instr, Unt ip, RT);
+private Unt runTimesConst(Ulong instr, Unt ip, RT);
+private Unt runDivByConst(Ulong instr, Unt ip, RT);
+private Unt runShiftLeftConst(Ulong instr, Unt ip, RT);
+private Unt runDivByPow2Const(Ulong instr, Unt ip, RT);
+private Unt runRemPow2Const(Ulong instr, Unt ip, RT);
 private Unt runNewString(Ulong instr, Unt ip, RT);
 private Unt runConcatStrings(Ulong instr, Unt ip, RT);
 private Unt runReverseString(Ulong instr, Unt ip, RT);
 private Unt runSetLocal(Ulong instr, Unt ip, RT);
+private Unt runMove(Ulong instr, Unt ip, RT);
 private Unt runBuiltinCall(Ulong instr, Unt ip, RT);
 private Unt runCall(Ulong instr, Unt ip, RT);
 private Unt runReturn(Ulong instr, Unt ip, RT);
 private Unt runPrint(Ulong instr, Unt ip, RT);
+private Unt runJump(Ulong instr, Unt ip, RT);
+private Unt runBranchLt(Ulong instr, Unt ip, RT);
+private Unt runBranchEq(Ulong instr, Unt ip, RT);
+private Unt runBranchGt(Ulong instr, Unt ip, RT);
+private Unt runMinusBranchLt(Ulong instr, Unt ip, RT);
+private Unt runMinusBranchEq(Ulong instr, Unt ip, RT);
+private Unt runMinusBranchGt(Ulong instr, Unt ip, RT);
+private Unt runSetLocalPlusConst(Ulong instr, Unt ip, RT);
+private Unt runSetLocalCall(Ulong instr, Unt ip, RT);
+private Unt runNewList(Ulong instr, Unt ip, RT);
+private Unt runNewPtrList(Ulong instr, Unt ip, RT);
+private Unt runNewStackList(Ulong instr, Unt ip, RT);
+private Unt runTailCall(Ulong instr, Unt ip, RT);
+private Unt runGetFld(Ulong instr, Unt ip, RT);
+private Unt runGetElem(Ulong instr, Unt ip, RT);
+private Unt runGetElemUnchecked(Ulong instr, Unt ip, RT);
+private Unt runSetElem(Ulong instr, Unt ip, RT);
+private Unt runSetElemUnchecked(Ulong instr, Unt ip, RT);
+
+#ifdef JIT
+private Bool jitCompile(Unt fnId, RT);
+private Unt rtRunNative(Unt fnId, Unt newFrame, Unt ip, RT);
+#endif
 
 typedef Unt (*InterpreterFn)(Ulong, Unt, Interpreter* restrict);
 
-#define countInstructions (iPrint + 1)
+#define countInstructions (iSetElemUnchecked + 1)
+
+// With DIRECT_THREADED, the main loop dispatches through a table of labels inside "interpretCode"
+// instead, and this table is only used by "interpretBounded"
 static InterpreterFn const INTERPRETER_TABLE[countInstructions] = {
     [iPlus]        = &runPlus,
     [iTimes]       = &runTimes,
     [iMinus]       = &runMinus,
     [iDivBy]       = &runDivBy,
+    [iPlusConst]   = &runPlusConst,
+    [iMinusConst]  = &runMinusConst,
+    [iTimesConst]  = &runTimesConst,
+    [iDivByConst]  = &runDivByConst,
+    [iShiftLeftConst] = &runShiftLeftConst,
+    [iDivByPow2Const] = &runDivByPow2Const,
+    [iRemPow2Const]   = &runRemPow2Const,
    /*
     [iPlusFl]      = &runPlus;
     [iMinusFl]       = &runMinusFl;
     [iTimesFl]       = &runTimesFl;
     [iDivByFl]       = &runDivByFl;
-    [iPlusConst]       = &runPlusConst;
-    [iMinusConst]       = &runMinusConst;
-    [iTimesConst]       = &runTimesConst;
-    [iDivByConst]       = &runDivByConst;
     [iPlusFlConst]       = &runPlusFlConst;
     [iMinusFlConst]       = &runMinusFlConst;
     [iTimesFlConst]       = &runTimesFlConst;
     [iDivByFlConst]       = &runDivByFlConst;
     [iIndexOfSubstring]       = &runIndexOfSubstring;
-    [iGetFld]       = &runGetFld;
-    [iNewList]       = &runNewList;
     [iSubstring]       = &runSubstring;
    */
     [iNewstring]      = &runNewString,
     [iConcatStrs]     = &runConcatStrings,
     [iReverseString]  = &runReverseString,
     [iSetLocal]       = &runSetLocal,
+    [iMove]           = &runMove,
     [iBuiltinCall]    = &runBuiltinCall,
     [iCall]           = &runCall,
     [iReturn]         = &runReturn,
-    [iPrint]          = &runPrint
+    [iPrint]          = &runPrint,
+    [iJump]           = &runJump,
+    [iBranchLt]       = &runBranchLt,
+    [iBranchEq]       = &runBranchEq,
+    [iBranchGt]       = &runBranchGt,
+    [iMinusBranchLt]  = &runMinusBranchLt,
+    [iMinusBranchEq]  = &runMinusBranchEq,
+    [iMinusBranchGt]  = &runMinusBranchGt,
+    [iSetLocalPlusConst] = &runSetLocalPlusConst,
+    [iSetLocalCall]   = &runSetLocalCall,
+    [iNewList]        = &runNewList,
+    [iNewPtrList]     = &runNewPtrList,
+    [iNewStackList]   = &runNewStackList,
+    [iTailCall]       = &runTailCall,
+    [iGetFld]         = &runGetFld,
+    [iGetElem]        = &runGetElem,
+    [iGetElemUnchecked] = &runGetElemUnchecked,
+    [iSetElem]        = &runSetElem,
+    [iSetElemUnchecked] = &runSetElemUnchecked
 };
 
-#define countBuiltins 1
-
-typedef void (*BuiltinFn)(Interpreter*);
-BuiltinFn BUILTINS_TABLE[countBuiltins]; // filled in by "tabulateBuiltins"
 #define EYR_NULL 0
 
 //}}}
@@ -340,7 +407,7 @@ BuiltinFn BUILTINS_TABLE[countBuiltins]; // filled in by "tabulateBuiltins"
 
 testable Any* allocateOnArena(size_t, Arena*);
 #define allocate(T, a) (T*)allocateOnArena(sizeof(T), a)
-#define allocateArray(cap, T, a) (T*)allocateOnArena(cap*sizeof(T), a)
+#define allocateArray(cap, T, a) (T*)allocateOnArena((cap)*sizeof(T), a)
 
 //{{{ Stack
 
@@ -454,9 +521,11 @@ typedef struct { //:BtCodegen Backtrack for generating code
     Byte tp; // instructions, i.e. the "i*" constants
     Int startInstr; // index of starting instruction
     Int sentinel; // sentinel node of current function
+    Int loopId; // for loops: the id from nodFor, for labelled break/continue
 } BtCodegen;
 
 DEFINE_STACK_HEADER(BtCodegen)
+DEFINE_STACK(BtCodegen) //:createStackBtCodegen
 
 
 #define pop(X) _Generic((X),\
@@ -487,6 +556,7 @@ DEFINE_STACK_HEADER(BtCodegen)
     StackTypeFrame*: pushTypeFrame,\
     Stackint32_t*: pushint32_t,\
     Stackuint32_t*: pushuint32_t,\
+    Stackuint64_t*: pushuint64_t,\
     StackNode*: pushNode,\
     StackSourceLoc*: pushSourceLoc,\
     StackBtCodegen*: pushBtCodegen\
@@ -505,8 +575,6 @@ DEFINE_STACK_HEADER(BtCodegen)
 //}}}
 //{{{ Utils
 
-jmp_buf excBuf;
-
 //{{{ General
 
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
@@ -820,6 +888,8 @@ DEFINE_STACK(int32_t) //:createStackint32_t :pushint32_t :peekint32_t :hasValues
 DEFINE_STACK_HEADER(uint32_t)
 DEFINE_STACK(uint32_t) //:createStackuint32_t :pushuint32_t :peekuint32_t :hasValuesuint32_t
                        //:popuint32_t
+DEFINE_STACK_HEADER(uint64_t)
+DEFINE_STACK(uint64_t) //:createStackuint64_t :pushuint64_t
 
 DEFINE_INTERNAL_LIST_TYPE(Int)
 DEFINE_INTERNAL_LIST_CONSTRUCTOR(Int) //:createInListInt
@@ -834,6 +904,7 @@ typedef struct { // :StringBuilder
     Arr(char) cont;
     Int len;
     Int cap;
+    Arena* a;
 } StringBuilder;
 
 
@@ -915,6 +986,71 @@ printStringBuilder(StringBuilder s) { //:printStringBuilder
     printf("\n");
 }
 
+private StringBuilder*
+createStringBuilder(Int initCap, Arena* a) { //:createStringBuilder
+    StringBuilder* result = allocate(StringBuilder, a);
+    (*result) = (StringBuilder){ .cont = allocateArray(initCap, char, a), .len = 0,
+                                 .cap = initCap, .a = a };
+    return result;
+}
+
+private void
+sbEnsureCap(Int extra, StringBuilder* sb) { //:sbEnsureCap
+    if (sb->len + extra <= sb->cap) {
+        return;
+    }
+    Int newCap = sb->cap*2;
+    while (newCap < sb->len + extra) {
+        newCap *= 2;
+    }
+    Arr(char) newCont = allocateArray(newCap, char, sb->a);
+    memcpy(newCont, sb->cont, sb->len);
+    sb->cont = newCont;
+    sb->cap = newCap;
+}
+
+private void
+sbAppend(String s, StringBuilder* sb) { //:sbAppend
+    sbEnsureCap(s.len, sb);
+    memcpy(sb->cont + sb->len, s.cont, s.len);
+    sb->len += s.len;
+}
+
+private void
+sbAppendf(StringBuilder* sb, char const* format, ...) { //:sbAppendf
+// printf into the builder
+    va_list args;
+    va_start(args, format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    Int const len = vsnprintf(null, 0, format, args);
+    va_end(args);
+    sbEnsureCap(len + 1, sb); // +1 for the \0 which vsnprintf always writes
+    vsnprintf(sb->cont + sb->len, len + 1, format, argsCopy);
+    va_end(argsCopy);
+    sb->len += len;
+}
+
+private String
+stringOfBuilder(StringBuilder* sb) { //:stringOfBuilder
+    return (String){ .cont = sb->cont, .len = sb->len };
+}
+
+private String
+stringOfFormat(Arena* a, char const* format, ...) { //:stringOfFormat
+// sprintf into a new arena-allocated string
+    va_list args;
+    va_start(args, format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    Int const len = vsnprintf(null, 0, format, args);
+    va_end(args);
+    char* cont = allocateOnArena(len + 1, a);
+    vsnprintf(cont, len + 1, format, argsCopy);
+    va_end(argsCopy);
+    return (String){ .cont = cont, .len = len };
+}
+
 private bool isLetter(Byte a) { //:isLetter
     return ((a >= aALower && a <= aZLower) || (a >= aAUpper && a <= aZUpper));
 }
@@ -1046,24 +1182,6 @@ getIntMap(int key, int* value, IntMap* hm) { //:getIntMap
     return 1;
 }
 
-private int
-getUnsafeIntMap(int key, IntMap* hm) { //:getUnsafeIntMap
-// Throws an exception when key is absent
-    int hash = key % (hm->dictSize);
-    if (*(hm->dict + hash) == null) {
-        longjmp(excBuf, 1);
-    }
-
-    int* p = *(hm->dict + hash);
-    int maxInd = 2*((*p) & 0xFFFF) + 1;
-    for (int i = 1; i < maxInd; i += 2) {
-        if (p[i] == key) { // key already present
-            return p[i + 1];
-        }
-    }
-    longjmp(excBuf, 1);
-}
-
 private bool
 hasKeyValueIntMap(int key, int value, IntMap* hm) { //:hasKeyValueIntMap
     return false;
@@ -1112,6 +1230,7 @@ createStringDict(int initSize, Arena* a) {
     }
     result->dictSize = realInitSize;
     result->dict = dict;
+    result->len = 0;
 
     return result;
 }
@@ -1132,7 +1251,7 @@ addValueToBucket(Bucket** ptrToBucket, Int newIndString, Unt hash, Arena* a) {
     Bucket* p = *ptrToBucket;
     Int capacity = (p->capAndLen) >> 16;
     Int lenBucket = (p->capAndLen & 0xFFFF);
-    if (lenBucket + 1 < capacity) {
+    if (lenBucket < capacity) {
         *(p->cont + lenBucket) = (StringValue){.hash = hash, .indString = newIndString};
         (p->capAndLen) += 1;
     } else {
@@ -1148,10 +1267,50 @@ addValueToBucket(Bucket** ptrToBucket, Int newIndString, Unt hash, Arena* a) {
 }
 
 
+#define nameSpanOf(startBt, lenBts) (((Ulong)(lenBts) << 40) + (Ulong)(startBt))
+#define nameSpanStart(span) ((Long)((span) & LOWER40BITS))
+#define nameSpanLen(span) ((Int)((span) >> 40))
+#define nameLocStart(loc) ((Int)((loc) & LOWER24BITS))
+#define nameLocLen(loc) ((Int)((loc) >> 24))
+
+private void
+growStringDict(StringDict* hm) { //:growStringDict
+// Doubles the count of buckets, so that the buckets stay short however many names there are.
+// The values keep their hashes, so nothing needs rehashing
+    Int const newSize = 2*hm->dictSize;
+    Arr(Bucket*) newDict = allocateArray(newSize, Bucket*, hm->a);
+    memset(newDict, 0, newSize*sizeof(Bucket*));
+    for (Int i = 0; i < hm->dictSize; i++) {
+        Bucket* bu = hm->dict[i];
+        if (bu == null) {
+            continue;
+        }
+        Int const lenBucket = bu->capAndLen & 0xFFFF;
+        for (Int k = 0; k < lenBucket; k++) {
+            StringValue v = bu->cont[k];
+            Int const hashOffset = v.hash % newSize;
+            if (newDict[hashOffset] == null) {
+                Bucket* newBucket = allocateOnArena(
+                        sizeof(Bucket) + initBucketSize*sizeof(StringValue), hm->a);
+                newBucket->capAndLen = (initBucketSize << 16) + 1;
+                newBucket->cont[0] = v;
+                newDict[hashOffset] = newBucket;
+            } else {
+                addValueToBucket(newDict + hashOffset, v.indString, v.hash, hm->a);
+            }
+        }
+    }
+    hm->dict = newDict;
+    hm->dictSize = newSize;
+}
+
 testable Int
-addStringDict(char const* text, Int startBt, Int lenBts, StackUnt* stringTable,
+addStringDict(char const* text, Long startBt, Int lenBts, StackNameSpan* stringTable,
               StringDict* hm) { //:addStringDict
 // Unique'ing of symbols within source code
+    if (hm->len >= 4*hm->dictSize) {
+        growStringDict(hm);
+    }
     Unt hash = hashCode(text + startBt, lenBts);
     Int hashOffset = hash % (hm->dictSize);
     Int newIndString;
@@ -1163,7 +1322,7 @@ addStringDict(char const* text, Int startBt, Int lenBts, StackUnt* stringTable,
         StringValue* firstElem = (StringValue*)newBucket->cont;
 
         newIndString = stringTable->len;
-        NameLoc newName = ((Unt)(lenBts) << 24) + (Unt)startBt;
+        NameSpan newName = nameSpanOf(startBt, lenBts);
         push(newName, stringTable);
 
         *firstElem = (StringValue){.hash = hash, .indString = newIndString };
@@ -1172,8 +1331,9 @@ addStringDict(char const* text, Int startBt, Int lenBts, StackUnt* stringTable,
         int lenBucket = (bu->capAndLen & 0xFFFF);
         for (int i = 0; i < lenBucket; i++) {
             StringValue strVal = bu->cont[i];
-            if (strVal.hash == hash &&
-                  memcmp(text + (stringTable->cont[strVal.indString] & LOWER24BITS),
+            NameSpan const span = stringTable->cont[strVal.indString];
+            if (strVal.hash == hash && nameSpanLen(span) == lenBts &&
+                  memcmp(text + nameSpanStart(span),
                          text + startBt,
                          lenBts) == 0) {
                 // key already present
@@ -1182,15 +1342,16 @@ addStringDict(char const* text, Int startBt, Int lenBts, StackUnt* stringTable,
         }
 
         newIndString = stringTable->len;
-        NameLoc newName = ((Unt)(lenBts) << 24) + (Unt)startBt;
+        NameSpan newName = nameSpanOf(startBt, lenBts);
         push(newName, stringTable);
         addValueToBucket(hm->dict + hashOffset, newIndString, hash, hm->a);
     }
+    hm->len += 1;
     return newIndString;
 }
 
 testable Int
-getStringDict(Arr(char) text, String strToSearch, StackUnt* stringTable,
+getStringDict(Arr(char) text, String strToSearch, StackNameSpan* stringTable,
         StringDict* hm) { //:getStringDict
 // Returns the index of a string within the string table, or -1 if it's not present
     Int lenBts = strToSearch.len;
@@ -1203,10 +1364,9 @@ getStringDict(Arr(char) text, String strToSearch, StackUnt* stringTable,
         int lenBucket = (p->capAndLen & 0xFFFF);
         Arr(StringValue) stringValues = (StringValue*)p->cont;
         for (int i = 0; i < lenBucket; i++) {
-            if (stringValues[i].hash == hash
-                && memcmp(strToSearch.cont,
-                          text + (stringTable->cont[stringValues[i].indString] & LOWER24BITS),
-                          lenBts) == 0) {
+            NameSpan const span = stringTable->cont[stringValues[i].indString];
+            if (stringValues[i].hash == hash && nameSpanLen(span) == lenBts
+                && memcmp(strToSearch.cont, text + nameSpanStart(span), lenBts) == 0) {
                 return stringValues[i].indString;
             }
         }
@@ -1543,10 +1703,20 @@ DEFINE_INTERNAL_LIST_CONSTRUCTOR(Entity) //:createInListEntity
 DEFINE_INTERNAL_LIST_TYPE(Token) //:InListToken
 
 DEFINE_INTERNAL_LIST_TYPE(uint32_t)
+DEFINE_INTERNAL_LIST_CONSTRUCTOR(uint32_t) //:createInListuint32_t
 
 DEFINE_INTERNAL_LIST_TYPE(Node)
 DEFINE_INTERNAL_LIST_CONSTRUCTOR(Node) //:createInListNode
 
+typedef struct { //:TokenBase
+// The start of a lexer window, see "lexRebase"
+    Int tokenInd;  // the first token lexed in the window
+    Long startBt;
+} TokenBase;
+
+DEFINE_INTERNAL_LIST_TYPE(TokenBase)
+DEFINE_INTERNAL_LIST_CONSTRUCTOR(TokenBase) //:createInListTokenBase
+
 // Span levels, must all be more than 0
 #define slScope        1 // scopes (denoted by brackets): newlines and commas have no effect there
 #define slStmt         2 // single-line statements: newlines and semicolons break 'em
@@ -1557,15 +1727,19 @@ DEFINE_INTERNAL_LIST_CONSTRUCTOR(Node) //:createInListNode
 
 struct Compiler { // :Compiler
     // LEXING
-    String sourceCode;
+    Arr(char const) sourceCode; // prefixed with the "standardText"
+    Long inpLength;             // of @sourceCode
+    Long windowStart;           // of the lexer's window into @sourceCode, see "lexRebase"
+    InListTokenBase tokenBases; // the windows after the first one
     InListToken tokens;
     InListToken metas; // TODO - metas with links back into parent span tokens
-    InListInt newlines;
+    InListUns newlines; // the lower 32 bits of the offsets of the LFs in @sourceCode. They only
+                        // grow, so in inputs over 4 GB the rest is the count of wraparounds before
     StackSourceLoc* sourceLocs;
     InListInt numeric;          // [aTmp]
     StackBtToken* lexBtrack;    // [aTmp]
-    Stackuint32_t* stringTable;  // Operators, then standard strings, then imported ones, then
-                                 // parsed. Contains NameLoc pointing into @sourceCode
+    StackNameSpan* stringTable;  // Operators, then standard strings, then imported ones, then
+                                 // parsed. Contains NameSpan pointing into @sourceCode
     StringDict* stringDict;
 
     // PARSING
@@ -1584,26 +1758,34 @@ struct Compiler { // :Compiler
     InListInt types;
     StringDict* typesDict;
     StateForTypes* stateForTypes; // [aTmp]
+    InListInt constLiterals; // [aTmp] per entity: node of its literal value or -1, see "foldConstants"
 
     // CODEGEN
     StackBtCodegen* cgBtrack;    // [aTmp]
     InListUlong bytecode;
+    InListInt ptrMaps; // For the GC. Per function in @bytecode order:
+                       // [countSlots countParamSlots slot...], slots hold heap pointers
+    StringBuilder* staticText; // The text of the string literals, copied into the VM at init
 
     // GENERAL STATE
     Int i;
     Arena* a;
     Arena* aTmp;
     CompStats stats;
+    jmp_buf excBuf; // for the errors of this compilation
 };
 
-DEFINE_INTERNAL_LIST(newlines, Int, a) //:pushInnewlines
+DEFINE_INTERNAL_LIST(newlines, Unt, a) //:pushInnewlines
 DEFINE_INTERNAL_LIST(numeric, Int, a) //:pushInnumeric
 DEFINE_INTERNAL_LIST(importNames, Int, a) //:pushInimportNames
 DEFINE_INTERNAL_LIST(overloads, Int, a) //:pushInoverloads
 DEFINE_INTERNAL_LIST(types, Int, a) //:pushIntypes
 DEFINE_INTERNAL_LIST(bytecode, Ulong, a) //:pushInbytecode
+DEFINE_INTERNAL_LIST(ptrMaps, Int, a) //:pushInptrMaps
+DEFINE_INTERNAL_LIST(constLiterals, Int, aTmp) //:pushInconstLiterals
 DEFINE_INTERNAL_LIST_CONSTRUCTOR(Token) //:createInListToken
 DEFINE_INTERNAL_LIST(tokens, Token, a) //:pushIntokens
+DEFINE_INTERNAL_LIST(tokenBases, TokenBase, a) //:pushIntokenBases
 DEFINE_INTERNAL_LIST(toplevels, Assignment, a) //:pushIntoplevels
 DEFINE_INTERNAL_LIST(entities, Entity, a) //:pushInentities
 DEFINE_INTERNAL_LIST(nodes, Node, a) //:pushInnodes
@@ -1633,13 +1815,21 @@ typedef struct { // :TypeHeader
 // Function layout (all instructions are 8-byte sized):
 // length
 // actual code
+//
+// Stack frame layout: CallHeader, then the params, then the other locals and temporaries.
+// A callee's frame starts inside its caller's frame, at the address given by iCall, and the caller
+// writes the arguments there before the call. The return value ends up at the start of the
+// callee's frame, over the header
+
+typedef Int (*JitFn)(Unt* frame); //:JitFn Native code for a function. Returns 0 or a JIT_* error
 
 #define EyrPtr uint32_t //:Ptr Pointers are aligned to 4 bytes
 #define StackAddr int16_t //:StackAddr Offset from "currFrame". Negative values mean previous stack frame
+#define GC_SIZE_CLASSES 32 // Free lists with exact sizes in words, plus list 0 for all the bigger blocks
 
 
 struct Interpreter {    //:Interpreter
-    Unt ip; // current instruction pointer
+    Unt ip; // instruction pointer where "interpretCode" starts
     Arr(Ulong) code;
     Arr(Int) fns;   // indices into @code
     // global static string
@@ -1649,8 +1839,28 @@ struct Interpreter {    //:Interpreter
     EyrPtr topOfFrame;
     Arr(Unt) memory;
     StackAddr stackTop;
+    EyrPtr heapStart; // the garbage-collected heap is @memory[heapStart, heapTop)
     EyrPtr heapTop; // index into @memory
+    EyrPtr heapEnd; // the current limit of the heap, grows up to VM_RESERVE_SIZE
+    EyrPtr freeLists[GC_SIZE_CLASSES]; // heads of the free lists, EYR_NULL if empty
+    Arr(Int) ptrMaps;    // see @Compiler.ptrMaps
+    Arr(Int) ptrMapInds; // per function, index into @ptrMaps or -1 if its frames hold no pointers
+    Int countCollections;
+    EyrPtr regionMark; // heap top at the start of the active region, or EYR_NULL if none
+    EyrPtr pinned;     // heap object with the extra GC roots kept by "rtPin"
+    Int countPinned;
     String errMsg;
+    jmp_buf excBuf; // for runtime errors
+
+    Int countFns;
+    Arr(Unt) callCounts; // per function, to find the hot ones for the JIT
+    Arr(JitFn) jitFns;   // native code for the functions whose @fns entry is -1
+    Byte* jitBuf;        // executable memory for the JIT
+    Int jitBufLen;
+    Byte* image;         // the mapped bytecode image with the code, or null. See "loadImage"
+    Int imageLen;
+    Arena* aCompiler;    // the compiler's arena if the code is in it, or null. See "compile"
+    Arena* a; // own, so that the interpreters of one program can come and go
 };
 
 typedef struct { //:CallHeader
@@ -1659,7 +1869,20 @@ typedef struct { //:CallHeader
     Unt fnId;     // Index into @Interpreter.fns
 } CallHeader;
 
-#define stackFrameStart 2 // Skipped the 2 ints
+#define stackFrameStart 3 // The CallHeader takes up the first 3 ints
+
+// VM memory layout (in words): the stack, which grows upwards, then the guard pages, then the
+// static text and the heap. The whole range is reserved with mmap at once and its pages are only
+// committed when touched, so an idle VM costs a few pages of RSS. The heap grows by moving
+// @heapEnd up, without any copying. A frame running into the guard pages raises SIGSEGV, which is
+// turned into a runtime error, so "runCall" needs no stack checks
+#define VM_RESERVE_SIZE  (1 << 28) // 1 GB of address space
+#define VM_STACK_SIZE    (1 << 16)
+#define VM_GUARD_SIZE    (1 << 15) // 128 KB. Slot operands are signed 16 bits, so no access from a
+                                   // frame can skip over the guard
+#define VM_HEAP_INIT_SIZE (1 << 18)
+#define VM_REGION_HEAP_LIMIT (1 << 22) // Past this heap size, a region collects instead of growing
+#define JIT_THRESHOLD 1000 // Number of calls after which a function gets compiled to native code
 
 
 //}}}
@@ -1676,7 +1899,7 @@ private Compiler PROTO = {
         .i = -1
     };
 
-private Bool _wasInit = false;
+private pthread_once_t _initOnce = PTHREAD_ONCE_INIT;
 
 private void initCompiler();
 
@@ -1706,6 +1929,7 @@ private void initCompiler();
 #define iErrorInconsistentTypeExpr      11 // Reduced type expression has != 1 elements
 #define iErrorNotAFunction              12 // Expected to find a function type here
 #define iErrorArrayElemButShouldBePtr   13 // An assignment with list accessor on left should be ptr
+#define iErrorTooManyBindings           14 // A scope has more than 255 bindings
 
 //}}}
 //{{{ Syntax errors
@@ -1716,6 +1940,9 @@ char const errUnrecognizedByte[]           = "Unrecognized Byte in source code!"
 char const errWordChunkStart[]             = "In an identifier, each word piece must start with a letter. Tilde may come only after an identifier";
 char const errWordCapitalizationOrder[]    = "An identifier may not contain a capitalized piece after an uncapitalized one!";
 char const errWordLengthExceeded[]         = "I don't know why you want an identifier of more than 255 chars, but they aren't supported";
+char const errTokenLengthExceeded[]        = "A string literal or a single definition may not be longer than 64 MB";
+char const errLexemeLengthExceeded[]       = "A comment or a run of spaces may not be longer than 1 GB";
+char const errInputTooLong[]               = "A source file may not be longer than 256 GB";
 char const errWordTilde[]                  = "Mutable var definitions should look like `asdf~` with no spaces in between";
 char const errWordFreeFloatingFieldAcc[]   = "Free-floating field accessor";
 char const errWordInMeta[]                 = "Only ordinary words are allowed inside meta blocks!";
@@ -1808,6 +2035,31 @@ char const errTypeFnSingleReturnType[]      = "More than one return type in a fu
 char const errTypeOfNotList[]               = "Trying to get the element of a type which is not a list";
 char const errTypeOfListIndex[]             = "The type of a list/array index must be Int";
 
+//}}}
+//{{{ Codegen errors
+
+char const errCodegenUnsupported[]          = "The C backend doesn't support this construct yet";
+char const errCodegenEntryParams[]          = "The entry function must not have parameters";
+char const errBytecodeUnsupported[]         = "The bytecode generator doesn't support this construct yet";
+char const errBytecodeFrameTooBig[]         = "Too many local variables in a function";
+char const errConstantOrder[]               = "A toplevel constant can only use the constants defined before it";
+char const errConstantEvaluation[]          = "Error while evaluating a toplevel constant at compile time";
+char const errStringTooLong[]               = "A string literal longer than 16 MB isn't supported by the bytecode";
+
+//}}}
+//{{{ Runtime errors
+
+char const errDivisionByZero[]              = "Division by zero";
+char const errOutOfMemory[]                 = "Out of memory";
+char const errObjectTooLarge[]              = "Object too large for the heap";
+char const errStackOverflow[]               = "Stack overflow";
+char const errIndexOutOfBounds[]            = "Index out of bounds";
+char const errBuiltinCall[]                 = "Builtin calls aren't supported yet";
+char const errImageRead[]                   = "Could not read the bytecode image";
+char const errImageVersion[]                = "Not a bytecode image of this version of Eyr";
+char const errImageCorrupt[]                = "The bytecode image is corrupt";
+char const errImageStale[]                  = "The bytecode image is of another source";
+
 //}}}
 
 //}}}
@@ -1832,6 +2084,11 @@ private bool isFunctionWithParams(TypeId typeId, CM);
 private OuterTypeId typeGetOuter(FirstArgTypeId typeId, CM);
 private Int typeGetTyrity(TypeId typeId, CM);
 testable Int typeCheckBigExpr(Int indExpr, Int sentinel, CM);
+testable void foldConstants(Int indExpr, CM);
+private void foldRecordBinding(EntityId entityId, Int rightInd, CM);
+private Int foldLiteralOf(EntityId entityId, CM);
+private Int cOperatorOf(EntityId entityId);
+testable EntityId typeAccessorEntity(Int opId, CM);
 private TypeId typecheckList(Int startInd, CM);
 private TypeId tDefinition(StateForTypes* st, Int sentinel, CM);
 private TypeId tGetIndexOfFnFirstParam(TypeId fnType, CM);
@@ -1907,16 +2164,222 @@ void dbgCallFrames(Interpreter* rt);
 #endif
 
 //}}}
+//}}}
+//{{{ Lexer scanning kernels
+
+// The lexer's inner loops over runs of bytes: spaces, word chunks, comments and string literals.
+// With LEX_SIMD they test 16 (SSE2) or 32 (AVX2) bytes at a time, AVX2 being chosen at runtime if
+// the CPU has it. Every scanner returns the index of the first byte that ends the run, or @end.
+// They never read at or past @end: the vector loops stop short of it and a scalar tail finishes.
+// Most runs are short, so the front-ends ("spaceRunEnd" etc) try a single SSE2 vector inline
+// before calling the dispatched kernel for the rest of a long run
+
+typedef struct { //:LexScanners
+    Int (*spaceRunEnd)(SRC, Int i, Int end);     // the end of the spaces and LFs
+    Int (*wordRunEnd)(SRC, Int i, Int end);      // the end of the alphanumerics
+    Int (*byteFind)(SRC, Int i, Int end, Byte target);
+} LexScanners;
+
+private LexScanners _lexScanners; // set once by "chooseLexScanners"
+
+private Int
+spaceRunEndScalar(SRC, Int i, Int end) { //:spaceRunEndScalar
+    for (; i < end && isSpace(source[i]); i++);
+    return i;
+}
+
+private Int
+wordRunEndScalar(SRC, Int i, Int end) { //:wordRunEndScalar
+    for (; i < end && isAlphanumeric(source[i]); i++);
+    return i;
+}
+
+private Int
+byteFindScalar(SRC, Int i, Int end, Byte target) { //:byteFindScalar
+    for (; i < end && source[i] != target; i++);
+    return i;
+}
+
+#ifdef LEX_SIMD
+
+#define AVX2 __attribute__((target("avx2")))
+
+// The bitmasks of a vector at @p: a bit per byte, set for the bytes that end a run
+
+private Unt
+nonSpaceMask16(char const* p) { //:nonSpaceMask16
+    __m128i const v = _mm_loadu_si128((__m128i const*)p);
+    __m128i const spaces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(aSpace)),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8(aNewline)));
+    return ~(Unt)_mm_movemask_epi8(spaces) & 0xFFFF;
+}
+
+private Unt
+nonWordMask16(char const* p) { //:nonWordMask16
+// Bytes over 127 are negative for the signed comparisons, so they're never letters or digits
+    __m128i const v = _mm_loadu_si128((__m128i const*)p);
+    __m128i const lower = _mm_or_si128(v, _mm_set1_epi8(0x20)); // "A" -> "a" etc
+    __m128i const letters = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8(aALower - 1)),
+                                          _mm_cmpgt_epi8(_mm_set1_epi8(aZLower + 1), lower));
+    __m128i const digits = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(aDigit0 - 1)),
+                                         _mm_cmpgt_epi8(_mm_set1_epi8(aDigit0 + 10), v));
+    return ~(Unt)_mm_movemask_epi8(_mm_or_si128(letters, digits)) & 0xFFFF;
+}
+
+private Unt
+byteMask16(char const* p, Byte target) { //:byteMask16
+    __m128i const v = _mm_loadu_si128((__m128i const*)p);
+    return (Unt)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)target)));
+}
+
+AVX2 private Unt
+nonSpaceMask32(char const* p) { //:nonSpaceMask32
+    __m256i const v = _mm256_loadu_si256((__m256i const*)p);
+    __m256i const spaces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(aSpace)),
+                                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8(aNewline)));
+    return ~(Unt)_mm256_movemask_epi8(spaces);
+}
+
+AVX2 private Unt
+nonWordMask32(char const* p) { //:nonWordMask32
+    __m256i const v = _mm256_loadu_si256((__m256i const*)p);
+    __m256i const lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i const letters = _mm256_and_si256(
+            _mm256_cmpgt_epi8(lower, _mm256_set1_epi8(aALower - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8(aZLower + 1), lower));
+    __m256i const digits = _mm256_and_si256(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8(aDigit0 - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8(aDigit0 + 10), v));
+    return ~(Unt)_mm256_movemask_epi8(_mm256_or_si256(letters, digits));
+}
+
+AVX2 private Unt
+byteMask32(char const* p, Byte target) { //:byteMask32
+    __m256i const v = _mm256_loadu_si256((__m256i const*)p);
+    return (Unt)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)target)));
+}
+
+#define LEX_KERNELS(W, TARGET) /* the dispatched kernels for vectors of W bytes */               \
+TARGET private Int                                                                              \
+spaceRunEnd##W(SRC, Int i, Int end) {                                                           \
+    for (; i + W <= end; i += W) {                                                              \
+        Unt const others = nonSpaceMask##W(source + i);                                         \
+        if (others != 0) {                                                                      \
+            return i + __builtin_ctz(others);                                                   \
+        }                                                                                       \
+    }                                                                                           \
+    return spaceRunEndScalar(source, i, end);                                                   \
+}                                                                                               \
+                                                                                                \
+TARGET private Int                                                                              \
+wordRunEnd##W(SRC, Int i, Int end) {                                                            \
+    for (; i + W <= end; i += W) {                                                              \
+        Unt const others = nonWordMask##W(source + i);                                          \
+        if (others != 0) {                                                                      \
+            return i + __builtin_ctz(others);                                                   \
+        }                                                                                       \
+    }                                                                                           \
+    return wordRunEndScalar(source, i, end);                                                    \
+}                                                                                               \
+                                                                                                \
+TARGET private Int                                                                              \
+byteFind##W(SRC, Int i, Int end, Byte target) {                                                 \
+    for (; i + W <= end; i += W) {                                                              \
+        Unt const found = byteMask##W(source + i, target);                                      \
+        if (found != 0) {                                                                       \
+            return i + __builtin_ctz(found);                                                    \
+        }                                                                                       \
+    }                                                                                           \
+    return byteFindScalar(source, i, end, target);                                              \
+}
+
+LEX_KERNELS(16, ) //:spaceRunEnd16 :wordRunEnd16 :byteFind16
+LEX_KERNELS(32, AVX2) //:spaceRunEnd32 :wordRunEnd32 :byteFind32
+
+#endif
+
+private Int
+spaceRunEnd(SRC, Int i, Int end) { //:spaceRunEnd
+    if (i >= end || !isSpace(source[i])) {
+        return i;
+    }
+#ifdef LEX_SIMD
+    if (i + 16 <= end) {
+        Unt const others = nonSpaceMask16(source + i);
+        return others != 0 ? i + __builtin_ctz(others)
+                           : _lexScanners.spaceRunEnd(source, i + 16, end);
+    }
+#endif
+    return spaceRunEndScalar(source, i, end);
+}
+
+private Int
+wordRunEnd(SRC, Int i, Int end) { //:wordRunEnd
+#ifdef LEX_SIMD
+    if (i + 16 <= end) {
+        Unt const others = nonWordMask16(source + i);
+        return others != 0 ? i + __builtin_ctz(others)
+                           : _lexScanners.wordRunEnd(source, i + 16, end);
+    }
+#endif
+    return wordRunEndScalar(source, i, end);
+}
+
+private Int
+byteFind(SRC, Int i, Int end, Byte target) { //:byteFind
+#ifdef LEX_SIMD
+    return _lexScanners.byteFind(source, i, end, target);
+#else
+    return byteFindScalar(source, i, end, target);
+#endif
+}
+
+private void
+chooseLexScanners(void) { //:chooseLexScanners
+#ifdef LEX_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _lexScanners = (LexScanners){ .spaceRunEnd = &spaceRunEnd32, .wordRunEnd = &wordRunEnd32,
+                                      .byteFind = &byteFind32 };
+    } else { // SSE2 is always there on x86-64
+        _lexScanners = (LexScanners){ .spaceRunEnd = &spaceRunEnd16, .wordRunEnd = &wordRunEnd16,
+                                      .byteFind = &byteFind16 };
+    }
+#else
+    _lexScanners = (LexScanners){ .spaceRunEnd = &spaceRunEndScalar,
+                                  .wordRunEnd = &wordRunEndScalar, .byteFind = &byteFindScalar };
+#endif
+}
+
 //}}}
 //{{{ LexerUtils
 
+struct StandardText { //:StandardText
+// The "standardText" that's prepended to all inputs, for the error messages and tests
+    Int len;         // in bytes
+    Int firstParsed; // the first nameId of the parsed names
+};
+
+testable StandardText
+getStandardTextLength(void) { //:getStandardTextLength
+    return (StandardText){ .len = sizeof(standardText) - 1,
+                           .firstParsed = strSentinel + countOperators };
+}
+
 #define CURR_BT source[lx->i]
 #define NEXT_BT source[lx->i + 1]
-#define IND_BT (lx->i - getStandardTextLength().len)
+#define IND_BT (lx->windowStart + lx->i - getStandardTextLength().len)
 #define VALIDATEI(cond, errInd) if (!(cond)) { throwExcInternal0(errInd, __LINE__, cm); }
 #define VALIDATEL(cond, errMsg) if (!(cond)) { throwExcLexer0(errMsg, __LINE__, lx); }
 
 
+#ifndef LEX_REBASE_AT
+#define LEX_REBASE_AT (1 << 30) // the lexer moves its window past this offset, see "lexRebase"
+#endif
+#define LEX_WINDOW (2*(Long)LEX_REBASE_AT - 1) // the max length of the window, so it fits an Int
+#define LEX_MAX_INPUT ((Long)1 << 38) // the offsets in a SourceLoc have 38 bits
+
+
 #ifdef TEST
 
 Int pos(Compiler* lx);
@@ -1924,46 +2387,85 @@ void dbgLexBtrack(Compiler* lx);
 
 #endif
 
+private Long
+tokStartBt(Int tokenInd, CM) { //:tokStartBt
+// The offset of a token in @sourceCode. Tokens keep only its lower 32 bits, so in an input
+// over 4 GB the rest comes from the start of the lexer window which the token was lexed in
+    Long windowStart = 0;
+    for (Int k = 0; k < cm->tokenBases.len && cm->tokenBases.cont[k].tokenInd <= tokenInd; k++) {
+        windowStart = cm->tokenBases.cont[k].startBt;
+    }
+    return windowStart + (Int)(cm->tokens.cont[tokenInd].startBt - (Unt)windowStart);
+}
+
 typedef union {
     uint64_t i;
     double   d;
 } FloatingBits;
 
-private String
-readSourceFile(String fName, Arena* a) { //:readSourceFile
-    FILE *file = fopen(fName.cont, "r");
-    if (file == null) {
-        goto cleanup;
-    }
-    // Go to the end of the file
-    if (fseek(file, 0L, SEEK_END) != 0) {
-        goto cleanup;
-    }
-    long fileSize = ftell(file);
-    if (fileSize == -1) {
-        goto cleanup;
-    }
-    Int lenStandard = sizeof(standardText);
-    // Allocate our buffer to that size, with space for the standard text in front of it
-    Arr(char) result = allocateOnArena(lenStandard + fileSize + 1, a);
-
-    // Go back to the start of the file
-    if (fseek(file, 0L, SEEK_SET) != 0) {
-        goto cleanup;
+typedef struct { //:SourceMap
+    char const* input; // the standardText followed by the file, for "lexicallyAnalyzeInput"
+    Long inpLength;    // 0 if the file can't be read or is empty
+    Byte* base; // the whole mapping, for "unmapSourceFile"
+    Ulong len;
+} SourceMap;
+
+private SourceMap
+mapSourceFile(String fName) { //:mapSourceFile
+// Maps a source file for the lexer, with no copying: the file goes in after an anonymous page
+// which gets the standardText at its end, so the input is the standardText followed by the file
+// contents and a \0, just like "prepareInput" gives. The \0 comes from the zero tail of the last
+// page of the file, or from an extra anonymous page if the file ends on a page boundary.
+// @fName must be \0-terminated
+    SourceMap const noFile = (SourceMap){ .input = null, .inpLength = 0, .base = null, .len = 0 };
+    Ulong const lenStandard = sizeof(standardText) - 1;
+    Ulong const pageSize = (Ulong)sysconf(_SC_PAGESIZE);
+    Ulong const prefixLen = (lenStandard + pageSize - 1)/pageSize*pageSize;
+    int const fd = open(fName.cont, O_RDONLY);
+    if (fd < 0) {
+        return noFile;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return noFile;
+    }
+    Ulong const fileLen = (Ulong)st.st_size;
+    Ulong const len = prefixLen + (fileLen/pageSize + 1)*pageSize;
+    Byte* base = mmap(null, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return noFile;
+    }
+    Byte* file = mmap(base + prefixLen, fileLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                      fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        munmap(base, len);
+        return noFile;
+    }
+    memcpy(base + prefixLen - lenStandard, standardText, lenStandard);
+    return (SourceMap){ .input = (char const*)(base + prefixLen - lenStandard),
+                        .inpLength = (Long)(lenStandard + fileLen), .base = base, .len = len };
+}
+
+private void
+unmapSourceFile(SourceMap m) { //:unmapSourceFile
+// The source is needed until the end of code generation, but not by the interpreter
+    if (m.base != null) {
+        munmap(m.base, m.len);
     }
+}
 
-    memcpy(result, standardText, lenStandard);
-    // Read the entire file into memory
-    size_t lenSource = fread(result + lenStandard, 1, fileSize, file);
-    Int const len = lenStandard + lenSource;
-    if (ferror(file) != 0 ) {
-        fputs("Error reading file", stderr);
-    } else {
-        result[len] = '\0'; // Just to be safe
+private Bool
+writeTextFile(String fName, String content) { //:writeTextFile
+// @fName must be \0-terminated
+    FILE *file = fopen(fName.cont, "w");
+    if (file == null) {
+        return false;
     }
-    cleanup:
-    fclose(file);
-    return (String){.cont = result, .len = len};
+    Bool const wasWritten = fwrite(content.cont, 1, content.len, file) == (size_t)content.len;
+    return (fclose(file) == 0) && wasWritten;
 }
 
 testable String
@@ -1997,13 +2499,7 @@ nameOfStandard(Int strId) { //:nameOfStandard
 
 private void
 skipSpaces(Arr(char const) source, LX) { //:skipSpaces
-    while (lx->i < lx->stats.inpLength) {
-        Byte currBt = CURR_BT;
-        if (!isSpace(currBt)) {
-            return;
-        }
-        lx->i += 1;
-    }
+    lx->i = spaceRunEnd(source, lx->i, lx->stats.inpLength);
 }
 
 
@@ -2040,7 +2536,7 @@ throwExcInternal0(Int errInd, Int lineNumber, CM) {
     printf("Internal error %d at line %d\n", errInd, lineNumber);
     cm->stats.errMsg = stringOfInt(errInd, cm->a);
     printString(cm->stats.errMsg);
-    longjmp(excBuf, 1);
+    longjmp(cm->excBuf, 1);
 }
 
 #define throwExcInternal(errInd, cm) throwExcInternal0(errInd, __LINE__, cm)
@@ -2050,10 +2546,10 @@ throwExcLexer0(char const errMsg[], Int lineNumber, LX) {
 // Sets i to beyond input's length to communicate to callers that lexing is over
     lx->stats.wasLexerError = true;
 #ifdef DEBUG
-    printf("Error on code line %d, i = %d: %s\n", lineNumber, IND_BT, errMsg);
+    printf("Error on code line %d, i = %lld: %s\n", lineNumber, (long long)IND_BT, errMsg);
 #endif
     lx->stats.errMsg = str(errMsg);
-    longjmp(excBuf, 1);
+    longjmp(lx->excBuf, 1);
 }
 
 #define throwExcLexer(msg) throwExcLexer0(msg, __LINE__, lx)
@@ -2067,11 +2563,24 @@ checkPrematureEnd(Int requiredSymbols, LX) { //:checkPrematureEnd
     VALIDATEL(lx->i + requiredSymbols <= lx->stats.inpLength, errPrematureEndOfInput)
 }
 
+private Long
+lexTokStart(Int tokenInd, LX) { //:lexTokStart
+// The offset of a lexed token relative to the lexer's window. It's negative for the tokens of the
+// previous windows, which have absolute offsets by now, see "lexRebase"
+    InListTokenBase const bases = lx->tokenBases;
+    if (bases.len == 0 || tokenInd >= bases.cont[bases.len - 1].tokenInd) {
+        return (Int)lx->tokens.cont[tokenInd].startBt;
+    }
+    return tokStartBt(tokenInd, lx) - lx->windowStart;
+}
+
 private void
 setSpanLengthLexer(Int tokenInd, LX) { //:setSpanLengthLexer
 // Finds the top-level punctuation opener by its index, and sets its lengths.
 // Called when the matching closer is lexed. Does not pop anything from the "lexBtrack"
-    lx->tokens.cont[tokenInd].lenBts = lx->i - lx->tokens.cont[tokenInd].startBt + 1;
+    Long const lenBts = lx->i - lexTokStart(tokenInd, lx) + 1;
+    VALIDATEL(lenBts < MAXTOKENLEN, errTokenLengthExceeded)
+    lx->tokens.cont[tokenInd].lenBts = lenBts;
     lx->tokens.cont[tokenInd].pl2 = lx->tokens.len - tokenInd - 1;
 }
 
@@ -2086,7 +2595,9 @@ getLexContext(LX) { //:getLexContext
 private void
 setStmtSpanLength(Int spanInd, LX) { //:setStmtSpanLength
 // Correctly calculates the lenBts for a single-line, statement-type span.
-    lx->tokens.cont[spanInd].lenBts = lx->i - lx->tokens.cont[spanInd].startBt;
+    Long const lenBts = lx->i - lexTokStart(spanInd, lx);
+    VALIDATEL(lenBts < MAXTOKENLEN, errTokenLengthExceeded)
+    lx->tokens.cont[spanInd].lenBts = lenBts;
     lx->tokens.cont[spanInd].pl2 = lx->tokens.len - spanInd - 1;
 }
 
@@ -2112,7 +2623,7 @@ wrapInAStatementStarting(Int startBt, Arr(char const) source, LX) {
 private void
 wrapInAStatement(Arr(char const) source, LX) { //:wrapInAStatement
     if (hasValues(lx->lexBtrack)) {
-        auto spanLevel = peek(lx->lexBtrack).spanLevel;
+        Unt const spanLevel = peek(lx->lexBtrack).spanLevel;
         if (spanLevel == slScope || spanLevel == slUnbraced) {
             addStatementSpan(tokStmt, lx->i, lx);
         }
@@ -2426,10 +2937,8 @@ wordChunk(SRC, LX) { //:wordChunk
         result = true;
     } else VALIDATEL(isLowercaseLetter(currBt), errWordChunkStart)
 
-    lx->i += 1; // CONSUME the first letter of the word
-    while (lx->i < lx->stats.inpLength && isAlphanumeric(CURR_BT)) {
-        lx->i += 1; // CONSUME alphanumeric characters
-    }
+    lx->i = wordRunEnd(source, lx->i + 1, lx->stats.inpLength);
+    // CONSUME the first letter and the alphanumeric characters after it
     return result;
 }
 
@@ -2565,7 +3074,8 @@ wordInternal(Unt wordType, SRC, LX) { //:wordInternal
     // accounting for the initial ".", ":" or other symbol
     Int lenString = lx->i - startBt;
     VALIDATEL(lenString <= maxWordLength, errWordLengthExceeded)
-    Int stringId = addStringDict(source, startBt, lenString, lx->stringTable, lx->stringDict);
+    Int stringId = addStringDict(lx->sourceCode, lx->windowStart + startBt, lenString,
+                                 lx->stringTable, lx->stringDict);
     if (stringId - countOperators < strFirstNonReserved)  {
         wordReserved(wordType, stringId - countOperators, startBt, realStartBt, source, lx);
     } else {
@@ -2586,7 +3096,8 @@ lexDot(SRC, LX) { //:lexDot
         errUnexpectedToken);
     Token prevTok = lx->tokens.cont[lx->tokens.len - 1];
     lx->i += 1; // CONSUME the dot
-    VALIDATEL(prevTok.tp == tokWord && lx->i == (prevTok.startBt + prevTok.lenBts + 1),
+    VALIDATEL(prevTok.tp == tokWord
+              && lx->i == lexTokStart(lx->tokens.len - 1, lx) + prevTok.lenBts + 1,
             errWordFreeFloatingFieldAcc);
     wordInternal(tokFieldAcc, source, lx);
 }
@@ -2652,7 +3163,7 @@ lexTilde(SRC, LX) { //:lexTilde
     Int const lastInd = lx->tokens.len - 1;
     VALIDATEL(lx->tokens.len > 0, errWordTilde)
     Token lastTk = lx->tokens.cont[lastInd];
-    VALIDATEL(lx->tokens.cont[lastInd].tp == tokWord && (lastTk.startBt + lastTk.lenBts == lx->i),
+    VALIDATEL(lastTk.tp == tokWord && lexTokStart(lastInd, lx) + lastTk.lenBts == lx->i,
               errWordTilde)
     lx->tokens.cont[lastInd].pl2 = 1;
     lx->tokens.cont[lastInd].lenBts = lastTk.lenBts + 1;
@@ -2741,15 +3252,9 @@ lexUnderscore(SRC, LX) { //:lexUnderscore
 
 private void
 lexNewline(SRC, LX) { //:lexNewline
-    pushInnewlines(lx->i, lx);
-
-    lx->i += 1;     // CONSUME the LF
-    while (lx->i < lx->stats.inpLength) {
-        if (!isSpace(CURR_BT)) {
-            break;
-        }
-        lx->i += 1; // CONSUME a space or tab
-    }
+    pushInnewlines((Unt)(lx->windowStart + lx->i), lx);
+    lx->i = spaceRunEnd(source, lx->i + 1, lx->stats.inpLength);
+    // CONSUME the LF and the spaces and LFs after it
 }
 
 private void
@@ -2757,11 +3262,8 @@ lexComment(SRC, LX) { //:lexComment
 // Eyr separates between documentation comments (which live in meta info and are
 // spelt as "meta(`comment`)") and comments for, well, eliding text from code;
 // Elision comments are of the "//" form.
-    lx->i += 2; // CONSUME the "//"
-
-    for (;lx->i < lx->stats.inpLength - 1 && CURR_BT != aNewline; lx->i += 1) {
-        // CONSUME the comment
-    }
+    lx->i = byteFind(source, lx->i + 2, lx->stats.inpLength - 1, aNewline);
+    // CONSUME the "//" and the comment
 }
 
 private void
@@ -2922,18 +3424,16 @@ lexPipe(SRC, LX) { //:lexPipe
 
 private void
 lexSpace(SRC, LX) { //:lexSpace
-    lx->i += 1; // CONSUME the space
-    while (lx->i < lx->stats.inpLength && isSpace(CURR_BT)) {
-        lx->i += 1; // CONSUME a space
-    }
+    lx->i = spaceRunEnd(source, lx->i + 1, lx->stats.inpLength);
+    // CONSUME the space and the spaces and LFs after it
 }
 
 private void
 lexStringLiteral(SRC, LX) { //:lexStringLiteral
     wrapInAStatement(source, lx);
-    Int j = lx->i + 1;
-    for (; j < lx->stats.inpLength && source[j] != aBacktick; j++);
+    Int const j = byteFind(source, lx->i + 1, lx->stats.inpLength, aBacktick);
     VALIDATEL(j != lx->stats.inpLength, errPrematureEndOfInput)
+    VALIDATEL(j - lx->i + 1 < MAXTOKENLEN, errTokenLengthExceeded)
     pushIntokens((Token){.tp=tokString, .startBt=(lx->i), .lenBts=(j - lx->i + 1)}, lx);
     lx->i = j + 1; // CONSUME the string literal, including the closing quote character
 }
@@ -3017,6 +3517,7 @@ private void popScopeFrame(CM);
 private EntityId importActivateEntity(Entity ent, CM);
 private void createBuiltins(Compiler* cm);
 testable Compiler* createLexer(String sourceCode, Arena* a);
+private Compiler* createLexerOver(char const* input, Long inpLength, Arena* a);
 private void eLinearize(Int sentinel, TOKS, CM);
 private TypeId exprHeadless(Int sentinel, SourceLoc loc, TOKS, CM);
 private Int pExprWorker(Token tk, TOKS, CM);
@@ -3029,7 +3530,7 @@ throwExcParser0(char const errMsg[], Int lineNumber, CM) {
     printf("Error on i = %d line %d\n", cm->i, lineNumber);
 #endif
     cm->stats.errMsg = str(errMsg);
-    longjmp(excBuf, 1);
+    longjmp(cm->excBuf, 1);
 }
 
 #define throwExcParser(errMsg) throwExcParser0(errMsg, __LINE__, cm)
@@ -3095,23 +3596,48 @@ pAddAccessorCall(Int sentinel, SourceLoc loc, StateForExprs* s) {
     push(loc, s->locsCalls);
 }
 
+private Long
+startBtOf(Token tk, CM) { //:startBtOf
+// The offset in @sourceCode of a token near the one being parsed, which gives the higher bits that
+// the token lacks, see "tokStartBt"
+    if (cm->tokenBases.len == 0) {
+        return tk.startBt;
+    }
+    Long const nearBt = tokStartBt(cm->i < cm->tokens.len ? cm->i : cm->tokens.len - 1, cm);
+    return nearBt + (Int)(tk.startBt - (Unt)nearBt);
+}
+
+private SourceLoc
+locAt(Long startBt, Int lenBts) { //:locAt
+// A SourceLoc keeps the offset in 38 bits, which "lexicallyAnalyzeInput" ensures is enough
+    return (SourceLoc){ .startBt = (Unt)startBt, .lenBts = lenBts, .startBtHigh = startBt >> 32 };
+}
+
+private Long
+locStartBt(SourceLoc loc) { //:locStartBt
+    return ((Long)loc.startBtHigh << 32) | loc.startBt;
+}
+
+private SourceLoc
+locOf(Token tk, CM) { return locAt(startBtOf(tk, cm), tk.lenBts); }
+
 private void
-pAddUnaryCall(Token tok, StateForExprs* s) {
+pAddUnaryCall(Token tok, StateForExprs* s, CM) {
 //:pAddUnaryCall Pushes a unary, prefix call to the temporary stacks during expression parsing
     push(((ExprFrame) { .tp = exfrUnaryCall, .startNode = -1, .sentinel = -1,
                         .argCount = 1 }), s->frames);
     push(((Node) { .tp = nodCall, .pl1 = tok.pl1 }), s->calls);
-    push(((SourceLoc) { .startBt = tok.startBt, .lenBts = tok.lenBts }), s->locsCalls);
+    push(locOf(tok, cm), s->locsCalls);
 }
 
 private void
-pAddFunctionCall(Token tk, Int sentinel, StateForExprs* s) {
+pAddFunctionCall(Token tk, Int sentinel, StateForExprs* s, CM) {
 //:pAddFunctionCall Pushes a call to the temporary stacks during expression parsing
     push(
         ((ExprFrame) {.tp = exfrCall, .sentinel = sentinel, .argCount = 0 }),
         s->frames);
     push(((Node) { .tp = nodCall, .pl1 = tk.pl1 }), s->calls);
-    push(((SourceLoc) { .startBt = tk.startBt, .lenBts = tk.lenBts }), s->locsCalls);
+    push(locOf(tk, cm), s->locsCalls);
 }
 
 void
@@ -3161,9 +3687,6 @@ void printIntArrayOff(Int startInd, Int count, Arr(Int) arr);
 
 //}}}
 
-private SourceLoc
-locOf(Token tk) { return (SourceLoc){.startBt = tk.startBt, .lenBts = tk.lenBts}; }
-
 private void
 openParsedScope(Int sentinelToken, SourceLoc loc, CM) {
 //:openParsedScope Performs coordinated insertions to start a scope within the parser
@@ -3181,7 +3704,7 @@ openFnScope(EntityId fnEntity, NameId name, TypeId fnType, Token fnTk, Int senti
                         .typeId = fnType }), cm->backtrack);
     pushLexScope(cm->scopeStack); // a function body is also a lexical scope
     addNode((Node){ .tp = nodFnDef, .pl1 = fnEntity, .pl3 = (name & LOWER24BITS)},
-            locOf(fnTk), cm);
+            locOf(fnTk, cm), cm);
 }
 
 private void
@@ -3190,7 +3713,7 @@ pMisc(Token tok, TOKS, CM) {
 
 private void
 pScope(Token tok, TOKS, CM) { //:pScope
-    openParsedScope(cm->i + tok.pl2, locOf(tok), cm);
+    openParsedScope(cm->i + tok.pl2, locOf(tok, cm), cm);
 }
 
 private void
@@ -3199,7 +3722,7 @@ parseTry(Token tok, TOKS, CM) {
 }
 
 
-private void ifFindNextClause(Int start, Int sentinel, OUT Int* nextTokenInd, OUT Int* lastLastByte,
+private void ifFindNextClause(Int start, Int sentinel, OUT Int* nextTokenInd, OUT Unt* lastLastByte,
                               TOKS) { //:ifFindNextClause
 // Finds the next clause inside an "if" syntax form. Returns the index of that clause's first token
 // and the last byte (of course exclusive, so the byte after) of the last token/span before that
@@ -3233,7 +3756,7 @@ ifCondition(Token tok, TOKS, CM) { //:ifCondition
 // Precondition: we are 1 past the "stmt" token, which is the first parameter
     Int leftSentinel = calcSentinel(tok, cm->i - 1);
     VALIDATEP(tok.tp == tokElseIf, errIfLeft)
-    VALIDATEP(leftSentinel + 1 < cm->stats.inpLength, errPrematureEndOfTokens)
+    VALIDATEP(leftSentinel + 1 < cm->tokens.len, errPrematureEndOfTokens)
 
     TypeId typeLeft = pExprWorker(tok, toks, cm);
     VALIDATEP(typeLeft == tokBool, errTypeMustBeBool)
@@ -3254,10 +3777,10 @@ private void
 pIf(Token tok, TOKS, CM) { //:pIf
     Int const ifSentinel = cm->i + tok.pl2;
     Int indNextClause;
-    Int lastByteBeforeNextClause;
+    Unt lastByteBeforeNextClause; // the lower 32 bits, like in a Token
     ifFindNextClause(cm->i, ifSentinel, OUT &indNextClause, OUT &lastByteBeforeNextClause, toks);
 
-    ifOpenSpan(nodIf, ifSentinel, indNextClause, locOf(tok), cm);
+    ifOpenSpan(nodIf, ifSentinel, indNextClause, locOf(tok, cm), cm);
 
     Token stmtTok = toks[cm->i];
     cm->i += 1; // CONSUME the stmt token
@@ -3266,12 +3789,12 @@ pIf(Token tok, TOKS, CM) { //:pIf
     Token scopeTok = toks[cm->i];
     if (indNextClause > 0) {
         VALIDATEP(indNextClause > cm->i, errIfEmpty)
-        SourceLoc loc = { .startBt = scopeTok.startBt,
-                          .lenBts = lastByteBeforeNextClause - scopeTok.startBt};
+        SourceLoc loc = locAt(startBtOf(scopeTok, cm),
+                              (Int)(lastByteBeforeNextClause - scopeTok.startBt));
         openParsedScope(indNextClause, loc, cm);
     } else {
         lastByteBeforeNextClause = tok.startBt + tok.lenBts;
-        openParsedScope(ifSentinel, locOf(scopeTok), cm);
+        openParsedScope(ifSentinel, locOf(scopeTok, cm), cm);
     }
 }
 
@@ -3279,12 +3802,12 @@ private void
 pElseIf(Token tok, TOKS, CM) { //:pElseIf
 // ElseIf spans go inside an if: (if expr (scope ...) (elseif expr (scope ...))
     Int const ifSentinel = cm->i + tok.pl2;
-    ifOpenSpan(nodElseIf, ifSentinel, 0, locOf(tok), cm);
+    ifOpenSpan(nodElseIf, ifSentinel, 0, locOf(tok, cm), cm);
 
     Token stmtTok = toks[cm->i];
     cm->i += 1; // CONSUME the stmt token
     ifCondition(stmtTok, toks, cm);
-    openParsedScope(ifSentinel, locOf(tok), cm);
+    openParsedScope(ifSentinel, locOf(tok, cm), cm);
 }
 
 private void
@@ -3293,8 +3816,8 @@ pElse(Token tok, TOKS, CM) { //:pElse
     mbCloseSpans(cm);
 
     Int const ifSentinel = cm->i + tok.pl2;
-    ifOpenSpan(nodElseIf, ifSentinel, 0, locOf(tok), cm);
-    openParsedScope(ifSentinel, locOf(tok), cm);
+    ifOpenSpan(nodElseIf, ifSentinel, 0, locOf(tok, cm), cm);
+    openParsedScope(ifSentinel, locOf(tok, cm), cm);
 }
 
 private TypeId
@@ -3317,11 +3840,10 @@ assignmentComplexLeftSide(Int sentinel, TOKS, CM) { //:assignmentComplexLeftSide
         push(j, sc);
     }
 
-    Int startBt = firstTk.startBt;
-    Int lastBt = toks[j - 1].startBt + toks[j - 1].lenBts;
+    Unt const lastBt = toks[j - 1].startBt + toks[j - 1].lenBts;
     TypeId leftType = exprUpToWithFrame(
             (ParseFrame){ .tp = nodExpr, .startNodeInd = cm->nodes.len, .sentinel = sentinel },
-            (SourceLoc){.startBt = startBt, .lenBts = lastBt - startBt }, toks, cm);
+            locAt(startBtOf(firstTk, cm), (Int)(lastBt - firstTk.startBt)), toks, cm);
 
     // we also need to mutate the last opGetElem to opGetElemPtr, but we do that in
     // "assignmentMutateComplexLeft"
@@ -3335,9 +3857,9 @@ assignmentMutateComplexLeft(Int rightNodeInd, TOKS, CM) {
     Node lastNode = cm->nodes.cont[rightNodeInd - 1];
     if (lastNode.tp == nodCall)  {
 #ifdef SAFETY
-        VALIDATEI(lastNode.pl1 == opGetElem, iErrorArrayElemButShouldBePtr)
+        VALIDATEI(lastNode.pl1 == typeAccessorEntity(opGetElem, cm), iErrorArrayElemButShouldBePtr)
 #endif
-        cm->nodes.cont[rightNodeInd - 1].pl1 = opGetElemPtr;
+        cm->nodes.cont[rightNodeInd - 1].pl1 = typeAccessorEntity(opGetElemPtr, cm);
     }
 }
 
@@ -3350,7 +3872,7 @@ pAssignmentRight(TypeId leftType, Token rightTk, Int sentinel, TOKS, CM) {
     } else {
         TypeId rightType = exprUpToWithFrame(
                 (ParseFrame){ .tp = nodExpr, .startNodeInd = cm->nodes.len, .sentinel = sentinel },
-                locOf(rightTk), toks, cm);
+                locOf(rightTk, cm), toks, cm);
         VALIDATEP(rightType != -2, errAssignment)
         return rightType;
     }
@@ -3370,7 +3892,7 @@ pAssignmentWorker(Token tok, Assignment assignment, TOKS, CM) {
     Int const assignmentNodeInd = cm->nodes.len;
     push(((ParseFrame){.tp = tp, .startNodeInd = assignmentNodeInd,
                        .sentinel = assignment.sentinel}), cm->backtrack);
-    addNode((Node){ .tp = tp}, locOf(tok), cm);
+    addNode((Node){ .tp = tp}, locOf(tok, cm), cm);
     if (countLeftSide == 1)  {
         Token nameTk = toks[cm->i];
         NameId newName = (Unt)nameTk.pl1;
@@ -3385,7 +3907,7 @@ pAssignmentWorker(Token tok, Assignment assignment, TOKS, CM) {
                     nameTk.pl2 == 1 ? classMut: classImmut, cm
             );
         }
-        addNode((Node){ .tp = nodBinding, .pl1 = entityId, .pl2 = 0 }, locOf(nameTk), cm);
+        addNode((Node){ .tp = nodBinding, .pl1 = entityId, .pl2 = 0 }, locOf(nameTk, cm), cm);
     } ei (countLeftSide > 1) {
         leftType = assignmentComplexLeftSide(cm->i + countLeftSide, toks, cm);
     }
@@ -3404,6 +3926,7 @@ pAssignmentWorker(Token tok, Assignment assignment, TOKS, CM) {
     } ei (leftType > -1 && rightType > -1) {
         VALIDATEP(leftType == rightType, errTypeMismatch)
     }
+    foldRecordBinding(entityId, rightNodeInd, cm);
 
     mbCloseSpans(cm);
 }
@@ -3415,7 +3938,11 @@ pAssignment(Token tok, TOKS, CM) { //:pAssignment
         pTypeDef(toks, cm);
         return;
     }
-    pAssignmentWorker(tok, (Assignment), toks, cm);
+    Int const sentinel = calcSentinel(tok, cm->i - 1);
+    Int indRight = cm->i;
+    for (; indRight < sentinel && toks[indRight].tp != tokAssignRight; indRight += 1) {}
+    pAssignmentWorker(tok, (Assignment){.tokenInd = cm->i, .rightTokenInd = indRight,
+                                        .sentinel = sentinel}, toks, cm);
 }
 
 private void
@@ -3506,12 +4033,12 @@ pFor(Token forTk, TOKS, CM) { //:pFor
 
     push(((ParseFrame){ .tp = nodFor, .startNodeInd = cm->nodes.len, .sentinel = sentinel,
                         .typeId = cm->stats.loopCounter }), cm->backtrack);
-    addNode((Node){.tp = nodFor}, locOf(forTk), cm);
+    addNode((Node){.tp = nodFor}, locOf(forTk, cm), cm);
 
     // variable initialization
     Int sndInd = minPositiveOf(3, condInd, stepInd, bodyInd);
     if (sndInd > initInd) {
-        openParsedScope(sentinel, locOf(forTk), cm);
+        openParsedScope(sentinel, locOf(forTk, cm), cm);
         for (cm->i = initInd; cm->i < sndInd;) {
             // parse assignments
             Token tok = toks[cm->i];
@@ -3530,17 +4057,17 @@ pFor(Token forTk, TOKS, CM) { //:pFor
                 (ParseFrame){ .tp = nodExpr, .startNodeInd = cm->nodes.len,
                               .sentinel = minPositiveOf(3, stepInd, bodyInd, sentinel),
                               .typeId = cm->stats.loopCounter },
-                locOf(condTok), toks, cm);
+                locOf(condTok, cm), toks, cm);
         VALIDATEP(condTypeId == tokBool, errTypeMustBeBool)
     }
 
     // readying to parse the body + step statements
-    Int bodyStartBt = toks[sndInd].startBt;
+    Token const bodyTk = toks[sndInd];
     Int const bodyNodeInd = cm->nodes.len;
 
     cm->nodes.cont[forNodeInd].pl3 = bodyNodeInd - forNodeInd; // distance to inner scope
-    openParsedScope(sentinel, (SourceLoc) {.startBt = bodyStartBt,
-                                           .lenBts = forTk.lenBts - bodyStartBt + forTk.startBt },
+    openParsedScope(sentinel,
+                    locAt(startBtOf(bodyTk, cm), forTk.lenBts - (bodyTk.startBt - forTk.startBt)),
                     cm);
 
     cm->i = minPositiveOf(2, stepInd, bodyInd); // CONSUME the "for" until the loop body + step
@@ -3577,15 +4104,20 @@ exprSingleItem(Token tk, CM) { //:exprSingleItem
     if (tk.tp == tokWord) {
         Int varId = getActiveVar(tk.pl1, cm);
         typeId = getTypeOfVar(varId, cm);
-        addNode((Node){.tp = nodId, .pl1 = varId, .pl2 = tk.pl1}, locOf(tk), cm);
+        Int const literalInd = foldLiteralOf(varId, cm);
+        if (literalInd > -1) { // an immutable with a known value
+            addNode(cm->nodes.cont[literalInd], cm->sourceLocs->cont[literalInd], cm);
+        } else {
+            addNode((Node){.tp = nodId, .pl1 = varId, .pl2 = tk.pl1}, locOf(tk, cm), cm);
+        }
     } ei (tk.tp == tokOperator) {
         Int operBindingId = tk.pl1;
         OpDef operDefinition = OPERATORS[operBindingId];
         VALIDATEP(operDefinition.arity == 1, errOperatorWrongArity)
-        addNode((Node){ .tp = nodId, .pl1 = operBindingId}, locOf(tk), cm);
+        addNode((Node){ .tp = nodId, .pl1 = operBindingId}, locOf(tk, cm), cm);
         // TODO add the type when we support first-class functions
     } ei (tk.tp <= topVerbatimType) {
-        addNode((Node){.tp = tk.tp, .pl1 = tk.pl1, .pl2 = tk.pl2}, locOf(tk), cm);
+        addNode((Node){.tp = tk.tp, .pl1 = tk.pl1, .pl2 = tk.pl2}, locOf(tk, cm), cm);
         typeId = tk.tp;
     } else {
         throwExcParser(errUnexpectedToken);
@@ -3748,7 +4280,7 @@ eLinearize(Int sentinel, TOKS, CM) { //:eLinearize
         eClose(stEx, cm);
         ExprFrame parent = peek(frames);
         Token cTk = toks[cm->i];
-        SourceLoc loc = locOf(cTk);
+        SourceLoc loc = locOf(cTk, cm);
         Unt tokType = cTk.tp;
         if (tokType == tokWord && (cm->i + 1) < sentinel && toks[cm->i + 1].tp == tokAccessor) {
             // accessor like `a[i]`, but on this iteration we parse only the `a`
@@ -3757,13 +4289,13 @@ eLinearize(Int sentinel, TOKS, CM) { //:eLinearize
                     .sentinel = accSentinel }), frames);
             EntityId varId = getActiveVar(cTk.pl1, cm);
             push(((Node){ .tp = nodId, .pl1 = varId, .pl2 = cTk.pl1 }), scr);
-            push(locOf(cTk), locsScr);
+            push(locOf(cTk, cm), locsScr);
         } ei (tokType == tokAccessor) {
             // accessor like `a[i]`, now we parse the `[i]`
             Int const accSentinel = calcSentinel(cTk, cm->i);
             pAddAccessorCall(accSentinel, loc, stEx);
         } ei ((tokType == tokWord || tokType == tokOperator) && parent.tp == exfrParen) {
-            pAddFunctionCall(cTk, parent.sentinel, stEx);
+            pAddFunctionCall(cTk, parent.sentinel, stEx, cm);
         } ei (tokType <= topVerbatimTokenVariant || tokType == tokWord) {
             if (tokType == tokWord) {
                 EntityId varId = getActiveVar(cTk.pl1, cm);
@@ -3786,7 +4318,7 @@ eLinearize(Int sentinel, TOKS, CM) { //:eLinearize
             }
         } ei (tokType == tokOperator) {
             if (OPERATORS[cTk.pl1].arity == 1) {
-                pAddUnaryCall(cTk, stEx);
+                pAddUnaryCall(cTk, stEx, cm);
             } else {
                 push(((Node){ .tp = nodId, .pl2 = cTk.pl1 }), scr);
                 push(loc, locsScr);
@@ -3828,6 +4360,7 @@ exprUpToWithFrame(ParseFrame frame, SourceLoc loc, TOKS, CM) {
     eLinearize(frame.sentinel, toks, cm);
     exprCopyFromScratch(startNodeInd, cm);
     Int exprType = typeCheckBigExpr(startNodeInd, cm->nodes.len, cm);
+    foldConstants(startNodeInd, cm);
     mbCloseSpans(cm);
     return exprType;
 }
@@ -3847,6 +4380,7 @@ exprUpTo(Int sentinelToken, SourceLoc loc, TOKS, CM) { //:exprUpTo
     eLinearize(sentinelToken, toks, cm);
     exprCopyFromScratch(startNodeInd, cm);
     Int exprType = typeCheckBigExpr(startNodeInd, cm->nodes.len, cm);
+    foldConstants(startNodeInd, cm);
     return exprType;
 }
 
@@ -3880,7 +4414,7 @@ pExprWorker(Token tok, TOKS, CM) { //:pExprWorker
             }
         }
 
-        return exprUpTo(cm->i + tok.pl2, locOf(tok), toks, cm);
+        return exprUpTo(cm->i + tok.pl2, locOf(tok, cm), toks, cm);
     } else {
         return exprSingleItem(tok, cm);
     }
@@ -3994,7 +4528,7 @@ pBreakCont(Token tok, TOKS, CM) { //:pBreakCont
     if (tok.pl1 > 0) { // continue
         loopId += BIG;
     }
-    addNode((Node){.tp = nodBreakCont, .pl1 = loopId}, locOf(tok), cm);
+    addNode((Node){.tp = nodBreakCont, .pl1 = loopId}, locOf(tok, cm), cm);
     cm->i = sentinel; // CONSUME the whole break statement
 }
 
@@ -4055,10 +4589,10 @@ pReturn(Token tok, TOKS, CM) { //:pReturn
 
     push(((ParseFrame){ .tp = nodReturn, .startNodeInd = cm->nodes.len,
                         .sentinel = sentinelToken }), cm->backtrack);
-    addNode((Node){.tp = nodReturn}, locOf(tok), cm);
+    addNode((Node){.tp = nodReturn}, locOf(tok, cm), cm);
 
     Token rTk = toks[cm->i];
-    SourceLoc loc = {.startBt = rTk.startBt, .lenBts = tok.lenBts - rTk.startBt + tok.startBt};
+    SourceLoc loc = locAt(startBtOf(rTk, cm), tok.lenBts - (rTk.startBt - tok.startBt));
     Int typeId = exprHeadless(sentinelToken, loc, toks, cm);
     VALIDATEP(typeId > -1, errReturn)
     if (typeId > -1) {
@@ -4088,12 +4622,12 @@ importEntities(Arr(Entity) impts, Int countEntities, CM) { //:importEntities
     cm->stats.countNonparsedEntities = cm->entities.len;
 }
 
-private StackUnt*
-copyStringTable(StackUnt* table, Arena* a) { //:copyStringTable
-    StackUnt* result = createStackuint32_t(table->cap, a);
+private StackNameSpan*
+copyStringTable(StackNameSpan* table, Arena* a) { //:copyStringTable
+    StackNameSpan* result = createStackuint64_t(table->cap, a);
     result->len = table->len;
     result->cap = table->cap;
-    memcpy(result->cont, table->cont, table->len*4);
+    memcpy(result->cont, table->cont, table->len*sizeof(NameSpan));
     return result;
 }
 
@@ -4119,6 +4653,7 @@ copyStringDict(StringDict* from, Arena* a) { //:copyStringDict
     }
     result->dictSize = dictSize;
     result->dict = dict;
+    result->len = from->len;
     return result;
 }
 
@@ -4129,10 +4664,10 @@ createProtoCompiler(OUT Compiler* proto, Arena* a) { //:createProtoCompiler
 // - types that are sufficient for the built-in operators
 // - entities with the built-in operator entities
 // - overloadIds with counts
-    Stackuint32_t* st = createStackuint32_t(16, a);
+    StackNameSpan* st = createStackuint64_t(16, a);
     (*proto) = (Compiler){
         .entities = createInListEntity(32, a),
-        .sourceCode = str(standardText),
+        .sourceCode = standardText,
         .stringTable = st, .stringDict = createStringDict(128, a),
         .types = createInListInt(64, a), .typesDict = createStringDict(128, a),
         .activeBindings = allocateArray(countOperators, Int, a),
@@ -4157,25 +4692,65 @@ finalizeLexer(LX) { //:finalizeLexer
     VALIDATEL(top.spanLevel != slScope && !hasValues(lx->lexBtrack), errPunctuationExtraOpening)
 }
 
-testable Compiler*
-lexicallyAnalyze(String sourceCode, Arena* a) {
-//:lexicallyAnalyze Main lexer function. Precondition: the input Byte array has been prepended
-// with StandardText
-    Compiler* lx = createLexer(sourceCode, a);
-    Int const inpLength = lx->stats.inpLength;
-    Arr(char const) inp = lx->sourceCode.cont;
-    VALIDATEL(inpLength > 0, "Empty input")
+private void
+lexMakeStartsAbsolute(LX) { //:lexMakeStartsAbsolute
+// The tokens of the current window get the lower 32 bits of their offsets in @sourceCode
+    InListTokenBase const bases = lx->tokenBases;
+    if (bases.len == 0) {
+        return;
+    }
+    Unt const windowStart = (Unt)lx->windowStart;
+    for (Int j = bases.cont[bases.len - 1].tokenInd; j < lx->tokens.len; j++) {
+        lx->tokens.cont[j].startBt += windowStart;
+    }
+}
+
+private Int
+lexRebase(LX) { //:lexRebase
+// Offsets in the lexer are Ints, so in an input longer than 2 GB it lexes through a window which
+// moves forward every LEX_REBASE_AT bytes. Each token can go LEX_WINDOW - LEX_REBASE_AT bytes
+// past that, which is only too little for a giant comment: the scanners would stop at the end of
+// the window as if it were the end of the input. Returns the new window length
+    VALIDATEL(lx->i < lx->stats.inpLength - 1
+              || lx->windowStart + lx->stats.inpLength == lx->inpLength, errLexemeLengthExceeded)
+    lexMakeStartsAbsolute(lx);
+    lx->windowStart += lx->i;
+    lx->i = 0;
+    pushIntokenBases((TokenBase){ .tokenInd = lx->tokens.len, .startBt = lx->windowStart }, lx);
+    Long const remaining = lx->inpLength - lx->windowStart;
+    lx->stats.inpLength = (Int)(remaining < LEX_WINDOW ? remaining : LEX_WINDOW);
+    return lx->stats.inpLength;
+}
+
+private Compiler*
+lexicallyAnalyzeInput(char const* input, Long inpLength, Arena* a) {
+//:lexicallyAnalyzeInput Main lexer function. Precondition: the input has been prepended
+// with StandardText, by "prepareInput" or "mapSourceFile"
+    Compiler* lx = createLexerOver(input, inpLength, a);
+    Int windowLength = lx->stats.inpLength;
 
     // Main loop over the input
-    if (setjmp(excBuf) == 0) {
-        while (lx->i < inpLength) {
-            (LEX_TABLE[inp[lx->i]])(inp, lx);
+    if (setjmp(lx->excBuf) == 0) {
+        VALIDATEL(windowLength > 0, "Empty input")
+        VALIDATEL(inpLength < LEX_MAX_INPUT, errInputTooLong)
+        while (lx->i < windowLength) {
+            (LEX_TABLE[input[lx->windowStart + lx->i]])(input + lx->windowStart, lx);
+            if (lx->i >= LEX_REBASE_AT) {
+                windowLength = lexRebase(lx);
+            }
         }
         finalizeLexer(lx);
+        lexMakeStartsAbsolute(lx);
     }
     return lx;
 }
 
+testable Compiler*
+lexicallyAnalyze(String sourceCode, Arena* a) { //:lexicallyAnalyze
+    String input = prepareInput(sourceCode.cont, a);
+    return lexicallyAnalyzeInput(input.cont, sourceCode.len + sizeof(standardText) - 1, a);
+}
+
 struct
 ScopeStackFrame {
 // This frame corresponds either to a lexical scope or a subexpression.
@@ -4280,7 +4855,8 @@ pushLexScope(ScopeStack* scopeStack) { //:pushLexScope
 
 private void
 resizeScopeArrayIfNecessary(Int initLength, ScopeStackFrame* topScope,
-                            ScopeStack* scopeStack) { //:resizeScopeArrayIfNecessary
+                            CM) { //:resizeScopeArrayIfNecessary
+    ScopeStack* scopeStack = cm->scopeStack;
     int newLength = scopeStack->topScope->len + 1;
     if (newLength == initLength) {
         int remainingSpace = scopeStack->currChunk->len - scopeStack->nextInd + 1;
@@ -4293,14 +4869,14 @@ resizeScopeArrayIfNecessary(Int initLength, ScopeStackFrame* topScope,
             topScope->bindings = newContent;
         }
     } ei (newLength == 256) {
-        longjmp(excBuf, 1);
+        throwExcInternal(iErrorTooManyBindings, cm);
     }
 }
 
 private void
 addBinding(NameId nameId, Int bindingId, CM) { //:addBinding
     ScopeStackFrame* topScope = cm->scopeStack->topScope;
-    resizeScopeArrayIfNecessary(64, topScope, cm->scopeStack);
+    resizeScopeArrayIfNecessary(64, topScope, cm);
 
     topScope->bindings[topScope->len] = nameId;
     topScope->len += 1;
@@ -4432,15 +5008,17 @@ buildStandardStrings(LX) { //:buildStandardStrings
         push(0, lx->stringTable);
     }
     for (Int i = 0; i < strSentinel; i++) {
-        addStringDict(lx->sourceCode.cont, standardOffsets[i], standardStringLens[i],
+        addStringDict(lx->sourceCode, standardOffsets[i], standardStringLens[i],
                       lx->stringTable, lx->stringDict);
     }
 }
 
 private Unt
 stToFullName(Int sta, CM) { //:stToFullName
-// Converts a standard string to its nameId. Doesn't work for reserved words, obviously
-    return cm->stringTable->cont[sta + countOperators];
+// Converts a standard string to its NameLoc. Doesn't work for reserved words, obviously.
+// The standard strings are at the start of every input, so they always fit into a NameLoc
+    NameSpan const span = cm->stringTable->cont[sta + countOperators];
+    return ((Unt)nameSpanLen(span) << 24) + (Unt)nameSpanStart(span);
 }
 
 private void
@@ -4635,24 +5213,25 @@ importPrelude(CM) { //:importPrelude
     importEntities(imports, sizeof(imports)/sizeof(Entity), cm);
 }
 
-testable Compiler*
-createLexer(String sourceCode, Arena* a) {
-//:createLexer A proto compiler contains just the built-in definitions and tables. This fn
-// copies it and performs initialization. Post-condition: i has been incremented by the
-// standardText size
-    if (!_wasInit) {
-        initCompiler();
-    }
+private Compiler*
+createLexerOver(char const* input, Long inpLength, Arena* a) {
+//:createLexerOver A proto compiler contains just the built-in definitions and tables. This fn
+// copies it and performs initialization. @input is prefixed with the standardText.
+// Post-condition: i has been incremented by the standardText size
+    initCompiler();
     Compiler* lx = allocate(Compiler, a);
     Arena* aTmp = createArena();
 
     (*lx) = (Compiler){
         // this assumes that the source code is prefixed with the "standardText"
         .i = sizeof(standardText) - 1,
-        .sourceCode = prepareInput(sourceCode.cont, a),
+        .sourceCode = input,
+        .inpLength = inpLength,
+        .windowStart = 0,
+        .tokenBases = createInListTokenBase(4, a),
         .tokens = createInListToken(LEXER_INIT_SIZE, a),
         .metas = createInListToken(100, a),
-        .newlines = createInListInt(500, a),
+        .newlines = createInListuint32_t(500, a),
         .numeric = createInListInt(50, aTmp),
         .lexBtrack = createStackBtToken(16, aTmp),
         .stringTable = copyStringTable(PROTO.stringTable, a),
@@ -4660,7 +5239,7 @@ createLexer(String sourceCode, Arena* a) {
         .a = a, .aTmp = aTmp
     };
     lx->stats = (CompStats){
-        .inpLength = sourceCode.len + sizeof(standardText) - 1,
+        .inpLength = (Int)(inpLength < LEX_WINDOW ? inpLength : LEX_WINDOW),
         .countOverloads = PROTO.stats.countOverloads,
         .countOverloadedNames = PROTO.stats.countOverloadedNames,
         .wasLexerError = false, .wasError = false, .errMsg = empty
@@ -4668,6 +5247,12 @@ createLexer(String sourceCode, Arena* a) {
     return lx;
 }
 
+testable Compiler*
+createLexer(String sourceCode, Arena* a) { //:createLexer
+    String input = prepareInput(sourceCode.cont, a);
+    return createLexerOver(input.cont, sourceCode.len + sizeof(standardText) - 1, a);
+}
+
 testable void
 initializeParser(Compiler* lx, Arena* a) { //:initializeParser
 // Turns a lexer into a parser. Initializes all the parser & typer stuff after lexing is done
@@ -4681,7 +5266,6 @@ initializeParser(Compiler* lx, Arena* a) { //:initializeParser
     cm->i = 0;
     cm->stats = (CompStats){
         .loopCounter = 0,
-        .len = sizeof(standardText) - 1,
         .firstParsed = (strSentinel + countOperators),
         .firstBuiltin = countOperators
     }; 
@@ -4689,6 +5273,7 @@ initializeParser(Compiler* lx, Arena* a) { //:initializeParser
     cm->sourceLocs = createStackSourceLoc(initNodeCap, a);
     cm->monoCode = createInListNode(initNodeCap, a);
     cm->monoIds = createMultiAssocList(a);
+    cm->constLiterals = createInListInt(64, lx->aTmp);
 
     StateForExprs* stForExprs = allocate(StateForExprs, a);
     (*stForExprs) = (StateForExprs) {
@@ -4726,7 +5311,7 @@ initializeParser(Compiler* lx, Arena* a) { //:initializeParser
     cm->typesDict = copyStringDict(PROTO.typesDict, a);
 
     cm->importNames = createInListInt(8, lx->aTmp);
-    cm->toplevels = createInListToplevel(8, lx->a);
+    cm->toplevels = createInListAssignment(8, lx->a);
 
     cm->scopeStack = createScopeStack();
 
@@ -4866,7 +5451,6 @@ determineIfFnDef(Int tokInd, Int const sentinel, TOKS, CM, OUT Int* indRight) {
          *indRight += 1) {}
 
 #ifdef SAFETY
-    print("ind Right %d sentinel %d", *indRight, sentinel);
     VALIDATEI((*indRight < sentinel && toks[*indRight].pl2 > 0), iErrorInconsistentSpans);
 #endif
     return (toks[(*indRight) + 1].tp == tokFn);
@@ -4898,7 +5482,6 @@ pToplevelConstants(CM) { //:pToplevelConstants
     Arr(Token) toks = cm->tokens.cont;
     Int const len = cm->tokens.len;
     while (cm->i < len) {
-    print("const %d", cm->i) ; 
         Token tok = toks[cm->i];
         if (tok.tp == tokDef) {
             Int indRight;
@@ -4911,7 +5494,7 @@ pToplevelConstants(CM) { //:pToplevelConstants
             cm->i += 1; // CONSUME the left and right assignment
             Assignment newConst = (Assignment){ .isFunction = false, .tokenInd = cm->i, 
                         .rightTokenInd = indRight, .sentinel = sentinel};
-            pAssignment(newConst, toks, cm);
+            pAssignmentWorker(toks[newConst.tokenInd - 1], newConst, toks, cm);
         } else {
             cm->i = calcSentinel(tok, cm->i);
         }
@@ -4988,7 +5571,7 @@ pToplevelBody(Int indToplevel, TOKS, CM) {
     cm->toplevels.cont[indToplevel].nodeInd = cm->nodes.len;
     Int fnStartInd = toplevelSignature.tokenInd;
 
-    Int const fnSentinel = toplevelSignature.sentinelToken;
+    Int const fnSentinel = toplevelSignature.sentinel;
     EntityId fnEntity = toplevelSignature.entityId;
     TypeId fnType = cm->entities.cont[fnEntity].typeId;
 
@@ -5014,7 +5597,8 @@ pToplevelBody(Int indToplevel, TOKS, CM) {
                     nameOfToken(paramName), cm->types.cont[paramTypeInd],
                     paramName.pl1 == 1 ? classMut : classImmut, cm
             );
-            addNode(((Node){.tp = nodBinding, .pl1 = newEntityId, .pl2 = 0}), locOf(paramName), cm);
+            addNode(((Node){.tp = nodBinding, .pl1 = newEntityId, .pl2 = 0}), locOf(paramName, cm),
+                    cm);
 
             cm->i += 1; // CONSUME the param name
             cm->i = calcSentinel(toks[cm->i], cm->i); // CONSUME the tokens of param type
@@ -5062,9 +5646,9 @@ pToplevelSignatures(TOKS, CM) { //:pToplevelSignatures
         NameId name = (Unt)nameTk.pl1;
         cm->i = fnInd + 1; // CONSUME the left side, tokAssignmentRight and tokFn
         
-        Toplevel newFn = (Toplevel){
+        Assignment newFn = (Assignment){
             .tokenInd = cm->i, .rightTokenInd = indRight,
-            .sentinelToken = nextI, .isFunction = true, .nameId = name
+            .sentinel = nextI, .isFunction = true, .nameId = name
         };        
         
         pFnSignature(newFn, voidToVoid, toks, cm);
@@ -5073,7 +5657,7 @@ pToplevelSignatures(TOKS, CM) { //:pToplevelSignatures
 
 testable void
 parseMain(CM, Arena* a) { //:parseMain
-    if (setjmp(excBuf) == 0) {
+    if (setjmp(cm->excBuf) == 0) {
         Arr(Token) toks = cm->tokens.cont;
         pToplevelTypes(cm);
         // This gives the complete overloads & overloadIds tables + list of toplevel functions
@@ -5087,7 +5671,6 @@ parseMain(CM, Arena* a) { //:parseMain
         pFunctionBodies(toks, cm);
     }
     clearArena(cm->aTmp);
-    return cm;
 }
 
 testable Compiler*
@@ -5098,6 +5681,7 @@ parse(CM, Arena* a) { //:parse
     cm->stats.toksLen = cm->tokens.len;
     cm->stats.nodesLen = cm->nodes.len;
     cm->stats.typesLen = cm->types.len;
+    return cm;
 }
 
 //}}}
@@ -5753,6 +6337,18 @@ populateExp(Int indExpr, Int sentinelNode, CM) {
     }
 }
 
+testable EntityId
+typeAccessorEntity(Int opId, CM) { //:typeAccessorEntity
+// The dummy entity of a list accessor, opGetElem or opGetElemPtr. They're made by "buildOperators"
+// one after the other
+    for (EntityId e = 0; e < cm->entities.len; e++) {
+        if (cOperatorOf(e) == opGetElem) {
+            return opId == opGetElem ? e : e + 1;
+        }
+    }
+    return -1;
+}
+
 testable void
 typeReduceExpr(StackInt* exp, Int indExpr, CM) {
 //:typeReduceExpr Runs the typechecking "evaluation" on a pure expression, i.e. one that doesn't
@@ -5778,6 +6374,7 @@ typeReduceExpr(StackInt* exp, Int indExpr, CM) {
             VALIDATEP(type2 == tokInt, errTypeOfListIndex)
 
             TypeId eltType = getGenericParam(type1, 0, cm);
+            cm->nodes.cont[j + indExpr + (currAhead)].pl1 = typeAccessorEntity(opGetElem, cm);
 
             j -= 2;
             shiftStackLeft(j + 1, 2, cm);
@@ -5901,60 +6498,3338 @@ typecheckList(Int startInd, CM) { //:typecheckList
 }
 
 //}}}
-//{{{ Generic types
-
-testable void
-typeSkipNode(Int* ind, CM) {
-// Completely skips the current node in a type, whether the node is concrete or param,
-// a call or not
-    Int toSkip = 1;
-    while (toSkip > 0) {
-        Int cType = cm->types.cont[*ind];
-        Int hdr = (cType >> 24) & 0xFF;
-        if (hdr == 255) {
-            toSkip += cType & 0xFF;
-        } else {
-            toSkip += hdr;
-        }
-        (*ind) += 1;
-        toSkip -= 1;
-    }
-}
+//{{{ Constant folding
 
-#define typeGenTag(val) ((val >> 24) & 0xFF)
+// Runs on every expression right after its typecheck, while the expression is still at the end of
+// @nodes. Operator calls on literals are evaluated, and the ids of immutable bindings with literal
+// values are replaced by those literals. The RPN gets compacted in place, so @nodes shrinks.
+// Strings are never computed here because a string literal's text lives in the source code
 
-private Int
-typeEltArgcount(Int typeElt) {
-// Get type-arg-count from a type element (which may be a type call, concrete type, type param etc)
-    Unt genericTag = typeGenTag(typeElt);
-    if (genericTag == 255) {
-        return typeElt & 0xFF;
-    } else {
-        return genericTag;
-    }
+private Long
+foldIntOf(Node nd) { //:foldIntOf
+    return (Long)(((Ulong)(Unt)nd.pl1 << 32) + (Unt)nd.pl2);
 }
 
-private Int
-typeMergeTypeCall(Int startInd, Int len, CM) {
-// Takes a single call from within a concrete type, and merges it into the type dictionary
-// as a whole, separate type. Returns the unique typeId
-    return -1;
+private Node
+foldIntNode(Ulong value) { //:foldIntNode
+    return (Node){ .tp = tokInt, .pl1 = (Int)(value >> 32), .pl2 = (Int)(value & LOWER32BITS) };
 }
 
-//}}}
-//}}}
-//{{{ Interpreter
-//{{{ Utils
+private double
+foldDoubleOf(Node nd) { //:foldDoubleOf
+    Ulong bits = ((Ulong)(Unt)nd.pl1 << 32) + (Unt)nd.pl2;
+    double result;
+    memcpy(&result, &bits, 8);
+    return result;
+}
 
-private Unt
-rtDeref0(EyrPtr address, RT) { //:rtDeref0
-// Gets value at pointer as an integer
-    return *(rt->memory + address);
+private Node
+foldDoubleNode(double value) { //:foldDoubleNode
+    Ulong bits;
+    memcpy(&bits, &value, 8);
+    return (Node){ .tp = tokDouble, .pl1 = (Int)(bits >> 32), .pl2 = (Int)(bits & LOWER32BITS) };
 }
 
-#define rtDeref(ptr) rtDeref0(ptr, rt)
+private Node
+foldBoolNode(Bool value) { //:foldBoolNode
+    return (Node){ .tp = tokBool, .pl2 = value ? 1 : 0 };
+}
 
-private EyrPtr
+private Bool
+foldComparison(Int opId, Int cmp, OUT Node* result) { //:foldComparison
+// "cmp" is the sign of (left - right)
+    if (opId == opLessTh) {
+        *result = foldBoolNode(cmp < 0);
+    } ei (opId == opLTEQ) {
+        *result = foldBoolNode(cmp <= 0);
+    } ei (opId == opGreaterTh) {
+        *result = foldBoolNode(cmp > 0);
+    } ei (opId == opGTEQ) {
+        *result = foldBoolNode(cmp >= 0);
+    } ei (opId == opEquality) {
+        *result = foldBoolNode(cmp == 0);
+    } ei (opId == opNotEqual) {
+        *result = foldBoolNode(cmp != 0);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+private Bool
+foldInts(Int opId, Int arity, Node left, Node right, OUT Node* result) { //:foldInts
+// Wraps around on overflow, like the generated code. Division by zero stays a runtime error
+    Long const a = foldIntOf(left);
+    if (arity == 1) {
+        if (opId == opBitwiseNeg) {
+            *result = foldIntNode(~(Ulong)a);
+        } ei (opId == opLTZero || opId == opGTZero) {
+            *result = foldBoolNode(opId == opLTZero ? a < 0 : a > 0);
+        } else {
+            return false;
+        }
+        return true;
+    }
+    Long const b = foldIntOf(right);
+    if (opId == opPlus) {
+        *result = foldIntNode((Ulong)a + (Ulong)b);
+    } ei (opId == opMinus) {
+        *result = foldIntNode((Ulong)a - (Ulong)b);
+    } ei (opId == opTimes) {
+        *result = foldIntNode((Ulong)a * (Ulong)b);
+    } ei (opId == opDivBy || opId == opRemainder) {
+        if (b == 0 || (a == LLONG_MIN && b == -1)) {
+            return false;
+        }
+        *result = foldIntNode((Ulong)(opId == opDivBy ? a/b : a % b));
+    } ei (opId == opBitwiseAnd) {
+        *result = foldIntNode((Ulong)a & (Ulong)b);
+    } ei (opId == opBitwiseOr) {
+        *result = foldIntNode((Ulong)a | (Ulong)b);
+    } ei (opId == opBitwiseXor) {
+        *result = foldIntNode((Ulong)a ^ (Ulong)b);
+    } else {
+        return foldComparison(opId, (a > b) - (a < b), result);
+    }
+    return true;
+}
+
+private Bool
+foldDoubles(Int opId, Int arity, Node left, Node right, OUT Node* result) { //:foldDoubles
+    double const a = foldDoubleOf(left);
+    if (arity == 1) {
+        if (opId == opLTZero || opId == opGTZero) {
+            *result = foldBoolNode(opId == opLTZero ? a < 0 : a > 0);
+            return true;
+        }
+        return false;
+    }
+    double const b = foldDoubleOf(right);
+    if (opId == opPlus) {
+        *result = foldDoubleNode(a + b);
+    } ei (opId == opMinus) {
+        *result = foldDoubleNode(a - b);
+    } ei (opId == opTimes) {
+        *result = foldDoubleNode(a*b);
+    } ei (opId == opDivBy) {
+        *result = foldDoubleNode(a/b);
+    } ei (a != a || b != b) { // NaN compares as unequal to everything
+        *result = foldBoolNode(opId == opNotEqual);
+        return opId == opLessTh || opId == opLTEQ || opId == opGreaterTh || opId == opGTEQ
+            || opId == opEquality || opId == opNotEqual;
+    } else {
+        return foldComparison(opId, (a > b) - (a < b), result);
+    }
+    return true;
+}
+
+private Bool
+foldCall(Node call, Arr(Node) args, OUT Node* result) { //:foldCall
+// Evaluates an operator call on literal args. Returns false if it must be left for the runtime
+    Int const opId = cOperatorOf(call.pl1);
+    if (opId == -1 || call.pl2 < 1 || call.pl2 > 2) {
+        return false;
+    }
+    Node const left = args[0];
+    Node const right = call.pl2 == 2 ? args[1] : left;
+    if (left.tp != right.tp) {
+        return false;
+    }
+    if (left.tp == tokInt) {
+        return foldInts(opId, call.pl2, left, right, result);
+    } ei (left.tp == tokDouble) {
+        return foldDoubles(opId, call.pl2, left, right, result);
+    } ei (left.tp == tokBool) {
+        if (opId == opBoolNeg && call.pl2 == 1) {
+            *result = foldBoolNode(left.pl2 == 0);
+        } ei (opId == opBoolAnd && call.pl2 == 2) {
+            *result = foldBoolNode(left.pl2 != 0 && right.pl2 != 0);
+        } ei (opId == opBoolOr && call.pl2 == 2) {
+            *result = foldBoolNode(left.pl2 != 0 || right.pl2 != 0);
+        } else {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+private Int
+foldLiteralOf(EntityId entityId, CM) { //:foldLiteralOf
+// The node of the literal value of an immutable binding, or -1 if it has none
+    return entityId < cm->constLiterals.len ? cm->constLiterals.cont[entityId] : -1;
+}
+
+private void
+foldRecordBinding(EntityId entityId, Int rightInd, CM) { //:foldRecordBinding
+// Called after the right side of a new binding is parsed. If it's immutable and its right side has
+// become a single literal, uses of the binding can be replaced by the literal
+    if (entityId < 0 || cm->entities.cont[entityId].class != classImmut) {
+        return;
+    }
+    Int literalInd = rightInd;
+    if (cm->nodes.cont[rightInd].tp == nodExpr && cm->nodes.len == rightInd + 2) {
+        literalInd = rightInd + 1;
+    }
+    if (literalInd + 1 != cm->nodes.len || cm->nodes.cont[literalInd].tp > topVerbatimTokenVariant) {
+        return;
+    }
+    while (cm->constLiterals.len <= entityId) {
+        pushInconstLiterals(-1, cm);
+    }
+    cm->constLiterals.cont[entityId] = literalInd;
+}
+
+testable void
+foldConstants(Int indExpr, CM) { //:foldConstants
+// Folds the expression at "indExpr" which runs until the end of @nodes. Operand starts are kept on
+// a stack, so an operand is a literal iff it's a single node with a literal type
+    Node expr = cm->nodes.cont[indExpr];
+    Int const sentinel = cm->nodes.len;
+    if (expr.pl1 != 0) {
+        return; // has internal declarations
+    }
+    for (Int j = indExpr + 1; j < sentinel; j++) {
+        Unt const tp = cm->nodes.cont[j].tp;
+        if (tp > topVerbatimTokenVariant && tp != nodId && tp != nodCall) {
+            return;
+        }
+    }
+    StackInt* starts = cm->stateForExprs->exp; // free after the typecheck
+    starts->len = 0;
+    Arr(Node) nodes = cm->nodes.cont;
+    Arr(SourceLoc) locs = cm->sourceLocs->cont;
+    Int w = indExpr + 1; // where the next node will be written
+    for (Int j = indExpr + 1; j < sentinel; j++) {
+        Node nd = nodes[j];
+        SourceLoc loc = locs[j];
+        if (nd.tp == nodId && foldLiteralOf(nd.pl1, cm) > -1) {
+            Int const literalInd = foldLiteralOf(nd.pl1, cm);
+            nd = nodes[literalInd];
+            loc = locs[literalInd]; // string literals are read from their location
+        }
+        if (nd.tp != nodCall) {
+            nodes[w] = nd;
+            locs[w] = loc;
+            push(w, starts);
+            w += 1;
+            continue;
+        }
+        Int const argc = nd.pl2;
+        Int const firstArg = starts->len - argc;
+        Bool allLiterals = argc > 0;
+        for (Int k = 0; k < argc && allLiterals; k++) {
+            Int const start = starts->cont[firstArg + k];
+            Int const end = k + 1 < argc ? starts->cont[firstArg + k + 1] : w;
+            allLiterals = end == start + 1 && nodes[start].tp <= topVerbatimTokenVariant;
+        }
+        Int const callStart = argc > 0 ? starts->cont[firstArg] : w;
+        Node folded;
+        if (allLiterals && foldCall(nd, nodes + callStart, &folded)) {
+            nodes[callStart] = folded;
+            locs[callStart] = loc;
+            w = callStart + 1;
+        } else {
+            nodes[w] = nd;
+            locs[w] = loc;
+            w += 1;
+        }
+        starts->len = firstArg;
+        push(callStart, starts);
+    }
+    cm->nodes.len = w;
+    cm->sourceLocs->len = w;
+}
+
+//}}}
+//{{{ Generic types
+
+testable void
+typeSkipNode(Int* ind, CM) {
+// Completely skips the current node in a type, whether the node is concrete or param,
+// a call or not
+    Int toSkip = 1;
+    while (toSkip > 0) {
+        Int cType = cm->types.cont[*ind];
+        Int hdr = (cType >> 24) & 0xFF;
+        if (hdr == 255) {
+            toSkip += cType & 0xFF;
+        } else {
+            toSkip += hdr;
+        }
+        (*ind) += 1;
+        toSkip -= 1;
+    }
+}
+
+#define typeGenTag(val) ((val >> 24) & 0xFF)
+
+private Int
+typeEltArgcount(Int typeElt) {
+// Get type-arg-count from a type element (which may be a type call, concrete type, type param etc)
+    Unt genericTag = typeGenTag(typeElt);
+    if (genericTag == 255) {
+        return typeElt & 0xFF;
+    } else {
+        return genericTag;
+    }
+}
+
+private Int
+typeMergeTypeCall(Int startInd, Int len, CM) {
+// Takes a single call from within a concrete type, and merges it into the type dictionary
+// as a whole, separate type. Returns the unique typeId
+    return -1;
+}
+
+//}}}
+//}}}
+//{{{ Codegen
+//{{{ Superinstructions
+
+private Int
+instrSize(Ulong instr) { //:instrSize
+// Number of 8-byte slots taken by an instruction
+    Int opCode = instr >> 58;
+    if ((opCode >= iPlusFlConst && opCode <= iDivByFlConst) || opCode == iSubstring
+            || opCode == iGetElemPtr || opCode == iSwap || opCode == iSetBigLocal
+            || (opCode >= iMinusBranchLt && opCode <= iSetLocalCall)) {
+        return 2;
+    }
+    return 1;
+}
+
+private Arr(Bool)
+findJumpTargets(Int start, Int sentinel, CM) { //:findJumpTargets
+// Marks the instructions in [start; sentinel) which are the targets of jumps or branches
+    Arr(Ulong) code = cm->bytecode.cont;
+    Arr(Bool) result = allocateArray(sentinel - start, Bool, cm->aTmp);
+    memset(result, 0, (sentinel - start)*sizeof(Bool));
+    for (Int j = start; j < sentinel; j += instrSize(code[j])) {
+        Int opCode = code[j] >> 58;
+        if (opCode < iJump || opCode > iBranchGt) {
+            continue;
+        }
+        Int target = (Int)(code[j] & LOWER32BITS);
+        if (target >= start && target < sentinel) {
+            result[target - start] = true;
+        }
+    }
+    return result;
+}
+
+private Int
+fusedOpCode(Ulong first, Ulong second) { //:fusedOpCode
+// Returns the superinstruction for a pair of instructions, or -1 if they don't fuse
+    Int op1 = first >> 58;
+    Int op2 = second >> 58;
+    if (op1 == iMinus && op2 >= iBranchLt && op2 <= iBranchGt) {
+        StackAddr diff = (StackAddr)((first >> 40) & LOWER16BITS);
+        StackAddr tested = (StackAddr)((second >> 32) & LOWER16BITS);
+        if (diff != tested) {
+            return -1;
+        }
+        return iMinusBranchLt + (op2 - iBranchLt);
+    } ei (op1 == iSetLocal && op2 == iPlusConst) {
+        return iSetLocalPlusConst;
+    } ei (op1 == iSetLocal && op2 == iCall) {
+        return iSetLocalCall;
+    }
+    return -1;
+}
+
+private Int
+fuseInFunction(Int start, Int sentinel, CM) { //:fuseInFunction
+// Fuses the instructions of one function. Returns the number of fusions made
+    Arr(Ulong) code = cm->bytecode.cont;
+    Arr(Bool) isTarget = findJumpTargets(start, sentinel, cm);
+    Int countFusions = 0;
+    Int j = start;
+    while (j < sentinel) {
+        Int sz = instrSize(code[j]);
+        Int next = j + sz;
+        if (sz > 1 || next >= sentinel || isTarget[next - start]) {
+            j = next;
+            continue;
+        }
+        Int fused = fusedOpCode(code[j], code[next]);
+        if (fused == -1) {
+            j = next;
+            continue;
+        }
+        code[j] = (code[j] & ~(0x3FUL << 58)) | ((Ulong)fused << 58);
+        countFusions += 1;
+        j = next + instrSize(code[next]);
+    }
+    return countFusions;
+}
+
+testable void
+fuseSuperinstructions(CM) { //:fuseSuperinstructions
+// Peephole pass over the emitted bytecode that fuses frequent pairs of instructions into
+// superinstructions, so they cost one dispatch instead of two. Must run after codegen is finished
+    Arr(Ulong) code = cm->bytecode.cont;
+    Int fnId = 0;
+    Int j = 0;
+    while (j < cm->bytecode.len) {
+        Int const sentinel = j + 1 + (Int)code[j]; // the first slot is the function's length
+        Int countFusions = fuseInFunction(j + 1, sentinel, cm);
+        cm->stats.countFusions += countFusions;
+#ifdef DEBUG
+        print("Function %d: %d fusions", fnId, countFusions);
+#endif
+        fnId += 1;
+        j = sentinel;
+    }
+}
+
+//}}}
+//{{{ C backend
+
+// Ahead-of-time backend: walks the typed AST and emits a standalone C translation unit, which
+// includes the tiny runtime header below and can be compiled with e.g. "gcc -O2".
+// Locals are named "v<entityId>" and functions "f<entityId>", so no clashes with C keywords
+// are possible. The entry point is the first toplevel function, same as in the interpreter
+
+#define C_RUNTIME_NAME "eyr_runtime.h"
+
+static char const C_RUNTIME[] =
+    "#ifndef EYR_RUNTIME_H\n"
+    "#define EYR_RUNTIME_H\n"
+    "// Runtime for the C emitted by the Eyr compiler. Eyr integers wrap around on overflow,\n"
+    "// so compile with -fwrapv\n"
+    "#include <stdarg.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdbool.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "typedef int64_t EyrInt;\n"
+    "typedef double EyrDouble;\n"
+    "typedef bool EyrBool;\n"
+    "typedef struct { char const* cont; int32_t len; } EyrStr;\n"
+    "\n"
+    "#define EYR_STR(lit) ((EyrStr){ .cont = (lit), .len = sizeof(lit) - 1 })\n"
+    "#define EYR_PI 3.14159265358979323846\n"
+    "#define EYR_E  2.71828182845904523536\n"
+    "\n"
+    "static inline void eyrPanic(char const* msg) {\n"
+    "    fprintf(stderr, \"%s\\n\", msg);\n"
+    "    exit(1);\n"
+    "}\n"
+    "static inline EyrInt eyrDivBy(EyrInt a, EyrInt b) {\n"
+    "    if (b == 0) eyrPanic(\"Division by zero\");\n"
+    "    return b == -1 ? -a : a/b; // INT64_MIN/-1 traps even with -fwrapv\n"
+    "}\n"
+    "static inline EyrInt eyrRemainder(EyrInt a, EyrInt b) {\n"
+    "    if (b == 0) eyrPanic(\"Division by zero\");\n"
+    "    return b == -1 ? 0 : a % b;\n"
+    "}\n"
+    "static inline void eyrPrintStr(EyrStr s) {\n"
+    "    fwrite(s.cont, 1, s.len, stdout);\n"
+    "    fputc('\\n', stdout);\n"
+    "}\n"
+    "static inline void eyrPrintInt(EyrInt n) { printf(\"%lld\\n\", (long long)n); }\n"
+    "static inline void eyrPrintDouble(EyrDouble x) { printf(\"%g\\n\", x); }\n"
+    "static inline void eyrPrintErr(EyrStr s) {\n"
+    "    fwrite(s.cont, 1, s.len, stderr);\n"
+    "    fputc('\\n', stderr);\n"
+    "}\n"
+    "\n"
+    "static inline EyrStr eyrConcat(EyrStr a, EyrStr b) { // never freed, there's no GC here\n"
+    "    char* cont = malloc(a.len + b.len + 1);\n"
+    "    memcpy(cont, a.cont, a.len);\n"
+    "    memcpy(cont + a.len, b.cont, b.len);\n"
+    "    return (EyrStr){ .cont = cont, .len = a.len + b.len };\n"
+    "}\n"
+    "static inline int eyrCompareStr(EyrStr a, EyrStr b) {\n"
+    "    int cmp = memcmp(a.cont, b.cont, a.len < b.len ? a.len : b.len);\n"
+    "    return cmp != 0 ? cmp : (a.len > b.len) - (a.len < b.len);\n"
+    "}\n"
+    "static inline EyrStr eyrFormat(char const* format, ...) {\n"
+    "    va_list args;\n"
+    "    va_start(args, format);\n"
+    "    char* cont = malloc(32);\n"
+    "    int len = vsnprintf(cont, 32, format, args);\n"
+    "    va_end(args);\n"
+    "    return (EyrStr){ .cont = cont, .len = len < 32 ? len : 31 };\n"
+    "}\n"
+    "#define eyrStrOfInt(n) eyrFormat(\"%lld\", (long long)(n))\n"
+    "#define eyrStrOfDouble(x) eyrFormat(\"%g\", (x))\n"
+    "#define eyrStrOfBool(b) ((b) ? EYR_STR(\"true\") : EYR_STR(\"false\"))\n"
+    "\n"
+    "#endif\n";
+
+
+typedef struct { //:CEmitter
+    StringBuilder* out;
+    Arr(Bool) declared; // [aTmp] whether an entity has been declared already
+    StackInt* loops;    // [aTmp] ids of the enclosing loops, for break/continue with a depth
+    Int indent;
+} CEmitter;
+
+
+private Int
+cNodeSize(Node nd) { //:cNodeSize
+    return nd.tp >= nodScope ? nd.pl2 + 1 : 1;
+}
+
+private char const*
+cTypeName(TypeId typeId, CM) { //:cTypeName
+    if (typeId == tokInt || typeId == tokLong) {
+        return "EyrInt";
+    } ei (typeId == tokDouble) {
+        return "EyrDouble";
+    } ei (typeId == tokBool) {
+        return "EyrBool";
+    } ei (typeId == tokString) {
+        return "EyrStr";
+    } ei (typeId == tokMisc) {
+        return "void";
+    }
+    throwExcParser(errCodegenUnsupported);
+}
+
+private void
+cIndent(CEmitter* ce) { //:cIndent
+    sbAppendf(ce->out, "%*s", 4*ce->indent, "");
+}
+
+private String
+cLiteral(Int ind, CM) { //:cLiteral
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp == tokInt || nd.tp == tokLong) {
+        Long value = (Long)(((Ulong)(Unt)nd.pl1 << 32) + (Unt)nd.pl2);
+        return stringOfFormat(cm->aTmp, "%lldLL", (long long)value);
+    } ei (nd.tp == tokDouble) {
+        Ulong bits = ((Ulong)(Unt)nd.pl1 << 32) + (Unt)nd.pl2;
+        double value;
+        memcpy(&value, &bits, 8);
+        return stringOfFormat(cm->aTmp, "%.17g", value);
+    } ei (nd.tp == tokBool) {
+        return nd.pl2 > 0 ? s("true") : s("false");
+    }
+    // tokString. The source text includes the backticks
+    SourceLoc loc = cm->sourceLocs->cont[ind];
+    StringBuilder* sb = createStringBuilder(loc.lenBts + 16, cm->aTmp);
+    sbAppend(s("EYR_STR(\""), sb);
+    for (Long j = locStartBt(loc) + 1; j < locStartBt(loc) + loc.lenBts - 1; j++) {
+        char c = cm->sourceCode[j];
+        if (c == '"' || c == '\\') {
+            sbAppendf(sb, "\\%c", c);
+        } ei (c == '\n') {
+            sbAppend(s("\\n"), sb);
+        } else {
+            sbAppendf(sb, "%c", c);
+        }
+    }
+    sbAppend(s("\")"), sb);
+    return stringOfBuilder(sb);
+}
+
+private Int
+cOperatorOf(EntityId entityId) { //:cOperatorOf
+// Operator entities are the first ones, see "buildOperators". Returns -1 for non-operators
+    if (entityId >= PROTO.entities.len) {
+        return -1;
+    }
+    Unt name = PROTO.entities.cont[entityId].name;
+    for (Int k = 0; k < countOperators; k++) {
+        if (OPERATORS[k].name == name) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+private String
+cOperatorCall(Int opId, TypeId operandType, Arr(String) args, CM) { //:cOperatorCall
+// Operator call of the right flavour for the operand type. Comparisons of strings go via
+// "eyrCompareStr", integer division is checked for zero
+    Arena* a = cm->aTmp;
+    char const* infix = null;
+    if (opId == opPlus) {
+        if (operandType == tokString) {
+            return stringOfFormat(a, "eyrConcat(%.*s, %.*s)",
+                                  args[0].len, args[0].cont, args[1].len, args[1].cont);
+        }
+        infix = "+";
+    } ei (opId == opMinus) {
+        infix = "-";
+    } ei (opId == opTimes) {
+        infix = "*";
+    } ei (opId == opDivBy && operandType == tokDouble) {
+        infix = "/";
+    } ei (opId == opDivBy || opId == opRemainder) {
+        return stringOfFormat(a, "%s(%.*s, %.*s)",
+                              opId == opDivBy ? "eyrDivBy" : "eyrRemainder",
+                              args[0].len, args[0].cont, args[1].len, args[1].cont);
+    } ei (opId == opBitwiseAnd) {
+        infix = "&";
+    } ei (opId == opBitwiseOr) {
+        infix = "|";
+    } ei (opId == opBitwiseXor) {
+        infix = "^";
+    } ei (opId == opBoolAnd) {
+        infix = "&&";
+    } ei (opId == opBoolOr) {
+        infix = "||";
+    } ei (opId == opLessTh) {
+        infix = "<";
+    } ei (opId == opLTEQ) {
+        infix = "<=";
+    } ei (opId == opGreaterTh) {
+        infix = ">";
+    } ei (opId == opGTEQ) {
+        infix = ">=";
+    } ei (opId == opEquality) {
+        infix = "==";
+    } ei (opId == opNotEqual) {
+        infix = "!=";
+    } ei (opId == opBoolNeg) {
+        return stringOfFormat(a, "(!%.*s)", args[0].len, args[0].cont);
+    } ei (opId == opBitwiseNeg) {
+        return stringOfFormat(a, "(~%.*s)", args[0].len, args[0].cont);
+    } ei (opId == opToString) {
+        char const* conv = operandType == tokDouble ? "eyrStrOfDouble"
+                         : operandType == tokBool ? "eyrStrOfBool" : "eyrStrOfInt";
+        return stringOfFormat(a, "%s(%.*s)", conv, args[0].len, args[0].cont);
+    } ei (opId == opSize && operandType == tokString) {
+        return stringOfFormat(a, "((EyrInt)(%.*s).len)", args[0].len, args[0].cont);
+    }
+    VALIDATEP(infix != null, errCodegenUnsupported)
+    if (operandType == tokString) {
+        return stringOfFormat(a, "(eyrCompareStr(%.*s, %.*s) %s 0)",
+                              args[0].len, args[0].cont, args[1].len, args[1].cont, infix);
+    }
+    return stringOfFormat(a, "(%.*s %s %.*s)",
+                          args[0].len, args[0].cont, infix, args[1].len, args[1].cont);
+}
+
+private String
+cCall(Node call, Arr(String) args, CM) { //:cCall
+    Entity ent = cm->entities.cont[call.pl1];
+    TypeId firstParamType = call.pl2 > 0 ? getFirstParamType(ent.typeId, cm) : -1;
+    Int opId = cOperatorOf(call.pl1);
+    if (opId > -1) {
+        return cOperatorCall(opId, firstParamType, args, cm);
+    }
+    StringBuilder* sb = createStringBuilder(64, cm->aTmp);
+    if (call.pl1 < cm->stats.countNonparsedEntities) {
+        // the Prelude
+        if (ent.name == nameOfStandard(strPrint)) {
+            sbAppendf(sb, "%s(", firstParamType == tokString ? "eyrPrintStr"
+                               : firstParamType == tokDouble ? "eyrPrintDouble" : "eyrPrintInt");
+        } ei (ent.name == nameOfStandard(strPrintErr)) {
+            sbAppend(s("eyrPrintErr("), sb);
+        } else {
+            throwExcParser(errCodegenUnsupported);
+        }
+    } else {
+        sbAppendf(sb, "f%d(", call.pl1);
+    }
+    for (Int k = 0; k < call.pl2; k++) {
+        if (k > 0) {
+            sbAppend(s(", "), sb);
+        }
+        sbAppend(args[k], sb);
+    }
+    sbAppend(s(")"), sb);
+    return stringOfBuilder(sb);
+}
+
+private String
+cAtom(Int ind, CM) { //:cAtom
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp <= topVerbatimTokenVariant) {
+        return cLiteral(ind, cm);
+    } ei (nd.tp == nodId) {
+        if (nd.pl1 < cm->stats.countNonparsedEntities) {
+            Unt name = cm->entities.cont[nd.pl1].name;
+            VALIDATEP(name == nameOfStandard(strMathPi) || name == nameOfStandard(strMathE),
+                      errCodegenUnsupported)
+            return name == nameOfStandard(strMathPi) ? s("EYR_PI") : s("EYR_E");
+        }
+        return stringOfFormat(cm->aTmp, "v%d", nd.pl1);
+    } ei (nd.tp == nodCall) { // a nullary call
+        return cCall(nd, null, cm);
+    }
+    throwExcParser(errCodegenUnsupported);
+}
+
+private String
+cExpr(Int ind, CM) { //:cExpr
+// An expression is either a single atom or a nodExpr with its operands in reverse Polish notation
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp != nodExpr) {
+        return cAtom(ind, cm);
+    }
+    Int const sentinel = ind + nd.pl2 + 1;
+    Arr(String) stack = allocateArray(nd.pl2, String, cm->aTmp);
+    Int len = 0;
+    for (Int j = ind + 1; j < sentinel; j++) {
+        Node elt = cm->nodes.cont[j];
+        if (elt.tp == nodCall) {
+            len -= elt.pl2;
+            VALIDATEI(len >= 0, iErrorInconsistentSpans)
+            stack[len] = cCall(elt, stack + len, cm);
+        } else {
+            stack[len] = cAtom(j, cm);
+        }
+        len += 1;
+    }
+    VALIDATEI(len == 1, iErrorInconsistentSpans)
+    return stack[0];
+}
+
+private void cStatements(Int start, Int sentinel, CEmitter* ce, CM);
+
+private void
+cBlock(Int scopeInd, CEmitter* ce, CM) { //:cBlock
+// Body of a scope node, including the braces. The opening brace goes on the current line
+    Node scope = cm->nodes.cont[scopeInd];
+    sbAppend(s("{\n"), ce->out);
+    ce->indent += 1;
+    cStatements(scopeInd + 1, scopeInd + scope.pl2 + 1, ce, cm);
+    ce->indent -= 1;
+    cIndent(ce);
+    sbAppend(s("}"), ce->out);
+}
+
+private void
+cAssignment(Int ind, CEmitter* ce, CM) { //:cAssignment
+// [Assignment Binding rightSide]. The first assignment to an entity is its declaration
+    Node asg = cm->nodes.cont[ind];
+    Node left = cm->nodes.cont[ind + 1];
+    Node right = cm->nodes.cont[ind + asg.pl3];
+    VALIDATEP(left.tp == nodBinding && right.tp != nodDataAlloc, errCodegenUnsupported)
+
+    String rightSide = cExpr(ind + asg.pl3, cm);
+    cIndent(ce);
+    if (!ce->declared[left.pl1]) {
+        ce->declared[left.pl1] = true;
+        sbAppendf(ce->out, "%s ", cTypeName(cm->entities.cont[left.pl1].typeId, cm));
+    }
+    sbAppendf(ce->out, "v%d = %.*s;\n", left.pl1, rightSide.len, rightSide.cont);
+}
+
+private void
+cIf(Int ind, CEmitter* ce, CM) { //:cIf
+// [If cond Scope ElseIf(cond Scope)... ElseIf(Scope)]. The last one is the "else"
+    Node ifNode = cm->nodes.cont[ind];
+    Int const sentinel = ind + ifNode.pl2 + 1;
+    Int j = ind + 1;
+    String cond = cExpr(j, cm);
+    j += cNodeSize(cm->nodes.cont[j]);
+    cIndent(ce);
+    sbAppendf(ce->out, "if (%.*s) ", cond.len, cond.cont);
+    cBlock(j, ce, cm);
+    j += cNodeSize(cm->nodes.cont[j]);
+    while (j < sentinel) {
+        Node clause = cm->nodes.cont[j];
+        VALIDATEI(clause.tp == nodElseIf, iErrorInconsistentSpans)
+        Int k = j + 1;
+        if (cm->nodes.cont[k].tp == nodScope) {
+            sbAppend(s(" else "), ce->out);
+        } else {
+            cond = cExpr(k, cm);
+            k += cNodeSize(cm->nodes.cont[k]);
+            sbAppendf(ce->out, " else if (%.*s) ", cond.len, cond.cont);
+        }
+        cBlock(k, ce, cm);
+        j += clause.pl2 + 1;
+    }
+    sbAppend(s("\n"), ce->out);
+}
+
+private void
+cFor(Int ind, CEmitter* ce, CM) { //:cFor
+// [For Scope(inits... cond Scope(body... step...))] or, without inits, [For cond Scope(body...)]
+// A loop that's the target of a "break 2" etc has the id in pl1; it gets the labels
+// "brk<id>" and "cont<id>"
+    Node forNode = cm->nodes.cont[ind];
+    Int const bodyInd = ind + forNode.pl3;
+    Int j = ind + 1;
+    Bool const hasInits = cm->nodes.cont[j].tp == nodScope && j != bodyInd;
+    if (hasInits) {
+        cIndent(ce);
+        sbAppend(s("{\n"), ce->out);
+        ce->indent += 1;
+        j += 1;
+    }
+    String cond = s("true");
+    while (j < bodyInd) {
+        Node nd = cm->nodes.cont[j];
+        Int const size = cNodeSize(nd);
+        if (j + size == bodyInd && nd.tp != nodAssignment) {
+            cond = cExpr(j, cm);
+        } else {
+            cStatements(j, j + size, ce, cm);
+        }
+        j += size;
+    }
+    cIndent(ce);
+    sbAppendf(ce->out, "while (%.*s) {\n", cond.len, cond.cont);
+    push(forNode.pl1, ce->loops);
+    ce->indent += 1;
+    cStatements(bodyInd + 1, bodyInd + cm->nodes.cont[bodyInd].pl2 + 1, ce, cm);
+    if (forNode.pl1 > 0) {
+        cIndent(ce);
+        sbAppendf(ce->out, "cont%d:;\n", forNode.pl1);
+    }
+    ce->indent -= 1;
+    pop(ce->loops);
+    cIndent(ce);
+    sbAppend(s("}\n"), ce->out);
+    if (forNode.pl1 > 0) {
+        cIndent(ce);
+        sbAppendf(ce->out, "brk%d:;\n", forNode.pl1);
+    }
+    if (hasInits) {
+        ce->indent -= 1;
+        cIndent(ce);
+        sbAppend(s("}\n"), ce->out);
+    }
+}
+
+private void
+cBreakCont(Node nd, CEmitter* ce, CM) { //:cBreakCont
+    Bool const isContinue = nd.pl1 >= BIG;
+    Int const loopId = isContinue ? nd.pl1 - BIG : nd.pl1;
+    VALIDATEP(hasValues(ce->loops), errBreakContinueInvalidDepth)
+    cIndent(ce);
+    if (loopId > 0 && loopId != peek(ce->loops)) {
+        sbAppendf(ce->out, "goto %s%d;\n", isContinue ? "cont" : "brk", loopId);
+    } else {
+        sbAppend(isContinue ? s("continue;\n") : s("break;\n"), ce->out);
+    }
+}
+
+private void
+cStatements(Int start, Int sentinel, CEmitter* ce, CM) { //:cStatements
+    Int j = start;
+    while (j < sentinel) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp == nodAssignment || nd.tp == nodDef) {
+            cAssignment(j, ce, cm);
+        } ei (nd.tp == nodScope) {
+            cIndent(ce);
+            cBlock(j, ce, cm);
+            sbAppend(s("\n"), ce->out);
+        } ei (nd.tp == nodIf) {
+            cIf(j, ce, cm);
+        } ei (nd.tp == nodFor) {
+            cFor(j, ce, cm);
+        } ei (nd.tp == nodBreakCont) {
+            cBreakCont(nd, ce, cm);
+        } ei (nd.tp == nodReturn) {
+            cIndent(ce);
+            if (nd.pl2 > 0) {
+                String result = cExpr(j + 1, cm);
+                sbAppendf(ce->out, "return %.*s;\n", result.len, result.cont);
+            } else {
+                sbAppend(s("return;\n"), ce->out);
+            }
+        } ei (nd.tp == nodExpr || nd.tp == nodCall || nd.tp == nodId
+              || nd.tp <= topVerbatimTokenVariant) {
+            String expr = cExpr(j, cm);
+            cIndent(ce);
+            sbAppendf(ce->out, "%.*s;\n", expr.len, expr.cont);
+        } else {
+            throwExcParser(errCodegenUnsupported);
+        }
+        j += cNodeSize(nd);
+    }
+}
+
+private void
+cSignature(EntityId fnEntity, Int paramsInd, CEmitter* ce, CM) { //:cSignature
+// "static Ret f<id>(T1 v<id1>, ...)". The params are the first nodBindings of the function body
+    TypeId fnType = cm->entities.cont[fnEntity].typeId;
+    Int const arity = fnType > topVerbatimType ? tGetFnArity(fnType, cm) : 0;
+    Int const firstParam = fnType > topVerbatimType ? tGetIndexOfFnFirstParam(fnType, cm) : -1;
+    TypeId const returnType = fnType > topVerbatimType ? getFunctionReturnType(fnType, cm)
+                                                       : tokMisc;
+    sbAppendf(ce->out, "static %s f%d(", cTypeName(returnType, cm), fnEntity);
+    if (arity == 0) {
+        sbAppend(s("void"), ce->out);
+    }
+    for (Int k = 0; k < arity; k++) {
+        Node param = cm->nodes.cont[paramsInd + k];
+        VALIDATEI(param.tp == nodBinding, iErrorInconsistentSpans)
+        ce->declared[param.pl1] = true;
+        sbAppendf(ce->out, "%s%s v%d", k > 0 ? ", " : "",
+                  cTypeName(cm->types.cont[firstParam + k], cm), param.pl1);
+    }
+    sbAppend(s(")"), ce->out);
+}
+
+private void
+cFunction(Int nodeInd, CEmitter* ce, CM) { //:cFunction
+    Node fnDef = cm->nodes.cont[nodeInd];
+    TypeId fnType = cm->entities.cont[fnDef.pl1].typeId;
+    Int const arity = fnType > topVerbatimType ? tGetFnArity(fnType, cm) : 0;
+    cSignature(fnDef.pl1, nodeInd + 1, ce, cm);
+    sbAppend(s(" {\n"), ce->out);
+    ce->indent = 1;
+    cStatements(nodeInd + 1 + arity, nodeInd + fnDef.pl2 + 1, ce, cm);
+    ce->indent = 0;
+    sbAppend(s("}\n\n"), ce->out);
+}
+
+testable String
+emitC(CM) { //:emitC
+// Emits the whole program as a C translation unit. Toplevel constants become static
+// globals which are initialized in "main" before the entry function is called.
+// Returns an empty string in case of error (the message is in @stats.errMsg)
+    if (cm->toplevels.len == 0) {
+        return empty;
+    }
+    if (setjmp(cm->excBuf) != 0) {
+        return empty;
+    }
+    StringBuilder* out = createStringBuilder(4096, cm->a);
+    CEmitter ce = (CEmitter){
+        .out = out, .declared = allocateArray(cm->entities.len, Bool, cm->aTmp),
+        .loops = createStackint32_t(16, cm->aTmp), .indent = 0 };
+    memset(ce.declared, 0, cm->entities.len*sizeof(Bool));
+    sbAppend(s("#include \"" C_RUNTIME_NAME "\"\n\n"), out);
+
+    Int firstFnNode = cm->nodes.len;
+    for (Int k = 0; k < cm->toplevels.len; k++) {
+        Assignment fn = cm->toplevels.cont[k];
+        firstFnNode = fn.nodeInd < firstFnNode ? fn.nodeInd : firstFnNode;
+        cSignature(fn.entityId, fn.nodeInd + 1, &ce, cm);
+        sbAppend(s(";\n"), out);
+    }
+    sbAppend(s("\n"), out);
+
+    // Toplevel constants: the declarations go here, the initializations into "main"
+    StringBuilder* inits = createStringBuilder(256, cm->aTmp);
+    for (Int j = 0; j < firstFnNode; j += cNodeSize(cm->nodes.cont[j])) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp != nodAssignment && nd.tp != nodDef) {
+            continue;
+        }
+        EntityId constEntity = cm->nodes.cont[j + 1].pl1;
+        sbAppendf(out, "static %s v%d;\n",
+                  cTypeName(cm->entities.cont[constEntity].typeId, cm), constEntity);
+        ce.declared[constEntity] = true;
+        ce.out = inits;
+        ce.indent = 1;
+        cAssignment(j, &ce, cm);
+        ce.out = out;
+        ce.indent = 0;
+    }
+    sbAppend(s("\n"), out);
+
+    for (Int k = 0; k < cm->toplevels.len; k++) {
+        cFunction(cm->toplevels.cont[k].nodeInd, &ce, cm);
+    }
+
+    Assignment entry = cm->toplevels.cont[0];
+    TypeId entryType = cm->entities.cont[entry.entityId].typeId;
+    VALIDATEP(entryType <= topVerbatimType || tGetFnArity(entryType, cm) == 0,
+              errCodegenEntryParams)
+    sbAppend(s("int main(void) {\n"), out);
+    sbAppend(stringOfBuilder(inits), out);
+    sbAppendf(out, "    f%d();\n    return 0;\n}\n", entry.entityId);
+    return stringOfBuilder(out);
+}
+
+//}}}
+//{{{ Bytecode
+
+private void initInterpreter(Compiler* cm, Interpreter* rt);
+private void interpretCode(RT);
+private Bool interpretBounded(Long maxSteps, RT);
+private void freeInterpreter(RT);
+private char* rtStringChars(EyrPtr str, RT); // for "bcEvalConstant"
+
+// Compiles the typed AST of the toplevel functions to bytecode, in the order of @toplevels, so a
+// function's id is its index there. Locals and temporaries are first emitted as virtual registers.
+// Then a liveness analysis over the function's code gives the range of instructions where every
+// register is live, and a linear scan packs the registers into stack slots. So variables that are
+// never live at the same time share a slot, and frames stay small. Heap pointers and plain values
+// never share a slot, because the GC takes whatever is in a pointer slot for a pointer.
+// Outgoing calls put their frames right after the caller's slots, in the "call area"
+
+#define BC_LIST_AREA 0x6000 // Register numbers from here on are the slots of list literals
+#define BC_CALL_AREA 0x8000 // Register numbers from here on are offsets into the call area
+#define BC_PENDING   -2     // A toplevel constant which isn't evaluated yet
+#define BC_BAKED     -3     // A toplevel constant evaluated at compile time, see "bcEvalConstant"
+#define BC_UNNUMBERED -2    // A function which has no id yet, because no emitted code calls it
+#define BC_INLINE_MAX_NODES 40 // Functions with bodies up to this size get inlined into their callers
+#define BC_INLINE_MAX_DEPTH 4  // ...but no deeper than this
+#define BC_CONST_EVAL_STEPS 100000000 // Instructions that the initializer of a constant may run
+
+#define bcInstr3(op, a, b, c) (((Ulong)(op) << 58) | ((Ulong)((a) & 0xFFFF) << 40) \
+                               | ((Ulong)((b) & 0xFFFF) << 24) | (Ulong)((c) & 0xFFFF))
+#define bcInstr2(op, a, k) (((Ulong)(op) << 58) | ((Ulong)((a) & 0xFFFF) << 32) | (Ulong)(Unt)(k))
+
+typedef struct { //:BcGen
+    Int fnStart;          // index of the current function's length slot in @bytecode
+    Arr(Int) fnIds;       // [aTmp] function id of every entity, -1 for non-functions
+    Arr(Int) toplevelInds; // [aTmp] index in @toplevels of every function entity
+    StackInt* fnQueue;    // [aTmp] indices in @toplevels by function id, -1 for an initializer
+    Arr(Int) constants;   // [aTmp] node of the literal value of every toplevel constant, or
+                          // BC_PENDING/BC_BAKED, or -1 for the other entities
+    Arr(Int) bakedValues; // [aTmp] baked Int/Bool: the value. Baked String: start in @staticText
+    Arr(Int) bakedLens;   // [aTmp] baked String: length of the text
+    Arr(Int) regs;        // [aTmp] virtual register of every local, -1 if none yet
+    StackInt* locals;     // [aTmp] the locals that have a register, to reset @regs
+    StackInt* regIsPtr;   // [aTmp] per register: 1 iff it holds a heap pointer
+    StackInt* breaks;     // [aTmp] pairs (loop depth, index of the jump to patch)
+    Int callArea;         // size of the call area, in slots
+    StackInt* inlined;    // [aTmp] entities of the function being generated and the ones inlined in it
+    StackInt* inlineReturns; // [aTmp] jumps of the "return"s of the function being inlined, or null
+    Int inlineResult;     // register for the return value of the function being inlined
+    Arr(Int) hoisted;     // [aTmp] per node: register with the value of the subexpression ending
+                          // there, computed before the loop (see "bcHoistInvariants"), or -1
+    Arr(Int) variantIn;   // [aTmp] per entity: the last loop which assigns to it
+    Int countLoops;
+    StackInt* derivedIvs; // [aTmp] triples (induction variable, register, increment) of the loops
+                          // being generated
+    Arr(Bool) escaping;   // [aTmp] per entity: its value may outlive the frame, see "bcFindEscapes"
+    StackInt* listArea;   // [aTmp] per slot of the list area: 1 iff it holds a heap pointer
+    Bool hasFrameLists;   // the current function keeps some lists in its frame
+    Arr(Bool) inBounds;   // [aTmp] per node: the list accessor there is proven to be in bounds, see
+                          // "bcFindInBounds"
+} BcGen;
+
+typedef struct { //:BcExpr An expression in reverse Polish notation
+    Int first;       // node index of the first operand
+    Arr(Int) starts; // [aTmp] by node index - @first: start of the subexpression ending there
+} BcExpr;
+
+// The SSA IR, see "ssaBuild". Terminators end the blocks, and only they can transfer control
+#define irConst      1 // {a = value}
+#define irString     2 // {a = start in the static text, b = length}
+#define irParam      3 // {a = index of the param}
+#define irPhi        4 // {a = start in @operands, b = count, one per predecessor, c = replacement or -1}
+#define irArith      5 // kind = iPlus, iMinus, iTimes, iDivBy, iRemPow2Const or iConcatStrs {a, b}
+#define irCall       6 // {a = entity of the function, b = start in @operands, c = count}
+#define irPrint      7 // {a}
+#define irJump       8 // {a = block}
+#define irBranch     9 // kind = iBranchLt, iBranchEq or iBranchGt: if kind(a) then goto b else goto c
+#define irReturn    10 // {a = value or -1}
+
+typedef struct { //:IrInstr A value or instruction of the SSA IR, named by its index in @IrFunction.instrs
+    Byte op;
+    Byte kind;
+    TypeId type; // tokMisc for instructions without a value
+    Int a;
+    Int b;
+    Int c;
+} IrInstr;
+
+DEFINE_STACK_HEADER(IrInstr)
+DEFINE_STACK(IrInstr) //:createStackIrInstr
+
+typedef struct { //:IrBlock
+    StackInt* instrs; // the phis are among them but get no code there, their values come from the preds
+    StackInt* preds;
+    StackInt* defs;   // pairs (entity, value): the current values of the variables at the block's end
+    StackInt* incompletePhis; // pairs (entity, phi) made before the block got sealed
+    Int term;         // the terminator, -1 if none yet
+    Bool sealed;      // all preds are known
+} IrBlock;
+
+DEFINE_STACK_HEADER(IrBlock)
+DEFINE_STACK(IrBlock) //:createStackIrBlock
+
+typedef struct { //:IrFunction
+    StackIrInstr* instrs;
+    StackIrBlock* blocks; // block 0 is the entry
+    StackInt* operands;   // of the phis and calls
+    StackInt* loops;      // triples (loop id, continue block, break block) of the loops being built
+    Int curBlock;         // where the new instructions go
+} IrFunction;
+
+private Int
+bcEmit(Ulong instr, CM) { //:bcEmit
+    pushInbytecode(instr, cm);
+    return cm->bytecode.len - 1;
+}
+
+private void
+bcPatch(Int instrInd, Int target, CM) { //:bcPatch
+// Sets the code pointer of a jump or branch
+    Ulong* instr = cm->bytecode.cont + instrInd;
+    *instr = (*instr & ~(Ulong)LOWER32BITS) | (Unt)target;
+}
+
+private void
+bcPatchAll(StackInt* jumps, Int target, CM) { //:bcPatchAll
+    for (Int k = 0; k < jumps->len; k++) {
+        bcPatch(jumps->cont[k], target, cm);
+    }
+    jumps->len = 0;
+}
+
+private TypeId
+bcListEltType(TypeId typeId, CM) { //:bcListEltType
+// The element type of a list type (L E), or -1 if it's not a list
+    if (typeId <= topVerbatimType || cm->types.cont[typeId] != 3) {
+        return -1;
+    }
+    TypeHeader hdr = typeReadHeader(typeId, cm);
+    if (hdr.sort != sorTypeCall || hdr.tyrity != 1
+            || hdr.nameAndLen != (Unt)cm->activeBindings[nameOfStandard(strL)]) {
+        return -1;
+    }
+    return cm->types.cont[typeId + 3];
+}
+
+private Bool
+bcIsPtrType(TypeId typeId, CM) { //:bcIsPtrType
+    if (typeId == tokString || bcListEltType(typeId, cm) > -1) {
+        return true;
+    }
+    VALIDATEP(typeId == tokInt || typeId == tokBool, errBytecodeUnsupported)
+    return false;
+}
+
+private Int
+bcNewReg(Bool isPtr, BcGen* g, CM) { //:bcNewReg
+    VALIDATEP(g->regIsPtr->len < BC_LIST_AREA, errBytecodeFrameTooBig)
+    push(isPtr ? 1 : 0, g->regIsPtr);
+    return g->regIsPtr->len - 1;
+}
+
+private Int
+bcRegOf(EntityId entityId, BcGen* g, CM) { //:bcRegOf
+    if (g->regs[entityId] == -1) {
+        g->regs[entityId] = bcNewReg(bcIsPtrType(cm->entities.cont[entityId].typeId, cm), g, cm);
+        push(entityId, g->locals);
+    }
+    return g->regs[entityId];
+}
+
+private Int
+bcLiteralValue(Node nd, CM) { //:bcLiteralValue
+// Ints and Bools. The VM's words are 32-bit
+    if (nd.tp == tokBool) {
+        return nd.pl2 > 0 ? 1 : 0;
+    }
+    VALIDATEP(nd.tp == tokInt, errBytecodeUnsupported)
+    Long value = (Long)(((Ulong)(Unt)nd.pl1 << 32) + (Unt)nd.pl2);
+    VALIDATEP(value >= INT_MIN && value <= INT_MAX, errBytecodeUnsupported)
+    return (Int)value;
+}
+
+private void
+bcArgs(Int callInd, Int countArgs, BcExpr* ex, OUT Arr(Int) args) { //:bcArgs
+// The node indices where the args of a call end, i.e. the roots of their subexpressions
+    Int j = callInd - 1;
+    for (Int k = countArgs - 1; k > -1; k--) {
+        args[k] = j;
+        j = ex->starts[j - ex->first] - 1;
+    }
+}
+
+private TypeId
+bcTypeOf(Int ind, BcExpr* ex, CM) { //:bcTypeOf
+// The type of the subexpression ending at "ind"
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp <= tokString) {
+        return nd.tp;
+    } ei (nd.tp == nodId) {
+        return cm->entities.cont[nd.pl1].typeId;
+    } ei (cOperatorOf(nd.pl1) == opGetElem) {
+        Int args[2];
+        bcArgs(ind, 2, ex, args);
+        return bcListEltType(bcTypeOf(args[0], ex, cm), cm);
+    }
+    return getFunctionReturnType(cm->entities.cont[nd.pl1].typeId, cm);
+}
+
+private Int bcValue(Int ind, Int dest, BcExpr* ex, BcGen* g, CM);
+private BcExpr bcExprOf(Int ind, CM);
+
+private void
+bcBranch(Int opCode, Int reg, Bool negated, StackInt* jumps, CM) { //:bcBranch
+// Jumps iff the branch condition holds on "reg", or iff it doesn't hold if "negated"
+    if (!negated) {
+        push(bcEmit(bcInstr2(opCode, reg, 0), cm), jumps);
+        return;
+    }
+    Int const here = cm->bytecode.len;
+    bcEmit(bcInstr2(opCode, reg, here + 2), cm);
+    push(bcEmit(bcInstr2(iJump, 0, 0), cm), jumps);
+}
+
+private Bool
+bcIsCondOp(Int opId) { //:bcIsCondOp
+// The operators that "bcCond" compiles to branches
+    return opId == opBoolNeg || opId == opBoolAnd || opId == opBoolOr || opId == opLTZero
+        || opId == opGTZero || opId == opLessTh || opId == opGreaterTh || opId == opEquality
+        || opId == opLTEQ || opId == opGTEQ || opId == opNotEqual;
+}
+
+private void
+bcCond(Int ind, Bool sense, StackInt* jumps, BcExpr* ex, BcGen* g, CM) { //:bcCond
+// Emits a jump that's taken iff the Bool expression equals "sense". The jumps to be patched go
+// into "jumps". Comparisons are a subtraction and a branch on the sign of the difference
+    Node nd = cm->nodes.cont[ind];
+    Int const opId = nd.tp == nodCall ? cOperatorOf(nd.pl1) : -1;
+    Int args[2];
+    if (opId == opBoolNeg) {
+        bcArgs(ind, 1, ex, args);
+        bcCond(args[0], !sense, jumps, ex, g, cm);
+    } ei (opId == opBoolAnd || opId == opBoolOr) {
+        bcArgs(ind, 2, ex, args);
+        Bool const shortCircuits = opId == opBoolAnd ? !sense : sense; // the 1st operand decides
+        if (shortCircuits) {
+            bcCond(args[0], sense, jumps, ex, g, cm);
+            bcCond(args[1], sense, jumps, ex, g, cm);
+        } else {
+            StackInt* skips = createStackint32_t(4, cm->aTmp);
+            bcCond(args[0], !sense, skips, ex, g, cm);
+            bcCond(args[1], sense, jumps, ex, g, cm);
+            bcPatchAll(skips, cm->bytecode.len, cm);
+        }
+    } ei (opId == opLTZero || opId == opGTZero) {
+        bcArgs(ind, 1, ex, args);
+        Int const operand = bcValue(args[0], -1, ex, g, cm);
+        bcBranch(opId == opLTZero ? iBranchLt : iBranchGt, operand, !sense, jumps, cm);
+    } ei (bcIsCondOp(opId)) { // comparisons
+        VALIDATEP(getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm) != tokString,
+                  errBytecodeUnsupported)
+        bcArgs(ind, 2, ex, args);
+        Int const left = bcValue(args[0], -1, ex, g, cm);
+        Int const right = bcValue(args[1], -1, ex, g, cm);
+        Int const diff = bcNewReg(false, g, cm);
+        bcEmit(bcInstr3(iMinus, diff, left, right), cm);
+        // <= is "not >", >= is "not <", != is "not =="
+        Int const opCode = (opId == opLessTh || opId == opGTEQ) ? iBranchLt
+                         : (opId == opGreaterTh || opId == opLTEQ) ? iBranchGt : iBranchEq;
+        Bool const isNegation = opId == opLTEQ || opId == opGTEQ || opId == opNotEqual;
+        bcBranch(opCode, diff, isNegation == sense, jumps, cm);
+    } else {
+        Int const value = bcValue(ind, -1, ex, g, cm); // 0 or 1
+        bcBranch(iBranchEq, value, sense, jumps, cm);
+    }
+}
+
+private void bcStatements(Int start, Int sentinel, BcGen* g, CM);
+
+private Bool
+bcIsInlinable(EntityId fnEntity, BcGen* g, CM) { //:bcIsInlinable
+// Small non-recursive functions, if they aren't already being inlined up the chain
+    if (g->inlined->len >= BC_INLINE_MAX_DEPTH) {
+        return false;
+    }
+    for (Int k = 0; k < g->inlined->len; k++) {
+        if (g->inlined->cont[k] == fnEntity) {
+            return false;
+        }
+    }
+    Int const fnInd = cm->toplevels.cont[g->toplevelInds[fnEntity]].nodeInd;
+    Int const sentinel = fnInd + cm->nodes.cont[fnInd].pl2 + 1;
+    if (sentinel - fnInd - 1 > BC_INLINE_MAX_NODES) {
+        return false;
+    }
+    for (Int j = fnInd + 1; j < sentinel; j++) {
+        if (cm->nodes.cont[j].tp == nodCall && cm->nodes.cont[j].pl1 == fnEntity) {
+            return false;
+        }
+    }
+    return true;
+}
+
+private Int
+bcInline(Int ind, Int dest, BcExpr* ex, BcGen* g, CM) { //:bcInline
+// The callee's body is emitted in place of the call. Its bindings get new registers for every
+// copy, the params are set from the args, and its "return"s become jumps to the end of the copy
+    Node nd = cm->nodes.cont[ind];
+    Int const fnInd = cm->toplevels.cont[g->toplevelInds[nd.pl1]].nodeInd;
+    Int const sentinel = fnInd + cm->nodes.cont[fnInd].pl2 + 1;
+    Arr(Int) args = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+    Arr(Int) values = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+    bcArgs(ind, nd.pl2, ex, args);
+    for (Int k = 0; k < nd.pl2; k++) { // before the params get registers, as an arg may be a copy too
+        Node arg = cm->nodes.cont[args[k]];
+        values[k] = (arg.tp == tokInt || arg.tp == tokBool) ? -1 : bcValue(args[k], -1, ex, g, cm);
+    }
+    for (Int j = fnInd + 1; j < sentinel; j++) {
+        if (cm->nodes.cont[j].tp == nodBinding) {
+            g->regs[cm->nodes.cont[j].pl1] = -1;
+        }
+    }
+    for (Int k = 0; k < nd.pl2; k++) {
+        Int const param = bcRegOf(cm->nodes.cont[fnInd + 1 + k].pl1, g, cm);
+        if (values[k] == -1) {
+            bcEmit(bcInstr2(iSetLocal, param, bcLiteralValue(cm->nodes.cont[args[k]], cm)), cm);
+        } else {
+            bcEmit(bcInstr3(iMove, param, values[k], 0), cm);
+        }
+    }
+    TypeId const returnType = getFunctionReturnType(cm->entities.cont[nd.pl1].typeId, cm);
+    Int const result = returnType == tokMisc ? -1
+                     : dest > -1 ? dest : bcNewReg(bcIsPtrType(returnType, cm), g, cm);
+
+    StackInt* outerReturns = g->inlineReturns;
+    Int const outerResult = g->inlineResult;
+    g->inlineReturns = createStackint32_t(4, cm->aTmp);
+    g->inlineResult = result;
+    push(nd.pl1, g->inlined);
+    bcStatements(fnInd + 1 + nd.pl2, sentinel, g, cm);
+    pop(g->inlined);
+    if (hasValues(g->inlineReturns) && peek(g->inlineReturns) == cm->bytecode.len - 1) {
+        pop(g->inlineReturns); // a jump to the very next instruction
+        cm->bytecode.len -= 1;
+    }
+    bcPatchAll(g->inlineReturns, cm->bytecode.len, cm);
+    g->inlineReturns = outerReturns;
+    g->inlineResult = outerResult;
+    return result;
+}
+
+private Int
+bcFnId(EntityId fnEntity, BcGen* g, CM) { //:bcFnId
+// Functions are numbered in the order of their first call, and queued for generation then. So the
+// functions nothing calls (or only dead code calls) never get into the bytecode
+    if (g->fnIds[fnEntity] == BC_UNNUMBERED) {
+        g->fnIds[fnEntity] = g->fnQueue->len;
+        push(g->toplevelInds[fnEntity], g->fnQueue);
+    }
+    return g->fnIds[fnEntity];
+}
+
+private void
+bcCallArgs(Int ind, BcExpr* ex, BcGen* g, CM) { //:bcCallArgs
+// The args are computed first, then moved into the call area, so that nested calls don't
+// clobber them
+    Node nd = cm->nodes.cont[ind];
+    Arr(Int) args = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+    Arr(Int) values = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+    bcArgs(ind, nd.pl2, ex, args);
+    for (Int k = 0; k < nd.pl2; k++) {
+        Node arg = cm->nodes.cont[args[k]];
+        values[k] = (arg.tp == tokInt || arg.tp == tokBool) ? -1 : bcValue(args[k], -1, ex, g, cm);
+    }
+    for (Int k = 0; k < nd.pl2; k++) {
+        Int const slot = BC_CALL_AREA + stackFrameStart + k;
+        if (values[k] == -1) {
+            bcEmit(bcInstr2(iSetLocal, slot, bcLiteralValue(cm->nodes.cont[args[k]], cm)), cm);
+        } else {
+            bcEmit(bcInstr3(iMove, slot, values[k], 0), cm);
+        }
+    }
+    g->callArea = MAX(g->callArea, stackFrameStart + nd.pl2);
+}
+
+private Int
+bcCall(Int ind, Int dest, BcExpr* ex, BcGen* g, CM) { //:bcCall
+// Call of a function of the program. Returns -1 for void functions
+    Node nd = cm->nodes.cont[ind];
+    if (bcIsInlinable(nd.pl1, g, cm)) {
+        return bcInline(ind, dest, ex, g, cm);
+    }
+    Int const fnId = bcFnId(nd.pl1, g, cm);
+    bcCallArgs(ind, ex, g, cm);
+    bcEmit(bcInstr2(iCall, BC_CALL_AREA, fnId), cm);
+
+    TypeId const fnType = cm->entities.cont[nd.pl1].typeId;
+    TypeId const returnType = fnType > topVerbatimType ? getFunctionReturnType(fnType, cm) : tokMisc;
+    if (returnType == tokMisc) {
+        return -1;
+    }
+    Int const result = dest > -1 ? dest : bcNewReg(bcIsPtrType(returnType, cm), g, cm);
+    bcEmit(bcInstr3(iMove, result, BC_CALL_AREA, 0), cm); // the return value is at frame start
+    return result;
+}
+
+private Bool
+bcIsTailCall(Int ind, BcGen* g, CM) { //:bcIsTailCall
+// Whether the expression in tail position at "ind" can reuse the current frame: it's a call of a
+// function of the program which doesn't get inlined. Not if the frame has lists, because the args
+// might point to them
+    Node expr = cm->nodes.cont[ind];
+    Node nd = cm->nodes.cont[expr.tp == nodExpr ? ind + expr.pl2 : ind];
+    if (nd.tp != nodCall || (expr.tp == nodExpr && expr.pl1 != 0) || g->hasFrameLists
+            || cOperatorOf(nd.pl1) > -1 || g->fnIds[nd.pl1] == -1 || bcIsInlinable(nd.pl1, g, cm)) {
+        return false;
+    }
+    Int const fnId = g->fnIds[nd.pl1] > -1 ? g->fnIds[nd.pl1] : g->fnQueue->len;
+    return fnId <= LOWER16BITS && nd.pl2 <= LOWER16BITS;
+}
+
+private void
+bcTailCall(Int ind, BcGen* g, CM) { //:bcTailCall
+// A call in tail position, see "bcIsTailCall". The callee returns right to our caller, so deep
+// tail recursion runs in constant stack space
+    BcExpr ex = bcExprOf(ind, cm);
+    Node expr = cm->nodes.cont[ind];
+    Int const callInd = expr.tp == nodExpr ? ind + expr.pl2 : ind;
+    Node nd = cm->nodes.cont[callInd];
+    Int const fnId = bcFnId(nd.pl1, g, cm);
+    bcCallArgs(callInd, &ex, g, cm);
+    bcEmit(bcInstr3(iTailCall, BC_CALL_AREA, nd.pl2, fnId), cm);
+}
+
+private Int
+bcLog2(Int value) { //:bcLog2
+// The power of 2 that equals "value", or -1 if it's not a power of 2
+    if (value <= 0 || (value & (value - 1)) != 0) {
+        return -1;
+    }
+    Int result = 0;
+    while (value > 1) {
+        value >>= 1;
+        result += 1;
+    }
+    return result;
+}
+
+private Int
+bcOperator(Int opId, Int ind, Int dest, BcExpr* ex, BcGen* g, CM) { //:bcOperator
+    Node nd = cm->nodes.cont[ind];
+    TypeId const operandType = getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm);
+    Int args[2];
+    if ((opId == opPlus || opId == opMinus || opId == opTimes || opId == opDivBy
+            || opId == opRemainder) && operandType == tokInt) {
+        bcArgs(ind, 2, ex, args);
+        Node right = cm->nodes.cont[args[1]];
+        Int const shift = right.tp == tokInt && opId != opPlus && opId != opMinus
+                          ? bcLog2(bcLiteralValue(right, cm)) : -1;
+        if (shift > -1) { // strength reduction to shifts and masks
+            Int const result = bcValue(args[0], dest > -1 ? dest : bcNewReg(false, g, cm), ex, g, cm);
+            Int const opCode = opId == opTimes ? iShiftLeftConst
+                             : opId == opDivBy ? iDivByPow2Const : iRemPow2Const;
+            bcEmit(bcInstr2(opCode, result, shift), cm);
+            return result;
+        }
+        VALIDATEP(opId != opRemainder, errBytecodeUnsupported) // only by powers of 2 so far
+        Int const opCode = opId == opPlus ? iPlus : opId == opMinus ? iMinus
+                         : opId == opTimes ? iTimes : iDivBy;
+        if (right.tp == tokInt && !(opId == opDivBy && bcLiteralValue(right, cm) == 0)) {
+            // Into the result, then modified in place. A zero divisor is left to the runtime check
+            Int const result = bcValue(args[0], dest > -1 ? dest : bcNewReg(false, g, cm), ex, g, cm);
+            bcEmit(bcInstr2(opCode - iPlus + iPlusConst, result, bcLiteralValue(right, cm)), cm);
+            return result;
+        }
+        Int const left = bcValue(args[0], -1, ex, g, cm);
+        Int const rightReg = bcValue(args[1], -1, ex, g, cm);
+        Int const result = dest > -1 ? dest : bcNewReg(false, g, cm);
+        bcEmit(bcInstr3(opCode, result, left, rightReg), cm);
+        return result;
+    } ei (opId == opPlus && operandType == tokString) {
+        bcArgs(ind, 2, ex, args);
+        Int const left = bcValue(args[0], -1, ex, g, cm);
+        Int const right = bcValue(args[1], -1, ex, g, cm);
+        Int const result = dest > -1 ? dest : bcNewReg(true, g, cm);
+        bcEmit(bcInstr3(iConcatStrs, result, left, right), cm);
+        return result;
+    } ei (opId == opSize) { // strings and lists start with their length
+        bcArgs(ind, 1, ex, args);
+        TypeId const argType = bcTypeOf(args[0], ex, cm);
+        VALIDATEP(argType == tokString || bcListEltType(argType, cm) > -1, errBytecodeUnsupported)
+        Int const obj = bcValue(args[0], -1, ex, g, cm);
+        Int const result = dest > -1 ? dest : bcNewReg(false, g, cm);
+        bcEmit(bcInstr3(iGetFld, result, obj, 0), cm);
+        return result;
+    } ei (opId == opGetElem) {
+        bcArgs(ind, 2, ex, args);
+        TypeId const eltType = bcTypeOf(ind, ex, cm);
+        VALIDATEP(eltType > -1, errBytecodeUnsupported)
+        Int const lst = bcValue(args[0], -1, ex, g, cm);
+        Int const index = bcValue(args[1], -1, ex, g, cm);
+        Int const result = dest > -1 ? dest : bcNewReg(bcIsPtrType(eltType, cm), g, cm);
+        bcEmit(bcInstr3(g->inBounds[ind] ? iGetElemUnchecked : iGetElem, result, lst, index), cm);
+        return result;
+    }
+    // Bool-valued: computed by branching, the result is written only after the condition
+    VALIDATEP(bcIsCondOp(opId), errBytecodeUnsupported)
+    StackInt* falseJumps = createStackint32_t(4, cm->aTmp);
+    bcCond(ind, false, falseJumps, ex, g, cm);
+    Int const result = dest > -1 ? dest : bcNewReg(false, g, cm);
+    bcEmit(bcInstr2(iSetLocal, result, 1), cm);
+    Int const jumpOver = bcEmit(bcInstr2(iJump, 0, 0), cm);
+    bcPatchAll(falseJumps, cm->bytecode.len, cm);
+    bcEmit(bcInstr2(iSetLocal, result, 0), cm);
+    bcPatch(jumpOver, cm->bytecode.len, cm);
+    return result;
+}
+
+private Int
+bcAppendStaticText(String text, CM) { //:bcAppendStaticText
+// Returns the start of the text in the static text
+    if (cm->staticText == null) {
+        cm->staticText = createStringBuilder(256, cm->a);
+    }
+    Int const start = cm->staticText->len;
+    sbAppend(text, cm->staticText);
+    return start;
+}
+
+private Int
+bcStaticString(Int start, Int len, Int dest, BcGen* g, CM) { //:bcStaticString
+// A new string is a copy of a piece of the static text. Its length goes in the lower 24 bits of
+// the instruction
+    VALIDATEP(len <= LOWER24BITS, errStringTooLong)
+    Int const startReg = bcNewReg(false, g, cm);
+    Int const result = dest > -1 ? dest : bcNewReg(true, g, cm);
+    bcEmit(bcInstr2(iSetLocal, startReg, start), cm);
+    bcEmit(bcInstr3(iNewstring, result, startReg, 0) | (Unt)len, cm);
+    return result;
+}
+
+private Int
+bcString(Int ind, Int dest, BcGen* g, CM) { //:bcString
+    SourceLoc loc = cm->sourceLocs->cont[ind];
+    Int const len = loc.lenBts - 2; // without the backticks
+    Int const start = bcAppendStaticText(
+            (String){ .cont = cm->sourceCode + locStartBt(loc) + 1, .len = len }, cm);
+    return bcStaticString(start, len, dest, g, cm);
+}
+
+private Int
+bcBaked(EntityId constEntity, Int dest, BcGen* g, CM) { //:bcBaked
+    if (cm->entities.cont[constEntity].typeId == tokString) {
+        return bcStaticString(g->bakedValues[constEntity], g->bakedLens[constEntity], dest, g, cm);
+    }
+    Int const result = dest > -1 ? dest : bcNewReg(false, g, cm);
+    bcEmit(bcInstr2(iSetLocal, result, g->bakedValues[constEntity]), cm);
+    return result;
+}
+
+private Int
+bcValue(Int ind, Int dest, BcExpr* ex, BcGen* g, CM) { //:bcValue
+// Emits the subexpression ending at "ind" and returns the register with its value. If "dest" is
+// given, that's where the value goes, and it's only written after all the operands have been read
+    Node nd = cm->nodes.cont[ind];
+    if (g->hoisted[ind] > -1) {
+        if (dest > -1 && dest != g->hoisted[ind]) {
+            bcEmit(bcInstr3(iMove, dest, g->hoisted[ind], 0), cm);
+            return dest;
+        }
+        return g->hoisted[ind];
+    } ei (nd.tp == tokInt || nd.tp == tokBool) {
+        Int const result = dest > -1 ? dest : bcNewReg(false, g, cm);
+        bcEmit(bcInstr2(iSetLocal, result, bcLiteralValue(nd, cm)), cm);
+        return result;
+    } ei (nd.tp == tokString) {
+        return bcString(ind, dest, g, cm);
+    } ei (nd.tp == nodId) {
+        if (g->regs[nd.pl1] == -1 && g->constants[nd.pl1] > -1) { // a toplevel constant
+            return bcValue(g->constants[nd.pl1], dest, ex, g, cm);
+        } ei (g->constants[nd.pl1] == BC_BAKED) {
+            return bcBaked(nd.pl1, dest, g, cm);
+        }
+        VALIDATEP(g->constants[nd.pl1] != BC_PENDING, errConstantOrder)
+        VALIDATEP(nd.pl1 >= cm->stats.countNonparsedEntities && g->constants[nd.pl1] == -1,
+                  errBytecodeUnsupported)
+        Int const reg = bcRegOf(nd.pl1, g, cm);
+        if (dest > -1 && dest != reg) {
+            bcEmit(bcInstr3(iMove, dest, reg, 0), cm);
+            return dest;
+        }
+        return reg;
+    }
+    VALIDATEP(nd.tp == nodCall, errBytecodeUnsupported)
+    Int const opId = cOperatorOf(nd.pl1);
+    if (opId > -1) {
+        return bcOperator(opId, ind, dest, ex, g, cm);
+    } ei (g->fnIds[nd.pl1] != -1) {
+        return bcCall(ind, dest, ex, g, cm);
+    }
+    // The Prelude
+    Entity ent = cm->entities.cont[nd.pl1];
+    VALIDATEP(ent.name == nameOfStandard(strPrint) && nd.pl2 == 1
+              && getFirstParamType(ent.typeId, cm) == tokString, errBytecodeUnsupported)
+    Int arg;
+    bcArgs(ind, 1, ex, &arg);
+    bcEmit(bcInstr3(iPrint, 0, 0, bcValue(arg, -1, ex, g, cm)), cm);
+    return -1;
+}
+
+private BcExpr
+bcExprOf(Int ind, CM) { //:bcExprOf
+// Finds where every subexpression starts. An operand starts at itself, a call at its first arg.
+// The declarations inside an expression (the list literals) belong to the operand after them
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp != nodExpr) { // a single operand
+        return (BcExpr){ .first = ind, .starts = null };
+    }
+    BcExpr ex = (BcExpr){ .first = ind + 1, .starts = allocateArray(nd.pl2, Int, cm->aTmp) };
+    StackInt* st = createStackint32_t(16, cm->aTmp);
+    Int declStart = -1;
+    for (Int j = ind + 1; j < ind + nd.pl2 + 1; j++) {
+        Node elt = cm->nodes.cont[j];
+        if (elt.tp == nodAssignment) {
+            declStart = declStart > -1 ? declStart : j;
+            j += elt.pl2;
+            continue;
+        }
+        Int start = declStart > -1 ? declStart : j;
+        declStart = -1;
+        if (elt.tp == nodCall) {
+            VALIDATEI(st->len >= elt.pl2, iErrorInconsistentSpans)
+            for (Int k = 0; k < elt.pl2; k++) {
+                start = pop(st);
+            }
+        }
+        ex.starts[j - ex.first] = start;
+        push(start, st);
+    }
+    VALIDATEI(st->len == 1, iErrorInconsistentSpans)
+    return ex;
+}
+
+private void
+bcInnerDecls(Int ind, BcGen* g, CM) { //:bcInnerDecls
+// The declarations inside an expression, i.e. its list literals. They go before all of its code
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp != nodExpr || nd.pl1 == 0) {
+        return;
+    }
+    for (Int j = ind + 1; j < ind + nd.pl2 + 1; j++) {
+        if (cm->nodes.cont[j].tp == nodAssignment) {
+            bcStatements(j, j + cm->nodes.cont[j].pl2 + 1, g, cm);
+            j += cm->nodes.cont[j].pl2;
+        }
+    }
+}
+
+private Int
+bcExpr(Int ind, Int dest, BcGen* g, CM) { //:bcExpr
+// A whole expression, i.e. a nodExpr or a single operand
+    bcInnerDecls(ind, g, cm);
+    BcExpr ex = bcExprOf(ind, cm);
+    Node nd = cm->nodes.cont[ind];
+    return bcValue(nd.tp == nodExpr ? ind + nd.pl2 : ind, dest, &ex, g, cm);
+}
+
+private void
+bcCondExpr(Int ind, StackInt* falseJumps, BcGen* g, CM) { //:bcCondExpr
+    bcInnerDecls(ind, g, cm);
+    BcExpr ex = bcExprOf(ind, cm);
+    Node nd = cm->nodes.cont[ind];
+    bcCond(nd.tp == nodExpr ? ind + nd.pl2 : ind, false, falseJumps, &ex, g, cm);
+}
+
+private Int
+bcConstCondition(Int ind, BcGen* g, CM) { //:bcConstCondition
+// 1 or 0 for a condition known at compile time (a literal or a Bool constant), otherwise -1
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp == nodExpr && nd.pl2 == 1) { // folded by "foldConstants"
+        nd = cm->nodes.cont[ind + 1];
+    }
+    if (nd.tp == tokBool) {
+        return nd.pl2;
+    } ei (nd.tp != nodId || g->regs[nd.pl1] > -1) {
+        return -1;
+    } ei (g->constants[nd.pl1] > -1) {
+        return bcConstCondition(g->constants[nd.pl1], g, cm);
+    } ei (g->constants[nd.pl1] == BC_BAKED && cm->entities.cont[nd.pl1].typeId == tokBool) {
+        return g->bakedValues[nd.pl1];
+    }
+    return -1;
+}
+
+private void
+bcIf(Int ind, BcGen* g, CM) { //:bcIf
+// [If cond Scope ElseIf(cond Scope)... ElseIf(Scope)]. The clauses with a false constant condition
+// are dropped, and so are all the clauses after a true one
+    Node ifNode = cm->nodes.cont[ind];
+    Int const sentinel = ind + ifNode.pl2 + 1;
+    StackInt* endJumps = createStackint32_t(4, cm->aTmp);
+    StackInt* falseJumps = createStackint32_t(4, cm->aTmp);
+    Int j = ind + 1;
+    while (j < sentinel) {
+        Int clauseEnd = sentinel;
+        if (cm->nodes.cont[j].tp == nodElseIf) {
+            clauseEnd = j + cm->nodes.cont[j].pl2 + 1;
+            j += 1;
+        }
+        Int condition = 1; // "else"
+        if (cm->nodes.cont[j].tp != nodScope) {
+            condition = bcConstCondition(j, g, cm);
+            if (condition == -1) {
+                bcCondExpr(j, falseJumps, g, cm);
+            }
+            j += cNodeSize(cm->nodes.cont[j]);
+        }
+        Node scope = cm->nodes.cont[j];
+        if (condition == 0) {
+            j += scope.pl2 + 1;
+            continue;
+        }
+        bcStatements(j + 1, j + scope.pl2 + 1, g, cm);
+        j += scope.pl2 + 1;
+        if (condition == 1) {
+            break;
+        }
+        if (j < sentinel) {
+            push(bcEmit(bcInstr2(iJump, 0, 0), cm), endJumps);
+        }
+        bcPatchAll(falseJumps, cm->bytecode.len, cm);
+        VALIDATEI(j == clauseEnd || clauseEnd == sentinel, iErrorInconsistentSpans)
+    }
+    bcPatchAll(endJumps, cm->bytecode.len, cm);
+}
+
+private Bool
+bcIsInvariant(Int start, Int end, BcGen* g, CM) { //:bcIsInvariant
+// Whether the subexpression [start; end] has the same value on every iteration of the current loop
+// and may be computed even if the loop doesn't run: Int arithmetic which can't fail, over literals,
+// constants and the variables the loop doesn't assign
+    for (Int m = start; m <= end; m++) {
+        Node nd = cm->nodes.cont[m];
+        if (nd.tp == tokInt) {
+            continue;
+        } ei (nd.tp == nodId) {
+            if ((g->regs[nd.pl1] > -1 && g->variantIn[nd.pl1] != g->countLoops)
+                    || g->constants[nd.pl1] > -1 || g->constants[nd.pl1] == BC_BAKED) {
+                continue;
+            }
+            return false;
+        } ei (nd.tp != nodCall) {
+            return false;
+        }
+        Int const opId = cOperatorOf(nd.pl1);
+        if (opId == -1 || getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm) != tokInt) {
+            return false;
+        } ei (opId == opDivBy || opId == opRemainder) { // only by a nonzero literal
+            if (cm->nodes.cont[m - 1].tp != tokInt || bcLiteralValue(cm->nodes.cont[m - 1], cm) == 0) {
+                return false;
+            }
+        } ei (opId != opPlus && opId != opMinus && opId != opTimes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+private Int
+bcIvIncrement(EntityId iv, Int start, Int sentinel, Int bodyInd, CM) { //:bcIvIncrement
+// The increment of a basic induction variable: one that's assigned only once in the loop, by a
+// statement "iv = iv + c" or "iv = iv - c" directly in the loop body. 0 if "iv" isn't one
+    Int countAssignments = 0;
+    for (Int j = start; j < sentinel; j++) {
+        if (cm->nodes.cont[j].tp == nodBinding && cm->nodes.cont[j].pl1 == iv) {
+            countAssignments += 1;
+        }
+    }
+    if (countAssignments != 1) {
+        return 0;
+    }
+    Int const bodySentinel = bodyInd + cm->nodes.cont[bodyInd].pl2 + 1;
+    for (Int j = bodyInd + 1; j < bodySentinel; j += cNodeSize(cm->nodes.cont[j])) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp != nodAssignment || cm->nodes.cont[j + 1].pl1 != iv) {
+            continue;
+        }
+        Node expr = cm->nodes.cont[j + 2];
+        Node left = cm->nodes.cont[j + 3];
+        Node right = cm->nodes.cont[j + 4];
+        Node op = cm->nodes.cont[j + 5];
+        if (nd.pl2 != 5 || expr.tp != nodExpr || left.tp != nodId || left.pl1 != iv
+                || right.tp != tokInt || op.tp != nodCall) {
+            return 0;
+        }
+        Int const opId = cOperatorOf(op.pl1);
+        if (opId == opPlus) {
+            return bcLiteralValue(right, cm);
+        } ei (opId == opMinus) {
+            return -bcLiteralValue(right, cm);
+        }
+        return 0;
+    }
+    return 0;
+}
+
+private Int
+bcDerivedIv(Int start, Int end, Int loopStart, Int sentinel, Int bodyInd, BcExpr* ex, BcGen* g,
+            CM) { //:bcDerivedIv
+// Strength reduction of "iv*c" for a basic induction variable "iv": it gets a register which is set
+// before the loop and then incremented along with "iv". Returns the register, or -1
+    Node nd = cm->nodes.cont[end];
+    if (end - start != 2 || cOperatorOf(nd.pl1) != opTimes
+            || getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm) != tokInt) {
+        return -1;
+    }
+    Node left = cm->nodes.cont[start];
+    Node right = cm->nodes.cont[start + 1];
+    if (left.tp == tokInt) {
+        Node tmp = left;
+        left = right;
+        right = tmp;
+    }
+    if (left.tp != nodId || right.tp != tokInt || g->regs[left.pl1] == -1) {
+        return -1;
+    }
+    Int const increment = bcIvIncrement(left.pl1, loopStart, sentinel, bodyInd, cm);
+    if (increment == 0) {
+        return -1;
+    }
+    Int const reg = bcValue(end, -1, ex, g, cm);
+    push(left.pl1, g->derivedIvs);
+    push(reg, g->derivedIvs);
+    push(increment*bcLiteralValue(right, cm), g->derivedIvs);
+    return reg;
+}
+
+private StackInt*
+bcHoistInvariants(Int loopStart, Int sentinel, Int bodyInd, BcGen* g, CM) { //:bcHoistInvariants
+// Loop-invariant code motion: the largest invariant subexpressions of the loop [loopStart;
+// sentinel) are computed before it, into the registers in @hoisted. Returns the nodes to reset
+// after the loop
+    g->countLoops += 1;
+    for (Int j = loopStart; j < sentinel; j++) {
+        if (cm->nodes.cont[j].tp == nodBinding) {
+            g->variantIn[cm->nodes.cont[j].pl1] = g->countLoops;
+        }
+    }
+    StackInt* hoisted = createStackint32_t(4, cm->aTmp);
+    for (Int j = loopStart; j < sentinel; j++) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp != nodExpr || nd.pl1 != 0) {
+            continue;
+        }
+        BcExpr ex = bcExprOf(j, cm);
+        for (Int k = j + nd.pl2; k > j; k--) {
+            if (cm->nodes.cont[k].tp != nodCall) {
+                continue;
+            }
+            Int const start = ex.starts[k - ex.first];
+            if (g->hoisted[k] == -1) {
+                if (bcIsInvariant(start, k, g, cm)) {
+                    g->hoisted[k] = bcValue(k, -1, &ex, g, cm);
+                } else {
+                    g->hoisted[k] = bcDerivedIv(start, k, loopStart, sentinel, bodyInd, &ex, g, cm);
+                }
+                if (g->hoisted[k] > -1) {
+                    push(k, hoisted);
+                }
+            }
+            if (g->hoisted[k] > -1) {
+                k = start; // the subexpressions inside are done too
+            }
+        }
+        j += nd.pl2;
+    }
+    return hoisted;
+}
+
+private void
+bcFindInBounds(Int ind, Int condInd, Int bodyInd, BcGen* g, CM) { //:bcFindInBounds
+// Bounds check elimination for a loop "for i~ = c; i < ##lst; { ... i = i + 1 ... }" where c >= 0
+// and "lst" isn't reassigned in the loop, so its length doesn't change. Then 0 <= i < ##lst holds in
+// the body up to the increment, and the accesses "lst[i]" there need no checks. The step must be 1:
+// i + 1 <= ##lst can't overflow, but i + d for a bigger d could wrap around to a negative index
+    Node expr = cm->nodes.cont[condInd];
+    if (expr.tp != nodExpr || expr.pl1 != 0 || expr.pl2 != 4) {
+        return;
+    }
+    Node iv = cm->nodes.cont[condInd + 1];
+    Node lst = cm->nodes.cont[condInd + 2];
+    Node size = cm->nodes.cont[condInd + 3];
+    Node cmp = cm->nodes.cont[condInd + 4];
+    if (iv.tp != nodId || lst.tp != nodId || size.tp != nodCall || cOperatorOf(size.pl1) != opSize
+            || cmp.tp != nodCall || cOperatorOf(cmp.pl1) != opLessTh
+            || g->variantIn[lst.pl1] == g->countLoops
+            || bcListEltType(cm->entities.cont[lst.pl1].typeId, cm) == -1
+            || bcIvIncrement(iv.pl1, condInd, ind + cm->nodes.cont[ind].pl2 + 1, bodyInd, cm) != 1) {
+        return;
+    }
+    Bool isNonneg = false; // the initial value
+    for (Int j = ind + 2; j < condInd; j += cNodeSize(cm->nodes.cont[j])) {
+        Node init = cm->nodes.cont[j];
+        if (init.tp == nodAssignment && cm->nodes.cont[j + 1].tp == nodBinding
+                && cm->nodes.cont[j + 1].pl1 == iv.pl1) {
+            Node right = cm->nodes.cont[j + init.pl3];
+            isNonneg = right.tp == tokInt && bcLiteralValue(right, cm) >= 0;
+        }
+    }
+    if (!isNonneg) {
+        return;
+    }
+    Int const bodySentinel = bodyInd + cm->nodes.cont[bodyInd].pl2 + 1;
+    Int increment = bodyInd + 1;
+    while (increment < bodySentinel && !(cm->nodes.cont[increment].tp == nodAssignment
+            && cm->nodes.cont[increment + 1].tp == nodBinding
+            && cm->nodes.cont[increment + 1].pl1 == iv.pl1)) {
+        increment += cNodeSize(cm->nodes.cont[increment]);
+    }
+    EntityId const getElem = typeAccessorEntity(opGetElem, cm);
+    EntityId const getElemPtr = typeAccessorEntity(opGetElemPtr, cm);
+    for (Int j = bodyInd + 3; j < increment; j++) {
+        Node nd = cm->nodes.cont[j];
+        Node arg0 = cm->nodes.cont[j - 2];
+        Node arg1 = cm->nodes.cont[j - 1];
+        if (nd.tp == nodCall && (nd.pl1 == getElem || nd.pl1 == getElemPtr)
+                && arg0.tp == nodId && arg0.pl1 == lst.pl1 && arg1.tp == nodId && arg1.pl1 == iv.pl1) {
+            g->inBounds[j] = true;
+        }
+    }
+}
+
+private void
+bcFor(Int ind, BcGen* g, CM) { //:bcFor
+// [For Scope(inits... cond Scope(body...))] or [For cond Scope(body...)]. Continue jumps to the
+// condition, break to after the loop
+    Node forNode = cm->nodes.cont[ind];
+    Int const bodyInd = ind + forNode.pl3;
+    Int j = ind + 1;
+    if (cm->nodes.cont[j].tp == nodScope && j != bodyInd) {
+        j += 1;
+    }
+    Int condInd = -1;
+    while (j < bodyInd) {
+        Node nd = cm->nodes.cont[j];
+        Int const size = cNodeSize(nd);
+        if (j + size == bodyInd && nd.tp != nodAssignment) {
+            condInd = j;
+        } else {
+            bcStatements(j, j + size, g, cm);
+        }
+        j += size;
+    }
+    Int const countDerived = g->derivedIvs->len;
+    StackInt* hoisted = bcHoistInvariants(condInd > -1 ? condInd : bodyInd,
+                                          ind + forNode.pl2 + 1, bodyInd, g, cm);
+    if (condInd > -1) {
+        bcFindInBounds(ind, condInd, bodyInd, g, cm);
+    }
+    Int const top = cm->bytecode.len;
+    StackInt* exits = createStackint32_t(4, cm->aTmp);
+    if (condInd > -1) {
+        bcCondExpr(condInd, exits, g, cm);
+    }
+    push(((BtCodegen){ .tp = iJump, .startInstr = top, .sentinel = ind + forNode.pl2 + 1,
+                       .loopId = forNode.pl1 }), cm->cgBtrack);
+    bcStatements(bodyInd + 1, bodyInd + cm->nodes.cont[bodyInd].pl2 + 1, g, cm);
+    bcEmit(bcInstr2(iJump, 0, top), cm);
+
+    Int const depth = cm->cgBtrack->len;
+    pop(cm->cgBtrack);
+    bcPatchAll(exits, cm->bytecode.len, cm);
+    Int countKept = 0;
+    for (Int k = 0; k < g->breaks->len; k += 2) {
+        if (g->breaks->cont[k] == depth) {
+            bcPatch(g->breaks->cont[k + 1], cm->bytecode.len, cm);
+        } else {
+            g->breaks->cont[countKept] = g->breaks->cont[k];
+            g->breaks->cont[countKept + 1] = g->breaks->cont[k + 1];
+            countKept += 2;
+        }
+    }
+    g->breaks->len = countKept;
+    for (Int k = 0; k < hoisted->len; k++) {
+        g->hoisted[hoisted->cont[k]] = -1;
+    }
+    g->derivedIvs->len = countDerived;
+}
+
+private void
+bcBreakCont(Node nd, BcGen* g, CM) { //:bcBreakCont
+// Goes to the innermost loop with the loop id, or to the innermost loop if there's no such one
+// (that's how the unlabelled ones get there)
+    Bool const isContinue = nd.pl1 >= BIG;
+    Int const loopId = isContinue ? nd.pl1 - BIG : nd.pl1;
+    StackBtCodegen* loops = cm->cgBtrack;
+    VALIDATEP(hasValues(loops), errBreakContinueInvalidDepth)
+    Int depth = loops->len;
+    if (loopId > 0) {
+        for (Int k = loops->len; k > 0; k--) {
+            if (loops->cont[k - 1].loopId == loopId) {
+                depth = k;
+                break;
+            }
+        }
+    }
+    if (isContinue) {
+        bcEmit(bcInstr2(iJump, 0, loops->cont[depth - 1].startInstr), cm);
+    } else {
+        push(depth, g->breaks);
+        push(bcEmit(bcInstr2(iJump, 0, 0), cm), g->breaks);
+    }
+}
+
+private EntityId
+bcNameOf(Int ind, CM) { //:bcNameOf
+// The entity if the expression at "ind" is just a name, else -1
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp == nodExpr) {
+        nd = cm->nodes.cont[ind + nd.pl2]; // the root
+    }
+    return nd.tp == nodId ? nd.pl1 : -1;
+}
+
+private void
+bcArgEscapes(Int ind, StackInt* edges, BcGen* g, CM) { //:bcArgEscapes
+// The names passed to the calls in the expression at "ind". A param of a toplevel function gets an
+// edge to its arg, the Prelude functions keep their args
+    Node expr = cm->nodes.cont[ind];
+    BcExpr ex = bcExprOf(ind, cm);
+    for (Int j = ind + 1; j < ind + expr.pl2 + 1; j++) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp == nodAssignment) { // the inner declarations are done by "bcFindEscapes"
+            j += nd.pl2;
+            continue;
+        } ei (nd.tp != nodCall || cOperatorOf(nd.pl1) > -1) {
+            continue;
+        }
+        Arr(Int) args = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+        bcArgs(j, nd.pl2, &ex, args);
+        for (Int k = 0; k < nd.pl2; k++) {
+            Node arg = cm->nodes.cont[args[k]];
+            if (arg.tp != nodId) {
+                continue;
+            } ei (g->fnIds[nd.pl1] != -1) {
+                Int const calleeInd = cm->toplevels.cont[g->toplevelInds[nd.pl1]].nodeInd;
+                push(cm->nodes.cont[calleeInd + 1 + k].pl1, edges);
+                push(arg.pl1, edges);
+            } else {
+                g->escaping[arg.pl1] = true;
+            }
+        }
+    }
+}
+
+private void
+bcFindEscapes(BcGen* g, CM) { //:bcFindEscapes
+// Escape analysis for the list literals, over the whole program. A value escapes if it may be used
+// after its frame is gone: it's returned, stored in a list or a mutable variable, or passed to a
+// param which escapes. Binding it to an immutable name or passing it to a param of a toplevel
+// function makes it escape iff that name or param does. These are the edges, and the escapes
+// spread over them until nothing changes. The operators never keep their args
+    memset(g->escaping, 0, cm->entities.len*sizeof(Bool));
+    StackInt* edges = createStackint32_t(16, cm->aTmp); // pairs (entity, entity escaping with it)
+    for (Int j = 0; j < cm->nodes.len; j++) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp == nodAssignment || nd.tp == nodDef) {
+            Node left = cm->nodes.cont[j + 1];
+            EntityId const value = bcNameOf(j + nd.pl3, cm);
+            if (value > -1 && left.tp == nodBinding
+                    && cm->entities.cont[left.pl1].class == classImmut) {
+                push(left.pl1, edges);
+                push(value, edges);
+            } ei (value > -1) {
+                g->escaping[value] = true;
+            }
+        } ei (nd.tp == nodReturn && nd.pl2 > 0 && bcNameOf(j + 1, cm) > -1) {
+            g->escaping[bcNameOf(j + 1, cm)] = true;
+        } ei (nd.tp == nodDataAlloc) {
+            Int k = j + 1;
+            for (Int m = 0; m < nd.pl3; m++) {
+                if (cm->nodes.cont[k].tp == nodId) {
+                    g->escaping[cm->nodes.cont[k].pl1] = true;
+                }
+                k += cNodeSize(cm->nodes.cont[k]);
+            }
+        } ei (nd.tp == nodExpr) {
+            bcArgEscapes(j, edges, g, cm);
+        }
+    }
+    Bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Int k = 0; k < edges->len; k += 2) {
+            if (g->escaping[edges->cont[k]] && !g->escaping[edges->cont[k + 1]]) {
+                g->escaping[edges->cont[k + 1]] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+private void
+bcDataAlloc(Int ind, EntityId entityId, BcGen* g, CM) { //:bcDataAlloc
+// A list literal. Its elements are computed into consecutive slots of the list area. If the list
+// doesn't escape (see "bcFindEscapes"), it stays right there in the frame, with no heap allocation.
+// Otherwise the slots get copied into a new heap list
+    Node nd = cm->nodes.cont[ind];
+    TypeId const eltType = bcListEltType(cm->entities.cont[entityId].typeId, cm);
+    VALIDATEP(eltType > -1 || nd.pl3 == 0, errBytecodeUnsupported) // an empty list has no type yet
+    Bool const eltIsPtr = nd.pl3 > 0 && bcIsPtrType(eltType, cm);
+    Bool const isOnStack = !g->escaping[entityId];
+    if (isOnStack) {
+        push(0, g->listArea); // the length
+        g->hasFrameLists = true;
+    }
+    Int const start = BC_LIST_AREA + g->listArea->len;
+    for (Int k = 0; k < nd.pl3; k++) {
+        push(eltIsPtr ? 1 : 0, g->listArea);
+    }
+    VALIDATEP(BC_LIST_AREA + g->listArea->len < BC_CALL_AREA, errBytecodeFrameTooBig)
+    Int j = ind + 1;
+    for (Int k = 0; k < nd.pl3; k++) {
+        bcExpr(j, start + k, g, cm);
+        j += cNodeSize(cm->nodes.cont[j]);
+    }
+    if (g->regs[entityId] == -1) {
+        g->regs[entityId] = bcNewReg(!isOnStack, g, cm);
+        push(entityId, g->locals);
+    }
+    Int const opCode = isOnStack ? iNewStackList : eltIsPtr ? iNewPtrList : iNewList;
+    bcEmit(bcInstr3(opCode, g->regs[entityId], start, nd.pl3), cm);
+}
+
+private void
+bcSetElem(Int ind, BcGen* g, CM) { //:bcSetElem
+// "lst[i] = value". The left side is an expression ending with the opGetElemPtr accessor
+    Node nd = cm->nodes.cont[ind];
+    Node left = cm->nodes.cont[ind + 1];
+    Int const accessorInd = ind + 1 + left.pl2;
+    VALIDATEP(left.pl1 == 0 && cm->nodes.cont[accessorInd].tp == nodCall
+              && cm->nodes.cont[accessorInd].pl1 == typeAccessorEntity(opGetElemPtr, cm),
+              errBytecodeUnsupported)
+    BcExpr ex = bcExprOf(ind + 1, cm);
+    Int args[2];
+    bcArgs(accessorInd, 2, &ex, args);
+    Int const lst = bcValue(args[0], -1, &ex, g, cm);
+    Int const index = bcValue(args[1], -1, &ex, g, cm);
+    Int const value = bcExpr(ind + nd.pl3, -1, g, cm);
+    bcEmit(bcInstr3(g->inBounds[accessorInd] ? iSetElemUnchecked : iSetElem, lst, index, value), cm);
+}
+
+private void
+bcStatements(Int start, Int sentinel, BcGen* g, CM) { //:bcStatements
+    Int j = start;
+    while (j < sentinel) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp == nodAssignment && cm->nodes.cont[j + 1].tp == nodExpr) {
+            bcSetElem(j, g, cm);
+        } ei (nd.tp == nodAssignment || nd.tp == nodDef) {
+            Node left = cm->nodes.cont[j + 1];
+            VALIDATEP(left.tp == nodBinding, errBytecodeUnsupported)
+            if (cm->nodes.cont[j + nd.pl3].tp == nodDataAlloc) {
+                bcDataAlloc(j + nd.pl3, left.pl1, g, cm);
+                j += cNodeSize(nd);
+                continue;
+            }
+            bcExpr(j + nd.pl3, bcRegOf(left.pl1, g, cm), g, cm);
+            for (Int k = 0; k < g->derivedIvs->len; k += 3) { // see "bcDerivedIv"
+                if (g->derivedIvs->cont[k] == left.pl1) {
+                    bcEmit(bcInstr2(iPlusConst, g->derivedIvs->cont[k + 1],
+                                    g->derivedIvs->cont[k + 2]), cm);
+                }
+            }
+        } ei (nd.tp == nodScope) {
+            bcStatements(j + 1, j + nd.pl2 + 1, g, cm);
+        } ei (nd.tp == nodIf) {
+            bcIf(j, g, cm);
+        } ei (nd.tp == nodFor) {
+            bcFor(j, g, cm);
+        } ei (nd.tp == nodBreakCont) {
+            bcBreakCont(nd, g, cm);
+            return; // the rest of the scope is unreachable
+        } ei (nd.tp == nodReturn && g->inlineReturns != null) { // see "bcInline"
+            if (nd.pl2 > 0) {
+                bcExpr(j + 1, g->inlineResult, g, cm);
+            }
+            push(bcEmit(bcInstr2(iJump, 0, 0), cm), g->inlineReturns);
+            return;
+        } ei (nd.tp == nodReturn) {
+            if (nd.pl2 > 0 && bcIsTailCall(j + 1, g, cm)) {
+                bcTailCall(j + 1, g, cm);
+            } ei (nd.pl2 > 0) {
+                bcEmit(bcInstr2(iReturn, bcExpr(j + 1, -1, g, cm), 1), cm);
+            } else {
+                bcEmit(bcInstr2(iReturn, 0, 0), cm);
+            }
+            return;
+        } ei (nd.tp == nodExpr || nd.tp == nodCall || nd.tp == nodId
+              || nd.tp <= topVerbatimTokenVariant) {
+            bcExpr(j, -1, g, cm);
+        } else {
+            throwExcParser(errBytecodeUnsupported);
+        }
+        j += cNodeSize(nd);
+    }
+}
+
+private Int
+bcOperands(Ulong instr, OUT Arr(Int) uses, OUT Int* def) { //:bcOperands
+// The bit offsets of the register fields an instruction reads ("uses") and writes ("def", -1 if
+// none). Returns the count of uses. Only the instructions emitted by this codegen are known here
+    Int const opCode = instr >> 58;
+    *def = -1;
+    if (opCode == iPlus || opCode == iMinus || opCode == iTimes || opCode == iDivBy
+            || opCode == iConcatStrs) {
+        *def = 40;
+        uses[0] = 24;
+        uses[1] = 0;
+        return 2;
+    } ei ((opCode >= iPlusConst && opCode <= iDivByConst)
+            || (opCode >= iShiftLeftConst && opCode <= iRemPow2Const)) {
+        *def = 32;
+        uses[0] = 32;
+        return 1;
+    } ei (opCode == iNewstring || opCode == iReverseString || opCode == iMove
+            || opCode == iNewList || opCode == iNewPtrList || opCode == iNewStackList
+            || opCode == iGetFld) {
+        *def = 40;
+        uses[0] = 24;
+        return 1;
+    } ei (opCode == iGetElem || opCode == iGetElemUnchecked) {
+        *def = 40;
+        uses[0] = 24;
+        uses[1] = 0;
+        return 2;
+    } ei (opCode == iSetElem || opCode == iSetElemUnchecked) {
+        uses[0] = 40;
+        uses[1] = 24;
+        uses[2] = 0;
+        return 3;
+    } ei (opCode == iSetLocal) {
+        *def = 32;
+    } ei ((opCode >= iBranchLt && opCode <= iBranchGt)
+            || (opCode == iReturn && (instr & 0xFF) > 0)) {
+        uses[0] = 32;
+        return 1;
+    } ei (opCode == iPrint) {
+        uses[0] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+#define bcField(instr, shift) (Int)(((instr) >> (shift)) & LOWER16BITS)
+
+private void
+bcLiveRanges(Int countRegs, OUT Arr(Int) starts, OUT Arr(Int) ends, BcGen* g, CM) {
+//:bcLiveRanges Backward dataflow over the current function's code until the live sets stop
+// changing. The range of a register spans all the instructions where it's live or written.
+// Registers that never occur get start = -1
+    Arr(Ulong) code = cm->bytecode.cont + g->fnStart + 1;
+    Int const countInstrs = cm->bytecode.len - g->fnStart - 1;
+    Int const words = (countRegs + 31)/32 + 1;
+    Arr(Unt) liveIn = allocateArray(countInstrs*words, Unt, cm->aTmp);
+    Arr(Unt) live = allocateArray(words, Unt, cm->aTmp);
+    memset(liveIn, 0, countInstrs*words*sizeof(Unt));
+    Int uses[3];
+    Int def;
+    Bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Int p = countInstrs - 1; p > -1; p--) {
+            Int const opCode = code[p] >> 58;
+            memset(live, 0, words*sizeof(Unt));
+            if (opCode != iJump && opCode != iReturn && opCode != iTailCall && p + 1 < countInstrs) {
+                for (Int w = 0; w < words; w++) {
+                    live[w] |= liveIn[(p + 1)*words + w];
+                }
+            }
+            if (opCode >= iJump && opCode <= iBranchGt) {
+                Int const target = (Int)(code[p] & LOWER32BITS) - g->fnStart - 1;
+                for (Int w = 0; w < words; w++) {
+                    live[w] |= liveIn[target*words + w];
+                }
+            }
+            Int const countUses = bcOperands(code[p], uses, &def);
+            if (def > -1 && bcField(code[p], def) < BC_LIST_AREA) {
+                Int const r = bcField(code[p], def);
+                live[r/32] &= ~(1U << (r % 32));
+            }
+            for (Int k = 0; k < countUses; k++) {
+                Int const r = bcField(code[p], uses[k]);
+                if (r < BC_LIST_AREA) {
+                    live[r/32] |= 1U << (r % 32);
+                }
+            }
+            if (memcmp(live, liveIn + p*words, words*sizeof(Unt)) != 0) {
+                memcpy(liveIn + p*words, live, words*sizeof(Unt));
+                changed = true;
+            }
+        }
+    }
+    memset(starts, 0xFF, countRegs*sizeof(Int));
+    for (Int p = 0; p < countInstrs; p++) {
+        bcOperands(code[p], uses, &def);
+        for (Int r = 0; r < countRegs; r++) {
+            Bool const isDef = def > -1 && bcField(code[p], def) == r;
+            if (isDef || (liveIn[p*words + r/32] & (1U << (r % 32))) != 0) {
+                if (starts[r] == -1) {
+                    starts[r] = p;
+                }
+                ends[r] = p;
+            }
+        }
+    }
+}
+
+private StackAddr
+bcSlotOf(Int reg, Arr(Int) slots, Int frameSize, Int listAreaSize) { //:bcSlotOf
+// The list area is at the end of the frame, right before the call area
+    return reg >= BC_CALL_AREA ? frameSize + reg - BC_CALL_AREA
+         : reg >= BC_LIST_AREA ? frameSize - listAreaSize + reg - BC_LIST_AREA : slots[reg];
+}
+
+private void
+bcRewrite(Arr(Int) slots, Int frameSize, BcGen* g, CM) { //:bcRewrite
+// Replaces the registers in the current function's code with their stack slots
+    Int uses[3];
+    Int def;
+    for (Int j = g->fnStart + 1; j < cm->bytecode.len; j++) {
+        Ulong instr = cm->bytecode.cont[j];
+        Int const countUses = bcOperands(instr, uses, &def);
+        Int countFields = countUses;
+        if (def > -1 && (countUses == 0 || uses[0] != def)) {
+            uses[countFields] = def;
+            countFields += 1;
+        }
+        if ((instr >> 58) == iCall || (instr >> 58) == iTailCall) {
+            uses[countFields] = (instr >> 58) == iCall ? 32 : 40;
+            countFields += 1;
+        }
+        for (Int k = 0; k < countFields; k++) {
+            StackAddr const slot = bcSlotOf(bcField(instr, uses[k]), slots, frameSize,
+                                            g->listArea->len);
+            instr = (instr & ~((Ulong)LOWER16BITS << uses[k])) | ((Ulong)slot << uses[k]);
+        }
+        cm->bytecode.cont[j] = instr;
+    }
+}
+
+private void
+bcAllocateSlots(Int arity, BcGen* g, CM) { //:bcAllocateSlots
+// Linear scan over the live ranges, ordered by their starts. A slot is reused when its previous
+// register is dead by then and both hold pointers or both don't. The params are where the caller
+// put them, after the call header, and the list area goes after all the others. Then writes the
+// pointer map of the function
+    Int const countRegs = g->regIsPtr->len;
+    Int const countInstrs = cm->bytecode.len - g->fnStart - 1;
+    Arr(Int) starts = allocateArray(countRegs + 1, Int, cm->aTmp);
+    Arr(Int) ends = allocateArray(countRegs + 1, Int, cm->aTmp);
+    Arr(Int) slots = allocateArray(countRegs + 1, Int, cm->aTmp);
+    Int const maxSlots = countRegs + g->listArea->len + stackFrameStart + 1;
+    Arr(Int) slotEnds = allocateArray(maxSlots, Int, cm->aTmp);
+    Arr(Bool) slotIsPtr = allocateArray(maxSlots, Bool, cm->aTmp);
+    bcLiveRanges(countRegs, starts, ends, g, cm);
+
+    Int frameSize = stackFrameStart;
+    for (Int r = 0; r < arity; r++) {
+        slots[r] = frameSize;
+        slotEnds[frameSize] = starts[r] > -1 ? ends[r] : -1;
+        slotIsPtr[frameSize] = g->regIsPtr->cont[r] == 1;
+        frameSize += 1;
+    }
+    // Counting sort of the other registers by start
+    Arr(Int) firstOfStart = allocateArray(countInstrs + 2, Int, cm->aTmp);
+    Arr(Int) order = allocateArray(countRegs + 1, Int, cm->aTmp);
+    memset(firstOfStart, 0, (countInstrs + 2)*sizeof(Int));
+    for (Int r = arity; r < countRegs; r++) {
+        if (starts[r] > -1) {
+            firstOfStart[starts[r] + 1] += 1;
+        }
+    }
+    for (Int p = 0; p < countInstrs; p++) {
+        firstOfStart[p + 1] += firstOfStart[p];
+    }
+    Int countOrdered = 0;
+    for (Int r = arity; r < countRegs; r++) {
+        if (starts[r] > -1) {
+            order[firstOfStart[starts[r]]] = r;
+            firstOfStart[starts[r]] += 1;
+            countOrdered += 1;
+        }
+    }
+    for (Int k = 0; k < countOrdered; k++) {
+        Int const r = order[k];
+        Bool const isPtr = g->regIsPtr->cont[r] == 1;
+        Int slot = stackFrameStart;
+        while (slot < frameSize && (slotEnds[slot] >= starts[r] || slotIsPtr[slot] != isPtr)) {
+            slot += 1;
+        }
+        if (slot == frameSize) {
+            slotIsPtr[slot] = isPtr;
+            frameSize += 1;
+        }
+        slots[r] = slot;
+        slotEnds[slot] = ends[r];
+    }
+    for (Int k = 0; k < g->listArea->len; k++) {
+        slotIsPtr[frameSize] = g->listArea->cont[k] == 1;
+        frameSize += 1;
+    }
+    VALIDATEP(frameSize + g->callArea < BC_CALL_AREA, errBytecodeFrameTooBig)
+    bcRewrite(slots, frameSize, g, cm);
+
+    Int const mapInd = cm->ptrMaps.len;
+    pushInptrMaps(0, cm);
+    pushInptrMaps(0, cm);
+    for (Int slot = stackFrameStart; slot < frameSize; slot++) {
+        if (slotIsPtr[slot]) {
+            pushInptrMaps(slot, cm);
+            cm->ptrMaps.cont[mapInd] += 1;
+            if (slot < stackFrameStart + arity) {
+                cm->ptrMaps.cont[mapInd + 1] += 1;
+            }
+        }
+    }
+}
+
+private void
+bcStartFunction(BcGen* g, CM) { //:bcStartFunction
+// [length][code]
+    g->fnStart = bcEmit(0, cm);
+    g->regIsPtr->len = 0;
+    g->listArea->len = 0;
+    g->hasFrameLists = false;
+    g->callArea = 0;
+}
+
+private void
+bcEndFunction(Int arity, BcGen* g, CM) { //:bcEndFunction
+    bcEmit(bcInstr2(iReturn, 0, 0), cm);
+    cm->bytecode.cont[g->fnStart] = cm->bytecode.len - g->fnStart - 1;
+    bcAllocateSlots(arity, g, cm);
+
+    for (Int k = 0; k < g->locals->len; k++) {
+        g->regs[g->locals->cont[k]] = -1;
+    }
+    g->locals->len = 0;
+}
+
+#ifdef SSA
+testable IrFunction* ssaBuild(Assignment fn, Int arity, BcGen* g, CM);
+testable String ssaDump(IrFunction* f, CM);
+testable void ssaLower(IrFunction* f, BcGen* g, CM);
+#endif
+
+private void
+bcFunction(Assignment fn, BcGen* g, CM) { //:bcFunction
+// The params are the first nodBindings of the function body
+    TypeId const fnType = cm->entities.cont[fn.entityId].typeId;
+    Int const arity = fnType > topVerbatimType ? tGetFnArity(fnType, cm) : 0;
+    bcStartFunction(g, cm);
+    for (Int k = 0; k < arity; k++) {
+        Node param = cm->nodes.cont[fn.nodeInd + 1 + k];
+        VALIDATEI(param.tp == nodBinding, iErrorInconsistentSpans)
+        bcRegOf(param.pl1, g, cm); // so the k-th param is register k
+    }
+#ifdef SSA
+    IrFunction* ir = ssaBuild(fn, arity, g, cm);
+#ifdef DEBUG
+    printString(ssaDump(ir, cm));
+#endif
+    ssaLower(ir, g, cm);
+#else
+    push(fn.entityId, g->inlined);
+    Int const sentinel = fn.nodeInd + cm->nodes.cont[fn.nodeInd].pl2 + 1;
+    Int last = fn.nodeInd + 1 + arity; // the last statement
+    for (Int j = last; j < sentinel; j += cNodeSize(cm->nodes.cont[j])) {
+        last = j;
+    }
+    Bool const isVoid = fnType <= topVerbatimType || getFunctionReturnType(fnType, cm) == tokMisc;
+    if (isVoid && last < sentinel && (cm->nodes.cont[last].tp == nodExpr
+            || cm->nodes.cont[last].tp == nodCall)) { // the last call of a void function may be a tail call
+        bcStatements(fn.nodeInd + 1 + arity, last, g, cm);
+        if (bcIsTailCall(last, g, cm)) {
+            bcTailCall(last, g, cm);
+        } else {
+            bcStatements(last, sentinel, g, cm);
+        }
+    } else {
+        bcStatements(fn.nodeInd + 1 + arity, sentinel, g, cm);
+    }
+    pop(g->inlined);
+#endif
+    bcEndFunction(arity, g, cm);
+}
+
+private Arr(Int)
+bcUnnumberedFns(BcGen* g, CM) { //:bcUnnumberedFns
+    Arr(Int) fnIds = allocateArray(cm->entities.len, Int, cm->aTmp);
+    memset(fnIds, 0xFF, cm->entities.len*sizeof(Int));
+    for (Int k = 0; k < cm->toplevels.len; k++) {
+        fnIds[cm->toplevels.cont[k].entityId] = BC_UNNUMBERED;
+    }
+    return fnIds;
+}
+
+private void
+bcEvalConstant(EntityId constEntity, Int rightInd, BcGen* g, CM) { //:bcEvalConstant
+// Compile-time evaluation of a toplevel constant. Its initializer becomes the entry function of a
+// scratch program which also has all the functions it may call. The program is run in a scratch
+// VM for at most BC_CONST_EVAL_STEPS instructions, and the result is baked into the code, with
+// Strings going into the static text
+    TypeId const typeId = cm->entities.cont[constEntity].typeId;
+    VALIDATEP(typeId == tokInt || typeId == tokBool || typeId == tokString, errBytecodeUnsupported)
+    Arr(Int) fnIds = g->fnIds;
+    StackInt* fnQueue = g->fnQueue;
+    Int const textLen = cm->staticText != null ? cm->staticText->len : 0;
+    g->fnIds = bcUnnumberedFns(g, cm);
+    g->fnQueue = createStackint32_t(8, cm->aTmp);
+    push(-1, g->fnQueue);
+
+    bcStartFunction(g, cm);
+    bcEmit(bcInstr2(iReturn, bcExpr(rightInd, -1, g, cm), 1), cm);
+    bcEndFunction(0, g, cm);
+    for (Int k = 1; k < g->fnQueue->len; k++) {
+        bcFunction(cm->toplevels.cont[g->fnQueue->cont[k]], g, cm);
+    }
+    g->fnIds = fnIds;
+    g->fnQueue = fnQueue;
+
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    Bool const wasError = rt.errMsg.len > 0 || !interpretBounded(BC_CONST_EVAL_STEPS, &rt)
+                          || rt.errMsg.len > 0;
+    Unt const result = rt.memory != null ? rt.memory[0] : 0;
+    cm->bytecode.len = 0;
+    cm->ptrMaps.len = 0;
+    if (cm->staticText != null) {
+        cm->staticText->len = textLen; // the scratch program's literals aren't needed anymore
+    }
+    if (!wasError && typeId == tokString) {
+        String text = { .cont = rtStringChars(result, &rt), .len = rt.memory[result] };
+        g->bakedValues[constEntity] = bcAppendStaticText(text, cm);
+        g->bakedLens[constEntity] = text.len;
+    } else {
+        g->bakedValues[constEntity] = (Int)result;
+    }
+    freeInterpreter(&rt);
+    VALIDATEP(!wasError, errConstantEvaluation)
+    g->constants[constEntity] = BC_BAKED;
+}
+
+//{{{ SSA
+
+// A function is built into an SSA IR first: basic blocks of IrInstrs, with phis where values from
+// different control flow paths meet. The construction follows Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form": every variable is looked up from its uses
+// backwards through the predecessor blocks, and a block is "sealed" once all its predecessors are
+// known. Phis created in unsealed blocks get their operands when the block is sealed. Trivial phis
+// (whose operands are all the same value) are replaced afterwards. The IR is then lowered to the same
+// bytecode as the direct codegen, with a virtual register per value.
+// The IR is used instead of the direct codegen in builds with SSA. It doesn't cover all of it yet:
+// there are no list literals, element accesses ("lst[i]", "lst[i] = x") or "##" of a list, so
+// functions with lists fail with errBytecodeUnsupported. Nor does it inline, hoist out of loops or
+// emit tail calls. Once lists are in, ssaLowerInstr gets the iGetElem and iSetElem opcodes, with
+// the bounds checks dropped as in "bcFindInBounds"
+
+private Int
+ssaNewBlock(IrFunction* f, CM) { //:ssaNewBlock
+    pushIrBlock((IrBlock){ .instrs = createStackint32_t(8, cm->aTmp),
+                           .preds = createStackint32_t(2, cm->aTmp),
+                           .defs = createStackint32_t(8, cm->aTmp),
+                           .incompletePhis = createStackint32_t(2, cm->aTmp),
+                           .term = -1, .sealed = false }, f->blocks);
+    return f->blocks->len - 1;
+}
+
+private Int
+ssaAddTo(Int block, IrInstr instr, IrFunction* f) { //:ssaAddTo
+    pushIrInstr(instr, f->instrs);
+    push(f->instrs->len - 1, f->blocks->cont[block].instrs);
+    return f->instrs->len - 1;
+}
+
+#define ssaAdd(instr) ssaAddTo(f->curBlock, (instr), f)
+
+private Int
+ssaConst(Int value, TypeId type, IrFunction* f) { //:ssaConst
+    return ssaAdd(((IrInstr){ .op = irConst, .type = type, .a = value }));
+}
+
+private Bool
+ssaIsDead(Int block, IrFunction* f) { //:ssaIsDead
+// A block that no control flow reaches, e.g. the code after a "return"
+    return block > 0 && f->blocks->cont[block].sealed && f->blocks->cont[block].preds->len == 0;
+}
+
+private void
+ssaTerminate(IrInstr term, IrFunction* f, CM) { //:ssaTerminate
+// Ends the current block. The code after it, if any, goes into a new dead block
+    Int const block = f->curBlock;
+    if (!ssaIsDead(block, f)) {
+        if (term.op == irJump) {
+            push(block, f->blocks->cont[term.a].preds);
+        } ei (term.op == irBranch) {
+            push(block, f->blocks->cont[term.b].preds);
+            push(block, f->blocks->cont[term.c].preds);
+        }
+    }
+    pushIrInstr(term, f->instrs);
+    f->blocks->cont[block].term = f->instrs->len - 1;
+    f->curBlock = ssaNewBlock(f, cm);
+    f->blocks->cont[f->curBlock].sealed = true;
+}
+
+private void
+ssaJump(Int target, IrFunction* f, CM) { //:ssaJump
+    ssaTerminate((IrInstr){ .op = irJump, .type = tokMisc, .a = target }, f, cm);
+}
+
+private void
+ssaBranch(Int kind, Int value, Int ifTrue, Int ifFalse, IrFunction* f, CM) { //:ssaBranch
+    if (ifTrue == ifFalse) {
+        ssaJump(ifTrue, f, cm);
+        return;
+    }
+    ssaTerminate((IrInstr){ .op = irBranch, .kind = kind, .type = tokMisc, .a = value, .b = ifTrue,
+                            .c = ifFalse }, f, cm);
+}
+
+private void
+ssaWrite(EntityId var, Int block, Int value, IrFunction* f) { //:ssaWrite
+    StackInt* defs = f->blocks->cont[block].defs;
+    for (Int k = 0; k < defs->len; k += 2) {
+        if (defs->cont[k] == var) {
+            defs->cont[k + 1] = value;
+            return;
+        }
+    }
+    push(var, defs);
+    push(value, defs);
+}
+
+private Int ssaReadRecursive(EntityId var, Int block, IrFunction* f, CM);
+
+private Int
+ssaRead(EntityId var, Int block, IrFunction* f, CM) { //:ssaRead
+    StackInt* defs = f->blocks->cont[block].defs;
+    for (Int k = 0; k < defs->len; k += 2) {
+        if (defs->cont[k] == var) {
+            return defs->cont[k + 1];
+        }
+    }
+    return ssaReadRecursive(var, block, f, cm);
+}
+
+private void
+ssaAddPhiOperands(EntityId var, Int phi, Int block, IrFunction* f, CM) { //:ssaAddPhiOperands
+// The operands are read first, because reading may add the operands of other phis
+    StackInt* preds = f->blocks->cont[block].preds;
+    Arr(Int) values = allocateArray(preds->len + 1, Int, cm->aTmp);
+    for (Int k = 0; k < preds->len; k++) {
+        values[k] = ssaRead(var, preds->cont[k], f, cm);
+    }
+    f->instrs->cont[phi].a = f->operands->len;
+    f->instrs->cont[phi].b = preds->len;
+    for (Int k = 0; k < preds->len; k++) {
+        push(values[k], f->operands);
+    }
+}
+
+private Int
+ssaReadRecursive(EntityId var, Int block, IrFunction* f, CM) { //:ssaReadRecursive
+    IrBlock blk = f->blocks->cont[block];
+    TypeId const type = cm->entities.cont[var].typeId;
+    Int value;
+    if (!blk.sealed) {
+        value = ssaAddTo(block, (IrInstr){ .op = irPhi, .type = type, .c = -1 }, f);
+        push(var, blk.incompletePhis);
+        push(value, blk.incompletePhis);
+    } ei (blk.preds->len == 0) { // undefined, so any value will do
+        value = ssaAddTo(block, (IrInstr){ .op = irConst, .type = type, .a = 0 }, f);
+    } ei (blk.preds->len == 1) {
+        value = ssaRead(var, blk.preds->cont[0], f, cm);
+    } else {
+        value = ssaAddTo(block, (IrInstr){ .op = irPhi, .type = type, .c = -1 }, f);
+        ssaWrite(var, block, value, f); // breaks the cycles through this block
+        ssaAddPhiOperands(var, value, block, f, cm);
+    }
+    ssaWrite(var, block, value, f);
+    return value;
+}
+
+private void
+ssaSeal(Int block, IrFunction* f, CM) { //:ssaSeal
+    StackInt* incompletePhis = f->blocks->cont[block].incompletePhis;
+    for (Int k = 0; k < incompletePhis->len; k += 2) {
+        ssaAddPhiOperands(incompletePhis->cont[k], incompletePhis->cont[k + 1], block, f, cm);
+    }
+    f->blocks->cont[block].sealed = true;
+}
+
+private Int
+ssaResolve(Int value, IrFunction* f) { //:ssaResolve
+// The value with the trivial phis replaced
+    while (f->instrs->cont[value].op == irPhi && f->instrs->cont[value].c > -1) {
+        value = f->instrs->cont[value].c;
+    }
+    return value;
+}
+
+private void
+ssaRemoveTrivialPhis(IrFunction* f) { //:ssaRemoveTrivialPhis
+// A phi whose operands are all the same value (or the phi itself) is replaced with that value.
+// Replacing one can make others trivial, so this goes on until nothing changes
+    Bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Int v = 0; v < f->instrs->len; v++) {
+            IrInstr phi = f->instrs->cont[v];
+            if (phi.op != irPhi || phi.c > -1) {
+                continue;
+            }
+            Int same = -1;
+            Bool isTrivial = true;
+            for (Int k = 0; k < phi.b && isTrivial; k++) {
+                Int const operand = ssaResolve(f->operands->cont[phi.a + k], f);
+                if (operand != v && operand != same) {
+                    isTrivial = same == -1;
+                    same = operand;
+                }
+            }
+            if (isTrivial && same > -1) {
+                f->instrs->cont[v].c = same;
+                changed = true;
+            }
+        }
+    }
+}
+
+private Int ssaValue(Int ind, BcExpr* ex, IrFunction* f, BcGen* g, CM);
+
+private void
+ssaCond(Int ind, BcExpr* ex, Int ifTrue, Int ifFalse, IrFunction* f, BcGen* g, CM) { //:ssaCond
+// Ends the current block with the jumps for a Bool expression. Like "bcCond", comparisons are a
+// subtraction and a branch on the sign of the difference
+    Node nd = cm->nodes.cont[ind];
+    Int const opId = nd.tp == nodCall ? cOperatorOf(nd.pl1) : -1;
+    Int const constant = bcConstCondition(ind, g, cm);
+    Int args[2];
+    if (constant > -1) {
+        ssaJump(constant == 1 ? ifTrue : ifFalse, f, cm);
+    } ei (opId == opBoolNeg) {
+        bcArgs(ind, 1, ex, args);
+        ssaCond(args[0], ex, ifFalse, ifTrue, f, g, cm);
+    } ei (opId == opBoolAnd || opId == opBoolOr) {
+        bcArgs(ind, 2, ex, args);
+        Int const second = ssaNewBlock(f, cm);
+        if (opId == opBoolAnd) {
+            ssaCond(args[0], ex, second, ifFalse, f, g, cm);
+        } else {
+            ssaCond(args[0], ex, ifTrue, second, f, g, cm);
+        }
+        ssaSeal(second, f, cm);
+        f->curBlock = second;
+        ssaCond(args[1], ex, ifTrue, ifFalse, f, g, cm);
+    } ei (opId == opLTZero || opId == opGTZero) {
+        bcArgs(ind, 1, ex, args);
+        ssaBranch(opId == opLTZero ? iBranchLt : iBranchGt, ssaValue(args[0], ex, f, g, cm),
+                  ifTrue, ifFalse, f, cm);
+    } ei (bcIsCondOp(opId)) { // comparisons
+        VALIDATEP(getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm) != tokString,
+                  errBytecodeUnsupported)
+        bcArgs(ind, 2, ex, args);
+        Int const left = ssaValue(args[0], ex, f, g, cm);
+        Int const right = ssaValue(args[1], ex, f, g, cm);
+        Int const diff = ssaAdd(((IrInstr){ .op = irArith, .kind = iMinus, .type = tokInt,
+                                            .a = left, .b = right }));
+        Int const kind = (opId == opLessTh || opId == opGTEQ) ? iBranchLt
+                       : (opId == opGreaterTh || opId == opLTEQ) ? iBranchGt : iBranchEq;
+        if (opId == opLTEQ || opId == opGTEQ || opId == opNotEqual) {
+            ssaBranch(kind, diff, ifFalse, ifTrue, f, cm);
+        } else {
+            ssaBranch(kind, diff, ifTrue, ifFalse, f, cm);
+        }
+    } else {
+        ssaBranch(iBranchEq, ssaValue(ind, ex, f, g, cm), ifFalse, ifTrue, f, cm); // 0 is false
+    }
+}
+
+private Int
+ssaOperator(Int opId, Int ind, BcExpr* ex, IrFunction* f, BcGen* g, CM) { //:ssaOperator
+    Node nd = cm->nodes.cont[ind];
+    TypeId const operandType = getFirstParamType(cm->entities.cont[nd.pl1].typeId, cm);
+    Int args[2];
+    if ((opId == opPlus || opId == opMinus || opId == opTimes || opId == opDivBy
+            || opId == opRemainder) && operandType == tokInt) {
+        bcArgs(ind, 2, ex, args);
+        VALIDATEP(opId != opRemainder || (cm->nodes.cont[args[1]].tp == tokInt
+                  && bcLog2(bcLiteralValue(cm->nodes.cont[args[1]], cm)) > -1),
+                  errBytecodeUnsupported) // only by powers of 2 so far
+        Int const left = ssaValue(args[0], ex, f, g, cm);
+        Int const right = ssaValue(args[1], ex, f, g, cm);
+        Int const kind = opId == opPlus ? iPlus : opId == opMinus ? iMinus
+                       : opId == opTimes ? iTimes : opId == opDivBy ? iDivBy : iRemPow2Const;
+        return ssaAdd(((IrInstr){ .op = irArith, .kind = kind, .type = tokInt,
+                                  .a = left, .b = right }));
+    } ei (opId == opPlus && operandType == tokString) {
+        bcArgs(ind, 2, ex, args);
+        Int const left = ssaValue(args[0], ex, f, g, cm);
+        Int const right = ssaValue(args[1], ex, f, g, cm);
+        return ssaAdd(((IrInstr){ .op = irArith, .kind = iConcatStrs, .type = tokString,
+                                  .a = left, .b = right }));
+    }
+    // Bool-valued: the two paths meet at a phi of 1 and 0
+    VALIDATEP(bcIsCondOp(opId), errBytecodeUnsupported)
+    Int const ifTrue = ssaNewBlock(f, cm);
+    Int const ifFalse = ssaNewBlock(f, cm);
+    Int const join = ssaNewBlock(f, cm);
+    ssaCond(ind, ex, ifTrue, ifFalse, f, g, cm);
+    ssaSeal(ifTrue, f, cm);
+    ssaSeal(ifFalse, f, cm);
+    f->curBlock = ifTrue;
+    Int const one = ssaConst(1, tokBool, f);
+    ssaJump(join, f, cm);
+    f->curBlock = ifFalse;
+    Int const zero = ssaConst(0, tokBool, f);
+    ssaJump(join, f, cm);
+    ssaSeal(join, f, cm);
+    f->curBlock = join;
+    StackInt* preds = f->blocks->cont[join].preds;
+    Int const phi = ssaAdd(((IrInstr){ .op = irPhi, .type = tokBool, .a = f->operands->len,
+                                       .b = preds->len, .c = -1 }));
+    for (Int k = 0; k < preds->len; k++) {
+        push(preds->cont[k] == ifTrue ? one : zero, f->operands);
+    }
+    return phi;
+}
+
+private Int
+ssaValue(Int ind, BcExpr* ex, IrFunction* f, BcGen* g, CM) { //:ssaValue
+// Builds the subexpression ending at "ind" and returns its value, or -1 if it has none
+    Node nd = cm->nodes.cont[ind];
+    if (nd.tp == tokInt || nd.tp == tokBool) {
+        return ssaConst(bcLiteralValue(nd, cm), nd.tp, f);
+    } ei (nd.tp == tokString) {
+        SourceLoc loc = cm->sourceLocs->cont[ind];
+        Int const len = loc.lenBts - 2; // without the backticks
+        Int const start = bcAppendStaticText(
+                (String){ .cont = cm->sourceCode + locStartBt(loc) + 1, .len = len }, cm);
+        return ssaAdd(((IrInstr){ .op = irString, .type = tokString, .a = start, .b = len }));
+    } ei (nd.tp == nodId) {
+        TypeId const type = cm->entities.cont[nd.pl1].typeId;
+        if (g->constants[nd.pl1] > -1) { // a toplevel constant
+            return ssaValue(g->constants[nd.pl1], ex, f, g, cm);
+        } ei (g->constants[nd.pl1] == BC_BAKED && type == tokString) {
+            return ssaAdd(((IrInstr){ .op = irString, .type = tokString,
+                                      .a = g->bakedValues[nd.pl1], .b = g->bakedLens[nd.pl1] }));
+        } ei (g->constants[nd.pl1] == BC_BAKED) {
+            return ssaConst(g->bakedValues[nd.pl1], type, f);
+        }
+        VALIDATEP(g->constants[nd.pl1] != BC_PENDING, errConstantOrder)
+        VALIDATEP(nd.pl1 >= cm->stats.countNonparsedEntities && g->constants[nd.pl1] == -1,
+                  errBytecodeUnsupported)
+        return ssaRead(nd.pl1, f->curBlock, f, cm);
+    }
+    VALIDATEP(nd.tp == nodCall, errBytecodeUnsupported)
+    Int const opId = cOperatorOf(nd.pl1);
+    if (opId > -1) {
+        return ssaOperator(opId, ind, ex, f, g, cm);
+    } ei (g->fnIds[nd.pl1] != -1) {
+        Arr(Int) args = allocateArray(nd.pl2 + 1, Int, cm->aTmp);
+        bcArgs(ind, nd.pl2, ex, args);
+        for (Int k = 0; k < nd.pl2; k++) {
+            args[k] = ssaValue(args[k], ex, f, g, cm);
+        }
+        Int const start = f->operands->len;
+        for (Int k = 0; k < nd.pl2; k++) {
+            push(args[k], f->operands);
+        }
+        TypeId const fnType = cm->entities.cont[nd.pl1].typeId;
+        TypeId const returnType = fnType > topVerbatimType ? getFunctionReturnType(fnType, cm) : tokMisc;
+        Int const call = ssaAdd(((IrInstr){ .op = irCall, .type = returnType, .a = nd.pl1,
+                                            .b = start, .c = nd.pl2 }));
+        return returnType == tokMisc ? -1 : call;
+    }
+    // The Prelude
+    Entity ent = cm->entities.cont[nd.pl1];
+    VALIDATEP(ent.name == nameOfStandard(strPrint) && nd.pl2 == 1
+              && getFirstParamType(ent.typeId, cm) == tokString, errBytecodeUnsupported)
+    Int arg;
+    bcArgs(ind, 1, ex, &arg);
+    Int const value = ssaValue(arg, ex, f, g, cm);
+    ssaAdd(((IrInstr){ .op = irPrint, .type = tokMisc, .a = value }));
+    return -1;
+}
+
+private Int
+ssaExpr(Int ind, IrFunction* f, BcGen* g, CM) { //:ssaExpr
+    Node nd = cm->nodes.cont[ind];
+    VALIDATEP(nd.tp != nodExpr || nd.pl1 == 0, errBytecodeUnsupported) // no list literals yet
+    BcExpr ex = bcExprOf(ind, cm);
+    return ssaValue(nd.tp == nodExpr ? ind + nd.pl2 : ind, &ex, f, g, cm);
+}
+
+private void
+ssaCondExpr(Int ind, Int ifTrue, Int ifFalse, IrFunction* f, BcGen* g, CM) { //:ssaCondExpr
+    Node nd = cm->nodes.cont[ind];
+    VALIDATEP(nd.tp != nodExpr || nd.pl1 == 0, errBytecodeUnsupported)
+    BcExpr ex = bcExprOf(ind, cm);
+    ssaCond(nd.tp == nodExpr ? ind + nd.pl2 : ind, &ex, ifTrue, ifFalse, f, g, cm);
+}
+
+private void ssaStatements(Int start, Int sentinel, IrFunction* f, BcGen* g, CM);
+
+private void
+ssaIf(Int ind, IrFunction* f, BcGen* g, CM) { //:ssaIf
+// [If cond Scope ElseIf(cond Scope)... ElseIf(Scope)]. Every clause ends with a jump to the join.
+// Like in "bcIf", the clauses with a false constant condition and the ones after a true one are
+// dropped
+    Int const sentinel = ind + cm->nodes.cont[ind].pl2 + 1;
+    Int const join = ssaNewBlock(f, cm);
+    Bool isExhaustive = false; // one of the clauses always runs
+    Int j = ind + 1;
+    while (j < sentinel) {
+        if (cm->nodes.cont[j].tp == nodElseIf) {
+            j += 1;
+        }
+        Int condition = 1; // "else"
+        Int next = -1; // the block of the next clause
+        if (cm->nodes.cont[j].tp != nodScope) {
+            condition = bcConstCondition(j, g, cm);
+            if (condition == -1) {
+                Int const then = ssaNewBlock(f, cm);
+                next = ssaNewBlock(f, cm);
+                ssaCondExpr(j, then, next, f, g, cm);
+                ssaSeal(then, f, cm);
+                ssaSeal(next, f, cm);
+                f->curBlock = then;
+            }
+            j += cNodeSize(cm->nodes.cont[j]);
+        }
+        Node scope = cm->nodes.cont[j];
+        j += scope.pl2 + 1;
+        if (condition == 0) {
+            continue;
+        }
+        ssaStatements(j - scope.pl2, j, f, g, cm);
+        ssaJump(join, f, cm);
+        if (condition == 1) {
+            isExhaustive = true;
+            break;
+        }
+        f->curBlock = next;
+    }
+    if (!isExhaustive) {
+        ssaJump(join, f, cm);
+    }
+    ssaSeal(join, f, cm);
+    f->curBlock = join;
+}
+
+private void
+ssaFor(Int ind, IrFunction* f, BcGen* g, CM) { //:ssaFor
+// The inits, then the header block with the condition, then the body which jumps back to the
+// header. The header is sealed after the body, when the back edges are known
+    Node forNode = cm->nodes.cont[ind];
+    Int const bodyInd = ind + forNode.pl3;
+    Int j = ind + 1;
+    if (cm->nodes.cont[j].tp == nodScope && j != bodyInd) {
+        j += 1;
+    }
+    Int condInd = -1;
+    while (j < bodyInd) {
+        Node nd = cm->nodes.cont[j];
+        Int const size = cNodeSize(nd);
+        if (j + size == bodyInd && nd.tp != nodAssignment) {
+            condInd = j;
+        } else {
+            ssaStatements(j, j + size, f, g, cm);
+        }
+        j += size;
+    }
+    Int const header = ssaNewBlock(f, cm);
+    Int const body = ssaNewBlock(f, cm);
+    Int const exit = ssaNewBlock(f, cm);
+    ssaJump(header, f, cm);
+    f->curBlock = header;
+    if (condInd > -1) {
+        ssaCondExpr(condInd, body, exit, f, g, cm);
+    } else {
+        ssaJump(body, f, cm);
+    }
+    ssaSeal(body, f, cm);
+    f->curBlock = body;
+    push(forNode.pl1, f->loops);
+    push(header, f->loops);
+    push(exit, f->loops);
+    ssaStatements(bodyInd + 1, bodyInd + cm->nodes.cont[bodyInd].pl2 + 1, f, g, cm);
+    ssaJump(header, f, cm);
+    f->loops->len -= 3;
+    ssaSeal(header, f, cm);
+    ssaSeal(exit, f, cm);
+    f->curBlock = exit;
+}
+
+private void
+ssaBreakCont(Node nd, IrFunction* f, CM) { //:ssaBreakCont
+// Same targets as in "bcBreakCont"
+    Bool const isContinue = nd.pl1 >= BIG;
+    Int const loopId = isContinue ? nd.pl1 - BIG : nd.pl1;
+    VALIDATEP(hasValues(f->loops), errBreakContinueInvalidDepth)
+    Int loop = f->loops->len - 3;
+    if (loopId > 0) {
+        for (Int k = f->loops->len - 3; k >= 0; k -= 3) {
+            if (f->loops->cont[k] == loopId) {
+                loop = k;
+                break;
+            }
+        }
+    }
+    ssaJump(f->loops->cont[loop + (isContinue ? 1 : 2)], f, cm);
+}
+
+private void
+ssaStatements(Int start, Int sentinel, IrFunction* f, BcGen* g, CM) { //:ssaStatements
+    Int j = start;
+    while (j < sentinel) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp == nodAssignment || nd.tp == nodDef) {
+            Node left = cm->nodes.cont[j + 1];
+            Node right = cm->nodes.cont[j + nd.pl3];
+            VALIDATEP(left.tp == nodBinding && right.tp != nodDataAlloc, errBytecodeUnsupported)
+            ssaWrite(left.pl1, f->curBlock, ssaExpr(j + nd.pl3, f, g, cm), f);
+        } ei (nd.tp == nodScope) {
+            ssaStatements(j + 1, j + nd.pl2 + 1, f, g, cm);
+        } ei (nd.tp == nodIf) {
+            ssaIf(j, f, g, cm);
+        } ei (nd.tp == nodFor) {
+            ssaFor(j, f, g, cm);
+        } ei (nd.tp == nodBreakCont) {
+            ssaBreakCont(nd, f, cm);
+            return; // the rest of the scope is unreachable
+        } ei (nd.tp == nodReturn) {
+            Int const value = nd.pl2 > 0 ? ssaExpr(j + 1, f, g, cm) : -1;
+            ssaTerminate((IrInstr){ .op = irReturn, .type = tokMisc, .a = value }, f, cm);
+            return;
+        } ei (nd.tp == nodExpr || nd.tp == nodCall || nd.tp == nodId
+              || nd.tp <= topVerbatimTokenVariant) {
+            ssaExpr(j, f, g, cm);
+        } else {
+            throwExcParser(errBytecodeUnsupported);
+        }
+        j += cNodeSize(nd);
+    }
+}
+
+testable IrFunction*
+ssaBuild(Assignment fn, Int arity, BcGen* g, CM) { //:ssaBuild
+// The params are the first nodBindings of the function body
+    IrFunction* f = allocate(IrFunction, cm->aTmp);
+    (*f) = (IrFunction){ .instrs = createStackIrInstr(64, cm->aTmp),
+                         .blocks = createStackIrBlock(16, cm->aTmp),
+                         .operands = createStackint32_t(16, cm->aTmp),
+                         .loops = createStackint32_t(6, cm->aTmp), .curBlock = 0 };
+    ssaNewBlock(f, cm);
+    f->blocks->cont[0].sealed = true;
+    for (Int k = 0; k < arity; k++) {
+        EntityId const param = cm->nodes.cont[fn.nodeInd + 1 + k].pl1;
+        ssaWrite(param, 0, ssaAdd(((IrInstr){ .op = irParam, .type = cm->entities.cont[param].typeId,
+                                              .a = k })), f);
+    }
+    Node fnDef = cm->nodes.cont[fn.nodeInd];
+    ssaStatements(fn.nodeInd + 1 + arity, fn.nodeInd + fnDef.pl2 + 1, f, g, cm);
+    ssaTerminate((IrInstr){ .op = irReturn, .type = tokMisc, .a = -1 }, f, cm);
+    ssaRemoveTrivialPhis(f);
+    return f;
+}
+
+private void
+ssaDumpValue(Int value, IrFunction* f, StringBuilder* sb) { //:ssaDumpValue
+    if (value == -1) {
+        sbAppendf(sb, " _");
+    } else {
+        sbAppendf(sb, " v%d", ssaResolve(value, f));
+    }
+}
+
+testable String
+ssaDump(IrFunction* f, CM) { //:ssaDump
+// The IR as text, for debugging. Dead blocks and replaced phis are left out
+    static char const* const arithNames[] = { [iPlus] = "+", [iMinus] = "-", [iTimes] = "*",
+            [iDivBy] = "/", [iRemPow2Const] = "%", [iConcatStrs] = "++" };
+    static char const* const branchNames[] = { [iBranchLt] = "<0", [iBranchEq] = "=0",
+                                               [iBranchGt] = ">0" };
+    StringBuilder* sb = createStringBuilder(256, cm->aTmp);
+    for (Int b = 0; b < f->blocks->len; b++) {
+        IrBlock blk = f->blocks->cont[b];
+        if (ssaIsDead(b, f)) {
+            continue;
+        }
+        sbAppendf(sb, "b%d:", b);
+        for (Int k = 0; k < blk.preds->len; k++) {
+            sbAppendf(sb, k == 0 ? " <- b%d" : ", b%d", blk.preds->cont[k]);
+        }
+        sbAppendf(sb, "\n");
+        for (Int k = 0; k < blk.instrs->len; k++) {
+            Int const v = blk.instrs->cont[k];
+            IrInstr instr = f->instrs->cont[v];
+            if (instr.op == irPhi && instr.c > -1) {
+                continue;
+            }
+            sbAppendf(sb, instr.type == tokMisc ? "   " : "    v%d =", v);
+            if (instr.op == irConst) {
+                sbAppendf(sb, " %d", instr.a);
+            } ei (instr.op == irString) {
+                sbAppendf(sb, " `%.*s`", instr.b, cm->staticText->cont + instr.a);
+            } ei (instr.op == irParam) {
+                sbAppendf(sb, " param %d", instr.a);
+            } ei (instr.op == irPhi) {
+                sbAppendf(sb, " phi");
+                for (Int m = 0; m < instr.b; m++) {
+                    ssaDumpValue(f->operands->cont[instr.a + m], f, sb);
+                }
+            } ei (instr.op == irArith) {
+                sbAppendf(sb, " %s", arithNames[instr.kind]);
+                ssaDumpValue(instr.a, f, sb);
+                ssaDumpValue(instr.b, f, sb);
+            } ei (instr.op == irCall) {
+                sbAppendf(sb, " call e%d", instr.a);
+                for (Int m = 0; m < instr.c; m++) {
+                    ssaDumpValue(f->operands->cont[instr.b + m], f, sb);
+                }
+            } ei (instr.op == irPrint) {
+                sbAppendf(sb, " print");
+                ssaDumpValue(instr.a, f, sb);
+            }
+            sbAppendf(sb, instr.type == tokInt ? " :Int\n" : instr.type == tokBool ? " :Bool\n"
+                        : instr.type == tokString ? " :String\n" : "\n");
+        }
+        IrInstr term = f->instrs->cont[blk.term];
+        if (term.op == irJump) {
+            sbAppendf(sb, "    jump b%d\n", term.a);
+        } ei (term.op == irBranch) {
+            sbAppendf(sb, "    if");
+            ssaDumpValue(term.a, f, sb);
+            sbAppendf(sb, " %s then b%d else b%d\n", branchNames[term.kind], term.b, term.c);
+        } else {
+            sbAppendf(sb, "    return");
+            ssaDumpValue(term.a, f, sb);
+            sbAppendf(sb, "\n");
+        }
+    }
+    return (String){ .cont = sb->cont, .len = sb->len };
+}
+
+private Bool
+ssaHasPhis(Int block, IrFunction* f) { //:ssaHasPhis
+    StackInt* instrs = f->blocks->cont[block].instrs;
+    for (Int k = 0; k < instrs->len; k++) {
+        IrInstr instr = f->instrs->cont[instrs->cont[k]];
+        if (instr.op == irPhi && instr.c == -1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+private void
+ssaLowerEdge(Int from, Int to, Bool canFallThrough, Arr(Int) regs, StackInt* fixups, IrFunction* f,
+             BcGen* g, CM) { //:ssaLowerEdge
+// The moves into the phis of "to", then the jump. The moves are a parallel copy, so with more than
+// one phi they go through temporaries
+    IrBlock target = f->blocks->cont[to];
+    Int predInd = 0;
+    while (target.preds->cont[predInd] != from) {
+        predInd += 1;
+    }
+    Int countPhis = 0;
+    for (Int k = 0; k < target.instrs->len; k++) {
+        IrInstr instr = f->instrs->cont[target.instrs->cont[k]];
+        countPhis += (instr.op == irPhi && instr.c == -1) ? 1 : 0;
+    }
+    Arr(Int) temps = allocateArray(countPhis + 1, Int, cm->aTmp);
+    for (Int pass = (countPhis > 1 ? 0 : 1); pass < 2; pass++) {
+        Int m = 0;
+        for (Int k = 0; k < target.instrs->len; k++) {
+            Int const phi = target.instrs->cont[k];
+            IrInstr instr = f->instrs->cont[phi];
+            if (instr.op != irPhi || instr.c > -1) {
+                continue;
+            }
+            Int const src = regs[ssaResolve(f->operands->cont[instr.a + predInd], f)];
+            if (pass == 0) {
+                temps[m] = bcNewReg(bcIsPtrType(instr.type, cm), g, cm);
+                bcEmit(bcInstr3(iMove, temps[m], src, 0), cm);
+            } ei (countPhis > 1) {
+                bcEmit(bcInstr3(iMove, regs[phi], temps[m], 0), cm);
+            } ei (src != regs[phi]) {
+                bcEmit(bcInstr3(iMove, regs[phi], src, 0), cm);
+            }
+            m += 1;
+        }
+    }
+    if (!canFallThrough || to != from + 1) {
+        push(bcEmit(bcInstr2(iJump, 0, 0), cm), fixups);
+        push(to, fixups);
+    }
+}
+
+private void
+ssaLowerInstr(Int v, Arr(Int) regs, IrFunction* f, BcGen* g, CM) { //:ssaLowerInstr
+    IrInstr instr = f->instrs->cont[v];
+    if (instr.op == irConst) {
+        bcEmit(bcInstr2(iSetLocal, regs[v], instr.a), cm);
+    } ei (instr.op == irString) {
+        bcStaticString(instr.a, instr.b, regs[v], g, cm);
+    } ei (instr.op == irArith) {
+        Int const left = regs[ssaResolve(instr.a, f)];
+        IrInstr right = f->instrs->cont[ssaResolve(instr.b, f)];
+        Int const shift = right.op == irConst ? bcLog2(right.a) : -1;
+        if (instr.kind == iRemPow2Const || (shift > -1 && (instr.kind == iTimes || instr.kind == iDivBy))) {
+            bcEmit(bcInstr3(iMove, regs[v], left, 0), cm);
+            bcEmit(bcInstr2(instr.kind == iTimes ? iShiftLeftConst
+                            : instr.kind == iDivBy ? iDivByPow2Const : iRemPow2Const, regs[v], shift), cm);
+        } ei (right.op == irConst && instr.kind <= iDivBy && !(instr.kind == iDivBy && right.a == 0)) {
+            bcEmit(bcInstr3(iMove, regs[v], left, 0), cm);
+            bcEmit(bcInstr2(instr.kind - iPlus + iPlusConst, regs[v], right.a), cm);
+        } else {
+            bcEmit(bcInstr3(instr.kind, regs[v], left, regs[ssaResolve(instr.b, f)]), cm);
+        }
+    } ei (instr.op == irCall) {
+        for (Int k = 0; k < instr.c; k++) {
+            bcEmit(bcInstr3(iMove, BC_CALL_AREA + stackFrameStart + k,
+                            regs[ssaResolve(f->operands->cont[instr.b + k], f)], 0), cm);
+        }
+        g->callArea = MAX(g->callArea, stackFrameStart + instr.c);
+        bcEmit(bcInstr2(iCall, BC_CALL_AREA, bcFnId(instr.a, g, cm)), cm);
+        if (instr.type != tokMisc) {
+            bcEmit(bcInstr3(iMove, regs[v], BC_CALL_AREA, 0), cm);
+        }
+    } ei (instr.op == irPrint) {
+        bcEmit(bcInstr3(iPrint, 0, 0, regs[ssaResolve(instr.a, f)]), cm);
+    }
+}
+
+testable void
+ssaLower(IrFunction* f, BcGen* g, CM) { //:ssaLower
+// Emits the bytecode of the function body. Every value gets a virtual register, the params the
+// ones already given to them by "bcFunction". The dead blocks are skipped
+    Arr(Int) regs = allocateArray(f->instrs->len, Int, cm->aTmp);
+    for (Int v = 0; v < f->instrs->len; v++) {
+        IrInstr instr = f->instrs->cont[v];
+        regs[v] = instr.op == irParam ? instr.a
+                : (instr.type == tokMisc || (instr.op == irPhi && instr.c > -1)) ? -1
+                : bcNewReg(bcIsPtrType(instr.type, cm), g, cm);
+    }
+    Arr(Int) blockStarts = allocateArray(f->blocks->len, Int, cm->aTmp);
+    StackInt* fixups = createStackint32_t(16, cm->aTmp); // pairs (jump, block)
+    for (Int b = 0; b < f->blocks->len; b++) {
+        IrBlock blk = f->blocks->cont[b];
+        if (ssaIsDead(b, f)) {
+            continue;
+        }
+        blockStarts[b] = cm->bytecode.len;
+        for (Int k = 0; k < blk.instrs->len; k++) {
+            ssaLowerInstr(blk.instrs->cont[k], regs, f, g, cm);
+        }
+        IrInstr term = f->instrs->cont[blk.term];
+        if (term.op == irJump) {
+            ssaLowerEdge(b, term.a, true, regs, fixups, f, g, cm);
+        } ei (term.op == irBranch) {
+            // A target with phis needs the moves, so it's reached through a jump after them
+            Bool const isDirect = !ssaHasPhis(term.b, f);
+            Int const branch = bcEmit(bcInstr2(term.kind, regs[ssaResolve(term.a, f)], 0), cm);
+            if (isDirect) {
+                push(branch, fixups);
+                push(term.b, fixups);
+            }
+            ssaLowerEdge(b, term.c, isDirect, regs, fixups, f, g, cm);
+            if (!isDirect) {
+                bcPatch(branch, cm->bytecode.len, cm);
+                ssaLowerEdge(b, term.b, false, regs, fixups, f, g, cm);
+            }
+        } ei (term.a > -1) {
+            bcEmit(bcInstr2(iReturn, regs[ssaResolve(term.a, f)], 1), cm);
+        } else {
+            bcEmit(bcInstr2(iReturn, 0, 0), cm);
+        }
+    }
+    for (Int k = 0; k < fixups->len; k += 2) {
+        bcPatch(fixups->cont[k], blockStarts[fixups->cont[k + 1]], cm);
+    }
+}
+
+//}}}
+
+testable void
+genBytecode(Bool keepAllFns, CM) { //:genBytecode
+// Generates the bytecode and pointer maps. The entry function is the first toplevel. With
+// "keepAllFns" every function is generated and its id is its index in @toplevels (for the embedding
+// API, where any function may be called), otherwise only the ones reachable from the entry function
+// are. Errors go into @stats
+    if (cm->stats.wasError || cm->toplevels.len == 0) {
+        return;
+    }
+    cm->bytecode = createInListUlong(256, cm->a);
+    cm->ptrMaps = createInListInt(64, cm->a);
+    if (setjmp(cm->excBuf) != 0) {
+        cm->bytecode.len = 0;
+        cm->ptrMaps.len = 0;
+        return;
+    }
+    Int const countEntities = cm->entities.len;
+    BcGen g = (BcGen){
+        .toplevelInds = allocateArray(countEntities, Int, cm->aTmp),
+        .fnQueue = createStackint32_t(16, cm->aTmp),
+        .constants = allocateArray(countEntities, Int, cm->aTmp),
+        .bakedValues = allocateArray(countEntities, Int, cm->aTmp),
+        .bakedLens = allocateArray(countEntities, Int, cm->aTmp),
+        .regs = allocateArray(countEntities, Int, cm->aTmp),
+        .locals = createStackint32_t(16, cm->aTmp),
+        .regIsPtr = createStackint32_t(16, cm->aTmp),
+        .breaks = createStackint32_t(16, cm->aTmp),
+        .inlined = createStackint32_t(8, cm->aTmp),
+        .inlineReturns = null,
+        .hoisted = allocateArray(cm->nodes.len, Int, cm->aTmp),
+        .variantIn = allocateArray(countEntities, Int, cm->aTmp),
+        .countLoops = 0,
+        .derivedIvs = createStackint32_t(8, cm->aTmp),
+        .escaping = allocateArray(countEntities, Bool, cm->aTmp),
+        .listArea = createStackint32_t(8, cm->aTmp),
+        .inBounds = allocateArray(cm->nodes.len, Bool, cm->aTmp) };
+    memset(g.hoisted, 0xFF, cm->nodes.len*sizeof(Int));
+    memset(g.inBounds, 0, cm->nodes.len*sizeof(Bool));
+    memset(g.variantIn, 0, countEntities*sizeof(Int));
+    memset(g.constants, 0xFF, countEntities*sizeof(Int));
+    memset(g.regs, 0xFF, countEntities*sizeof(Int));
+    cm->cgBtrack = createStackBtCodegen(16, cm->aTmp);
+
+    g.fnIds = bcUnnumberedFns(&g, cm);
+    Int firstFnNode = cm->nodes.len;
+    for (Int k = 0; k < cm->toplevels.len; k++) {
+        Assignment fn = cm->toplevels.cont[k];
+        g.toplevelInds[fn.entityId] = k;
+        firstFnNode = fn.nodeInd < firstFnNode ? fn.nodeInd : firstFnNode;
+    }
+    bcFindEscapes(&g, cm);
+    // Toplevel constants. Literals get inlined where they're used, the others are evaluated now, in
+    // order, so each can use the ones before it
+    for (Int j = 0; j < firstFnNode; j += cNodeSize(cm->nodes.cont[j])) {
+        Node nd = cm->nodes.cont[j];
+        if (nd.tp != nodAssignment && nd.tp != nodDef) {
+            continue;
+        }
+        Int rightInd = j + nd.pl3;
+        if (cm->nodes.cont[rightInd].tp == nodExpr && cm->nodes.cont[rightInd].pl2 == 1) {
+            rightInd += 1; // folded by "foldConstants"
+        }
+        Node right = cm->nodes.cont[rightInd];
+        g.constants[cm->nodes.cont[j + 1].pl1] = right.tp <= topVerbatimTokenVariant
+                                                 ? rightInd : BC_PENDING;
+    }
+    for (Int j = 0; j < firstFnNode; j += cNodeSize(cm->nodes.cont[j])) {
+        Node nd = cm->nodes.cont[j];
+        if ((nd.tp == nodAssignment || nd.tp == nodDef)
+                && g.constants[cm->nodes.cont[j + 1].pl1] == BC_PENDING) {
+            bcEvalConstant(cm->nodes.cont[j + 1].pl1, j + nd.pl3, &g, cm);
+        }
+    }
+    for (Int k = 0; k < (keepAllFns ? cm->toplevels.len : 1); k++) {
+        bcFnId(cm->toplevels.cont[k].entityId, &g, cm);
+    }
+    for (Int k = 0; k < g.fnQueue->len; k++) { // grows as the calls get emitted
+        bcFunction(cm->toplevels.cont[g.fnQueue->cont[k]], &g, cm);
+    }
+}
+
+//}}}
+//}}}
+//{{{ Interpreter
+//{{{ Utils
+
+private Unt
+rtDeref0(EyrPtr address, RT) { //:rtDeref0
+// Gets value at pointer as an integer
+    return *(rt->memory + address);
+}
+
+#define rtDeref(ptr) rtDeref0(ptr, rt)
+
+private EyrPtr
 rtPtrFromStack(StackAddr stackAddr, RT) { //:rtPtrFromStack
     return rt->currFrame + stackAddr;
 }
@@ -5968,9 +9843,55 @@ rtStackDeref0(StackAddr address, RT) { //:rtStackDeref0
 #define rtStackDeref(ptr) rtStackDeref0(ptr, rt)
 
 private void
-rtSetOnStack(StackAddr dest, Unt value, RT) { //:rtSetOnStack
-    Unt p = (rtDeref(rtPtrFromStack(dest, rt)));
-    *(rt->memory + p) = value;
+rtStackSet0(StackAddr address, Unt value, RT) { //:rtStackSet0
+// Sets the value of a stack slot
+    *(rt->memory + rtPtrFromStack(address, rt)) = value;
+}
+
+#define rtStackSet(ptr, value) rtStackSet0(ptr, value, rt)
+
+_Noreturn private void
+throwExcRuntime(char const errMsg[], RT) { //:throwExcRuntime
+    rt->errMsg = str(errMsg);
+    longjmp(rt->excBuf, 1);
+}
+
+private _Thread_local Interpreter* _rtCurrent = null; // the running one, for the SIGSEGV handler
+private struct sigaction _prevSegvAction;
+
+private void
+rtSegvHandler(int sig, siginfo_t* info, void* context) { //:rtSegvHandler
+// A fault in the guard pages is a stack overflow in the running VM. Any other fault is not ours, so
+// it goes to the previous handler. If that's the default one, it's put back for the faulting
+// instruction to rerun with, which crashes the process as it would've without us
+    Interpreter* rt = _rtCurrent;
+    Byte* addr = (Byte*)info->si_addr;
+    if (rt != null && addr >= (Byte*)(rt->memory + VM_STACK_SIZE)
+            && addr < (Byte*)(rt->memory + VM_STACK_SIZE + VM_GUARD_SIZE)) {
+        throwExcRuntime(errStackOverflow, rt); // fine from a handler thanks to SA_NODEFER
+    }
+    if ((_prevSegvAction.sa_flags & SA_SIGINFO) != 0) {
+        _prevSegvAction.sa_sigaction(sig, info, context);
+    } ei (_prevSegvAction.sa_handler != SIG_DFL && _prevSegvAction.sa_handler != SIG_IGN) {
+        _prevSegvAction.sa_handler(sig);
+    } else {
+        signal(SIGSEGV, SIG_DFL); // an ignored SIGSEGV would just fault forever
+    }
+}
+
+private void
+rtInstallSegvHandlerOnce(void) { //:rtInstallSegvHandlerOnce
+    struct sigaction action = { .sa_sigaction = &rtSegvHandler,
+                                .sa_flags = SA_SIGINFO | SA_NODEFER };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &_prevSegvAction);
+}
+
+private void
+rtInstallSegvHandler() { //:rtInstallSegvHandler
+// The handler is per process, and the running interpreter is per thread (see @_rtCurrent)
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, &rtInstallSegvHandlerOnce);
 }
 
 private void
@@ -5997,128 +9918,687 @@ setCallFrame(EyrPtr frame, CallHeader hdr, RT) {
     rt->memory[frame + 2] = (Unt)hdr.fnId;
 }
 
-private void
-printEyrString(EyrPtr strPtr, RT) {
-    EyrPtr address = rtDeref(strPtr);
-    Unt len = rtDeref(strPtr + 1);
-    
-#ifdef DEBUG
-    print("printing Eyr string with address %d and len %d", address, len);
-#endif
-
-    char* chars = (char*)(rt->memory) + rtDeref(address);
-    fwrite(chars, 1, len, stdout);
-    printf("\n");
+private char*
+rtStringChars(EyrPtr str, RT) { //:rtStringChars
+// A string is a heap object: [length] then the bytes
+    return (char*)(rt->memory + str + 1);
+}
+
+private void
+printEyrString(EyrPtr str, RT) { //:printEyrString
+    Unt len = rtDeref(str);
+#ifdef DEBUG
+    print("printing Eyr string with address %d and len %d", str, len);
+#endif
+    fwrite(rtStringChars(str, rt), 1, len, stdout);
+    printf("\n");
+}
+
+//}}}
+//{{{ Garbage collector
+
+// Every heap object is a header word followed by the payload. The header is the payload size in
+// words (lower 24 bits) plus the GC flags. An object either consists of pointers only (e.g. a list
+// of strings) or has no pointers at all (strings, lists of numbers), as known from its static type.
+// The collector is a precise, non-moving mark & sweep. Its roots are the stack slots listed in the
+// pointer maps of the functions active on the call stack.
+// Free blocks are kept in the free lists by size, and the next-pointer of a free block is stored
+// in its first payload word. A sweep rebuilds all the free lists, coalescing adjacent free blocks
+
+#define GC_MARKED     0x80000000
+#define GC_HAS_PTRS   0x40000000
+#define GC_FREE       0x20000000
+#define GC_SIZE_MASK  LOWER24BITS
+
+private Unt
+gcSize(EyrPtr obj, RT) { //:gcSize
+    return rt->memory[obj - 1] & GC_SIZE_MASK;
+}
+
+private void
+gcPushFree(EyrPtr obj, Unt size, RT) { //:gcPushFree
+    Int const sizeClass = size < GC_SIZE_CLASSES ? size : 0;
+    rt->memory[obj - 1] = size | GC_FREE;
+    rt->memory[obj] = rt->freeLists[sizeClass];
+    rt->freeLists[sizeClass] = obj;
+}
+
+private EyrPtr
+gcTakeFree(Unt size, RT) { //:gcTakeFree
+// Takes a block of at least "size" words from the free lists. Returns EYR_NULL if there are none.
+// Big blocks are split, with the remainder going back to the free lists
+    if (size < GC_SIZE_CLASSES && rt->freeLists[size] != EYR_NULL) {
+        EyrPtr obj = rt->freeLists[size];
+        rt->freeLists[size] = rt->memory[obj];
+        rt->memory[obj - 1] = size;
+        return obj;
+    }
+    EyrPtr* prev = &rt->freeLists[0];
+    for (EyrPtr obj = *prev; obj != EYR_NULL; obj = *prev) {
+        Unt const blockSize = gcSize(obj, rt);
+        if (blockSize >= size) {
+            *prev = rt->memory[obj];
+            rt->memory[obj - 1] = blockSize;
+            if (blockSize >= size + 2) { // the remainder needs at least a header + 1 word
+                rt->memory[obj - 1] = size;
+                gcPushFree(obj + size + 1, blockSize - size - 1, rt);
+            }
+            return obj;
+        }
+        prev = &rt->memory[obj];
+    }
+    return EYR_NULL;
+}
+
+private EyrPtr
+gcBump(Unt size, RT) { //:gcBump
+    if (rt->heapTop + size + 1 > rt->heapEnd) {
+        return EYR_NULL;
+    }
+    EyrPtr obj = rt->heapTop + 1;
+    rt->memory[obj - 1] = size;
+    rt->heapTop += size + 1;
+    return obj;
+}
+
+private void
+gcMark(EyrPtr root, StackInt* markStack, RT) { //:gcMark
+// Marks everything reachable from a root. Iterative, so deep structures don't overflow the C stack
+    if (root <= rt->heapStart || root >= rt->heapTop || (rt->memory[root - 1] & GC_MARKED)) {
+        return;
+    }
+    rt->memory[root - 1] |= GC_MARKED;
+    push((Int)root, markStack);
+    while (hasValues(markStack)) {
+        EyrPtr obj = (EyrPtr)pop(markStack);
+        Unt const header = rt->memory[obj - 1];
+        if ((header & GC_HAS_PTRS) == 0) {
+            continue;
+        }
+        Unt const size = header & GC_SIZE_MASK;
+        for (Unt k = 0; k < size; k++) {
+            EyrPtr child = rt->memory[obj + k];
+            if (child > rt->heapStart && child < rt->heapTop
+                    && (rt->memory[child - 1] & GC_MARKED) == 0) {
+                rt->memory[child - 1] |= GC_MARKED;
+                push((Int)child, markStack);
+            }
+        }
+    }
+}
+
+private void
+gcMarkRoots(StackInt* markStack, RT) { //:gcMarkRoots
+// The pinned objects, then the call stack from the current frame to the entry one (with ip = -1)
+    if (rt->pinned != EYR_NULL) {
+        rt->memory[rt->pinned - 1] |= GC_MARKED;
+        for (Int k = 0; k < rt->countPinned; k++) {
+            gcMark(rt->memory[rt->pinned + k], markStack, rt);
+        }
+    }
+    EyrPtr frame = rt->currFrame;
+    while (true) {
+        CallHeader hdr = getCallFrame(frame, rt);
+        Int const mapInd = rt->ptrMapInds[hdr.fnId];
+        if (mapInd > -1) {
+            Int const countSlots = rt->ptrMaps[mapInd];
+            for (Int k = 0; k < countSlots; k++) {
+                gcMark(rt->memory[frame + rt->ptrMaps[mapInd + 2 + k]], markStack, rt);
+            }
+        }
+        if (hdr.ip == (Unt)-1) {
+            return;
+        }
+        frame = hdr.prevFrame;
+    }
+}
+
+private Unt
+gcSweep(RT) { //:gcSweep
+// Unmarks the live objects and puts the runs of dead ones into the free lists.
+// A dead run at the very end just lowers the heap top. Returns the number of words freed up
+    Unt freed = 0;
+    for (Int k = 0; k < GC_SIZE_CLASSES; k++) {
+        rt->freeLists[k] = EYR_NULL;
+    }
+    EyrPtr runStart = EYR_NULL; // header of the first block in a run of dead ones
+    EyrPtr j = rt->heapStart;
+    while (j < rt->heapTop) {
+        Unt const header = rt->memory[j];
+        EyrPtr const next = j + (header & GC_SIZE_MASK) + 1;
+        if (header & GC_MARKED) {
+            rt->memory[j] = header & ~GC_MARKED;
+            if (runStart != EYR_NULL) {
+                gcPushFree(runStart + 1, j - runStart - 1, rt);
+                freed += j - runStart;
+                runStart = EYR_NULL;
+            }
+        } ei (runStart == EYR_NULL) {
+            runStart = j;
+        }
+        j = next;
+    }
+    if (runStart != EYR_NULL) {
+        freed += rt->heapTop - runStart;
+        rt->heapTop = runStart;
+    }
+    return freed;
+}
+
+private void
+rtReleasePages(EyrPtr start, EyrPtr end, RT) { //:rtReleasePages
+// Gives the whole pages of @memory[start, end) back to the OS. They stay reserved, and come back
+// zeroed when touched again
+    Ulong const pageSize = (Ulong)sysconf(_SC_PAGESIZE);
+    Ulong from = ((Ulong)(rt->memory + start) + pageSize - 1) & ~(pageSize - 1);
+    Ulong to = (Ulong)(rt->memory + end) & ~(pageSize - 1);
+    if (from < to) {
+        madvise((void*)from, to - from, MADV_DONTNEED);
+    }
+}
+
+testable Unt
+gcCollect(RT) { //:gcCollect
+// Returns the number of words freed up
+    Arena* a = createArena();
+    StackInt* markStack = createStackint32_t(64, a);
+    EyrPtr const oldTop = rt->heapTop;
+    gcMarkRoots(markStack, rt);
+    Unt const freed = gcSweep(rt);
+    deleteArena(a);
+    rtReleasePages(rt->heapTop, oldTop, rt);
+    rt->countCollections += 1;
+    return freed;
+}
+
+private void
+rtGrowHeap(Unt size, RT) { //:rtGrowHeap
+// Doubles the heap limit until there is room for "size" more words at the top
+    Ulong newEnd = rt->heapEnd;
+    while (newEnd < (Ulong)rt->heapTop + size + 1 && newEnd < VM_RESERVE_SIZE) {
+        newEnd += newEnd - rt->heapStart;
+    }
+    rt->heapEnd = newEnd < VM_RESERVE_SIZE ? (EyrPtr)newEnd : VM_RESERVE_SIZE;
+}
+
+testable EyrPtr
+rtAllocate(Unt sizeWords, Bool hasPointers, RT) { //:rtAllocate
+// Allocates a heap object and returns the pointer to its payload. May trigger a collection.
+// The payload of pointer objects is zeroed so that the GC never sees garbage in them
+    if (sizeWords > GC_SIZE_MASK) {
+        throwExcRuntime(errObjectTooLarge, rt); // the size wouldn't fit in the header
+    }
+    Unt const size = sizeWords > 0 ? sizeWords : 1; // free blocks need a word for the next-pointer
+    // Regions only bump the heap top, so they can be reset in O(1), until the heap hits the limit
+    Bool const isBumpOnly = rt->regionMark != EYR_NULL
+                            && rt->heapEnd - rt->heapStart < VM_REGION_HEAP_LIMIT;
+    EyrPtr obj = isBumpOnly ? EYR_NULL : gcTakeFree(size, rt);
+    if (obj == EYR_NULL) {
+        obj = gcBump(size, rt);
+    }
+    if (obj == EYR_NULL && isBumpOnly) {
+        rtGrowHeap(size, rt);
+        obj = gcBump(size, rt);
+    }
+    if (obj == EYR_NULL) {
+        Unt const freed = gcCollect(rt);
+        if (freed < (rt->heapEnd - rt->heapStart)/4) {
+            // Mostly live data: grow, or else the next collection would come right away
+            rtGrowHeap(size, rt);
+        }
+        obj = gcTakeFree(size, rt);
+        if (obj == EYR_NULL) {
+            obj = gcBump(size, rt);
+        }
+        if (obj == EYR_NULL) {
+            rtGrowHeap(size, rt);
+            obj = gcBump(size, rt);
+        }
+        if (obj == EYR_NULL) {
+            throwExcRuntime(errOutOfMemory, rt);
+        }
+    }
+    if (hasPointers) {
+        rt->memory[obj - 1] |= GC_HAS_PTRS;
+        memset(rt->memory + obj, 0, gcSize(obj, rt)*sizeof(Unt));
+    }
+    return obj;
+}
+
+private EyrPtr
+rtNewString(Unt len, RT) { //:rtNewString
+    EyrPtr str = rtAllocate(1 + len/4 + (len % 4 > 0), false, rt); // no wraparound for huge "len"
+    rt->memory[str] = len;
+    return str;
+}
+
+private void
+gcClearFrame(EyrPtr frame, Unt fnId, RT) { //:gcClearFrame
+// Nulls the pointer slots of a new frame, except the params which are already set by the caller
+    Int const mapInd = rt->ptrMapInds[fnId];
+    if (mapInd == -1) {
+        return;
+    }
+    Int const countSlots = rt->ptrMaps[mapInd];
+    for (Int k = rt->ptrMaps[mapInd + 1]; k < countSlots; k++) {
+        rt->memory[frame + rt->ptrMaps[mapInd + 2 + k]] = EYR_NULL;
+    }
+}
+
+//}}}
+//{{{ Regions
+
+// For embeddings where every request runs a short function and then throws away all its data.
+// "rtRegionMark" remembers the heap top and "rtRegionReset" goes back to it, freeing everything
+// allocated in between at once, without a GC. Data that must outlive the requests is allocated
+// before the mark (or kept with "rtRegionKeep") and made a root with "rtPin".
+// A region grows the heap when it runs out, up to VM_REGION_HEAP_LIMIT, and past that it collects.
+// After a collection the reset also has to drop the free blocks above the mark, so it becomes
+// O(free blocks). The pages above the heap top are given back to the OS on reset
+
+typedef struct { //:RtRegion
+    EyrPtr mark;
+    EyrPtr prevMark; // of the enclosing region, if any
+    EyrPtr pinned;
+    Int countPinned;
+    Int countCollections;
+} RtRegion;
+
+testable RtRegion
+rtRegionMark(RT) { //:rtRegionMark
+    RtRegion result = (RtRegion){
+        .mark = rt->heapTop, .prevMark = rt->regionMark, .pinned = rt->pinned,
+        .countPinned = rt->countPinned, .countCollections = rt->countCollections };
+    rt->regionMark = rt->heapTop;
+    return result;
+}
+
+private void
+rtDropFreeAbove(EyrPtr limit, RT) { //:rtDropFreeAbove
+// Removes the free blocks which don't fit below "limit" from the free lists. A block straddling
+// the limit becomes a dead object, for the next GC to reclaim
+    for (Int k = 0; k < GC_SIZE_CLASSES; k++) {
+        EyrPtr* prev = &rt->freeLists[k];
+        while (*prev != EYR_NULL) {
+            EyrPtr obj = *prev;
+            if (obj + gcSize(obj, rt) > limit) {
+                *prev = rt->memory[obj];
+                rt->memory[obj - 1] = obj < limit ? limit - obj : 0;
+            } else {
+                prev = &rt->memory[obj];
+            }
+        }
+    }
+}
+
+testable void
+rtRegionReset(RtRegion region, RT) { //:rtRegionReset
+// Frees everything allocated since the mark. The region stays active for the next request
+    EyrPtr const oldTop = rt->heapTop;
+    if (rt->countCollections != region.countCollections) {
+        EyrPtr const limit = rt->heapTop < region.mark ? rt->heapTop : region.mark;
+        rtDropFreeAbove(limit, rt);
+        rt->heapTop = limit;
+    } else {
+        rt->heapTop = region.mark;
+    }
+    rtReleasePages(rt->heapTop, oldTop, rt);
+    rt->regionMark = region.mark;
+    rt->pinned = region.pinned;
+    rt->countPinned = region.countPinned;
+    rt->currFrame = 0;
+    rt->errMsg = empty;
+}
+
+testable void
+rtRegionKeep(RtRegion* region, RT) { //:rtRegionKeep
+// Moves the mark up to the heap top, so everything allocated so far in the region outlives it
+    region->mark = rt->heapTop;
+    region->pinned = rt->pinned;
+    region->countPinned = rt->countPinned;
+    region->countCollections = rt->countCollections;
+    rt->regionMark = rt->heapTop;
+}
+
+testable void
+rtRegionEnd(RtRegion region, RT) { //:rtRegionEnd
+// Leaves the region, keeping its data. It's ordinary GC-managed heap from now on
+    rt->regionMark = region.prevMark;
+}
+
+testable Bool
+rtPin(EyrPtr obj, RT) { //:rtPin
+// Makes an object a GC root for the lifetime of the interpreter (or until a region reset, if it
+// was pinned inside a region). Returns false if out of memory.
+// Never collects, because "obj" isn't a root yet
+    Unt const cap = rt->pinned == EYR_NULL ? 0 : gcSize(rt->pinned, rt);
+    if ((Unt)rt->countPinned == cap) {
+        Unt const newCap = cap > 0 ? cap*2 : 8;
+        EyrPtr newPinned = rt->regionMark == EYR_NULL ? gcTakeFree(newCap, rt) : EYR_NULL;
+        if (newPinned == EYR_NULL) {
+            newPinned = gcBump(newCap, rt);
+        }
+        if (newPinned == EYR_NULL) {
+            rtGrowHeap(newCap, rt);
+            newPinned = gcBump(newCap, rt);
+        }
+        if (newPinned == EYR_NULL) {
+            return false;
+        }
+        if (cap > 0) {
+            memcpy(rt->memory + newPinned, rt->memory + rt->pinned, cap*sizeof(Unt));
+        }
+        rt->pinned = newPinned;
+    }
+    rt->memory[rt->pinned + rt->countPinned] = obj;
+    rt->countPinned += 1;
+    return true;
+}
+
+//}}}
+//{{{ Code running
+
+// Operand layouts: [A] [B] [C] are at bits 40, 24 and 0; [A] {B} are at bits 32 and 0
+#define OPER1 (StackAddr)((instr >> 40) & LOWER16BITS)
+#define OPER2 (StackAddr)((instr >> 24) & LOWER16BITS)
+#define OPER3 (StackAddr)(instr & LOWER16BITS)
+#define OPER_DEST (StackAddr)((instr >> 32) & LOWER16BITS)
+#define OPER_CONST (Int)(instr & LOWER32BITS)
+
+// Integer arithmetic wraps around on overflow, so it's done on Unt to stay clear of signed overflow.
+// INT_MIN / -1 is INT_MIN, like the JIT and the folding of constants
+
+private Unt
+runPlus(Ulong instr, Unt ip, Interpreter* rt) { //:runPlus
+    rtStackSet(OPER1, rtStackDeref(OPER2) + rtStackDeref(OPER3));
+    return ip + 1;
+}
+
+private Unt
+runMinus(Ulong instr, Unt ip, Interpreter* rt) { //:runMinus
+    rtStackSet(OPER1, rtStackDeref(OPER2) - rtStackDeref(OPER3));
+    return ip + 1;
+}
+
+private Unt
+runTimes(Ulong instr, Unt ip, Interpreter* rt) { //:runTimes
+    rtStackSet(OPER1, rtStackDeref(OPER2)*rtStackDeref(OPER3));
+    return ip + 1;
+}
+
+private Unt
+runDivBy(Ulong instr, Unt ip, Interpreter* rt) { //:runDivBy
+    Int const divisor = (Int)rtStackDeref(OPER3);
+    if (divisor == 0) {
+        throwExcRuntime(errDivisionByZero, rt);
+    }
+    Unt const dividend = rtStackDeref(OPER2);
+    rtStackSet(OPER1, divisor == -1 ? 0 - dividend : (Unt)((Int)dividend / divisor));
+    return ip + 1;
+}
+
+private Unt
+runPlusConst(Ulong instr, Unt ip, Interpreter* rt) { //:runPlusConst
+    rtStackSet(OPER_DEST, rtStackDeref(OPER_DEST) + (Unt)OPER_CONST);
+    return ip + 1;
+}
+
+private Unt
+runMinusConst(Ulong instr, Unt ip, Interpreter* rt) { //:runMinusConst
+    rtStackSet(OPER_DEST, rtStackDeref(OPER_DEST) - (Unt)OPER_CONST);
+    return ip + 1;
+}
+
+private Unt
+runTimesConst(Ulong instr, Unt ip, Interpreter* rt) { //:runTimesConst
+    rtStackSet(OPER_DEST, rtStackDeref(OPER_DEST)*(Unt)OPER_CONST);
+    return ip + 1;
+}
+
+private Unt
+runDivByConst(Ulong instr, Unt ip, Interpreter* rt) { //:runDivByConst
+// The codegen never emits a zero constant divisor
+    Unt const dividend = rtStackDeref(OPER_DEST);
+    rtStackSet(OPER_DEST, OPER_CONST == -1 ? 0 - dividend : (Unt)((Int)dividend / OPER_CONST));
+    return ip + 1;
+}
+
+private Unt
+runShiftLeftConst(Ulong instr, Unt ip, Interpreter* rt) { //:runShiftLeftConst
+    rtStackSet(OPER_DEST, rtStackDeref(OPER_DEST) << OPER_CONST);
+    return ip + 1;
+}
+
+private Unt
+runDivByPow2Const(Ulong instr, Unt ip, Interpreter* rt) { //:runDivByPow2Const
+// A negative dividend is biased by (divisor - 1) so that the shift rounds towards zero, like "/"
+    Int const value = (Int)rtStackDeref(OPER_DEST);
+    Int const bias = (value >> 31) & ((1 << OPER_CONST) - 1);
+    rtStackSet(OPER_DEST, (value + bias) >> OPER_CONST);
+    return ip + 1;
+}
+
+private Unt
+runRemPow2Const(Ulong instr, Unt ip, Interpreter* rt) { //:runRemPow2Const
+// Same sign as the dividend, like "%"
+    Int const value = (Int)rtStackDeref(OPER_DEST);
+    Int const mask = (1 << OPER_CONST) - 1;
+    Int const bias = (value >> 31) & mask;
+    rtStackSet(OPER_DEST, ((value + bias) & mask) - bias);
+    return ip + 1;
+}
+
+private Unt
+runNewString(Ulong instr, Unt ip, Interpreter* rt) { //:runNewString
+// iNewstring. Creates a new string as a substring of the static text. Stores pointer to the new
+// string on the stack
+    Int len = (Int)(instr & LOWER24BITS);
+    Unt start = rtStackDeref(OPER2); // actual starting symbol within the static text
+    EyrPtr newStr = rtNewString(len, rt);
+    memcpy(rtStringChars(newStr, rt), rt->textStart + start, len);
+    rtStackSet(OPER1, newStr);
+    return ip + 1;
+}
+
+private Unt
+runConcatStrings(Ulong instr, Unt ip, Interpreter* rt) { //:runConcatStrings
+// iConcatStrs. The operands are read after the allocation: it may have run the GC, which doesn't
+// move objects but does reuse the dead ones
+    Unt const len1 = rtDeref(rtStackDeref(OPER2));
+    Unt const len2 = rtDeref(rtStackDeref(OPER3));
+    EyrPtr newStr = rtNewString(len1 + len2, rt);
+    char* target = rtStringChars(newStr, rt);
+    memcpy(target, rtStringChars(rtStackDeref(OPER2), rt), len1);
+    memcpy(target + len1, rtStringChars(rtStackDeref(OPER3), rt), len2);
+    rtStackSet(OPER1, newStr);
+    return ip + 1;
+}
+
+private Unt
+runReverseString(Ulong instr, Unt ip, Interpreter* rt) { //:runReverseString
+// iReverseString [Dest] [Src]
+    Unt const len = rtDeref(rtStackDeref(OPER2));
+    EyrPtr newStr = rtNewString(len, rt);
+    char* target = rtStringChars(newStr, rt);
+    char const* src = rtStringChars(rtStackDeref(OPER2), rt);
+    for (Unt k = 0; k < len; k++) {
+        target[k] = src[len - k - 1];
+    }
+    rtStackSet(OPER1, newStr);
+    return ip + 1;
 }
 
-//}}}
-//{{{ Code running
+private Unt
+runSetLocal(Ulong instr, Unt ip, Interpreter* restrict rt) { //:runSetLocal
+// iSetLocal Sets the value of a local variable in the stack
+    rtStackSet(OPER_DEST, (Unt)(instr & LOWER32BITS));
+    return ip + 1;
+}
 
 private Unt
-runPlus(Ulong instr, Unt ip, Interpreter* rt) {  return ip + 1; }
+rtNewList(Ulong instr, Unt ip, Bool hasPointers, RT) { //:rtNewList
+// A list is laid out like a string: the length, then the elements. In a list of pointers the GC
+// also looks at the length, but it's too small to be taken for a heap address
+    Unt const len = (Unt)(instr & LOWER16BITS);
+    EyrPtr lst = rtAllocate(len + 1, hasPointers, rt);
+    rt->memory[lst] = len;
+    memcpy(rt->memory + lst + 1, rt->memory + rtPtrFromStack(OPER2, rt), len*sizeof(Unt));
+    rtStackSet(OPER1, lst);
+    return ip + 1;
+}
 
 private Unt
-runMinus(Ulong instr, Unt ip, Interpreter* rt) { return ip + 1; }
+runNewList(Ulong instr, Unt ip, RT) { //:runNewList
+// iNewList [Dest] [Start] [~Length]
+    return rtNewList(instr, ip, false, rt);
+}
 
 private Unt
-runTimes(Ulong instr, Unt ip, Interpreter* rt) { return ip + 1; }
+runNewPtrList(Ulong instr, Unt ip, RT) { //:runNewPtrList
+// iNewPtrList [Dest] [Start] [~Length]
+    return rtNewList(instr, ip, true, rt);
+}
 
 private Unt
-runDivBy(Ulong instr, Unt ip, Interpreter* rt) { return ip + 1; }
+runNewStackList(Ulong instr, Unt ip, RT) { //:runNewStackList
+// iNewStackList [Dest] [Start] [~Length]. Nothing to copy, the elements are already in place
+    StackAddr const header = OPER2 - 1;
+    rtStackSet(header, (Unt)(instr & LOWER16BITS));
+    rtStackSet(OPER1, rtPtrFromStack(header, rt));
+    return ip + 1;
+}
 
 private Unt
-runNewString(Ulong instr, Unt ip, Interpreter* rt) { //:runNewString
-// iNewstring. Creates a new string as a substring of the static text. Stores pointer to the new
-// string on the stack
-    StackAddr dest = (StackAddr)((instr >> 40) & LOWER16BITS);
-    StackAddr startAddr = (StackAddr)((instr >> 24) & LOWER16BITS);
-    Int len = (Int)(instr & LOWER24BITS);
-    Unt start = rtStackDeref(startAddr); // actual starting symbol within the static text
+runGetFld(Ulong instr, Unt ip, RT) { //:runGetFld
+// iGetFld [Dest] [Obj] [~Offset]. Offset 0 of a string or list is its length
+    rtStackSet(OPER1, rt->memory[rtStackDeref(OPER2) + OPER3]);
+    return ip + 1;
+}
 
-    char* copyFrom = rt->textStart + start;
-    EyrPtr eyrTarget = rtStackDeref(dest);
-    char* target = (char*)(rt->memory + eyrTarget);
-    print("copyFrom %p target %p", copyFrom, target);
+private EyrPtr
+rtElemAddress(EyrPtr lst, Int index, RT) { //:rtElemAddress
+// The unsigned comparison also catches the negative indices
+    if ((Unt)index >= rt->memory[lst]) {
+        throwExcRuntime(errIndexOutOfBounds, rt);
+    }
+    return lst + 1 + index;
+}
 
-    memcpy(target, copyFrom, len);
-    rtSetOnStack(rt->stackTop, eyrTarget, rt);
-    rtSetOnStack(rt->stackTop + 1, len, rt);
-    rt->stackTop += 2; // 1 for the pointer, 1 for the length
+private Unt
+runGetElem(Ulong instr, Unt ip, RT) { //:runGetElem
+// iGetElem [Dest] [List] [Index]
+    rtStackSet(OPER1, rt->memory[rtElemAddress(rtStackDeref(OPER2), rtStackDeref(OPER3), rt)]);
+    return ip + 1;
+}
 
-    rtMoveHeapTop(len, rt); // update the heap top after this allocation
+private Unt
+runGetElemUnchecked(Ulong instr, Unt ip, RT) { //:runGetElemUnchecked
+// iGetElemUnchecked [Dest] [List] [Index]
+    rtStackSet(OPER1, rt->memory[rtStackDeref(OPER2) + 1 + rtStackDeref(OPER3)]);
     return ip + 1;
 }
 
 private Unt
-runConcatStrings(Ulong instr, Unt ip, Interpreter* rt) { //:runConcatStrings
+runSetElem(Ulong instr, Unt ip, RT) { //:runSetElem
+// iSetElem [List] [Index] [Value]
+    rt->memory[rtElemAddress(rtStackDeref(OPER1), rtStackDeref(OPER2), rt)] = rtStackDeref(OPER3);
     return ip + 1;
 }
 
 private Unt
-runReverseString(Ulong instr, Unt ip, Interpreter* rt) { //:runReverseString
+runSetElemUnchecked(Ulong instr, Unt ip, RT) { //:runSetElemUnchecked
+// iSetElemUnchecked [List] [Index] [Value]
+    rt->memory[rtStackDeref(OPER1) + 1 + rtStackDeref(OPER2)] = rtStackDeref(OPER3);
     return ip + 1;
 }
 
 private Unt
-runSetLocal(Ulong instr, Unt ip, Interpreter* restrict rt) { //:runSetLocal
-// iSetLocal Sets the value of a local variable in the stack
-    StackAddr dest = (instr >> 32) & LOWER16BITS;
-    Unt address = rtStackDeref(dest);
-    *(rt->memory + address) = (Unt)(instr & LOWER32BITS);
+runMove(Ulong instr, Unt ip, RT) { //:runMove
+// iMove [Dest] [Src]
+    rtStackSet(OPER1, rtStackDeref(OPER2));
     return ip + 1;
 }
 
 private Unt
 runBuiltinCall(Ulong instr, Unt ip, RT) { //:runBuiltinCall
-    BUILTINS_TABLE[instr & (0xFF)](rt);
+// No builtins are implemented yet, and the code generator doesn't emit this instruction
+    throwExcRuntime(errBuiltinCall, rt);
     return ip + 1;
 }
 
 private Unt
 runCall(Ulong instr, Unt ip, RT) { //:runCall
-// iCall Creates and activates a new call frame.
-    Unt newIp = (Unt)(instr & LOWER32BITS);
-
-    // save the current IP to its frame
-    EyrPtr oldFrame = rtDeref(rt->currFrame);
-    print("saving old ip = %d", ip);
-    *(rt->memory + oldFrame + 1) = ip;
-    
-#ifdef DEBUG
-    print("frame before call:")
-    dbgCallFrames(rt);
-#endif 
-
-    setCallFrame(rt->stackTop, (CallHeader){.prevFrame = rt->currFrame, .ip = rt->ip}, rt);
-    rt->currFrame = rt->stackTop;
-    rt->stackTop += sizeof(CallHeader);
+// iCall Creates and activates a new call frame. Hot functions get compiled to native code, after
+// which calls to them don't go through the interpreter loop at all
+    Unt fnId = (Unt)(instr & LOWER32BITS);
+    EyrPtr newFrame = rtPtrFromStack(OPER_DEST, rt);
+    Int fnStart = rt->fns[fnId];
+#ifdef JIT
+    if (fnStart == -1) {
+        return rtRunNative(fnId, newFrame, ip, rt);
+    }
+    rt->callCounts[fnId] += 1;
+    if (rt->callCounts[fnId] == JIT_THRESHOLD && jitCompile(fnId, rt)) {
+        return rtRunNative(fnId, newFrame, ip, rt);
+    }
+#endif
+    setCallFrame(newFrame, (CallHeader){.prevFrame = rt->currFrame, .ip = ip + 1, .fnId = fnId}, rt);
+    gcClearFrame(newFrame, fnId, rt);
+    rt->currFrame = newFrame;
 
 #ifdef DEBUG
     print("frame after call:")
     dbgCallFrames(rt);
-#endif 
+#endif
+
+    return fnStart + 1; // +1 for the function length
+}
 
-    return newIp;
+private Unt
+runTailCall(Ulong instr, Unt ip, RT) { //:runTailCall
+// iTailCall. The callee gets the current frame: the args are moved over the params, and the header
+// keeps the return address of the current call. Only the function id changes, for the GC
+    Unt const fnId = (Unt)(instr & LOWER16BITS);
+    Unt const countArgs = (Unt)OPER2;
+    EyrPtr const frame = rt->currFrame;
+    memmove(rt->memory + frame + stackFrameStart,
+            rt->memory + rtPtrFromStack(OPER1, rt) + stackFrameStart, countArgs*sizeof(Unt));
+#ifdef JIT
+    Bool isNative = rt->fns[fnId] == -1;
+    if (!isNative) {
+        rt->callCounts[fnId] += 1;
+        isNative = rt->callCounts[fnId] == JIT_THRESHOLD && jitCompile(fnId, rt);
+    }
+    if (isNative) {
+        CallHeader hdr = getCallFrame(frame, rt); // the return value goes over it
+        rtRunNative(fnId, frame, ip, rt);
+        rt->currFrame = hdr.prevFrame;
+        return hdr.ip;
+    }
+#endif
+    rt->memory[frame + 2] = fnId;
+    gcClearFrame(frame, fnId, rt);
+    return rt->fns[fnId] + 1; // +1 for the function length
 }
 
 private Unt
 runReturn(Ulong instr, Unt ip, RT) { //:runReturn
-// Return from function. The return value, if any, will be stored right over the header
-    Int returnSize = instr & (0xFF);
+// Return from function. The return value, if any, will be stored right over the header.
+// Returning from the entry function ends the interpretation, because its header has ip = -1
     CallHeader callFrame = getCallFrame(rt->currFrame, rt);
-    if (callFrame.prevFrame == EYR_NULL) {
-        return -1; // End of interpretation because we've returned from "main"
+    Int returnSize = instr & (0xFF);
+    StackAddr src = OPER_DEST;
+    for (Int j = 0; j < returnSize; j++) {
+        rt->memory[rt->currFrame + j] = rtStackDeref(src + j);
     }
-
     rt->topOfFrame = rt->currFrame + returnSize;
     rt->currFrame = callFrame.prevFrame; // take a call off the stack
-    EyrPtr callerIp = rtDeref(callFrame.prevFrame) + 1;
-    
-#ifdef DEBUG 
-    print("caller's Ip restored as %d", callerIp);
+
+#ifdef DEBUG
+    print("caller's Ip restored as %d", callFrame.ip);
 #endif
 
-    return rtDeref(callerIp);
+    return callFrame.ip;
 }
 
 private Unt
@@ -6128,41 +10608,767 @@ runPrint(Ulong instr, Unt ip, RT) { //:runPrint iPrint
     return ip + 1;
 }
 
+private Unt
+runJump(Ulong instr, Unt ip, RT) { //:runJump
+    return (Unt)(instr & LOWER32BITS);
+}
+
+private Unt
+runBranchLt(Ulong instr, Unt ip, RT) { //:runBranchLt
+// Branch if the operand is negative
+    return (Int)rtStackDeref(OPER_DEST) < 0 ? (Unt)(instr & LOWER32BITS) : ip + 1;
+}
+
+private Unt
+runBranchEq(Ulong instr, Unt ip, RT) { //:runBranchEq
+// Branch if the operand is zero
+    return rtStackDeref(OPER_DEST) == 0 ? (Unt)(instr & LOWER32BITS) : ip + 1;
+}
+
+private Unt
+runBranchGt(Ulong instr, Unt ip, RT) { //:runBranchGt
+// Branch if the operand is positive
+    return (Int)rtStackDeref(OPER_DEST) > 0 ? (Unt)(instr & LOWER32BITS) : ip + 1;
+}
+
+//}}}
+//{{{ Superinstructions
+// Each one runs its parts back to back. The 2nd part sits in the next slot and gets the same ip
+// that it would've had without the fusion
+
+private Unt
+runMinusBranchLt(Ulong instr, Unt ip, RT) { //:runMinusBranchLt
+    runMinus(instr, ip, rt);
+    return runBranchLt(rt->code[ip + 1], ip + 1, rt);
+}
+
+private Unt
+runMinusBranchEq(Ulong instr, Unt ip, RT) { //:runMinusBranchEq
+    runMinus(instr, ip, rt);
+    return runBranchEq(rt->code[ip + 1], ip + 1, rt);
+}
+
+private Unt
+runMinusBranchGt(Ulong instr, Unt ip, RT) { //:runMinusBranchGt
+    runMinus(instr, ip, rt);
+    return runBranchGt(rt->code[ip + 1], ip + 1, rt);
+}
+
+private Unt
+runSetLocalPlusConst(Ulong instr, Unt ip, RT) { //:runSetLocalPlusConst
+    runSetLocal(instr, ip, rt);
+    return runPlusConst(rt->code[ip + 1], ip + 1, rt);
+}
+
+private Unt
+runSetLocalCall(Ulong instr, Unt ip, RT) { //:runSetLocalCall
+    runSetLocal(instr, ip, rt);
+    return runCall(rt->code[ip + 1], ip + 1, rt);
+}
+
+//}}}
+//{{{ JIT
+#ifdef JIT
+// Baseline template JIT for x86-64. Translates the integer subset of the bytecode one instruction at
+// a time: the stack frame pointer is in rdi, and every slot access is a memory operand off it.
+// Functions which call other functions or touch strings, lists etc stay interpreted
+
+#define JIT_BUF_SIZE 1048576 // Executable memory per interpreter
+#define JIT_MAX_INSTR 48     // Max native bytes emitted per instruction slot, except iReturn
+#define JIT_ERR_DIV_ZERO 1
+
+typedef struct { //:JitState
+    Arr(Byte) cont;
+    Int len;
+    Arr(Int) offsets;    // native offset of every instruction slot of the function
+    StackInt* fixups;    // pairs (position of a rel32, target ip)
+    StackInt* errFixups; // positions of rel32s that jump to the division-by-zero exit
+} JitState;
+
+private void
+jitEmit(JitState* js, Int count, ...) { //:jitEmit
+    va_list args;
+    va_start(args, count);
+    for (Int j = 0; j < count; j++) {
+        js->cont[js->len] = (Byte)va_arg(args, Int);
+        js->len += 1;
+    }
+    va_end(args);
+}
+
+private void
+jitInt(Int n, JitState* js) { //:jitInt
+// Little-endian 32-bit immediate or displacement
+    memcpy(js->cont + js->len, &n, 4);
+    js->len += 4;
+}
+
+private void
+jitSlot(Byte opCode, Byte modRm, StackAddr slot, JitState* js) { //:jitSlot
+// An instruction with the memory operand [rdi + 4*slot]
+    jitEmit(js, 2, opCode, modRm);
+    jitInt(4*slot, js);
+}
+
+private void
+jitJump(Int target, JitState* js) { //:jitJump
+// The rel32 of a just emitted jump opcode. Gets patched once all offsets are known
+    push(js->len, js->fixups);
+    push(target, js->fixups);
+    jitInt(0, js);
+}
+
+private void
+jitBranch(Byte condCode, Ulong instr, JitState* js) { //:jitBranch
+// cmp dword [slot], 0; j<cond> target
+    jitSlot(0x83, 0xBF, OPER_DEST, js);
+    jitEmit(js, 3, 0x00, 0x0F, condCode);
+    jitJump((Int)(instr & LOWER32BITS), js);
+}
+
+private Bool
+jitTranslate(Int start, Int sentinel, JitState* js, RT) { //:jitTranslate
+// Returns false if there's an instruction the JIT doesn't support
+    for (Int j = start; j < sentinel; j++) {
+        js->offsets[j - start] = js->len;
+        Ulong instr = rt->code[j];
+        Int opCode = instr >> 58;
+        if (opCode >= iMinusBranchLt && opCode <= iMinusBranchGt) {
+            opCode = iMinus; // the 2nd slot of a superinstruction is translated on its own
+        } ei (opCode == iSetLocalPlusConst) {
+            opCode = iSetLocal;
+        }
+
+        if (opCode >= iJump && opCode <= iBranchGt) {
+            Int target = (Int)(instr & LOWER32BITS);
+            if (target < start || target >= sentinel) {
+                return false;
+            }
+        }
+
+        if (opCode == iPlus || opCode == iMinus || opCode == iTimes) {
+            jitSlot(0x8B, 0x87, OPER2, js); // mov eax, [op1]
+            if (opCode == iPlus) {
+                jitSlot(0x03, 0x87, OPER3, js); // add eax, [op2]
+            } ei (opCode == iMinus) {
+                jitSlot(0x2B, 0x87, OPER3, js); // sub eax, [op2]
+            } else {
+                jitEmit(js, 1, 0x0F);
+                jitSlot(0xAF, 0x87, OPER3, js); // imul eax, [op2]
+            }
+            jitSlot(0x89, 0x87, OPER1, js); // mov [dest], eax
+        } ei (opCode == iDivBy) {
+            jitSlot(0x8B, 0x8F, OPER3, js); // mov ecx, [op2]
+            jitEmit(js, 4, 0x85, 0xC9, 0x0F, 0x84); // test ecx, ecx; jz divByZero
+            push(js->len, js->errFixups);
+            jitInt(0, js);
+            jitSlot(0x8B, 0x87, OPER2, js); // mov eax, [op1]
+            // idiv faults on INT_MIN / -1, so a divisor of -1 is a negation (which wraps)
+            jitEmit(js, 5, 0x83, 0xF9, 0xFF, 0x75, 0x04); // cmp ecx, -1; jne +4
+            jitEmit(js, 4, 0xF7, 0xD8, 0xEB, 0x03); // neg eax; jmp +3
+            jitEmit(js, 3, 0x99, 0xF7, 0xF9); // cdq; idiv ecx
+            jitSlot(0x89, 0x87, OPER1, js);
+        } ei (opCode == iPlusConst || opCode == iMinusConst) {
+            jitSlot(0x81, opCode == iPlusConst ? 0x87 : 0xAF, OPER_DEST, js); // add/sub [dest], imm
+            jitInt(OPER_CONST, js);
+        } ei (opCode == iDivByConst && OPER_CONST == -1) {
+            jitSlot(0xF7, 0x9F, OPER_DEST, js); // neg dword [dest], as idiv faults on INT_MIN / -1
+        } ei (opCode == iTimesConst || opCode == iDivByConst) {
+            jitSlot(0x8B, 0x87, OPER_DEST, js);
+            if (opCode == iTimesConst) {
+                jitEmit(js, 2, 0x69, 0xC0); // imul eax, eax, imm
+                jitInt(OPER_CONST, js);
+            } else {
+                jitEmit(js, 2, 0x99, 0xB9); // cdq; mov ecx, imm
+                jitInt(OPER_CONST, js);
+                jitEmit(js, 2, 0xF7, 0xF9); // idiv ecx
+            }
+            jitSlot(0x89, 0x87, OPER_DEST, js);
+        } ei (opCode == iShiftLeftConst) {
+            jitSlot(0xC1, 0xA7, OPER_DEST, js); // shl dword [dest], imm8
+            jitEmit(js, 1, (Byte)OPER_CONST);
+        } ei (opCode == iDivByPow2Const || opCode == iRemPow2Const) {
+            jitSlot(0x8B, 0x87, OPER_DEST, js);
+            jitEmit(js, 3, 0x99, 0x81, 0xE2); // cdq; and edx, mask
+            jitInt((1 << OPER_CONST) - 1, js);
+            jitEmit(js, 2, 0x01, 0xD0); // add eax, edx
+            if (opCode == iDivByPow2Const) {
+                jitEmit(js, 3, 0xC1, 0xF8, (Byte)OPER_CONST); // sar eax, imm8
+            } else {
+                jitEmit(js, 1, 0x25); // and eax, mask
+                jitInt((1 << OPER_CONST) - 1, js);
+                jitEmit(js, 2, 0x29, 0xD0); // sub eax, edx
+            }
+            jitSlot(0x89, 0x87, OPER_DEST, js);
+        } ei (opCode == iSetLocal) {
+            jitSlot(0xC7, 0x87, OPER_DEST, js); // mov dword [dest], imm
+            jitInt(OPER_CONST, js);
+        } ei (opCode == iMove) {
+            jitSlot(0x8B, 0x87, OPER2, js); // mov eax, [src]
+            jitSlot(0x89, 0x87, OPER1, js); // mov [dest], eax
+        } ei (opCode == iJump) {
+            jitEmit(js, 1, 0xE9);
+            jitJump((Int)(instr & LOWER32BITS), js);
+        } ei (opCode == iBranchLt) {
+            jitBranch(0x8C, instr, js); // jl
+        } ei (opCode == iBranchEq) {
+            jitBranch(0x84, instr, js); // je
+        } ei (opCode == iBranchGt) {
+            jitBranch(0x8F, instr, js); // jg
+        } ei (opCode == iReturn) {
+            Int returnSize = instr & (0xFF);
+            for (Int k = 0; k < returnSize; k++) {
+                jitSlot(0x8B, 0x87, OPER_DEST + k, js);
+                jitSlot(0x89, 0x87, k, js);
+            }
+            jitEmit(js, 3, 0x31, 0xC0, 0xC3); // xor eax, eax; ret
+        } else {
+            return false;
+        }
+    }
+    if (hasValues(js->errFixups)) {
+        Int errExit = js->len;
+        jitEmit(js, 1, 0xB8); // mov eax, JIT_ERR_DIV_ZERO; ret
+        jitInt(JIT_ERR_DIV_ZERO, js);
+        jitEmit(js, 1, 0xC3);
+        for (Int k = 0; k < js->errFixups->len; k++) {
+            Int pos = js->errFixups->cont[k];
+            Int rel = errExit - (pos + 4);
+            memcpy(js->cont + pos, &rel, 4);
+        }
+    }
+    for (Int k = 0; k < js->fixups->len; k += 2) {
+        Int pos = js->fixups->cont[k];
+        Int rel = js->offsets[js->fixups->cont[k + 1] - start] - (pos + 4);
+        memcpy(js->cont + pos, &rel, 4);
+    }
+    return true;
+}
+
+private Bool
+jitInstall(Unt fnId, JitState* js, RT) { //:jitInstall
+// Copies the native code into the executable buffer, and patches @fns so the next calls go there.
+// The buffer is only writable while we're copying into it
+    if (rt->jitBuf == null) {
+        void* buf = mmap(null, JIT_BUF_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0);
+        if (buf == MAP_FAILED) {
+            return false;
+        }
+        rt->jitBuf = buf;
+        rt->jitBufLen = 0;
+    }
+    if (rt->jitBufLen + js->len > JIT_BUF_SIZE) {
+        return false;
+    }
+    Byte* target = rt->jitBuf + rt->jitBufLen;
+    if (mprotect(rt->jitBuf, JIT_BUF_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    memcpy(target, js->cont, js->len);
+    if (mprotect(rt->jitBuf, JIT_BUF_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        return false;
+    }
+    rt->jitBufLen = MIN(JIT_BUF_SIZE, (rt->jitBufLen + js->len + 15) & ~15); // 16-byte aligned
+    *(void**)(&rt->jitFns[fnId]) = target; // POSIX allows this conversion, ISO C doesn't
+    rt->fns[fnId] = -1;
+    return true;
+}
+
+private Int
+jitMaxLen(Int start, Int sentinel, RT) { //:jitMaxLen
+// The upper bound of the native code size of a function, including the division-by-zero exit
+    Int result = JIT_MAX_INSTR;
+    for (Int j = start; j < sentinel; j++) {
+        Ulong const instr = rt->code[j];
+        result += (instr >> 58) == iReturn ? 12*(Int)(instr & 0xFF) + 3 : JIT_MAX_INSTR;
+    }
+    return result;
+}
+
+private Bool
+jitCompile(Unt fnId, RT) { //:jitCompile
+// Tries to compile a hot function. If that fails, the function stays interpreted for good
+    Int start = rt->fns[fnId] + 1;
+    Int sentinel = start + (Int)rt->code[start - 1];
+    Arena* a = createArena();
+    JitState js = {
+        .cont = allocateArray(jitMaxLen(start, sentinel, rt), Byte, a),
+        .len = 0,
+        .offsets = allocateArray(sentinel - start + 1, Int, a),
+        .fixups = createStackint32_t(16, a),
+        .errFixups = createStackint32_t(4, a)
+    };
+    Bool result = jitTranslate(start, sentinel, &js, rt) && jitInstall(fnId, &js, rt);
+    deleteArena(a);
+    return result;
+}
+
+private Unt
+rtRunNative(Unt fnId, EyrPtr newFrame, Unt ip, RT) { //:rtRunNative
+// Runs a compiled function in the frame its call would've created. The native code leaves the
+// return value at the start of that frame, same as "runReturn"
+    Int err = (rt->jitFns[fnId])(rt->memory + newFrame);
+    if (err == JIT_ERR_DIV_ZERO) {
+        throwExcRuntime(errDivisionByZero, rt);
+    }
+    return ip + 1;
+}
+
+#endif
 //}}}
 //{{{ Interpreter init
 
-private void
-tmpGetText(Interpreter* rt) { // Temporary, for testing purposes
-    char txt[] = "asdfBBCC";
-    Int const len = sizeof(txt) - 1;
-    char* dest = (char*)(rt->memory + rt->heapTop);
-    memcpy(dest, txt, len);
-    *(dest + len) = '\0';
-    rt->textStart = dest;
-    rtMoveHeapTop(len + 1, rt);
+private void
+rtLoadStaticText(CM, RT) { //:rtLoadStaticText
+// Copies the text of the string literals to the start of the heap, for "iNewstring"
+    Int const len = cm->staticText != null ? cm->staticText->len : 0;
+    char* dest = (char*)(rt->memory + rt->heapTop);
+    if (len > 0) {
+        memcpy(dest, cm->staticText->cont, len);
+    }
+    *(dest + len) = '\0';
+    rt->textStart = dest;
+    rtMoveHeapTop(len + 1, rt);
+}
+
+private Int
+rtCountFns(Arr(Ulong) code, Int codeLen) { //:rtCountFns
+// Every function starts with its length
+    Int countFns = 0;
+    for (Int j = 0; j < codeLen; j += (Int)code[j] + 1) {
+        countFns += 1;
+    }
+    return countFns;
+}
+
+private void
+rtCreate(Arr(Ulong) code, Arr(Int) fns, Int countFns, Arr(Int) ptrMaps, Int ptrMapsLen,
+         OUT Interpreter* rt) {
+//:rtCreate A VM for the code, with the heap not started yet: the static text may go first.
+// The code, the function table (if given, else it's made from the code) and the pointer maps are
+// shared, not copied
+    Arr(Unt) memory = mmap(null, VM_RESERVE_SIZE*sizeof(Unt), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED
+            || mprotect(memory + VM_STACK_SIZE, VM_GUARD_SIZE*sizeof(Unt), PROT_NONE) != 0) {
+        (*rt) = (Interpreter){ .errMsg = str(errOutOfMemory) };
+        return;
+    }
+    rtInstallSegvHandler();
+    Arena* a = createArena();
+    (*rt) = (Interpreter)  {
+        .ip = 1, // the entry function's code, after its length
+        .memory = memory,
+        .fns = fns != null ? fns : allocateArray(countFns + 1, Int, a),
+        .heapTop = VM_STACK_SIZE + VM_GUARD_SIZE,
+        .ptrMaps = ptrMaps,
+        .ptrMapInds = allocateArray(countFns + 1, Int, a),
+        .currFrame = 0,
+        .textStart = 0,
+        .code = code,
+        .countFns = countFns,
+        .callCounts = allocateArray(countFns + 1, Unt, a),
+        .jitFns = allocateArray(countFns + 1, JitFn, a),
+        .jitBuf = null,
+        .image = null,
+        .a = a
+    };
+    memset(rt->callCounts, 0, (countFns + 1)*sizeof(Unt));
+    for (Int fnId = 0, j = 0; fnId < countFns && fns == null; fnId++) {
+        rt->fns[fnId] = j;
+        j += (Int)code[j] + 1;
+    }
+    // The pointer maps. Without them (e.g. no strings or lists in the program) frames have no roots
+    memset(rt->ptrMapInds, 0xFF, (countFns + 1)*sizeof(Int));
+    Int mapInd = 0;
+    for (Int k = 0; k < countFns && mapInd < ptrMapsLen; k++) {
+        rt->ptrMapInds[k] = mapInd;
+        mapInd += ptrMaps[mapInd] + 2;
+    }
+}
+
+private void
+rtStart(RT) { //:rtStart
+// Starts the heap after whatever "rtCreate" has put at its start, and the entry frame
+    rt->heapStart = rt->heapTop; // the static text isn't collected
+    rt->heapEnd = rt->heapStart + VM_HEAP_INIT_SIZE;
+    // The entry function returns to ip = -1, which ends the interpretation
+    setCallFrame(rt->currFrame, (CallHeader){.prevFrame = EYR_NULL, .ip = -1, .fnId = 0}, rt);
+    gcClearFrame(rt->currFrame, 0, rt);
+}
+
+private void
+initInterpreter(CM, OUT Interpreter* rt) { //:initInterpreter
+// Creates a VM for the compiled code
+    rtCreate(cm->bytecode.cont, null, rtCountFns(cm->bytecode.cont, cm->bytecode.len),
+             cm->ptrMaps.cont, cm->ptrMaps.len, rt);
+    if (rt->memory == null) {
+        return;
+    }
+    rtLoadStaticText(cm, rt);
+    rtStart(rt);
+}
+
+private void
+freeInterpreter(RT) { //:freeInterpreter
+// Unmaps the VM memory, the JIT code and the image, and deletes the arenas
+    if (rt->memory != null) {
+        munmap(rt->memory, VM_RESERVE_SIZE*sizeof(Unt));
+        rt->memory = null;
+    }
+    if (rt->a != null) {
+        deleteArena(rt->a);
+        rt->a = null;
+    }
+    if (rt->aCompiler != null) {
+        deleteArena(rt->aCompiler);
+        rt->aCompiler = null;
+    }
+#ifdef JIT
+    if (rt->jitBuf != null) {
+        munmap(rt->jitBuf, JIT_BUF_SIZE);
+        rt->jitBuf = null;
+    }
+#endif
+    if (rt->image != null) {
+        munmap(rt->image, rt->imageLen);
+        rt->image = null;
+    }
+}
+
+//}}}
+//{{{ Bytecode image
+
+// A compiled program in a file, to be run without compiling it again. The runtime maps the file
+// and runs the code right in the mapping. Layout: the header, the function table (@Interpreter.fns),
+// the code (8-aligned), the pointer maps and the static text with a \0 after it. All numbers are
+// in the byte order of the machine, so an image is only good on the kind of machine that wrote it
+
+#define IMAGE_MAGIC   0x49525945 // "EYRI"
+#define IMAGE_VERSION 2 // Must be bumped on any change of the instruction set or of this layout
+#define FNV_BASIS     0xCBF29CE484222325ULL
+#define FNV_PRIME     0x100000001B3ULL
+
+typedef struct { //:ImageHeader
+    Unt magic;
+    Unt version;
+    Unt countFns;
+    Unt codeLen;     // in instruction slots
+    Unt ptrMapsLen;
+    Unt textLen;     // without the \0
+    Ulong sourceLen; // of the program's source, without the "standardText"
+    Byte sourceHash[32]; // its SHA-256. The cache compares both, see "imgCacheLoad"
+    Ulong checksum;  // of everything after the header
+    Ulong headerChecksum; // of the fields above
+} ImageHeader;
+
+private Ulong
+hashFnv(Byte const* data, Ulong len, Ulong hash) { //:hashFnv
+// 64-bit FNV-1a. "hash" is FNV_BASIS to start, or the result for the previous chunk to continue
+    for (Ulong j = 0; j < len; j++) {
+        hash = (hash ^ data[j])*FNV_PRIME;
+    }
+    return hash;
+}
+
+private Unt
+sha256Rotr(Unt x, Int n) { //:sha256Rotr
+    return (x >> n) | (x << (32 - n));
+}
+
+private void
+sha256Block(Byte const* block, Arr(Unt) state) { //:sha256Block
+// Adds a 64-byte block to the state
+    static Unt const rounds[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+        0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+        0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+        0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+        0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+        0xc67178f2 };
+    Unt w[64];
+    for (Int j = 0; j < 16; j++) {
+        w[j] = ((Unt)block[4*j] << 24) | ((Unt)block[4*j + 1] << 16) | ((Unt)block[4*j + 2] << 8)
+             | block[4*j + 3];
+    }
+    for (Int j = 16; j < 64; j++) {
+        w[j] = w[j - 16] + w[j - 7]
+             + (sha256Rotr(w[j - 15], 7) ^ sha256Rotr(w[j - 15], 18) ^ (w[j - 15] >> 3))
+             + (sha256Rotr(w[j - 2], 17) ^ sha256Rotr(w[j - 2], 19) ^ (w[j - 2] >> 10));
+    }
+    Unt h[8];
+    memcpy(h, state, sizeof(h));
+    for (Int j = 0; j < 64; j++) {
+        Unt const t1 = h[7] + (sha256Rotr(h[4], 6) ^ sha256Rotr(h[4], 11) ^ sha256Rotr(h[4], 25))
+                     + ((h[4] & h[5]) ^ (~h[4] & h[6])) + rounds[j] + w[j];
+        Unt const t2 = (sha256Rotr(h[0], 2) ^ sha256Rotr(h[0], 13) ^ sha256Rotr(h[0], 22))
+                     + ((h[0] & h[1]) ^ (h[0] & h[2]) ^ (h[1] & h[2]));
+        memmove(h + 1, h, 7*sizeof(Unt));
+        h[4] += t1;
+        h[0] = t1 + t2;
+    }
+    for (Int k = 0; k < 8; k++) {
+        state[k] += h[k];
+    }
+}
+
+testable void
+sha256(Byte const* data, Ulong len, OUT Byte* digest) { //:sha256
+// The 32-byte SHA-256 of the data. Unlike "hashFnv", a different source can't be made to match it
+    Unt state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    Ulong j = 0;
+    for (; len - j >= 64; j += 64) {
+        sha256Block(data + j, state);
+    }
+    // The rest, then a 1 bit, zeros and the length in bits, in one or two blocks
+    Byte tail[128] = {0};
+    Ulong const rest = len - j;
+    memcpy(tail, data + j, rest);
+    tail[rest] = 0x80;
+    Int const tailLen = rest < 56 ? 64 : 128;
+    for (Int k = 0; k < 8; k++) {
+        tail[tailLen - 1 - k] = (Byte)((len*8) >> (8*k));
+    }
+    sha256Block(tail, state);
+    if (tailLen == 128) {
+        sha256Block(tail + 64, state);
+    }
+    for (Int k = 0; k < 32; k++) {
+        digest[k] = (Byte)(state[k/4] >> (24 - 8*(k % 4)));
+    }
+}
+
+private Ulong
+imgLayout(ImageHeader hdr, OUT Ulong* codeOffset, OUT Ulong* ptrMapsOffset,
+          OUT Ulong* textOffset) { //:imgLayout
+// The offsets of the sections in the image. Returns its size
+    *codeOffset = (sizeof(ImageHeader) + (Ulong)hdr.countFns*sizeof(Int) + 7)/8*8;
+    *ptrMapsOffset = *codeOffset + (Ulong)hdr.codeLen*sizeof(Ulong);
+    *textOffset = *ptrMapsOffset + (Ulong)hdr.ptrMapsLen*sizeof(Int);
+    return *textOffset + hdr.textLen + 1;
+}
+
+testable Bool
+writeImage(String fName, CM) { //:writeImage
+// Writes the compiled program as an image. @fName must be \0-terminated
+    Arr(Ulong) code = cm->bytecode.cont;
+    ImageHeader hdr = (ImageHeader){
+        .magic = IMAGE_MAGIC, .version = IMAGE_VERSION,
+        .countFns = rtCountFns(code, cm->bytecode.len), .codeLen = cm->bytecode.len,
+        .ptrMapsLen = cm->ptrMaps.len,
+        .textLen = cm->staticText != null ? cm->staticText->len : 0,
+        .sourceLen = cm->inpLength - (sizeof(standardText) - 1) };
+    sha256((Byte const*)cm->sourceCode + sizeof(standardText) - 1, hdr.sourceLen,
+           OUT hdr.sourceHash);
+    Ulong codeOffset;
+    Ulong ptrMapsOffset;
+    Ulong textOffset;
+    Ulong const size = imgLayout(hdr, OUT &codeOffset, OUT &ptrMapsOffset, OUT &textOffset);
+    Byte* image = allocateOnArena(size, cm->aTmp);
+    memset(image, 0, size);
+
+    Arr(Int) fns = (Arr(Int))(image + sizeof(ImageHeader));
+    for (Int fnId = 0, j = 0; fnId < (Int)hdr.countFns; fnId++) {
+        fns[fnId] = j;
+        j += (Int)code[j] + 1;
+    }
+    memcpy(image + codeOffset, code, hdr.codeLen*sizeof(Ulong));
+    memcpy(image + ptrMapsOffset, cm->ptrMaps.cont, hdr.ptrMapsLen*sizeof(Int));
+    if (hdr.textLen > 0) {
+        memcpy(image + textOffset, cm->staticText->cont, hdr.textLen);
+    }
+    hdr.checksum = hashFnv(image + sizeof(ImageHeader), size - sizeof(ImageHeader), FNV_BASIS);
+    hdr.headerChecksum = hashFnv((Byte*)&hdr, sizeof(ImageHeader) - sizeof(Ulong), FNV_BASIS);
+    memcpy(image, &hdr, sizeof(ImageHeader));
+
+    FILE* file = fopen(fName.cont, "wb");
+    if (file == null) {
+        return false;
+    }
+    Bool const wasWritten = fwrite(image, 1, size, file) == size;
+    return (fclose(file) == 0) && wasWritten;
+}
+
+private Bool
+imgIsInBounds(ImageHeader hdr, Byte const* image, Ulong codeOffset, Ulong ptrMapsOffset) {
+//:imgIsInBounds Whether the function table and the pointer maps stay inside their sections. The
+// checksums only catch accidents, and the VM trusts both tables, so they're checked before running.
+// The code itself isn't verified
+    if (hdr.codeLen > INT32_MAX || hdr.ptrMapsLen > INT32_MAX) {
+        return false;
+    }
+    Arr(Int) fns = (Arr(Int))(image + sizeof(ImageHeader));
+    Arr(Ulong) code = (Arr(Ulong))(image + codeOffset);
+    Ulong j = 0;
+    for (Unt fnId = 0; fnId < hdr.countFns; fnId++) { // every function starts with its length
+        if (j >= hdr.codeLen || fns[fnId] != (Int)j || code[j] >= hdr.codeLen - j) {
+            return false;
+        }
+        j += code[j] + 1;
+    }
+    if (j != hdr.codeLen) {
+        return false;
+    }
+    // Each map is [countSlots, firstSlot, slots...], see "rtCreate"
+    Arr(Int) ptrMaps = (Arr(Int))(image + ptrMapsOffset);
+    for (Ulong mapInd = 0; mapInd < hdr.ptrMapsLen; mapInd += ptrMaps[mapInd] + 2) {
+        if (hdr.ptrMapsLen - mapInd < 2 || ptrMaps[mapInd] < 0 || ptrMaps[mapInd + 1] < 0
+                || (Ulong)ptrMaps[mapInd] > hdr.ptrMapsLen - mapInd - 2) {
+            return false;
+        }
+        for (Int k = 0; k < ptrMaps[mapInd]; k++) {
+            if (ptrMaps[mapInd + 2 + k] < 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+private char const*
+imgValidate(Byte const* image, Ulong len) { //:imgValidate
+// Returns the error, or null if the image is fine
+    if (len < sizeof(ImageHeader)) {
+        return errImageCorrupt;
+    }
+    ImageHeader hdr;
+    memcpy(&hdr, image, sizeof(ImageHeader));
+    if (hdr.magic != IMAGE_MAGIC || hdr.version != IMAGE_VERSION) {
+        return errImageVersion;
+    }
+    Ulong codeOffset;
+    Ulong ptrMapsOffset;
+    Ulong textOffset;
+    if (hdr.headerChecksum != hashFnv(image, sizeof(ImageHeader) - sizeof(Ulong), FNV_BASIS)
+            || imgLayout(hdr, OUT &codeOffset, OUT &ptrMapsOffset, OUT &textOffset) != len
+            || hdr.checksum != hashFnv(image + sizeof(ImageHeader), len - sizeof(ImageHeader),
+                                       FNV_BASIS)
+            || image[len - 1] != '\0'
+            || !imgIsInBounds(hdr, image, codeOffset, ptrMapsOffset)) {
+        return errImageCorrupt;
+    }
+    return null;
+}
+
+private Interpreter
+loadImage(String fName) { //:loadImage
+// Maps an image and creates a VM over it, with nothing copied. The mapping is private, so the
+// pages the VM does write to (the JIT marks the compiled functions in the function table) get
+// copied by the kernel, and the file stays the same. @fName must be \0-terminated
+    Interpreter rt = (Interpreter){ .errMsg = empty };
+    int const fd = open(fName.cont, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ImageHeader)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        rt.errMsg = str(errImageRead);
+        return rt;
+    }
+    Ulong const len = (Ulong)st.st_size;
+    Byte* image = mmap(null, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        rt.errMsg = str(errImageRead);
+        return rt;
+    }
+    char const* err = imgValidate(image, len);
+    if (err != null) {
+        munmap(image, len);
+        rt.errMsg = str(err);
+        return rt;
+    }
+    ImageHeader hdr;
+    memcpy(&hdr, image, sizeof(ImageHeader));
+    Ulong codeOffset;
+    Ulong ptrMapsOffset;
+    Ulong textOffset;
+    imgLayout(hdr, OUT &codeOffset, OUT &ptrMapsOffset, OUT &textOffset);
+    rtCreate((Arr(Ulong))(image + codeOffset), (Arr(Int))(image + sizeof(ImageHeader)),
+             hdr.countFns, (Arr(Int))(image + ptrMapsOffset), hdr.ptrMapsLen, &rt);
+    if (rt.memory == null) {
+        munmap(image, len);
+        return rt;
+    }
+    rt.textStart = (char*)(image + textOffset);
+    rt.image = image;
+    rt.imageLen = len;
+    rtStart(&rt);
+    return rt;
+}
+
+private String
+imgCachePath(char const* sourceCode, Long lenSource, Arena* a) { //:imgCachePath
+// The file of the compilation cache for this source code, or empty if the cache is off.
+// The cache dir is $EYR_CACHE_DIR or else ~/.cache/eyr; an empty EYR_CACHE_DIR turns it off.
+// Files are named by the hash of the image version, of the compiler's own source (EYR_SOURCE_HASH,
+// which the Makefile sets) and of the program's source. That hash is only 64 bits, so a hit is
+// checked against the source too, see "imgCacheLoad". A compiler built without EYR_SOURCE_HASH
+// can't tell its versions apart, so it has no cache
+#ifndef EYR_SOURCE_HASH
+    return empty;
+#else
+    char const* dir = getenv("EYR_CACHE_DIR");
+    if (dir == null) {
+        char const* home = getenv("HOME");
+        if (home == null || home[0] == '\0') {
+            return empty;
+        }
+        mkdir(stringOfFormat(a, "%s/.cache", home).cont, 0755);
+        dir = stringOfFormat(a, "%s/.cache/eyr", home).cont;
+    }
+    if (dir[0] == '\0') {
+        return empty;
+    }
+    mkdir(dir, 0755); // fails harmlessly if it exists
+    Unt const imageVersion = IMAGE_VERSION;
+    Ulong hash = hashFnv((Byte const*)&imageVersion, sizeof(Unt), FNV_BASIS);
+    hash = hashFnv((Byte const*)EYR_SOURCE_HASH, sizeof(EYR_SOURCE_HASH) - 1, hash);
+    hash = hashFnv((Byte const*)sourceCode, lenSource, hash);
+    return stringOfFormat(a, "%s/%016llx.eyri", dir, (unsigned long long)hash);
+#endif
 }
 
-private void
-tabulateBuiltins() { //:tabulateBuiltins
-    //BuiltinFn* p = BUILTINS_TABLE;
-    //p[0]         = &buiToStringInt;
+private Interpreter
+imgCacheLoad(String path, char const* sourceCode, Long lenSource) { //:imgCacheLoad
+// Loads the cached image, but only if it was compiled from this very source: the length and the
+// SHA-256 in its header must match. Anything else is a miss, with an error in @errMsg
+    Interpreter rt = loadImage(path);
+    if (rt.errMsg.len > 0) {
+        return rt;
+    }
+    ImageHeader hdr;
+    memcpy(&hdr, rt.image, sizeof(ImageHeader));
+    Byte sourceHash[32];
+    sha256((Byte const*)sourceCode, lenSource, OUT sourceHash);
+    if (hdr.sourceLen != (Ulong)lenSource || memcmp(hdr.sourceHash, sourceHash, 32) != 0) {
+        freeInterpreter(&rt);
+        rt = (Interpreter){ .errMsg = str(errImageStale) };
+    }
+    return rt;
 }
 
 private void
-initInterpreter(CM, OUT Interpreter* rt) { //:initInterpreter
-    Arena* a = cm->a;
-    (*rt) = (Interpreter)  {
-        .memory = allocateArray(1000000, Unt, a),
-        .fns = allocateArray(100, Int, a),
-        .heapTop = 50000,  // skipped the 200k of stack space
-        .currFrame = 0,
-        .textStart = 0,
-        .code = cm->bytecode.cont
-    };
-
-    tmpGetText(rt);
-    rt->fns[0] = 0;
-    setCallFrame(rt->currFrame, (CallHeader){.prevFrame = EYR_NULL, .ip = 0, .fnId = 0}, rt);
+imgCacheStore(String path, CM) { //:imgCacheStore
+// Writes to a temp file and renames it, so concurrent runs never see a partly written image.
+// The temp name is unique even among the threads of one process
+    String tmp = stringOfFormat(cm->aTmp, "%s.XXXXXX", path.cont);
+    int const fd = mkstemp((char*)tmp.cont);
+    if (fd < 0) {
+        return;
+    }
+    Bool const isReadable = fchmod(fd, 0644) == 0; // mkstemp makes it private to the user
+    close(fd);
+    if (isReadable && writeImage(tmp, cm) && rename(tmp.cont, path.cont) == 0) {
+        return;
+    }
+    unlink(tmp.cont);
 }
 
 //}}}
@@ -6170,20 +11376,23 @@ initInterpreter(CM, OUT Interpreter* rt) { //:initInterpreter
 //{{{ Init
 
 private void
-initCompiler() { //:initCompiler
-// Definition of the operators, lexer dispatch, parser dispatch etc tables for the compiler.
-// This function should only be called once, at compiler init.
-// Its results are global shared const.
-    static_assert(sizeof(CallHeader) == 12, "CallHeader should be 12 bytes to align right");
-    static_assert(sizeof(TypeHeader) == 8, "Sizeof TypeHeader must be 8");
-    if (_wasInit) {
-        return;
-    }
+initCompilerOnce(void) { //:initCompilerOnce
     populateStandardOffsets();
     tabulateLexer();
+    chooseLexScanners();
     Arena* aGlobal = createArena(); // it's ok to leak it. Will be cleaned up on process exit
     createProtoCompiler(&PROTO, aGlobal);
-    _wasInit = true;
+}
+
+private void
+initCompiler() { //:initCompiler
+// Definition of the operators, lexer dispatch, parser dispatch etc tables for the compiler.
+// They're built only once per process, even when many threads compile at the same time.
+// The results are global shared const.
+    static_assert(sizeof(CallHeader) == 12, "CallHeader should be 12 bytes to align right");
+    static_assert(sizeof(TypeHeader) == 8, "Sizeof TypeHeader must be 8");
+    static_assert(sizeof(SourceLoc) == 8, "SourceLoc must stay 8 bytes, see \"locAt\"");
+    pthread_once(&_initOnce, &initCompilerOnce);
 }
 
 //}}}
@@ -6214,16 +11423,19 @@ private void printStackInt(StackInt* st) { //:printStackInt
 }
 
 
-void printNameAndLen(Unt unsign, CM) { //:printNameAndLen
-    Int startBt = unsign & LOWER24BITS;
-    Int len = (unsign >> 24) & 0xFF;
-    fwrite(cm->sourceCode.cont + startBt, 1, len, stdout);
+void printNameAndLen(NameLoc name, CM) { //:printNameAndLen
+// The names of type headers are NameLocs (see "stToFullName"), or -1 for the anonymous types
+    if (name == (NameLoc)-1) {
+        printf("<anon>");
+        return;
+    }
+    fwrite(cm->sourceCode + nameLocStart(name), 1, nameLocLen(name), stdout);
 }
 
 
 void printName(NameId nameId, CM) { //:printName
-    Unt unsign = cm->stringTable->cont[nameId];
-    printNameAndLen(unsign, cm);
+    NameSpan const span = cm->stringTable->cont[nameId];
+    fwrite(cm->sourceCode + nameSpanStart(span), 1, nameSpanLen(span), stdout);
     printf("\n");
 }
 
@@ -6475,7 +11687,7 @@ Int
 getBinding(Int id, CM) { return cm->activeBindings[id]; }
 
 void
-setLoc(SourceLoc loc, CM) { cm->sourceLocs->cont[j] = loc; }
+setLoc(Int j, SourceLoc loc, CM) { cm->sourceLocs->cont[j] = loc; }
 
 void
 addTypeHeaderForTestFunction(Int arity, CM) {
@@ -6496,8 +11708,8 @@ equalityParser(/* test specimen */Compiler* a, /* expected */Compiler* b, Bool c
     int commonLength = statsA.nodesLen < statsB.nodesLen ? statsA.nodesLen : statsB.nodesLen;
     int i = 0;
     for (; i < commonLength; i++) {
-        Node nodA = a.nodes.cont[i];
-        Node nodB = b.nodes.cont[i];
+        Node nodA = a->nodes.cont[i];
+        Node nodB = b->nodes.cont[i];
         if (nodA.tp != nodB.tp
             || nodA.pl1 != nodB.pl1 || nodA.pl2 != nodB.pl2 || nodA.pl3 != nodB.pl3) {
             printf("\n\nUNEQUAL RESULTS on %d\n", i);
@@ -6518,21 +11730,22 @@ equalityParser(/* test specimen */Compiler* a, /* expected */Compiler* b, Bool c
     }
     if (compareLocsToo) {
         for (i = 0; i < commonLength; ++i) {
-            SourceLoc locA = a.sourceLocs->cont[i];
-            SourceLoc locB = b.sourceLocs->cont[i];
+            SourceLoc locA = a->sourceLocs->cont[i];
+            SourceLoc locB = b->sourceLocs->cont[i];
             if (locA.startBt != locB.startBt || locA.lenBts != locB.lenBts) {
                 printf("\n\nUNEQUAL SOURCE LOCS on %d\n", i);
                 if (locA.lenBts != locB.lenBts) {
                     printf("Diff in lenBts, %d but was expected %d\n", locA.lenBts, locB.lenBts);
                 }
                 if (locA.startBt != locB.startBt) {
-                    printf("Diff in startBt, %d but was expected %d\n", locA.startBt, locB.startBt);
+                    printf("Diff in startBt, %lld but was expected %lld\n",
+                           (long long)locA.startBt, (long long)locB.startBt);
                 }
                 return i;
             }
         }
     }
-    return (a.nodes.len == b.nodes.len) ? -2 : i;
+    return (a->nodes.len == b->nodes.len) ? -2 : i;
 }
 
 //}}}
@@ -6710,46 +11923,127 @@ void dbgCallFrames(RT) { //:dbgCallFrame
 //}}}
 //{{{ Main
 
+private Compiler*
+compileBytecode(Compiler* cm, OUT String* errMsg, Arena* a) { //:compileBytecode
+// Parses and generates the code of a lexed program. Returns null in case of error
+    if (cm->stats.wasLexerError) {
+        *errMsg = str("lexer error");
+        return null;
+    }
+
+    cm = parse(cm, a);
+    if (cm->stats.wasError) {
+        *errMsg = str("parse error");
+        return null;
+    }
+    genBytecode(false, cm);
+    if (cm->stats.wasError) {
+        *errMsg = cm->stats.errMsg;
+        return null;
+    }
+    fuseSuperinstructions(cm);
+    return cm;
+}
+
 private Interpreter
 compile(String sourceCode) { //:compile
     Interpreter rt = (Interpreter){ .errMsg = empty };
     if (sourceCode.len == 0) {
         return rt;
     }
-    initCompiler();
     Arena* a = createArena();
-    Compiler* cm = lexicallyAnalyze(sourceCode, a);
-    if (cm->stats.wasLexerError) {
-        rt.errMsg = str("lexer error");
-        return rt;
-    }
-
-    cm = parse(cm, a);
-    if (cm->stats.wasError) {
-        rt.errMsg = str("parse error");
+    Compiler* lx = lexicallyAnalyze(sourceCode, a);
+    Compiler* cm = compileBytecode(lx, OUT &rt.errMsg, a);
+    deleteArena(lx->aTmp);
+    if (cm == null) {
+        deleteArena(a);
         return rt;
     }
-
     initInterpreter(cm, &rt);
+    rt.aCompiler = a; // the code is in it
     return rt;
 }
 
 private Interpreter
 compileFile(String fn) { //:eyrCompileFile
+// Goes through the compilation cache (see "imgCachePath"): a hit maps the stored image instead
+// of compiling, and a miss compiles and stores the image, and then runs it like a hit would
     Interpreter rt = (Interpreter){ .errMsg = empty };
     if (fn.len == 0) {
         return rt;
     }
     initCompiler();
     Arena* a = createArena();
-    String sourceCode = readSourceFile(fn, a);
+    SourceMap sourceMap = mapSourceFile(fn);
+    if (sourceMap.inpLength == 0) {
+        rt.errMsg = str("could not read the source file");
+        goto cleanup;
+    }
+    Int const lenStandard = sizeof(standardText) - 1;
+    char const* source = sourceMap.input + lenStandard;
+    Long const lenSource = sourceMap.inpLength - lenStandard;
+    String cachePath = imgCachePath(source, lenSource, a);
+    if (cachePath.len > 0) {
+        rt = imgCacheLoad(cachePath, source, lenSource);
+        if (rt.errMsg.len == 0) {
+            goto cleanup;
+        }
+        rt = (Interpreter){ .errMsg = empty }; // a miss, or a bad image which gets overwritten
+    }
+    Arena* aCompiler = createArena();
+    Compiler* lx = lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, aCompiler);
+    Compiler* cm = compileBytecode(lx, OUT &rt.errMsg, aCompiler);
+    if (cm != null && cachePath.len > 0) {
+        imgCacheStore(cachePath, cm);
+        rt = imgCacheLoad(cachePath, source, lenSource);
+    }
+    if (cm != null && (cachePath.len == 0 || rt.errMsg.len > 0)) { // not stored
+        rt = (Interpreter){ .errMsg = empty };
+        initInterpreter(cm, &rt);
+        rt.aCompiler = aCompiler; // the code is in it
+    }
+    deleteArena(lx->aTmp);
+    if (rt.aCompiler == null) {
+        deleteArena(aCompiler);
+    }
+    cleanup:
+    unmapSourceFile(sourceMap);
     deleteArena(a);
-    return compile(sourceCode);
+    return rt;
+}
+
+private Bool
+interpretBounded(Long maxSteps, RT) { //:interpretBounded
+// Runs at most "maxSteps" instructions, for code that may not terminate. Returns false if they ran
+// out. The function table is used in both dispatch modes, and nothing gets compiled by the JIT
+// because native code doesn't count the steps
+    if (rt->countFns == 0 || setjmp(rt->excBuf) != 0) {
+        return true; // nothing to run, or a runtime error (it's in @errMsg)
+    }
+    _rtCurrent = rt;
+    for (Int k = 0; k <= rt->countFns; k++) {
+        rt->callCounts[k] = JIT_THRESHOLD + 1;
+    }
+    Int ip = rt->ip;
+    for (Long step = 0; ip > -1; step++) {
+        if (step == maxSteps) {
+            return false;
+        }
+        Ulong instr = rt->code[ip];
+        ip = (INTERPRETER_TABLE[instr >> 58])(instr, ip, rt);
+    }
+    return true;
 }
 
+#ifndef DIRECT_THREADED
+
 private void
-interpretCode(RT) {
-    Int ip = 1; // skipping the function size
+interpretCode(RT) { //:interpretCode
+    if (rt->countFns == 0 || setjmp(rt->excBuf) != 0) {
+        return; // nothing to run, or a runtime error (it's in @errMsg)
+    }
+    _rtCurrent = rt;
+    Int ip = rt->ip;
     while (ip > -1) {
         //print("ip = %d", ip);
         Ulong instr = rt->code[ip];
@@ -6758,34 +12052,705 @@ interpretCode(RT) {
     }
 }
 
+#else
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic" // labels as values are a GNU extension
+
+#define DISPATCH instr = rt->code[ip]; goto *DISPATCH_TABLE[instr >> 58];
+#define HANDLE(label, handler) label: ip = handler(instr, ip, rt); DISPATCH
+
+private void
+interpretCode(RT) { //:interpretCode
+// Direct-threaded version of the main loop (GCC labels-as-values). Every handler is called
+// directly, so it gets inlined here, and ends with its own indirect jump to the next handler.
+// That gives the branch predictor one jump site per opcode instead of the single shared one
+    static void* const DISPATCH_TABLE[64] = {
+        [0 ... 63]       = &&lUnknown,
+        [iPlus]          = &&lPlus,
+        [iTimes]         = &&lTimes,
+        [iMinus]         = &&lMinus,
+        [iDivBy]         = &&lDivBy,
+        [iPlusConst]     = &&lPlusConst,
+        [iMinusConst]    = &&lMinusConst,
+        [iTimesConst]    = &&lTimesConst,
+        [iDivByConst]    = &&lDivByConst,
+        [iShiftLeftConst] = &&lShiftLeftConst,
+        [iDivByPow2Const] = &&lDivByPow2Const,
+        [iRemPow2Const]  = &&lRemPow2Const,
+        [iNewstring]     = &&lNewString,
+        [iConcatStrs]    = &&lConcatStrings,
+        [iReverseString] = &&lReverseString,
+        [iSetLocal]      = &&lSetLocal,
+        [iMove]          = &&lMove,
+        [iBuiltinCall]   = &&lBuiltinCall,
+        [iCall]          = &&lCall,
+        [iReturn]        = &&lReturn,
+        [iPrint]         = &&lPrint,
+        [iJump]          = &&lJump,
+        [iBranchLt]      = &&lBranchLt,
+        [iBranchEq]      = &&lBranchEq,
+        [iBranchGt]      = &&lBranchGt,
+        [iMinusBranchLt] = &&lMinusBranchLt,
+        [iMinusBranchEq] = &&lMinusBranchEq,
+        [iMinusBranchGt] = &&lMinusBranchGt,
+        [iSetLocalPlusConst] = &&lSetLocalPlusConst,
+        [iSetLocalCall]  = &&lSetLocalCall,
+        [iNewList]       = &&lNewList,
+        [iNewPtrList]    = &&lNewPtrList,
+        [iNewStackList]  = &&lNewStackList,
+        [iTailCall]      = &&lTailCall,
+        [iGetFld]        = &&lGetFld,
+        [iGetElem]       = &&lGetElem,
+        [iGetElemUnchecked] = &&lGetElemUnchecked,
+        [iSetElem]       = &&lSetElem,
+        [iSetElemUnchecked] = &&lSetElemUnchecked
+    };
+    if (rt->countFns == 0 || setjmp(rt->excBuf) != 0) {
+        return; // nothing to run, or a runtime error (it's in @errMsg)
+    }
+    _rtCurrent = rt;
+    Unt ip = rt->ip;
+    Ulong instr;
+    DISPATCH
+
+    HANDLE(lPlus, runPlus)
+    HANDLE(lTimes, runTimes)
+    HANDLE(lMinus, runMinus)
+    HANDLE(lDivBy, runDivBy)
+    HANDLE(lPlusConst, runPlusConst)
+    HANDLE(lMinusConst, runMinusConst)
+    HANDLE(lTimesConst, runTimesConst)
+    HANDLE(lDivByConst, runDivByConst)
+    HANDLE(lShiftLeftConst, runShiftLeftConst)
+    HANDLE(lDivByPow2Const, runDivByPow2Const)
+    HANDLE(lRemPow2Const, runRemPow2Const)
+    HANDLE(lNewString, runNewString)
+    HANDLE(lConcatStrings, runConcatStrings)
+    HANDLE(lReverseString, runReverseString)
+    HANDLE(lSetLocal, runSetLocal)
+    HANDLE(lMove, runMove)
+    HANDLE(lBuiltinCall, runBuiltinCall)
+    HANDLE(lCall, runCall)
+    HANDLE(lPrint, runPrint)
+    HANDLE(lJump, runJump)
+    HANDLE(lBranchLt, runBranchLt)
+    HANDLE(lBranchEq, runBranchEq)
+    HANDLE(lBranchGt, runBranchGt)
+    HANDLE(lMinusBranchLt, runMinusBranchLt)
+    HANDLE(lMinusBranchEq, runMinusBranchEq)
+    HANDLE(lMinusBranchGt, runMinusBranchGt)
+    HANDLE(lSetLocalPlusConst, runSetLocalPlusConst)
+    HANDLE(lSetLocalCall, runSetLocalCall)
+    HANDLE(lNewList, runNewList)
+    HANDLE(lNewPtrList, runNewPtrList)
+    HANDLE(lNewStackList, runNewStackList)
+    HANDLE(lGetFld, runGetFld)
+    HANDLE(lGetElem, runGetElem)
+    HANDLE(lGetElemUnchecked, runGetElemUnchecked)
+    HANDLE(lSetElem, runSetElem)
+    HANDLE(lSetElemUnchecked, runSetElemUnchecked)
+
+    lReturn:
+    ip = runReturn(instr, ip, rt);
+    if (ip == (Unt)-1) { // returned from "main"
+        return;
+    }
+    DISPATCH
+
+    lTailCall:
+    ip = runTailCall(instr, ip, rt);
+    if (ip == (Unt)-1) { // a native callee has returned from "main"
+        return;
+    }
+    DISPATCH
+
+    lUnknown:
+    rt->errMsg = str("unknown instruction");
+}
+
+#undef HANDLE
+#undef DISPATCH
+
+#pragma GCC diagnostic pop
+
+#endif
+
+testable Unt
+rtCallFunction(Unt fnId, Arr(Unt) args, Int countArgs, RT) { //:rtCallFunction
+// Runs a function to completion on an idle interpreter, in the bottom stack frame (so it returns to
+// ip = -1 like the entry function). Returns the first word of the result. Errors are in @errMsg
+    rt->errMsg = empty;
+    rt->currFrame = 0;
+    setCallFrame(0, (CallHeader){.prevFrame = EYR_NULL, .ip = -1, .fnId = fnId}, rt);
+    memmove(rt->memory + stackFrameStart, args, countArgs*sizeof(Unt)); // "args" may be in place
+    gcClearFrame(0, fnId, rt);
+#ifdef JIT
+    if (rt->fns[fnId] == -1) {
+        if (setjmp(rt->excBuf) == 0) {
+            _rtCurrent = rt;
+            rtRunNative(fnId, 0, 0, rt);
+        }
+        return rt->memory[0];
+    }
+#endif
+    rt->ip = rt->fns[fnId] + 1; // +1 for the function length
+    interpretCode(rt);
+    return rt->memory[0];
+}
+
 void
-eyrRunFile(String filename) {
-    
+eyrRunFile(String filename) { //:eyrRunFile
+    Interpreter rt = compileFile(filename);
+    if (rt.errMsg.len == 0) {
+        interpretCode(&rt);
+    }
+    printString(rt.errMsg);
+    freeInterpreter(&rt);
 }
 
 void
 eyrRun(String sourceCode) {
     Interpreter rt = compile(sourceCode);
-    if (rt.errMsg.len > 0) {
-        printString(rt.errMsg);
+    if (rt.errMsg.len == 0) {
+        interpretCode(&rt);
+    }
+    printString(rt.errMsg);
+    freeInterpreter(&rt);
+}
+
+void
+eyrCompileToImage(String filename, String outFilename) { //:eyrCompileToImage
+// Compiles a source file to a bytecode image, see "writeImage". Both names must be \0-terminated
+    Arena* a = createArena();
+    SourceMap sourceMap = mapSourceFile(filename);
+    if (sourceMap.inpLength == 0) {
+        print("could not read the source file");
+        goto cleanup;
+    }
+    String errMsg = empty;
+    Compiler* cm = compileBytecode(lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, a),
+                                   OUT &errMsg, a);
+    if (cm == null) {
+        printString(errMsg);
+        goto cleanup;
+    }
+    if (!writeImage(outFilename, cm)) {
+        print("could not write the output file");
+    }
+    cleanup:
+    unmapSourceFile(sourceMap);
+    deleteArena(a);
+}
+
+void
+eyrRunImage(String filename) { //:eyrRunImage
+    Interpreter rt = loadImage(filename);
+    if (rt.errMsg.len == 0) {
+        interpretCode(&rt);
+    }
+    printString(rt.errMsg);
+    freeInterpreter(&rt);
+}
+
+Int
+eyrCheckFile(String filename) { //:eyrCheckFile
+// Lexes, parses and typechecks a source file without generating any code. Prints the error, if any.
+// Returns 0 if the file is fine, else 1, for the exit status of "eyr --check"
+    Int result = 1;
+    Arena* a = createArena();
+    SourceMap sourceMap = mapSourceFile(filename);
+    if (sourceMap.inpLength == 0) {
+        print("could not read the source file");
+        goto cleanup;
+    }
+    Compiler* cm = lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, a);
+    if (!cm->stats.wasLexerError) {
+        cm = parse(cm, a);
+    }
+    printString(cm->stats.errMsg);
+    result = cm->stats.wasLexerError || cm->stats.wasError ? 1 : 0;
+    deleteArena(cm->aTmp);
+    cleanup:
+    unmapSourceFile(sourceMap);
+    deleteArena(a);
+    return result;
+}
+
+private void
+benchLexer(String filename) { //:benchLexer
+// Prints the throughput of the lexer on a source file, the best of 5 runs. For "make benchLexer"
+    SourceMap sourceMap = mapSourceFile(filename);
+    if (sourceMap.inpLength == 0) {
+        print("could not read the source file");
         return;
     }
-    interpretCode(&rt);    
+    double best = 1e9;
+    for (Int k = 0; k < 5; k++) {
+        Arena* a = createArena();
+        struct timespec start;
+        struct timespec finish;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Compiler* lx = lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, a);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        double const secs = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec)*1e-9;
+        best = secs < best ? secs : best;
+        printString(lx->stats.errMsg);
+        deleteArena(lx->aTmp);
+        deleteArena(a);
+    }
+    double const mb = sourceMap.inpLength/1048576.0;
+    printf("lexed %.1f MB at %.0f MB/s\n", mb, mb/best);
+    unmapSourceFile(sourceMap);
+}
+
+private void
+benchDispatchRun(char const* name, Arr(Ulong) code, Int codeLen) { //:benchDispatchRun
+// Prints the best of 3 runs of a hand-assembled program and its result
+    double best = 1e9;
+    Unt result = 0;
+    for (Int k = 0; k < 3; k++) {
+        Arena* a = createArena();
+        Compiler* cm = allocateOnArena(sizeof(Compiler), a);
+        (*cm) = (Compiler){ .a = a, .aTmp = a };
+        cm->bytecode = createInListUlong(codeLen, a);
+        cm->ptrMaps = createInListInt(1, a);
+        cm->staticText = createStringBuilder(16, a);
+        for (Int j = 0; j < codeLen; j++) {
+            pushInbytecode(code[j], cm);
+        }
+        Interpreter rt;
+        initInterpreter(cm, &rt);
+        struct timespec start;
+        struct timespec finish;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        interpretCode(&rt);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        double const secs = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec)*1e-9;
+        best = secs < best ? secs : best;
+        result = rt.memory[0];
+        printString(rt.errMsg);
+        freeInterpreter(&rt);
+        deleteArena(a);
+    }
+    printf("%s = %u in %.3f s\n", name, result, best);
+}
+
+private void
+benchDispatch(void) { //:benchDispatch
+// Times the interpreter loop on hand-assembled bytecode, so the parser isn't involved. The two
+// programs are the examples fibonacci.eyr and nestedLoops.eyr. For "make benchDispatch"
+    Ulong fibonacci[] = {
+        3, bcInstr2(iSetLocal, 6, 32), bcInstr2(iCall, 3, 1), bcInstr2(iReturn, 3, 1),
+        11, // fib(n) with n in slot 3. The callees' frames are at slots 5 and 6
+        bcInstr3(iMove, 4, 3, 0), bcInstr2(iMinusConst, 4, 2), bcInstr2(iBranchLt, 4, 15),
+        bcInstr3(iMove, 8, 3, 0), bcInstr2(iMinusConst, 8, 1), bcInstr2(iCall, 5, 1),
+        bcInstr3(iMove, 9, 3, 0), bcInstr2(iMinusConst, 9, 2), bcInstr2(iCall, 6, 1),
+        bcInstr3(iPlus, 3, 5, 6), bcInstr2(iReturn, 3, 1) };
+    Ulong nestedLoops[] = {
+        9, // 10000 times, add up 1..10000
+        bcInstr2(iSetLocal, 3, 10000), bcInstr2(iSetLocal, 5, 0), bcInstr2(iSetLocal, 4, 10000),
+        bcInstr3(iPlus, 5, 5, 4), bcInstr2(iMinusConst, 4, 1), bcInstr2(iBranchGt, 4, 4),
+        bcInstr2(iMinusConst, 3, 1), bcInstr2(iBranchGt, 3, 3), bcInstr2(iReturn, 5, 1) };
+    benchDispatchRun("fib(32)", fibonacci, sizeof(fibonacci)/sizeof(Ulong));
+    benchDispatchRun("nested loops", nestedLoops, sizeof(nestedLoops)/sizeof(Ulong));
+}
+
+//{{{ Embedding
+
+struct EyrProgram { //:EyrProgram
+    Compiler* cm; // lives in @a, together with the bytecode. Its @aTmp is freed with the program
+    Arena* a;
+};
+
+EyrProgram*
+eyrCompile(String sourceCode, OUT String* errMsg) { //:eyrCompile
+// Compiles once for any number of calls. Returns null in case of error
+    *errMsg = empty;
+    initCompiler();
+    Arena* a = createArena();
+    Compiler* cm = lexicallyAnalyze(sourceCode, a);
+    if (cm->stats.wasLexerError) {
+        *errMsg = str("lexer error");
+        goto failure;
+    }
+    cm = parse(cm, a);
+    if (cm->stats.wasError) {
+        *errMsg = str("parse error");
+        goto failure;
+    }
+    genBytecode(true, cm);
+    if (cm->stats.wasError) {
+        *errMsg = cm->stats.errMsg;
+        goto failure;
+    }
+    fuseSuperinstructions(cm);
+    EyrProgram* prog = allocate(EyrProgram, a);
+    (*prog) = (EyrProgram){ .cm = cm, .a = a };
+    return prog;
+
+    failure:
+    deleteArena(cm->aTmp);
+    deleteArena(a);
+    return null;
+}
+
+void
+eyrFreeProgram(EyrProgram* prog) { //:eyrFreeProgram
+// The interpreters of this program must be freed first
+    deleteArena(prog->cm->aTmp);
+    deleteArena(prog->a);
+}
+
+Interpreter*
+eyrCreateInterpreter(EyrProgram* prog) { //:eyrCreateInterpreter
+// Returns null if the VM memory couldn't be reserved
+    Interpreter* rt = malloc(sizeof(Interpreter));
+    initInterpreter(prog->cm, rt);
+    if (rt->memory == null) {
+        free(rt);
+        return null;
+    }
+    return rt;
+}
+
+void
+eyrFreeInterpreter(Interpreter* rt) { //:eyrFreeInterpreter
+    freeInterpreter(rt);
+    free(rt);
+}
+
+Int
+eyrFindFunction(EyrProgram* prog, String name, Int countArgs) { //:eyrFindFunction
+// Returns the id of the toplevel function with this name and arity, or -1 if there's none.
+// Function ids are indices into @toplevels, which is also the order of functions in the bytecode
+    Compiler* cm = prog->cm;
+    for (Int k = 0; k < cm->toplevels.len; k++) {
+        Assignment fn = cm->toplevels.cont[k];
+        if (!fn.isFunction || tGetFnArity(cm->entities.cont[fn.entityId].typeId, cm) != countArgs) {
+            continue;
+        }
+        NameSpan const span = cm->stringTable->cont[fn.nameId];
+        if (nameSpanLen(span) == name.len
+                && memcmp(cm->sourceCode + nameSpanStart(span), name.cont, name.len) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+private EyrValue
+eyrError(char const* msg) { //:eyrError
+    return (EyrValue){ .tag = EYR_ERROR, .str = str(msg) };
+}
+
+private Int
+eyrTagOfType(TypeId tp) { //:eyrTagOfType
+    if (tp == tokInt) {
+        return EYR_INT;
+    } ei (tp == tokBool) {
+        return EYR_BOOL;
+    } ei (tp == tokString) {
+        return EYR_STRING;
+    } ei (tp == tokMisc) {
+        return EYR_VOID;
+    }
+    return EYR_ERROR;
+}
+
+EyrValue
+eyrCall(EyrProgram* prog, Int fnId, EyrValue const* args, Int countArgs, Interpreter* rt) {
+//:eyrCall Calls a function of the program on an idle interpreter created from it. The args are
+// checked against the function's param types. String args are copied into the VM heap
+    Compiler* cm = prog->cm;
+    if (rt->code != cm->bytecode.cont) {
+        return eyrError("the interpreter belongs to another program");
+    }
+    if (fnId < 0 || fnId >= cm->toplevels.len || fnId >= rt->countFns) {
+        return eyrError("no such function");
+    }
+    TypeId const fnType = cm->entities.cont[cm->toplevels.cont[fnId].entityId].typeId;
+    if (tGetFnArity(fnType, cm) != countArgs) {
+        return eyrError("wrong number of arguments");
+    }
+    Int const paramInd = tGetIndexOfFnFirstParam(fnType, cm);
+    for (Int k = 0; k < countArgs; k++) {
+        if (eyrTagOfType(cm->types.cont[paramInd + k]) != args[k].tag) {
+            return eyrError("wrong argument type");
+        }
+    }
+    Int const resultTag = eyrTagOfType(getFunctionReturnType(fnType, cm));
+    if (resultTag == EYR_ERROR) {
+        return eyrError("unsupported return type");
+    }
+
+    // The args go right into the bottom frame, where the string ones are GC roots while the
+    // others are being allocated
+    rt->currFrame = 0;
+    setCallFrame(0, (CallHeader){.prevFrame = EYR_NULL, .ip = -1, .fnId = fnId}, rt);
+    memset(rt->memory + stackFrameStart, 0, countArgs*sizeof(Unt));
+    gcClearFrame(0, fnId, rt);
+    if (setjmp(rt->excBuf) != 0) {
+        return (EyrValue){ .tag = EYR_ERROR, .str = rt->errMsg };
+    }
+    _rtCurrent = rt;
+    Arr(Unt) frameArgs = rt->memory + stackFrameStart;
+    for (Int k = 0; k < countArgs; k++) {
+        if (args[k].tag == EYR_STRING) {
+            EyrPtr newStr = rtNewString(args[k].str.len, rt);
+            memcpy(rtStringChars(newStr, rt), args[k].str.cont, args[k].str.len);
+            frameArgs[k] = newStr;
+        } else {
+            frameArgs[k] = (Unt)args[k].i;
+        }
+    }
+
+    Unt const result = rtCallFunction(fnId, frameArgs, countArgs, rt);
+    if (rt->errMsg.len > 0) {
+        return (EyrValue){ .tag = EYR_ERROR, .str = rt->errMsg };
+    } ei (resultTag == EYR_STRING) {
+        return (EyrValue){ .tag = EYR_STRING,
+                           .str = { .cont = rtStringChars(result, rt), .len = rtDeref(result) } };
+    } ei (resultTag == EYR_VOID) {
+        return (EyrValue){ .tag = EYR_VOID };
+    }
+    return (EyrValue){ .tag = resultTag, .i = (Int)result };
+}
+
+// A thread pool where every thread has its own interpreter over the program's shared bytecode.
+// Each job runs inside a region of its interpreter, so the heap is reset between jobs
+
+typedef struct EyrJob EyrJob;
+struct EyrJob { //:EyrJob
+    EyrJob* next;
+    Int fnId;
+    EyrValue* result;
+    Int countArgs;
+    EyrValue args[];
+};
+
+struct EyrPool { //:EyrPool
+    EyrProgram* prog;
+    pthread_mutex_t lock;
+    pthread_cond_t hasJobs; // signalled on submit and on closing
+    pthread_cond_t allDone; // signalled when @countPending drops to 0
+    EyrJob* head; // the queue of jobs not yet taken by a thread
+    EyrJob* tail;
+    Int countPending; // submitted but not finished
+    Bool isClosing;
+    Int countThreads;
+    pthread_t threads[];
+};
+
+private EyrJob*
+poolTakeJob(EyrPool* pool) { //:poolTakeJob
+// Blocks until there's a job. Returns null when the pool is closing and the queue is empty
+    pthread_mutex_lock(&pool->lock);
+    while (pool->head == null && !pool->isClosing) {
+        pthread_cond_wait(&pool->hasJobs, &pool->lock);
+    }
+    EyrJob* job = pool->head;
+    if (job != null) {
+        pool->head = job->next;
+        if (pool->head == null) {
+            pool->tail = null;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+private void*
+poolWorker(void* arg) { //:poolWorker
+    EyrPool* pool = (EyrPool*)arg;
+    Interpreter* rt = eyrCreateInterpreter(pool->prog);
+    RtRegion region;
+    if (rt != null) {
+        region = rtRegionMark(rt);
+    }
+    for (EyrJob* job = poolTakeJob(pool); job != null; job = poolTakeJob(pool)) {
+        EyrValue result = rt == null
+                        ? eyrError(errOutOfMemory)
+                        : eyrCall(pool->prog, job->fnId, job->args, job->countArgs, rt);
+        if (result.tag == EYR_STRING) { // copied out, because the VM memory is reset below
+            char* cont = malloc(result.str.len + 1);
+            memcpy(cont, result.str.cont, result.str.len);
+            cont[result.str.len] = '\0';
+            result.str.cont = cont;
+        }
+        *job->result = result;
+        if (rt != null) {
+            rtRegionReset(region, rt);
+        }
+        free(job);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->countPending -= 1;
+        if (pool->countPending == 0) {
+            pthread_cond_broadcast(&pool->allDone);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    if (rt != null) {
+        rtRegionEnd(region, rt);
+        eyrFreeInterpreter(rt);
+    }
+    return null;
+}
+
+EyrPool*
+eyrCreatePool(EyrProgram* prog, Int countThreads) { //:eyrCreatePool
+// Returns null if no threads could be started
+    EyrPool* pool = malloc(sizeof(EyrPool) + countThreads*sizeof(pthread_t));
+    (*pool) = (EyrPool){ .prog = prog };
+    pthread_mutex_init(&pool->lock, null);
+    pthread_cond_init(&pool->hasJobs, null);
+    pthread_cond_init(&pool->allDone, null);
+    for (Int k = 0; k < countThreads; k++) {
+        if (pthread_create(&pool->threads[k], null, &poolWorker, pool) != 0) {
+            break;
+        }
+        pool->countThreads += 1;
+    }
+    if (pool->countThreads == 0) {
+        eyrFreePool(pool);
+        return null;
+    }
+    return pool;
+}
+
+void
+eyrSubmit(EyrPool* pool, Int fnId, EyrValue const* args, Int countArgs, EyrValue* result) {
+//:eyrSubmit Queues a call. The args are copied, but the contents of their strings must stay valid
+// until "eyrWaitAll". A String result is allocated with malloc and must be freed by the caller
+    EyrJob* job = malloc(sizeof(EyrJob) + countArgs*sizeof(EyrValue));
+    (*job) = (EyrJob){ .fnId = fnId, .result = result, .countArgs = countArgs };
+    memcpy(job->args, args, countArgs*sizeof(EyrValue));
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail == null) {
+        pool->head = job;
+    } else {
+        pool->tail->next = job;
+    }
+    pool->tail = job;
+    pool->countPending += 1;
+    pthread_cond_signal(&pool->hasJobs);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+eyrWaitAll(EyrPool* pool) { //:eyrWaitAll
+// Blocks until all the submitted jobs have their results written
+    pthread_mutex_lock(&pool->lock);
+    while (pool->countPending > 0) {
+        pthread_cond_wait(&pool->allDone, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+eyrFreePool(EyrPool* pool) { //:eyrFreePool
+// Finishes the queued jobs, then stops the threads. The program must be freed after this
+    pthread_mutex_lock(&pool->lock);
+    pool->isClosing = true;
+    pthread_cond_broadcast(&pool->hasJobs);
+    pthread_mutex_unlock(&pool->lock);
+    for (Int k = 0; k < pool->countThreads; k++) {
+        pthread_join(pool->threads[k], null);
+    }
+    pthread_cond_destroy(&pool->allDone);
+    pthread_cond_destroy(&pool->hasJobs);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
 }
 
+//}}}
+
+testable String
+compileToC(Compiler* cm, OUT String* errMsg, Arena* a) { //:compileToC
+// Parses a lexed program and emits C. Returns an empty string in case of error
+    if (cm->stats.wasLexerError) {
+        *errMsg = str("lexer error");
+        return empty;
+    }
+    parse(cm, a);
+    if (cm->stats.wasError) {
+        *errMsg = cm->stats.errMsg;
+        return empty;
+    }
+    String result = emitC(cm);
+    *errMsg = cm->stats.errMsg;
+    return result;
+}
+
+void
+eyrCompileToC(String filename, String outFilename) { //:eyrCompileToC
+// Compiles a source file to C. The runtime header is written into the same directory as the
+// output file. Both names must be \0-terminated
+    Arena* a = createArena();
+    SourceMap sourceMap = mapSourceFile(filename);
+    if (sourceMap.inpLength == 0) {
+        print("could not read the source file");
+        goto cleanup;
+    }
+    String errMsg = empty;
+    String cCode = compileToC(lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, a),
+                              OUT &errMsg, a);
+    if (cCode.len == 0) {
+        printString(errMsg);
+        goto cleanup;
+    }
+    Int dirLen = outFilename.len;
+    while (dirLen > 0 && outFilename.cont[dirLen - 1] != '/') {
+        dirLen -= 1;
+    }
+    String runtimeFilename = stringOfFormat(a, "%.*s%s", dirLen, outFilename.cont, C_RUNTIME_NAME);
+    if (!writeTextFile(outFilename, cCode)
+            || !writeTextFile(runtimeFilename, (String){ .cont = C_RUNTIME,
+                                                         .len = sizeof(C_RUNTIME) - 1 })) {
+        print("could not write the output file");
+    }
+    cleanup:
+    unmapSourceFile(sourceMap);
+    deleteArena(a);
+}
 
 #ifndef TEST
 
 Int
 main(int argc, char** argv) { //:main
     Arena* a = createArena();
+    Int result = 0;
 
+    if (argc > 3 && strcmp(argv[1], "--emit-c") == 0) {
+        eyrCompileToC(str(argv[2]), str(argv[3])); // eyr --emit-c prog.eyr out.c
+        goto cleanup;
+    } ei (argc > 3 && strcmp(argv[1], "--emit-image") == 0) {
+        eyrCompileToImage(str(argv[2]), str(argv[3])); // eyr --emit-image prog.eyr prog.eyri
+        goto cleanup;
+    } ei (argc > 2 && strcmp(argv[1], "--image") == 0) {
+        eyrRunImage(str(argv[2])); // eyr --image prog.eyri
+        goto cleanup;
+    } ei (argc > 2 && strcmp(argv[1], "--check") == 0) {
+        result = eyrCheckFile(str(argv[2])); // eyr --check prog.eyr
+        goto cleanup;
+    } ei (argc > 2 && strcmp(argv[1], "--bench-lexer") == 0) {
+        benchLexer(str(argv[2])); // eyr --bench-lexer prog.eyr
+        goto cleanup;
+    } ei (argc > 1 && strcmp(argv[1], "--bench-dispatch") == 0) {
+        benchDispatch(); // eyr --bench-dispatch
+        goto cleanup;
+    } ei (argc > 1) {
+        eyrRunFile(str(argv[1]));
+        goto cleanup;
+    }
     String sourceCode = s("main = (( a = 78; print a))");
     eyrRun(sourceCode);
 
     cleanup:
     deleteArena(a);
-    return 0;
+    return result;
 }
 
 #endif
@@ -2,6 +2,9 @@
 #define EYR_INTERNAL_H
 //{{{ Utils
 
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+    #define constexpr const // the C23 "constexpr" came in GCC 13
+#endif
 #define Int int32_t
 #define Long int64_t
 #define Ulong uint64_t
@@ -9,6 +12,7 @@
 #define Ushort uint16_t
 #define StackInt Stackint32_t
 #define StackUnt Stackuint32_t
+#define StackNameSpan Stackuint64_t
 #define InListUlong InListuint64_t
 #define InListUns InListuint32_t
 #define Any void
@@ -20,6 +24,8 @@
 #define null NULL
 #define NameId int32_t // name index (in @stringTable)
 #define NameLoc uint32_t // 8 bit of length, 24 bits of startBt (in @standardText or @externalText)
+#define NameSpan uint64_t // 24 bits of length above 40 bits of startBt (in @sourceCode). Unlike the
+                          // NameLoc, it isn't limited to the first 16 MB of the input
 #define EntityId int32_t
 #define TypeId int32_t
 #define FirstArgTypeId int32_t
@@ -30,14 +36,15 @@
     #define testable static
 #endif
 #define OUT // the "out" parameters and args in functions
-#define BIG 70000000
+#define BIG 0x20000000 // a sentinel above any count of entities, types etc. 2*BIG still fits an Int
 #define LOWER24BITS 0x00FFFFFF
 #define LOWER26BITS 0x03FFFFFF
 #define LOWER16BITS 0x0000FFFF
 #define LOWER32BITS 0x00000000FFFFFFFF
+#define LOWER40BITS 0x000000FFFFFFFFFF
 #define PENULTIMATE8BITS 0xFF00
 #define THIRTYFIRSTBIT 0x40000000
-#define MAXTOKENLEN 67108864 // 2^26
+#define MAXTOKENLEN 67108864 // 2^26, the limit of "Token.lenBts"
 #define SIXTEENPLUSONE 65537 // 2^16 + 1
 #define LEXER_INIT_SIZE 1000
 #define ei else if
@@ -68,7 +75,7 @@ testable Bool endsWith(String a, String b);
 typedef struct { // :Token
     Unt tp : 6;
     Unt lenBts: 26;
-    Unt startBt;
+    Unt startBt; // the lower 32 bits of the offset in @sourceCode, see "tokStartBt"
     Unt pl1;
     Unt pl2;
 } Token;
@@ -248,8 +255,9 @@ typedef struct { // :Node
 } Node;
 
 typedef struct { // :SourceLoc
-    Int startBt;
-    Int lenBts;
+    Unt startBt;          // the lower 32 bits of the offset in @sourceCode, see "locOf"
+    Unt lenBts : 26;
+    Unt startBtHigh : 6;  // the rest of it, nonzero only for the inputs over 4 GB
 } SourceLoc;
 
 
@@ -260,7 +268,7 @@ typedef struct ScopeStackFrame ScopeStackFrame;
 typedef struct ScopeChunk ScopeChunk;
 
 typedef struct { // :CompStats
-    Int inpLength;
+    Int inpLength; // of the lexer's window into the input, see "lexRebase"
     Bool wasLexerError;
 
     Int countNonparsedEntities;
@@ -276,6 +284,7 @@ typedef struct { // :CompStats
     Int standardTextLen; // length of standardText
     Int firstParsed; // the name index for the first parsed word
     Int firstBuiltin; // the nameId for the first built-in word in standardStrings
+    Int countFusions; // superinstructions made by "fuseSuperinstructions"
 } CompStats;
 
 //}}}
@@ -309,7 +318,8 @@ typedef struct { // :CompStats
 #define iReverseString    19 // [Dest] [Src]
 #define iIndexOfSubstring 20 // [Dest] [String] [Substring]
 #define iGetFld           21 // [Dest] [Obj] [~Offset]
-#define iNewList          22 // [Dest] {Capacity}
+#define iNewList          22 // [Dest] [Start] [~Length]. A heap list of the values in the slots
+                                //  [Start; Start + Length)
 #define iGetElemPtr       23 // [Dest] [ArrAddress] {{ {0} {Elem index} }}
 #define iAddToList        24 // [List] {Value or reference}
 #define iRemoveFromList   25 // [List] {Elem Index}
@@ -320,13 +330,34 @@ typedef struct { // :CompStats
 #define iBranchEq         30
 #define iBranchGt         31 // /end
 #define iShortCircuit     32 // if [B] == [C] then [A] = [B] else ip += 1
-#define iCall             33 // [New frame pointer] { New instruction pointer }
+#define iCall             33 // [New frame pointer] {Function id}. Args are already in the new frame
 #define iBuiltinCall      34 // [Builtin index]
-#define iReturn           35 // [Size of return value = 0, 1 or 2]
+#define iReturn           35 // [Src] {Size of return value = 0, 1 or 2}. Moves it to frame start
 #define iSetLocal         36 // [Dest] {Value}
 #define iSetBigLocal      37 // [Dest] {{Value}}
 #define iPrint            38 // [String]
 #define iPrintErr         39 // [String]
+#define iMove             40 // [Dest] [Src]
+#define iShiftLeftConst   41 // [Src=Dest] {Shift}. Multiplication by a power of 2
+#define iDivByPow2Const   42 // [Src=Dest] {Shift}. Division by a power of 2, rounding towards zero
+#define iRemPow2Const     43 // [Src=Dest] {Shift}. Remainder of division by a power of 2
+// Superinstructions, created by the peephole pass "fuseSuperinstructions". A fused instruction
+// keeps the slots of its parts: the first slot is the 1st part with the fused opcode, the next slot
+// is the 2nd part unchanged. So no code pointers need to be moved
+#define iMinusBranchLt    44 // iMinus, then iBranchLt/Eq/Gt on its result
+#define iMinusBranchEq    45
+#define iMinusBranchGt    46 // /end
+#define iSetLocalPlusConst 47 // iSetLocal, then iPlusConst
+#define iSetLocalCall     48 // iSetLocal, then iCall
+#define iNewPtrList       49 // [Dest] [Start] [~Length]. Same as iNewList, for a list of pointers
+#define iNewStackList     50 // [Dest] [Start] [~Length]. A list in the current frame: the slots are
+                             // its elements, and the one before them gets the length
+#define iTailCall         51 // [New frame pointer] [~Count of args] [~Function id]. Moves the args to
+                             // the current frame, which the callee then takes over
+#define iGetElem          52 // [Dest] [List] [Index]. Throws if the index is out of bounds
+#define iGetElemUnchecked 53 // [Dest] [List] [Index]. For the indices proven to be in bounds
+#define iSetElem          54 // [List] [Index] [Value]. Throws if the index is out of bounds
+#define iSetElemUnchecked 55 // [List] [Index] [Value]
 
 //}}}
 
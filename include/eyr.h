@@ -3,8 +3,69 @@ typedef struct { // :String
     int32_t len;
 } String;
 
+typedef struct EyrProgram EyrProgram;   // compiled code, shared by any number of interpreters
+typedef struct Interpreter Interpreter; // a VM with its own stack and heap
+typedef struct EyrPool EyrPool;         // threads with an interpreter each, for parallel calls
+
+#define EYR_ERROR  -1 // the call failed, the message is in "str"
+#define EYR_VOID    0
+#define EYR_INT     1
+#define EYR_BOOL    2
+#define EYR_STRING  3
+
+typedef struct { // :EyrValue
+    int32_t tag; // one of the EYR_* constants above
+    union {
+        int32_t i;  // EYR_INT and EYR_BOOL
+        String str; // EYR_STRING and EYR_ERROR. A result string points into the VM's memory, so
+                    // it's only valid until the next call or region reset on that interpreter
+    };
+} EyrValue;
+
 void
 eyrRunFile(String filename);
 
 void
 eyrRun(String sourceCode);
+
+void
+eyrCompileToC(String filename, String outFilename);
+
+void
+eyrCompileToImage(String filename, String outFilename);
+
+void
+eyrRunImage(String filename);
+
+int32_t
+eyrCheckFile(String filename); // 0 if the file is fine, else 1
+
+EyrProgram*
+eyrCompile(String sourceCode, String* errMsg);
+
+void
+eyrFreeProgram(EyrProgram* prog);
+
+Interpreter*
+eyrCreateInterpreter(EyrProgram* prog);
+
+void
+eyrFreeInterpreter(Interpreter* rt);
+
+int32_t
+eyrFindFunction(EyrProgram* prog, String name, int32_t countArgs);
+
+EyrValue
+eyrCall(EyrProgram* prog, int32_t fnId, EyrValue const* args, int32_t countArgs, Interpreter* rt);
+
+EyrPool*
+eyrCreatePool(EyrProgram* prog, int32_t countThreads);
+
+void
+eyrSubmit(EyrPool* pool, int32_t fnId, EyrValue const* args, int32_t countArgs, EyrValue* result);
+
+void
+eyrWaitAll(EyrPool* pool);
+
+void
+eyrFreePool(EyrPool* pool);
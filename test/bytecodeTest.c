@@ -0,0 +1,1311 @@
+// Tests of the bytecode generator and its optimizations. The ASTs are built by hand, compiled to
+// bytecode and run in the interpreter, and some of the tests check the shape of the bytecode too.
+// Built with SSA, the same tests go through the SSA IR
+#include "../eyr.c"
+#include "eyrTest.h"
+
+//{{{ Utils
+
+#define N(...) addNode((Node){__VA_ARGS__}, (SourceLoc){0}, cm)
+
+
+private EntityId
+findOperator(Int opId, TypeId paramType) {
+// The operator overload with the given type of first parameter
+    for (Int e = 0; e < PROTO.entities.len; e++) {
+        TypeId fnType = PROTO.entities.cont[e].typeId;
+        if (cOperatorOf(e) == opId
+                && PROTO.types.cont[tGetIndexOfFnFirstParam(fnType, &PROTO)] == paramType) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+
+private EntityId
+findPrint(TypeId paramType, Compiler* cm) {
+    for (Int e = PROTO.entities.len; e < cm->stats.countNonparsedEntities; e++) {
+        Entity ent = cm->entities.cont[e];
+        if (ent.name == nameOfStandard(strPrint)
+                && cm->types.cont[tGetIndexOfFnFirstParam(ent.typeId, cm)] == paramType) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+
+private EntityId
+addEntity(TypeId typeId, Byte class, Compiler* cm) {
+    EntityId result = cm->entities.len;
+    pushInentities((Entity){ .typeId = typeId, .class = class }, cm);
+    return result;
+}
+
+
+private Compiler*
+createCompiler(char const* sourceCode, Arena* a) {
+// A compiler with the Prelude but no parsed nodes, so the tests can add their own
+    Compiler* cm = lexicallyAnalyze(str(sourceCode), a);
+    initializeParser(cm, a);
+    cm->stats.countNonparsedEntities = cm->entities.len;
+    return cm;
+}
+
+
+private void
+addStringLiteral(Compiler* cm) {
+// The first string literal of the source code
+    Int j = 0;
+    for (; j < cm->tokens.len && cm->tokens.cont[j].tp != tokString; j++) {}
+    Token tk = cm->tokens.cont[j];
+    addNode((Node){ .tp = tokString }, (SourceLoc){ .startBt = tk.startBt, .lenBts = tk.lenBts }, cm);
+}
+
+
+private void
+addFunction(EntityId fnEntity, Int nodeInd, Compiler* cm) {
+    setSpanLengthParser(nodeInd, cm);
+    pushIntoplevels((Assignment){ .entityId = fnEntity, .nodeInd = nodeInd, .isFunction = true },
+                    cm);
+}
+
+
+private void
+closeFor(Int forInd, Int scopeInd, Int bodyInd, Compiler* cm) {
+    setSpanLengthParser(bodyInd, cm);
+    setSpanLengthParser(scopeInd, cm);
+    setSpanLengthParser(forInd, cm);
+    cm->nodes.cont[forInd].pl3 = bodyInd - forInd;
+}
+
+
+private EyrProgram*
+compileProgram(char const* name, Compiler* cm, TestContext* ct) {
+// Null if the bytecode generator failed
+    genBytecode(true, cm);
+    if (!expectTrue(name, !cm->stats.wasError, ct)) {
+        printString(cm->stats.errMsg);
+        return null;
+    }
+    fuseSuperinstructions(cm);
+    EyrProgram* prog = allocate(EyrProgram, ct->a);
+    (*prog) = (EyrProgram){ .cm = cm, .a = ct->a };
+    return prog;
+}
+
+
+private Bool
+isInt(EyrValue value, Long expected) {
+    return value.tag == EYR_INT && value.i == expected;
+}
+
+
+private EyrValue
+callInt(EyrProgram* prog, Int fnId, Long arg, Interpreter* rt) {
+    return eyrCall(prog, fnId, (EyrValue[]){ { .tag = EYR_INT, .i = arg } }, 1, rt);
+}
+
+
+private Int
+fnStart(Int fnId, Compiler* cm) {
+// The index of the length word of a function in the bytecode
+    Int j = 0;
+    for (Int k = 0; k < fnId; k++) {
+        j += cm->bytecode.cont[j] + 1;
+    }
+    return j;
+}
+
+
+private Int
+countOps(Int opCode, Int fnId, Compiler* cm) {
+// The number of instructions with the opcode in a function
+    Int const start = fnStart(fnId, cm);
+    Int result = 0;
+    for (Int j = start + 1; j <= start + (Int)cm->bytecode.cont[start]; j++) {
+        if ((Int)(cm->bytecode.cont[j] >> 58) == opCode) {
+            result += 1;
+        }
+    }
+    return result;
+}
+
+
+private Int
+countLoopOps(Int opCode, Int fnId, Compiler* cm) {
+// The number of instructions with the opcode in the first loop of a function, i.e. from the target
+// of the first backward jump to that jump
+    Int const start = fnStart(fnId, cm);
+    Int const sentinel = start + (Int)cm->bytecode.cont[start] + 1;
+    Int jumpInd = start + 1;
+    while (jumpInd < sentinel && ((cm->bytecode.cont[jumpInd] >> 58) != iJump
+                                  || (Int)(cm->bytecode.cont[jumpInd] & LOWER32BITS) > jumpInd)) {
+        jumpInd += 1;
+    }
+    Int result = 0;
+    for (Int j = (Int)(cm->bytecode.cont[jumpInd] & LOWER32BITS); j <= jumpInd && j < sentinel;
+            j++) {
+        if ((Int)(cm->bytecode.cont[j] >> 58) == opCode) {
+            result += 1;
+        }
+    }
+    return result;
+}
+
+
+private Int
+countFunctions(Compiler* cm) {
+    Int result = 0;
+    for (Int j = 0; j < cm->bytecode.len; j += cm->bytecode.cont[j] + 1) {
+        result += 1;
+    }
+    return result;
+}
+
+
+private Int
+maxSlot(Int fnId, Compiler* cm) {
+// The highest stack slot that a function's instructions write or read, not counting the calls
+    Int const start = fnStart(fnId, cm);
+    Int result = 0;
+    Int uses[3];
+    Int def;
+    for (Int j = start + 1; j <= start + (Int)cm->bytecode.cont[start]; j++) {
+        Ulong const instr = cm->bytecode.cont[j];
+        Int const countUses = bcOperands(instr, uses, &def);
+        for (Int k = 0; k < countUses; k++) {
+            result = MAX(result, bcField(instr, uses[k]));
+        }
+        if (def > -1) {
+            result = MAX(result, bcField(instr, def));
+        }
+    }
+    return result;
+}
+
+//}}}
+//{{{ Codegen
+
+private void
+programTests(TestContext* ct) {
+// A global string, loops with break and continue, recursion and string concatenation
+    Compiler* cm = createCompiler("a = `he\"llo`", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId gt = findOperator(opGreaterTh, tokInt);
+    EntityId eq = findOperator(opEquality, tokInt);
+    EntityId minus = findOperator(opMinus, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId plusStr = findOperator(opPlus, tokString);
+    EntityId boolOr = findOperator(opBoolOr, tokDouble);
+    EntityId boolAnd = findOperator(opBoolAnd, tokBool);
+    EntityId printStr = findPrint(tokString, cm);
+    TypeId intOfInt = addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokInt }, cm), classImmut, cm);
+    EntityId fFib = addEntity(intOfInt, classImmut, cm);
+    EntityId fG = addEntity(intOfInt, classImmut, cm);
+    EntityId fRep = addEntity(addConcrFnType(2, (Int[]){ tokString, tokInt, tokString }, cm),
+                              classImmut, cm);
+    EntityId greeting = addEntity(tokString, classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+    EntityId acc = addEntity(tokInt, classMut, cm);
+    EntityId text = addEntity(tokString, classImmut, cm);
+    EntityId result = addEntity(tokString, classMut, cm);
+
+    // greeting = `he"llo`
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = greeting);
+    addStringLiteral(cm);
+
+    // main = acc~ = 0; for i~ = 0; i < 30 { acc = acc + fib i; i = i + 1 };
+    //        print (greeting + greeting); return acc
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 30); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 6, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = i);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = greeting); N(.tp = nodId, .pl1 = greeting);
+        N(.tp = nodCall, .pl1 = plusStr, .pl2 = 2); N(.tp = nodCall, .pl1 = printStr, .pl2 = 1);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    addFunction(fMain, mainInd, cm);
+
+    // fib n = if n < 2 { return n }; return fib(n - 1) + fib(n - 2)
+    Int const fibInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fFib);
+    N(.tp = nodBinding, .pl1 = n);
+    Int ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 2); N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = n);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 10);
+    N(.tp = nodExpr, .pl2 = 9);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    addFunction(fFib, fibInd, cm);
+
+    // g n = acc~ = 0; for i~ = 0; i < n { i = i + 1; if i == 3 || i == 5 { continue };
+    //       if i > 8 && n < 100 { break }; acc = acc + i }; return acc
+    Int const gInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fG);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 7);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 3); N(.tp = nodCall, .pl1 = eq, .pl2 = 2);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 5); N(.tp = nodCall, .pl1 = eq, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = boolOr, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 1); N(.tp = nodBreakCont, .pl1 = BIG);
+    setSpanLengthParser(ifInd, cm);
+    ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 7);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 8); N(.tp = nodCall, .pl1 = gt, .pl2 = 2);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 100); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = boolAnd, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 1); N(.tp = nodBreakCont);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = i);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    addFunction(fG, gInd, cm);
+
+    // rep text n = result~ = text; for i~ = 0; i < n { result = result + text; i = i + 1 };
+    //             return result
+    Int const repInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fRep);
+    N(.tp = nodBinding, .pl1 = text); N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = result);
+        N(.tp = nodId, .pl1 = text);
+    forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = result);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = result); N(.tp = nodId, .pl1 = text);
+        N(.tp = nodCall, .pl1 = plusStr, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = result);
+    addFunction(fRep, repInd, cm);
+
+    EyrProgram* prog = compileProgram("Compiling loops, recursion and strings", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    expectTrue("A loop calling a recursive function", isInt(eyrCall(prog, 0, null, 0, rt), 1346268),
+               ct);
+    expectTrue("Recursion", isInt(callInt(prog, 1, 20, rt), 6765), ct);
+    expectTrue("Break and continue", isInt(callInt(prog, 2, 20, rt), 28)
+                                     && isInt(callInt(prog, 2, 200, rt), 20092), ct);
+    Bool isOk = true;
+    for (Int j = 0; j < 3000 && isOk; j++) {
+        EyrValue repeated = eyrCall(prog, 3, (EyrValue[]){ { .tag = EYR_STRING, .str = s("ab") },
+                                                           { .tag = EYR_INT, .i = 50 } }, 2, rt);
+        isOk = repeated.tag == EYR_STRING && repeated.str.len == 102
+               && memcmp(repeated.str.cont + 96, "ababab", 6) == 0;
+    }
+    expectTrue("String concatenation with collections", isOk && rt->countCollections > 0, ct);
+    eyrFreeInterpreter(rt);
+}
+
+
+private void
+slotTests(TestContext* ct) {
+// Variables whose live ranges don't overlap share stack slots
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId fChain = addEntity(addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId vars[6];
+    for (Int k = 0; k < 6; k++) {
+        vars[k] = addEntity(tokInt, classImmut, cm);
+    }
+
+    // chain n = v0 = n + 1; v1 = v0 + 1; ... v5 = v4 + 1; return v5
+    Int const chainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fChain);
+    N(.tp = nodBinding, .pl1 = n);
+    for (Int k = 0; k < 6; k++) {
+        N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = vars[k]);
+            N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = k == 0 ? n : vars[k - 1]);
+            N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    }
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = vars[5]);
+    addFunction(fChain, chainInd, cm);
+
+    EyrProgram* prog = compileProgram("Compiling a chain of variables", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    expectTrue("A chain of variables", isInt(callInt(prog, 0, 10, rt), 16), ct);
+    expectTrue("The chain uses two slots", maxSlot(0, cm) <= stackFrameStart + 1, ct);
+    eyrFreeInterpreter(rt);
+}
+
+
+private void
+longStringTest(Int len, TestContext* ct) {
+// greet = return `xx...x`, with a literal of @len bytes. The length of iNewstring has 24 bits
+    char* source = allocateOnArena(len + 7, ct->a);
+    memcpy(source, "a = `", 5);
+    memset(source + 5, 'x', len);
+    memcpy(source + 5 + len, "`", 2);
+    Compiler* cm = createCompiler(source, ct->a);
+    EntityId fGreet = addEntity(addConcrFnType(0, (Int[]){ tokString }, cm), classImmut, cm);
+    Int const greetInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fGreet);
+    N(.tp = nodReturn, .pl2 = 1); addStringLiteral(cm);
+    addFunction(fGreet, greetInd, cm);
+
+    genBytecode(true, cm);
+    if (len <= LOWER24BITS) {
+        expectTrue("The longest string literal", !cm->stats.wasError
+                   && countOps(iNewstring, 0, cm) == 1, ct);
+    } else {
+        expectTrue("A string literal too long for the bytecode", cm->stats.wasError
+                   && equal(cm->stats.errMsg, str(errStringTooLong)), ct);
+    }
+}
+
+//}}}
+//{{{ Folding
+
+private void
+expectNodes(char const* name, Int start, Arr(Node) expected, Int count, Compiler* cm,
+            TestContext* ct) {
+// The nodes from "start" to the end must be "expected", compared by their types and payloads
+    Bool isOk = cm->nodes.len == start + count;
+    for (Int j = 0; j < count && isOk; j++) {
+        Node nd = cm->nodes.cont[start + j];
+        isOk = nd.tp == expected[j].tp && nd.pl1 == expected[j].pl1 && nd.pl2 == expected[j].pl2;
+    }
+    if (!expectTrue(name, isOk, ct)) {
+        for (Int j = start; j < cm->nodes.len; j++) {
+            Node nd = cm->nodes.cont[j];
+            printf(" [tp %d pl1 %d pl2 %d]", nd.tp, nd.pl1, nd.pl2);
+        }
+        printf("\n");
+    }
+}
+
+
+private Int
+addFolded(Arr(Node) nodes, Int count, Compiler* cm) {
+// Adds an expression and folds it the way the typer does
+    Int const exprInd = cm->nodes.len;
+    N(.tp = nodExpr);
+    for (Int j = 0; j < count; j++) {
+        addNode(nodes[j], (SourceLoc){0}, cm);
+    }
+    foldConstants(exprInd, cm);
+    setSpanLengthParser(exprInd, cm);
+    return exprInd;
+}
+
+
+private void
+foldingTests(TestContext* ct) {
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId times = findOperator(opTimes, tokInt);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId divBy = findOperator(opDivBy, tokInt);
+    EntityId plusDouble = findOperator(opPlus, tokDouble);
+    EntityId boolAnd = findOperator(opBoolAnd, tokBool);
+    EntityId k = addEntity(tokInt, classImmut, cm);
+    EntityId v = addEntity(tokInt, classMut, cm);
+
+    // k = 2*3 + 4
+    Int ind = addFolded((Node[]){ { .tp = tokInt, .pl2 = 2 }, { .tp = tokInt, .pl2 = 3 },
+                                  { .tp = nodCall, .pl1 = times, .pl2 = 2 },
+                                  { .tp = tokInt, .pl2 = 4 },
+                                  { .tp = nodCall, .pl1 = plus, .pl2 = 2 } }, 5, cm);
+    expectNodes("Int arithmetic", ind, (Node[]){ { .tp = nodExpr, .pl2 = 1 },
+                                                 { .tp = tokInt, .pl2 = 10 } }, 2, cm, ct);
+    foldRecordBinding(k, ind, cm);
+    expectTrue("An immutable binding to a literal", foldLiteralOf(k, cm) == ind + 1
+                                                    && foldLiteralOf(v, cm) == -1, ct);
+
+    // v + k*2 < 100
+    ind = addFolded((Node[]){ { .tp = nodId, .pl1 = v }, { .tp = nodId, .pl1 = k },
+                              { .tp = tokInt, .pl2 = 2 }, { .tp = nodCall, .pl1 = times, .pl2 = 2 },
+                              { .tp = nodCall, .pl1 = plus, .pl2 = 2 },
+                              { .tp = tokInt, .pl2 = 100 },
+                              { .tp = nodCall, .pl1 = lt, .pl2 = 2 } }, 7, cm);
+    expectNodes("Propagating a binding into a subexpression", ind,
+                (Node[]){ { .tp = nodExpr, .pl2 = 5 }, { .tp = nodId, .pl1 = v },
+                          { .tp = tokInt, .pl2 = 20 }, { .tp = nodCall, .pl1 = plus, .pl2 = 2 },
+                          { .tp = tokInt, .pl2 = 100 }, { .tp = nodCall, .pl1 = lt, .pl2 = 2 } },
+                6, cm, ct);
+
+    // 7 / 0
+    ind = addFolded((Node[]){ { .tp = tokInt, .pl2 = 7 }, { .tp = tokInt },
+                              { .tp = nodCall, .pl1 = divBy, .pl2 = 2 } }, 3, cm);
+    expectNodes("Division by zero is left for the runtime", ind,
+                (Node[]){ { .tp = nodExpr, .pl2 = 3 }, { .tp = tokInt, .pl2 = 7 }, { .tp = tokInt },
+                          { .tp = nodCall, .pl1 = divBy, .pl2 = 2 } }, 4, cm, ct);
+
+    // 1 < 2 && k < 5
+    ind = addFolded((Node[]){ { .tp = tokInt, .pl2 = 1 }, { .tp = tokInt, .pl2 = 2 },
+                              { .tp = nodCall, .pl1 = lt, .pl2 = 2 },
+                              { .tp = nodId, .pl1 = k }, { .tp = tokInt, .pl2 = 5 },
+                              { .tp = nodCall, .pl1 = lt, .pl2 = 2 },
+                              { .tp = nodCall, .pl1 = boolAnd, .pl2 = 2 } }, 7, cm);
+    expectNodes("Comparisons and Bool operators", ind,
+                (Node[]){ { .tp = nodExpr, .pl2 = 1 }, { .tp = tokBool } }, 2, cm, ct);
+
+    // 1.5 + 2.25
+    ind = addFolded((Node[]){ foldDoubleNode(1.5), foldDoubleNode(2.25),
+                              { .tp = nodCall, .pl1 = plusDouble, .pl2 = 2 } }, 3, cm);
+    expectTrue("Double arithmetic", cm->nodes.len == ind + 2
+                                    && foldDoubleOf(cm->nodes.cont[ind + 1]) == 3.75, ct);
+
+    // 9223372036854775807 + 1
+    ind = addFolded((Node[]){ { .tp = tokInt, .pl1 = 0x7FFFFFFF, .pl2 = -1 },
+                              { .tp = tokInt, .pl2 = 1 },
+                              { .tp = nodCall, .pl1 = plus, .pl2 = 2 } }, 3, cm);
+    expectTrue("Int arithmetic wraps around", cm->nodes.len == ind + 2
+                                    && foldIntOf(cm->nodes.cont[ind + 1]) == INT64_MIN, ct);
+}
+
+//}}}
+//{{{ Constants
+
+private void
+addFib(EntityId fFib, EntityId n, Compiler* cm) {
+// fib n = if n < 2 { return n }; return fib(n - 1) + fib(n - 2)
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId minus = findOperator(opMinus, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    Int const fibInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fFib);
+    N(.tp = nodBinding, .pl1 = n);
+    Int const ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 2); N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = n);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 10);
+    N(.tp = nodExpr, .pl2 = 9);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    addFunction(fFib, fibInd, cm);
+}
+
+
+private void
+constantTests(TestContext* ct) {
+// Toplevel constants with calls in their initializers are evaluated at compile time
+    Compiler* cm = createCompiler("a = `he\"llo`", ct->a);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId plusStr = findOperator(opPlus, tokString);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokInt }, cm), classImmut, cm);
+    EntityId fGreet = addEntity(addConcrFnType(0, (Int[]){ tokString }, cm), classImmut, cm);
+    EntityId fFib = addEntity(addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId greeting = addEntity(tokString, classImmut, cm);
+    EntityId k = addEntity(tokInt, classImmut, cm);
+    EntityId k2 = addEntity(tokInt, classImmut, cm);
+    EntityId twice = addEntity(tokString, classImmut, cm);
+
+    // greeting = `he"llo`; k = fib 10; k2 = k + fib 5; twice = greeting + greeting
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = greeting);
+    addStringLiteral(cm);
+    N(.tp = nodAssignment, .pl2 = 4, .pl3 = 2); N(.tp = nodBinding, .pl1 = k);
+        N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 10); N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+    N(.tp = nodAssignment, .pl2 = 6, .pl3 = 2); N(.tp = nodBinding, .pl1 = k2);
+        N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = k); N(.tp = tokInt, .pl2 = 5);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = twice);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = greeting); N(.tp = nodId, .pl1 = greeting);
+        N(.tp = nodCall, .pl1 = plusStr, .pl2 = 2);
+
+    // main = return k2; greet = return twice
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = k2);
+    addFunction(fMain, mainInd, cm);
+    Int const greetInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fGreet);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = twice);
+    addFunction(fGreet, greetInd, cm);
+    addFib(fFib, n, cm);
+
+    EyrProgram* prog = compileProgram("Compiling constants", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    expectTrue("Int constants", isInt(eyrCall(prog, 0, null, 0, rt), 60)
+                                && countOps(iCall, 0, cm) == 0, ct);
+    EyrValue result = eyrCall(prog, 1, null, 0, rt);
+    expectTrue("String constants", result.tag == EYR_STRING
+                                   && equal(result.str, s("he\"llohe\"llo")), ct);
+    eyrFreeInterpreter(rt);
+}
+
+
+private void
+endlessConstantTest(TestContext* ct) {
+// An initializer that never finishes runs out of steps. x = spin 1, where
+// spin n = acc~ = 0; for i~ = 0; i < n { acc = acc + 1 }; return acc
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokInt }, cm), classImmut, cm);
+    EntityId fSpin = addEntity(addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+    EntityId acc = addEntity(tokInt, classMut, cm);
+    EntityId x = addEntity(tokInt, classImmut, cm);
+
+    N(.tp = nodAssignment, .pl2 = 4, .pl3 = 2); N(.tp = nodBinding, .pl1 = x);
+        N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = fSpin, .pl2 = 1);
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = x);
+    addFunction(fMain, mainInd, cm);
+
+    Int const spinInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fSpin);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = acc); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    addFunction(fSpin, spinInd, cm);
+
+    genBytecode(true, cm);
+    expectTrue("A constant that doesn't terminate", cm->stats.wasError
+               && equal(cm->stats.errMsg, s(errConstantEvaluation)), ct);
+}
+
+//}}}
+//{{{ Dead code
+
+private void
+addIdentity(EntityId fn, EntityId n, Compiler* cm) {
+// fn n = return n
+    Int const fnInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fn);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = n);
+    addFunction(fn, fnInd, cm);
+}
+
+
+private Compiler*
+buildDeadCode(Arena* a) {
+// flag = false
+// main = if flag { return inFalse 1 }; if true { return fib 10 } else { return inElse 2 };
+//        return 0; afterReturn 3
+// and "unused" is never called
+    Compiler* cm = createCompiler("a = 1", a);
+    TypeId intOfInt = addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokInt }, cm), classImmut, cm);
+    EntityId fFib = addEntity(intOfInt, classImmut, cm);
+    EntityId fInFalse = addEntity(intOfInt, classImmut, cm);
+    EntityId fInElse = addEntity(intOfInt, classImmut, cm);
+    EntityId fAfterReturn = addEntity(intOfInt, classImmut, cm);
+    EntityId fUnused = addEntity(intOfInt, classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId flag = addEntity(tokBool, classImmut, cm);
+
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = flag); N(.tp = tokBool);
+
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    Int ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 1); N(.tp = nodId, .pl1 = flag);
+    N(.tp = nodScope, .pl2 = 4);
+        N(.tp = nodReturn, .pl2 = 3); N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = fInFalse, .pl2 = 1);
+    setSpanLengthParser(ifInd, cm);
+    ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 1); N(.tp = tokBool, .pl2 = 1);
+    N(.tp = nodScope, .pl2 = 4);
+        N(.tp = nodReturn, .pl2 = 3); N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 10);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+    N(.tp = nodElseIf, .pl2 = 5); N(.tp = nodScope, .pl2 = 4);
+        N(.tp = nodReturn, .pl2 = 3); N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fInElse, .pl2 = 1);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 2); N(.tp = tokInt, .pl2 = 3); N(.tp = nodCall, .pl1 = fAfterReturn, .pl2 = 1);
+    addFunction(fMain, mainInd, cm);
+
+    addFib(fFib, n, cm);
+    addIdentity(fInFalse, n, cm);
+    addIdentity(fInElse, n, cm);
+    addIdentity(fAfterReturn, n, cm);
+    addIdentity(fUnused, n, cm);
+    return cm;
+}
+
+
+private void
+deadCodeTests(TestContext* ct) {
+    Compiler* cm = buildDeadCode(ct->a);
+    genBytecode(false, cm);
+    if (!expectTrue("Compiling dead code", !cm->stats.wasError, ct)) {
+        printString(cm->stats.errMsg);
+        return;
+    }
+    expectTrue("Only main and fib are compiled", countFunctions(cm) == 2
+               && countOps(iJump, 0, cm) == 0 && countOps(iBranchEq, 0, cm) == 0, ct);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    expectTrue("Running the live code", rt.errMsg.len == 0 && rt.memory[0] == 55, ct);
+    freeInterpreter(&rt);
+
+    cm = buildDeadCode(ct->a);
+    genBytecode(true, cm);
+    expectTrue("The embedding API gets all functions", !cm->stats.wasError
+               && countFunctions(cm) == 6, ct);
+}
+
+//}}}
+//{{{ Inlining
+
+private Compiler*
+buildInlining(Arena* a) {
+// main = acc~ = 0; for i~ = 0; i < 10 { acc = acc + add3 i; i = i + 1 }; return acc + add3 -5 + fib 10
+// add3 n = if n < 0 { return 0 }; return n + 3
+    Compiler* cm = createCompiler("a = 1", a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    TypeId intOfInt = addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokInt }, cm), classImmut, cm);
+    EntityId fAdd3 = addEntity(intOfInt, classImmut, cm);
+    EntityId fFib = addEntity(intOfInt, classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+    EntityId acc = addEntity(tokInt, classMut, cm);
+
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 10); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 6, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = i);
+        N(.tp = nodCall, .pl1 = fAdd3, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 8);
+    N(.tp = nodExpr, .pl2 = 7); N(.tp = nodId, .pl1 = acc);
+        N(.tp = tokInt, .pl1 = -1, .pl2 = -5); N(.tp = nodCall, .pl1 = fAdd3, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+        N(.tp = tokInt, .pl2 = 10); N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    addFunction(fMain, mainInd, cm);
+
+    Int const add3Ind = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fAdd3);
+    N(.tp = nodBinding, .pl1 = n);
+    Int const ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 2); N(.tp = nodReturn, .pl2 = 1); N(.tp = tokInt);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 4);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 3); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    addFunction(fAdd3, add3Ind, cm);
+    addFib(fFib, n, cm);
+    return cm;
+}
+
+
+private void
+inliningTests(TestContext* ct) {
+    Compiler* cm = buildInlining(ct->a);
+    genBytecode(false, cm);
+    if (!expectTrue("Compiling inlinable calls", !cm->stats.wasError, ct)) {
+        printString(cm->stats.errMsg);
+        return;
+    }
+#ifndef SSA // the IR doesn't inline yet
+    expectTrue("A small function is inlined and dropped, a recursive one is not",
+               countFunctions(cm) == 2 && countOps(iCall, 0, cm) == 1, ct);
+#endif
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    expectTrue("Running the inlined code", rt.errMsg.len == 0 && rt.memory[0] == 130, ct);
+    freeInterpreter(&rt);
+
+    cm = buildInlining(ct->a);
+    EyrProgram* prog = compileProgram("Compiling inlinable calls for embedding", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    Interpreter* embedded = eyrCreateInterpreter(prog);
+    expectTrue("An inlined function can still be called from outside",
+               isInt(eyrCall(prog, 0, null, 0, embedded), 130)
+               && isInt(callInt(prog, 1, 4, embedded), 7) && isInt(callInt(prog, 1, -4, embedded), 0),
+               ct);
+    eyrFreeInterpreter(embedded);
+}
+
+//}}}
+//{{{ Loops
+
+private Long
+loopResult(Long n) {
+// What "loop" below computes
+    Long acc = 0;
+    for (Long i = 0; i < n; i++) {
+        acc = acc + i*4 + n*n/8 + (i - 50)/4 + (i - 50)%8;
+    }
+    return acc;
+}
+
+
+private void
+loopTests(TestContext* ct) {
+// loop n = acc~ = 0; for i~ = 0; i < n { acc = acc + i*4 + n*n/8 + (i - 50)/4 + (i - 50)%8;
+//                                         i = i + 1 }; return acc
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId minus = findOperator(opMinus, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId times = findOperator(opTimes, tokInt);
+    EntityId divBy = findOperator(opDivBy, tokInt);
+    EntityId remainder = findOperator(opRemainder, tokInt);
+    TypeId intOfInt = addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm);
+    EntityId fLoop = addEntity(intOfInt, classImmut, cm);
+    EntityId fDrive = addEntity(intOfInt, classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId acc = addEntity(tokInt, classMut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+
+    Int const loopInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fLoop);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 25, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+    N(.tp = nodExpr, .pl2 = 23);
+        N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 4);
+        N(.tp = nodCall, .pl1 = times, .pl2 = 2); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+        N(.tp = nodId, .pl1 = n); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = times, .pl2 = 2);
+        N(.tp = tokInt, .pl2 = 8); N(.tp = nodCall, .pl1 = divBy, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 50); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = tokInt, .pl2 = 4); N(.tp = nodCall, .pl1 = divBy, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 50); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = tokInt, .pl2 = 8); N(.tp = nodCall, .pl1 = remainder, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    addFunction(fLoop, loopInd, cm);
+
+    // drive n = acc~ = 0; for i~ = 0; i < 1100 { acc = acc + loop n; i = i + 1 }; return acc
+    Int const driveInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fDrive);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int const driveForInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const driveScopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1100); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const driveBodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 6, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = n);
+        N(.tp = nodCall, .pl1 = fLoop, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(driveForInd, driveScopeInd, driveBodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    addFunction(fDrive, driveInd, cm);
+
+    EyrProgram* prog = compileProgram("Compiling a loop", cm, ct);
+    if (prog == null) {
+        return;
+    }
+#ifndef SSA // the IR doesn't hoist yet
+    expectTrue("No multiplication or division is left in the loop",
+               countLoopOps(iTimes, 0, cm) == 0 && countLoopOps(iTimesConst, 0, cm) == 0
+               && countLoopOps(iDivBy, 0, cm) == 0 && countLoopOps(iDivByConst, 0, cm) == 0
+               && countLoopOps(iDivByPow2Const, 0, cm) == 1
+               && countLoopOps(iRemPow2Const, 0, cm) == 1, ct);
+#endif
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    Long const ns[] = { 0, 7, 100, 1000 };
+    Bool isOk = true;
+    for (Int j = 0; j < 4 && isOk; j++) {
+        isOk = isInt(callInt(prog, 0, ns[j], rt), loopResult(ns[j]));
+    }
+    expectTrue("Hoisted and strength-reduced code", isOk, ct);
+    // Enough calls for the JIT to compile "loop"
+    isOk = isInt(callInt(prog, 1, 7, rt), 1100*loopResult(7));
+    for (Int j = 0; j < 4 && isOk; j++) {
+        isOk = isInt(callInt(prog, 0, ns[j], rt), loopResult(ns[j]));
+    }
+#ifdef JIT
+    isOk = isOk && rt->fns[0] == -1;
+#endif
+    expectTrue("Hoisted and strength-reduced code in native code", isOk, ct);
+    eyrFreeInterpreter(rt);
+}
+
+//}}}
+//{{{ SSA
+
+private Long
+joinResult(Long n) {
+// What "join" below computes
+    Long x = n < 10 ? n : 10;
+    Long y = x;
+    for (Long i = 0; i < n; i++) {
+        y = y + x;
+        if (y > 1000) {
+            break;
+        }
+    }
+    return y;
+}
+
+
+private void
+joinTests(TestContext* ct) {
+// Variables assigned on several control flow paths, which need phis in the IR.
+// join n = x~ = 0; if n < 10 { x = n } else { x = 10 }; y~ = x;
+//          for i~ = 0; i < n { y = y + x; if y > 1000 { break }; i = i + 1 }; return y
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId gt = findOperator(opGreaterTh, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId fJoin = addEntity(addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId x = addEntity(tokInt, classMut, cm);
+    EntityId y = addEntity(tokInt, classMut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+
+    Int const joinInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fJoin);
+    N(.tp = nodBinding, .pl1 = n);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = x); N(.tp = tokInt);
+    Int ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 10); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 3);
+        N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = x);
+        N(.tp = nodId, .pl1 = n);
+    N(.tp = nodElseIf, .pl2 = 4); N(.tp = nodScope, .pl2 = 3);
+        N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = x);
+        N(.tp = tokInt, .pl2 = 10);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = y); N(.tp = nodId, .pl1 = x);
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = y);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = y); N(.tp = nodId, .pl1 = x);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = y); N(.tp = tokInt, .pl2 = 1000); N(.tp = nodCall, .pl1 = gt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 1); N(.tp = nodBreakCont);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = y);
+    addFunction(fJoin, joinInd, cm);
+
+    EyrProgram* prog = compileProgram("Compiling joins of control flow", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    Bool isOk = true;
+    for (Long arg = -2; arg < 300 && isOk; arg += 7) {
+        isOk = isInt(callInt(prog, 0, arg, rt), joinResult(arg));
+    }
+    expectTrue("Values from several control flow paths", isOk, ct);
+    eyrFreeInterpreter(rt);
+}
+
+//}}}
+//{{{ Lists
+
+#ifndef SSA // the IR doesn't support lists yet
+
+private void
+addListLiteral(EntityId list, EntityId tmp, Int count, Arr(Int) values, EntityId plus,
+               Compiler* cm) {
+// list = [values...], with the elements of a String list being the first string literal.
+// If "plus" isn't -1, the list gets one more element: 3 + 4
+    Int const assignmentInd = cm->nodes.len;
+    N(.tp = nodAssignment, .pl3 = 2); N(.tp = nodBinding, .pl1 = list);
+    Int const exprInd = cm->nodes.len;
+    N(.tp = nodExpr, .pl1 = 1);
+    Int const innerInd = cm->nodes.len;
+    N(.tp = nodAssignment, .pl3 = 2); N(.tp = nodBinding, .pl1 = tmp, .pl2 = -1);
+    Int const allocInd = cm->nodes.len;
+    N(.tp = nodDataAlloc, .pl3 = count + (plus > -1 ? 1 : 0));
+    for (Int k = 0; k < count; k++) {
+        if (values == null) {
+            addStringLiteral(cm);
+        } else {
+            N(.tp = tokInt, .pl2 = values[k]);
+        }
+    }
+    if (plus > -1) {
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = tokInt, .pl2 = 3); N(.tp = tokInt, .pl2 = 4);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    }
+    setSpanLengthParser(allocInd, cm);
+    setSpanLengthParser(innerInd, cm);
+    N(.tp = nodId, .pl1 = tmp, .pl2 = -1);
+    setSpanLengthParser(exprInd, cm);
+    setSpanLengthParser(assignmentInd, cm);
+}
+
+
+private void
+listTests(TestContext* ct) {
+// main = a = [10 20 30]; b = [`s1s2` `s1s2`]; c = make(); d = [5 6]; e = same d; z = one a;
+//        return c
+// make = x = [1 2 3 + 4]; return x
+// same p = return p
+// one q = return 1
+// Only a and b don't escape
+    Compiler* cm = createCompiler("a = `s1s2`", ct->a);
+    EntityId plus = findOperator(opPlus, tokInt);
+    TypeId intList = tCreateSingleParamTypeCall(0, tokInt, cm);
+    TypeId strList = tCreateSingleParamTypeCall(0, tokString, cm);
+    TypeId listOfVoid = addConcrFnType(0, (Int[]){ intList }, cm);
+    EntityId fMain = addEntity(listOfVoid, classImmut, cm);
+    EntityId fMake = addEntity(listOfVoid, classImmut, cm);
+    EntityId fSame = addEntity(addConcrFnType(1, (Int[]){ intList, intList }, cm), classImmut, cm);
+    EntityId fOne = addEntity(addConcrFnType(1, (Int[]){ intList, tokInt }, cm), classImmut, cm);
+    EntityId p = addEntity(intList, classImmut, cm);
+    EntityId q = addEntity(intList, classImmut, cm);
+    EntityId vars[6];
+    EntityId tmps[6];
+    for (Int k = 0; k < 6; k++) {
+        vars[k] = addEntity(k == 1 ? strList : intList, classImmut, cm);
+        tmps[k] = addEntity(k == 1 ? strList : intList, classImmut, cm);
+    }
+    EntityId z = addEntity(tokInt, classImmut, cm);
+
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    addListLiteral(vars[0], tmps[0], 3, (Int[]){ 10, 20, 30 }, -1, cm);
+    addListLiteral(vars[1], tmps[1], 2, null, -1, cm);
+    N(.tp = nodAssignment, .pl2 = 3, .pl3 = 2); N(.tp = nodBinding, .pl1 = vars[2]);
+        N(.tp = nodExpr, .pl2 = 1); N(.tp = nodCall, .pl1 = fMake);
+    addListLiteral(vars[3], tmps[3], 2, (Int[]){ 5, 6 }, -1, cm);
+    N(.tp = nodAssignment, .pl2 = 4, .pl3 = 2); N(.tp = nodBinding, .pl1 = vars[4]);
+        N(.tp = nodExpr, .pl2 = 2); N(.tp = nodId, .pl1 = vars[3]); N(.tp = nodCall, .pl1 = fSame, .pl2 = 1);
+    N(.tp = nodAssignment, .pl2 = 4, .pl3 = 2); N(.tp = nodBinding, .pl1 = z);
+        N(.tp = nodExpr, .pl2 = 2); N(.tp = nodId, .pl1 = vars[0]); N(.tp = nodCall, .pl1 = fOne, .pl2 = 1);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = vars[2]);
+    addFunction(fMain, mainInd, cm);
+
+    Int const makeInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMake);
+    addListLiteral(vars[5], tmps[5], 2, (Int[]){ 1, 2 }, plus, cm);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = vars[5]);
+    addFunction(fMake, makeInd, cm);
+    Int const sameInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fSame); N(.tp = nodBinding, .pl1 = p);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = p);
+    addFunction(fSame, sameInd, cm);
+    Int const oneInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fOne); N(.tp = nodBinding, .pl1 = q);
+    N(.tp = nodReturn, .pl2 = 1); N(.tp = tokInt, .pl2 = 1);
+    addFunction(fOne, oneInd, cm);
+
+    genBytecode(false, cm);
+    if (!expectTrue("Compiling list literals", !cm->stats.wasError, ct)) {
+        printString(cm->stats.errMsg);
+        return;
+    }
+    Int countStack = 0;
+    Int countHeap = 0;
+    for (Int fnId = 0; fnId < countFunctions(cm); fnId++) {
+        countStack += countOps(iNewStackList, fnId, cm);
+        countHeap += countOps(iNewList, fnId, cm) + countOps(iNewPtrList, fnId, cm);
+    }
+    expectTrue("Non-escaping lists stay in the frame", countStack == 2 && countHeap == 2, ct);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    EyrPtr const result = rt.memory[0];
+    expectTrue("A returned list is on the heap", rt.errMsg.len == 0 && result >= rt.heapStart
+               && rt.memory[result] == 3 && rt.memory[result + 1] == 1 && rt.memory[result + 2] == 2
+               && rt.memory[result + 3] == 7, ct);
+    freeInterpreter(&rt);
+}
+
+#endif
+//}}}
+//{{{ Tail calls
+
+private void
+tailCallTests(TestContext* ct) {
+// sum n acc = if n < 1 { return acc }; return sum (n - 1) (acc + 3)
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId minus = findOperator(opMinus, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId fSum = addEntity(addConcrFnType(2, (Int[]){ tokInt, tokInt, tokInt }, cm), classImmut,
+                              cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId acc = addEntity(tokInt, classImmut, cm);
+
+    Int const sumInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fSum);
+    N(.tp = nodBinding, .pl1 = n); N(.tp = nodBinding, .pl1 = acc);
+    Int const ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 2); N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = acc);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 8);
+    N(.tp = nodExpr, .pl2 = 7);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodId, .pl1 = acc); N(.tp = tokInt, .pl2 = 3); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fSum, .pl2 = 2);
+    addFunction(fSum, sumInd, cm);
+
+    EyrProgram* prog = compileProgram("Compiling a tail call", cm, ct);
+    if (prog == null) {
+        return;
+    }
+#ifndef SSA // the IR doesn't emit tail calls yet
+    expectTrue("A call in tail position is a tail call",
+               countOps(iTailCall, 0, cm) == 1 && countOps(iCall, 0, cm) == 0, ct);
+    Long const ns[] = { 0, 5, 100, 3000000 };
+#else
+    Long const ns[] = { 0, 5, 100, 1000 };
+#endif
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    Bool isOk = true;
+    for (Int j = 0; j < 4 && isOk; j++) {
+        EyrValue result = eyrCall(prog, 0, (EyrValue[]){ { .tag = EYR_INT, .i = ns[j] },
+                                                         { .tag = EYR_INT, .i = 1 } }, 2, rt);
+        isOk = isInt(result, 3*ns[j] + 1);
+    }
+    expectTrue("Deep tail recursion runs in constant stack space", isOk, ct);
+    eyrFreeInterpreter(rt);
+}
+
+//}}}
+//{{{ Bounds
+
+#ifndef SSA // the IR doesn't support lists yet
+
+private void
+addListSum(EntityId fn, Int step, EntityId n, EntityId lst, EntityId tmp, EntityId acc, EntityId i,
+           Compiler* cm) {
+// fn n = lst = [3 1 4 1 5]; acc~ = 0; for i~ = 0; i < ##lst { acc = acc + lst[i]; i = i + step };
+//        return acc + lst[n]
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId size = findOperator(opSize, tokString);
+    EntityId getElem = typeAccessorEntity(opGetElem, cm);
+    Int const fnInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fn);
+    N(.tp = nodBinding, .pl1 = n);
+    addListLiteral(lst, tmp, 5, (Int[]){ 3, 1, 4, 1, 5 }, -1, cm);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 4);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodId, .pl1 = lst); N(.tp = nodCall, .pl1 = size, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 7, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 5); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = lst);
+        N(.tp = nodId, .pl1 = i); N(.tp = nodCall, .pl1 = getElem, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = step);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    closeFor(forInd, scopeInd, bodyInd, cm);
+    N(.tp = nodReturn, .pl2 = 6);
+    N(.tp = nodExpr, .pl2 = 5); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = lst);
+        N(.tp = nodId, .pl1 = n); N(.tp = nodCall, .pl1 = getElem, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    addFunction(fn, fnInd, cm);
+}
+
+
+private void
+boundsTests(TestContext* ct) {
+// Only the access in the loop with the step of 1 loses its bounds check
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    TypeId intList = tCreateSingleParamTypeCall(0, tokInt, cm);
+    TypeId intOfInt = addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm);
+    EntityId fns[2];
+    for (Int k = 0; k < 2; k++) {
+        fns[k] = addEntity(intOfInt, classImmut, cm);
+    }
+    for (Int k = 0; k < 2; k++) {
+        addListSum(fns[k], k + 1, addEntity(tokInt, classImmut, cm),
+                   addEntity(intList, classImmut, cm), addEntity(intList, classImmut, cm),
+                   addEntity(tokInt, classMut, cm), addEntity(tokInt, classMut, cm), cm);
+    }
+    EyrProgram* prog = compileProgram("Compiling loops over a list", cm, ct);
+    if (prog == null) {
+        return;
+    }
+    expectTrue("A loop with the step of 1 accesses the list without checks",
+               countOps(iGetElemUnchecked, 0, cm) == 1 && countOps(iGetElem, 0, cm) == 1, ct);
+    expectTrue("A loop with the step of 2 keeps the checks",
+               countOps(iGetElemUnchecked, 1, cm) == 0 && countOps(iGetElem, 1, cm) == 2, ct);
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    expectTrue("Loops over a list", isInt(callInt(prog, 0, 0, rt), 17)
+               && isInt(callInt(prog, 0, 4, rt), 19) && isInt(callInt(prog, 1, 1, rt), 13), ct);
+    EyrValue result = callInt(prog, 0, 5, rt);
+    expectTrue("An access outside the loop is still checked", result.tag == EYR_ERROR
+               && equal(result.str, str(errIndexOutOfBounds)), ct);
+    eyrFreeInterpreter(rt);
+}
+
+#endif
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  BYTECODE TEST  --\n");
+    printf("----------------------------\n");
+
+    initCompiler();
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+
+    programTests(&ct);
+    slotTests(&ct);
+    longStringTest(LOWER24BITS, &ct);
+    longStringTest(LOWER24BITS + 1, &ct);
+    foldingTests(&ct);
+    constantTests(&ct);
+    endlessConstantTest(&ct);
+    deadCodeTests(&ct);
+    inliningTests(&ct);
+    loopTests(&ct);
+    joinTests(&ct);
+#ifndef SSA
+    listTests(&ct);
+    boundsTests(&ct);
+#endif
+    tailCallTests(&ct);
+
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// Tests of the C backend. The ASTs are built by hand, the emitted C is compiled with the system
+// compiler and run, and the output of the program is checked
+#include "../eyr.c"
+#include "eyrTest.h"
+
+//{{{ Utils
+
+#define N(...) addNode((Node){__VA_ARGS__}, (SourceLoc){0}, cm)
+#define C_TEST_DIR_TEMPLATE "/tmp/eyrCBackendXXXXXX"
+
+
+private EntityId
+findOperator(Int opId, TypeId paramType) {
+// The operator overload with the given type of first parameter
+    for (Int e = 0; e < PROTO.entities.len; e++) {
+        TypeId fnType = PROTO.entities.cont[e].typeId;
+        if (cOperatorOf(e) == opId
+                && PROTO.types.cont[tGetIndexOfFnFirstParam(fnType, &PROTO)] == paramType) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+
+private EntityId
+findPrint(TypeId paramType, Compiler* cm) {
+    for (Int e = PROTO.entities.len; e < cm->stats.countNonparsedEntities; e++) {
+        Entity ent = cm->entities.cont[e];
+        if (ent.name == nameOfStandard(strPrint)
+                && cm->types.cont[tGetIndexOfFnFirstParam(ent.typeId, cm)] == paramType) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+
+private EntityId
+addEntity(TypeId typeId, Byte class, Compiler* cm) {
+    EntityId result = cm->entities.len;
+    pushInentities((Entity){ .typeId = typeId, .class = class }, cm);
+    return result;
+}
+
+
+private Compiler*
+createCompiler(char const* sourceCode, Arena* a) {
+// A compiler with the Prelude but no parsed nodes, so the tests can add their own
+    Compiler* cm = lexicallyAnalyze(str(sourceCode), a);
+    initializeParser(cm, a);
+    cm->stats.countNonparsedEntities = cm->entities.len;
+    return cm;
+}
+
+
+private void
+addStringLiteral(Compiler* cm) {
+// The first string literal of the source code
+    Int j = 0;
+    for (; j < cm->tokens.len && cm->tokens.cont[j].tp != tokString; j++) {}
+    Token tk = cm->tokens.cont[j];
+    addNode((Node){ .tp = tokString }, (SourceLoc){ .startBt = tk.startBt, .lenBts = tk.lenBts }, cm);
+}
+
+
+private String
+runProgram(String cCode, Arena* a) {
+// Compiles the C code with the system compiler and runs it. Returns the stdout of the program,
+// or "compilation failed"
+    char dir[] = C_TEST_DIR_TEMPLATE;
+    if (mkdtemp(dir) == null) {
+        return s("compilation failed");
+    }
+    String srcName = stringOfFormat(a, "%s/prog.c", dir);
+    String runtimeName = stringOfFormat(a, "%s/" C_RUNTIME_NAME, dir);
+    writeTextFile(srcName, cCode);
+    writeTextFile(runtimeName, (String){ .cont = C_RUNTIME, .len = sizeof(C_RUNTIME) - 1 });
+    String cmd = stringOfFormat(a, "cc -O2 -fwrapv -w -o %s/prog %s/prog.c && %s/prog",
+                                dir, dir, dir);
+    FILE* pipe = popen(cmd.cont, "r");
+    StringBuilder* sb = createStringBuilder(64, a);
+    char buf[256];
+    size_t len;
+    while (pipe != null && (len = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        sbAppend((String){ .cont = buf, .len = (Int)len }, sb);
+    }
+    Bool const isOk = pipe != null && pclose(pipe) == 0;
+    system(stringOfFormat(a, "rm -rf %s", dir).cont);
+    return isOk ? stringOfBuilder(sb) : s("compilation failed");
+}
+
+
+private void
+expectOutput(char const* name, Compiler* cm, char const* expected, TestContext* ct) {
+    String cCode = emitC(cm);
+    String output = cCode.len > 0 ? runProgram(cCode, ct->a) : cm->stats.errMsg;
+    if (!expectTrue(name, equal(output, str(expected)), ct)) {
+        printString(cCode);
+        printf("Output:\n");
+        printString(output);
+        printf("But expected:\n%s\n", expected);
+    }
+}
+
+//}}}
+//{{{ Programs
+
+private void
+loopsTest(TestContext* ct) {
+// A global string, a loop, recursion and string concatenation
+    Compiler* cm = createCompiler("a = `he\"llo`", ct->a);
+    EntityId lt = findOperator(opLessTh, tokInt);
+    EntityId minus = findOperator(opMinus, tokInt);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId plusStr = findOperator(opPlus, tokString);
+    EntityId toStr = findOperator(opToString, tokInt);
+    EntityId printInt = findPrint(tokInt, cm);
+    EntityId printStr = findPrint(tokString, cm);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokMisc }, cm), classImmut, cm);
+    EntityId fFib = addEntity(addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    EntityId i = addEntity(tokInt, classMut, cm);
+    EntityId acc = addEntity(tokInt, classMut, cm);
+    EntityId greeting = addEntity(tokString, classImmut, cm);
+
+    // greeting = `he"llo`
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = greeting);
+    addStringLiteral(cm);
+
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc); N(.tp = tokInt);
+    // for i~ = 0; i < 30 { acc = acc + fib i; i = i + 1 }
+    Int const forInd = cm->nodes.len;
+    N(.tp = nodFor);
+    Int const scopeInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 2, .pl3 = 2); N(.tp = nodBinding, .pl1 = i); N(.tp = tokInt);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 30); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    Int const bodyInd = cm->nodes.len;
+    N(.tp = nodScope);
+    N(.tp = nodAssignment, .pl2 = 6, .pl3 = 2); N(.tp = nodBinding, .pl1 = acc);
+        N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = acc); N(.tp = nodId, .pl1 = i);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = i);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = nodId, .pl1 = i); N(.tp = tokInt, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    setSpanLengthParser(bodyInd, cm);
+    setSpanLengthParser(scopeInd, cm);
+    setSpanLengthParser(forInd, cm);
+    cm->nodes.cont[forInd].pl3 = bodyInd - forInd;
+    // print (greeting + $acc); print acc
+    N(.tp = nodExpr, .pl2 = 5); N(.tp = nodId, .pl1 = greeting); N(.tp = nodId, .pl1 = acc);
+        N(.tp = nodCall, .pl1 = toStr, .pl2 = 1); N(.tp = nodCall, .pl1 = plusStr, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = printStr, .pl2 = 1);
+    N(.tp = nodExpr, .pl2 = 2); N(.tp = nodId, .pl1 = acc); N(.tp = nodCall, .pl1 = printInt, .pl2 = 1);
+    setSpanLengthParser(mainInd, cm);
+
+    // fib n = if n < 2 { return n }; return fib(n - 1) + fib(n - 2)
+    Int const fibInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fFib);
+    N(.tp = nodBinding, .pl1 = n);
+    Int const ifInd = cm->nodes.len;
+    N(.tp = nodIf);
+    N(.tp = nodExpr, .pl2 = 3);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = lt, .pl2 = 2);
+    N(.tp = nodScope, .pl2 = 2); N(.tp = nodReturn, .pl2 = 1); N(.tp = nodId, .pl1 = n);
+    setSpanLengthParser(ifInd, cm);
+    N(.tp = nodReturn, .pl2 = 10);
+    N(.tp = nodExpr, .pl2 = 9);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodId, .pl1 = n); N(.tp = tokInt, .pl2 = 2); N(.tp = nodCall, .pl1 = minus, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = fFib, .pl2 = 1);
+        N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    setSpanLengthParser(fibInd, cm);
+
+    pushIntoplevels((Assignment){ .entityId = fMain, .nodeInd = mainInd, .isFunction = true }, cm);
+    pushIntoplevels((Assignment){ .entityId = fFib, .nodeInd = fibInd, .isFunction = true }, cm);
+    expectOutput("Loops, recursion and strings", cm, "he\"llo1346268\n1346268\n", ct);
+}
+
+
+private void
+arithmeticTest(TestContext* ct) {
+// Integers wrap around, and the division of the smallest one by -1 doesn't trap
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId plus = findOperator(opPlus, tokInt);
+    EntityId divBy = findOperator(opDivBy, tokInt);
+    EntityId remainder = findOperator(opRemainder, tokInt);
+    EntityId printInt = findPrint(tokInt, cm);
+    EntityId fMain = addEntity(addConcrFnType(0, (Int[]){ tokMisc }, cm), classImmut, cm);
+    EntityId x = addEntity(tokInt, classImmut, cm);
+
+    Int const mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    // x = 9223372036854775807 + 1
+    N(.tp = nodAssignment, .pl2 = 5, .pl3 = 2); N(.tp = nodBinding, .pl1 = x);
+        N(.tp = nodExpr, .pl2 = 3); N(.tp = tokInt, .pl1 = 0x7FFFFFFF, .pl2 = -1);
+        N(.tp = tokInt, .pl2 = 1); N(.tp = nodCall, .pl1 = plus, .pl2 = 2);
+    N(.tp = nodExpr, .pl2 = 2); N(.tp = nodId, .pl1 = x); N(.tp = nodCall, .pl1 = printInt, .pl2 = 1);
+    // print (x / -1); print (x % -1); print (-7 / 2)
+    N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = x); N(.tp = tokInt, .pl1 = -1, .pl2 = -1);
+        N(.tp = nodCall, .pl1 = divBy, .pl2 = 2); N(.tp = nodCall, .pl1 = printInt, .pl2 = 1);
+    N(.tp = nodExpr, .pl2 = 4); N(.tp = nodId, .pl1 = x); N(.tp = tokInt, .pl1 = -1, .pl2 = -1);
+        N(.tp = nodCall, .pl1 = remainder, .pl2 = 2); N(.tp = nodCall, .pl1 = printInt, .pl2 = 1);
+    N(.tp = nodExpr, .pl2 = 4); N(.tp = tokInt, .pl1 = -1, .pl2 = -7); N(.tp = tokInt, .pl2 = 2);
+        N(.tp = nodCall, .pl1 = divBy, .pl2 = 2); N(.tp = nodCall, .pl1 = printInt, .pl2 = 1);
+    setSpanLengthParser(mainInd, cm);
+
+    pushIntoplevels((Assignment){ .entityId = fMain, .nodeInd = mainInd, .isFunction = true }, cm);
+    expectOutput("Wrapping arithmetic", cm,
+                 "-9223372036854775808\n-9223372036854775808\n0\n-3\n", ct);
+}
+
+
+private void
+errorTests(TestContext* ct) {
+    Compiler* cm = createCompiler("a = 1", ct->a);
+    EntityId fMain = addEntity(addConcrFnType(1, (Int[]){ tokMisc, tokInt }, cm), classImmut, cm);
+    EntityId n = addEntity(tokInt, classImmut, cm);
+    Int mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodBinding, .pl1 = n);
+    setSpanLengthParser(mainInd, cm);
+    pushIntoplevels((Assignment){ .entityId = fMain, .nodeInd = mainInd, .isFunction = true }, cm);
+    expectOutput("Entry function with params", cm, errCodegenEntryParams, ct);
+
+    cm = createCompiler("a = 1", ct->a);
+    fMain = addEntity(addConcrFnType(0, (Int[]){ tokMisc }, cm), classImmut, cm);
+    EntityId list = addEntity(tokInt, classImmut, cm);
+    mainInd = cm->nodes.len;
+    N(.tp = nodFnDef, .pl1 = fMain);
+    N(.tp = nodAssignment, .pl2 = 3, .pl3 = 2); N(.tp = nodBinding, .pl1 = list);
+        N(.tp = nodDataAlloc, .pl2 = 1); N(.tp = tokInt, .pl2 = 1);
+    setSpanLengthParser(mainInd, cm);
+    pushIntoplevels((Assignment){ .entityId = fMain, .nodeInd = mainInd, .isFunction = true }, cm);
+    expectOutput("List allocation is unsupported", cm, errCodegenUnsupported, ct);
+}
+
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  C BACKEND TEST  --\n");
+    printf("----------------------------\n");
+
+    initCompiler();
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+
+    loopsTest(&ct);
+    arithmeticTest(&ct);
+    errorTests(&ct);
+
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
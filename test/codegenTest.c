@@ -25,8 +25,8 @@ typedef struct {
 //}}}
 //{{{ Utils
 
-#define S   70000000 // A constant larger than the largest allowed file size. Separates parsed
-                     // names from others
+#define S   BIG // Above any count of names, like in the compiler. Separates parsed names
+                // from others
 
 
 private CodegenTestSet* createTestSet0(String name, Arena *a, int count, Arr(CodegenTest) tests) {
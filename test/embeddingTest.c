@@ -0,0 +1,337 @@
+// Tests of the embedding API in eyr.h. The programs are hand-assembled bytecode with typed
+// toplevel functions, because only the parts of the compiler after the parser are under test.
+// Also tests compiling on several threads at once
+#include "../eyr.c"
+#include "eyrTest.h"
+#include <sys/resource.h>
+#include <pthread.h>
+
+//{{{ Utils
+
+#define I3(op, a, b, c) bcInstr3(op, a, b, c)
+#define I2(op, a, k) bcInstr2(op, a, k)
+
+
+private Long
+peakMemory(void) {
+// In KB
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+
+private Bool
+isString(EyrValue value, char const* expected) {
+    return value.tag == EYR_STRING && equal(value.str, str(expected));
+}
+
+
+private Bool
+isError(EyrValue value, char const* expected) {
+    return value.tag == EYR_ERROR && equal(value.str, str(expected));
+}
+
+
+#define FN_NAMES "greet add divide churn"
+
+private EyrProgram*
+buildProgram(Arena* a) {
+// Four functions after the entry one: greet(s String) String = s + "BBCC",
+// add(x Int, y Int) Int, divide(x Int, y Int) Int, and churn(n Int) Int which makes n*14 words of
+// garbage and returns 0
+    Compiler* cm = lexicallyAnalyze(s(FN_NAMES), a);
+    initializeParser(cm, a);
+    Ulong code[] = {
+        1, I2(iReturn, 3, 0),
+        4, I2(iSetLocal, 5, 4), I3(iNewstring, 4, 5, 4), I3(iConcatStrs, 4, 3, 4), I2(iReturn, 4, 1),
+        2, I3(iPlus, 3, 3, 4), I2(iReturn, 3, 1),
+        2, I3(iDivBy, 3, 3, 4), I2(iReturn, 3, 1),
+        8, I2(iSetLocal, 4, 0), I3(iNewstring, 5, 4, 4), I3(iNewstring, 6, 4, 8),
+        I3(iConcatStrs, 6, 6, 5), I3(iReverseString, 6, 6, 0), I2(iMinusConst, 3, 1),
+        I2(iBranchGt, 3, 15), I2(iReturn, 3, 1) };
+    Int ptrMaps[] = { 0, 0,  2, 1, 3, 4,  0, 0,  0, 0,  2, 0, 5, 6 };
+    cm->bytecode = createInListUlong(sizeof(code)/sizeof(Ulong), a);
+    for (Int j = 0; j < (Int)(sizeof(code)/sizeof(Ulong)); j++) {
+        pushInbytecode(code[j], cm);
+    }
+    cm->ptrMaps = createInListInt(sizeof(ptrMaps)/sizeof(Int), a);
+    for (Int j = 0; j < (Int)(sizeof(ptrMaps)/sizeof(Int)); j++) {
+        pushInptrMaps(ptrMaps[j], cm);
+    }
+    cm->staticText = createStringBuilder(16, a);
+    sbAppend(s("asdfBBCC"), cm->staticText);
+
+    TypeId types[] = {
+        addConcrFnType(0, (Int[]){ tokMisc }, cm),
+        addConcrFnType(1, (Int[]){ tokString, tokString }, cm),
+        addConcrFnType(2, (Int[]){ tokInt, tokInt, tokInt }, cm),
+        addConcrFnType(2, (Int[]){ tokInt, tokInt, tokInt }, cm),
+        addConcrFnType(1, (Int[]){ tokInt, tokInt }, cm) };
+    Int const textStart = sizeof(standardText) - 1;
+    NameSpan names[] = { // the entry function has no name of its own
+        nameSpanOf(textStart, 0),
+        nameSpanOf(textStart, 5),
+        nameSpanOf(textStart + 6, 3),
+        nameSpanOf(textStart + 10, 6),
+        nameSpanOf(textStart + 17, 5) };
+    for (Int k = 0; k < 5; k++) {
+        EntityId fn = cm->entities.len;
+        pushInentities((Entity){ .typeId = types[k], .class = classImmut }, cm);
+        Int const nameId = cm->stringTable->len;
+        push(names[k], cm->stringTable);
+        pushIntoplevels((Assignment){ .entityId = fn, .nameId = nameId, .isFunction = true }, cm);
+    }
+    EyrProgram* prog = allocate(EyrProgram, a);
+    (*prog) = (EyrProgram){ .cm = cm, .a = a };
+    return prog;
+}
+
+//}}}
+//{{{ Calls
+
+private void
+callTests(TestContext* ct) {
+    EyrProgram* prog = buildProgram(ct->a);
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    Int const greet = eyrFindFunction(prog, s("greet"), 1);
+    Int const add = eyrFindFunction(prog, s("add"), 2);
+    Int const divide = eyrFindFunction(prog, s("divide"), 2);
+    expectTrue("Finding functions", greet == 1 && add == 2 && divide == 3, ct);
+    expectTrue("Finding functions with a wrong arity or name",
+               eyrFindFunction(prog, s("greet"), 2) == -1
+               && eyrFindFunction(prog, s("gree"), 1) == -1, ct);
+
+    EyrValue result = eyrCall(prog, add, (EyrValue[]){ { .tag = EYR_INT, .i = 40 },
+                                                       { .tag = EYR_INT, .i = 2 } }, 2, rt);
+    expectTrue("Int args and result", result.tag == EYR_INT && result.i == 42, ct);
+    result = eyrCall(prog, greet, (EyrValue[]){ { .tag = EYR_STRING, .str = s("hello ") } }, 1, rt);
+    expectTrue("String args and result", isString(result, "hello BBCC"), ct);
+
+    result = eyrCall(prog, add, (EyrValue[]){ { .tag = EYR_INT, .i = 40 },
+                                              { .tag = EYR_STRING, .str = s("x") } }, 2, rt);
+    expectTrue("Wrong argument type", isError(result, "wrong argument type"), ct);
+    result = eyrCall(prog, add, (EyrValue[]){ { .tag = EYR_INT, .i = 40 } }, 1, rt);
+    expectTrue("Wrong number of arguments", isError(result, "wrong number of arguments"), ct);
+    result = eyrCall(prog, 5, null, 0, rt);
+    expectTrue("No such function", isError(result, "no such function"), ct);
+
+    result = eyrCall(prog, divide, (EyrValue[]){ { .tag = EYR_INT, .i = 1 },
+                                                 { .tag = EYR_INT, .i = 0 } }, 2, rt);
+    expectTrue("A runtime error", isError(result, errDivisionByZero), ct);
+    result = eyrCall(prog, divide, (EyrValue[]){ { .tag = EYR_INT, .i = 84 },
+                                                 { .tag = EYR_INT, .i = 2 } }, 2, rt);
+    expectTrue("The interpreter is usable after an error",
+               result.tag == EYR_INT && result.i == 42, ct);
+
+    EyrProgram* otherProg = buildProgram(ct->a);
+    result = eyrCall(otherProg, add, (EyrValue[]){ { .tag = EYR_INT, .i = 40 },
+                                                   { .tag = EYR_INT, .i = 2 } }, 2, rt);
+    expectTrue("An interpreter of another program",
+               isError(result, "the interpreter belongs to another program"), ct);
+    eyrFreeInterpreter(rt);
+}
+
+
+private void
+reuseTests(TestContext* ct) {
+// Many calls on one interpreter, some in a region
+    EyrProgram* prog = buildProgram(ct->a);
+    Interpreter* rt = eyrCreateInterpreter(prog);
+    EyrValue result = { .tag = EYR_VOID };
+    Bool isOk = true;
+    for (Int j = 0; j < 500000 && isOk; j++) {
+        result = eyrCall(prog, 1, (EyrValue[]){ { .tag = EYR_STRING, .str = s("hello ") } }, 1, rt);
+        isOk = isString(result, "hello BBCC");
+    }
+    expectTrue("Many calls on one interpreter", isOk && rt->countCollections > 0
+               && rt->heapEnd - rt->heapStart == VM_HEAP_INIT_SIZE, ct);
+
+    RtRegion region = rtRegionMark(rt);
+    EyrPtr const top = rt->heapTop;
+    for (Int j = 0; j < 500000 && isOk; j++) {
+        result = eyrCall(prog, 1, (EyrValue[]){ { .tag = EYR_STRING, .str = s("hello ") } }, 1, rt);
+        isOk = isString(result, "hello BBCC");
+        rtRegionReset(region, rt);
+    }
+    expectTrue("Many calls in a region", isOk && rt->heapTop == top, ct);
+    rtRegionEnd(region, rt);
+    eyrFreeInterpreter(rt);
+
+    String errMsg = empty;
+    expectTrue("Compiling a broken program", eyrCompile(s("f = (("), &errMsg) == null
+                                              && errMsg.len > 0, ct);
+    Long const memoryBefore = peakMemory();
+    for (Int j = 0; j < 2000; j++) {
+        eyrCompile(s("f = (("), &errMsg);
+        Interpreter broken = compile(s("f = (("));
+        freeInterpreter(&broken);
+    }
+    Long const memoryGrowth = peakMemory() - memoryBefore;
+    if (!expectTrue("Broken programs don't keep their arenas", memoryGrowth < 16*1024, ct)) {
+        printf("The peak memory grew by %lld KB\n", (long long)memoryGrowth);
+    }
+}
+
+//}}}
+//{{{ Pool
+
+private void
+poolTests(TestContext* ct) {
+    EyrProgram* prog = buildProgram(ct->a);
+    EyrPool* pool = eyrCreatePool(prog, 4);
+    Int const countJobs = 20000;
+    EyrValue* results = allocateArray(countJobs, EyrValue, ct->a);
+    for (Int j = 0; j < countJobs; j++) {
+        eyrSubmit(pool, 2, (EyrValue[]){ { .tag = EYR_INT, .i = j }, { .tag = EYR_INT, .i = 1 } }, 2,
+                  &results[j]);
+    }
+    eyrWaitAll(pool);
+    Bool isOk = true;
+    for (Int j = 0; j < countJobs; j++) {
+        isOk = isOk && results[j].tag == EYR_INT && results[j].i == j + 1;
+    }
+    expectTrue("Many jobs", isOk, ct);
+
+    for (Int j = 0; j < countJobs; j++) {
+        eyrSubmit(pool, 1, (EyrValue[]){ { .tag = EYR_STRING, .str = s("hello ") } }, 1,
+                  &results[j]);
+    }
+    eyrWaitAll(pool);
+    isOk = true;
+    for (Int j = 0; j < countJobs; j++) {
+        isOk = isOk && isString(results[j], "hello BBCC");
+        free((char*)results[j].str.cont);
+    }
+    expectTrue("Many jobs with string results", isOk, ct);
+
+    // Every job makes 2.5M*14 words of garbage, much more than a region grows the heap to
+    Long const memoryBefore = peakMemory();
+    for (Int j = 0; j < 8; j++) {
+        eyrSubmit(pool, 4, (EyrValue[]){ { .tag = EYR_INT, .i = 2500000 } }, 1, &results[j]);
+    }
+    eyrWaitAll(pool);
+    isOk = true;
+    for (Int j = 0; j < 8; j++) {
+        isOk = isOk && results[j].tag == EYR_INT && results[j].i == 0;
+    }
+    Long const memoryGrowth = peakMemory() - memoryBefore;
+    if (!expectTrue("Jobs with lots of garbage keep the heaps bounded",
+                    isOk && memoryGrowth < 4*4*2*VM_REGION_HEAP_LIMIT/1024, ct)) {
+        printf("The peak memory grew by %lld KB\n", (long long)memoryGrowth);
+    }
+    eyrFreePool(pool);
+}
+
+//}}}
+//{{{ Threads
+
+#define COUNT_COMPILE_THREADS 8
+#define COUNT_COMPILES 60 // per thread
+#define COUNT_CONSTANTS 1000 // per program, so that a compile takes long enough to be interrupted
+#define THREAD_SOURCE_CAP 32768
+
+typedef struct { //:CompileJob
+    Int first; // the number of the first source, see "threadSource"
+    EyrProgram* progs[COUNT_COMPILES];
+    String errMsgs[COUNT_COMPILES];
+} CompileJob;
+
+
+private String
+threadSource(Int n, char* buf) {
+// Constants which differ by @n. Every third program then has a lexer error at the end, and every
+// third one a parse error
+    Int len = 0;
+    for (Int j = 0; j < COUNT_CONSTANTS; j++) {
+        len += sprintf(buf + len, "x%d = %d;\n", j, n + j);
+    }
+    if (n % 3 == 1) {
+        len += sprintf(buf + len, "f = ((");
+    } ei (n % 3 == 2) {
+        len += sprintf(buf + len, "def main = {{}\n    x = 9;\n};\n");
+    }
+    return (String){ .cont = buf, .len = len };
+}
+
+
+private void*
+compileMany(void* arg) {
+    CompileJob* job = arg;
+    char buf[THREAD_SOURCE_CAP];
+    for (Int j = 0; j < COUNT_COMPILES; j++) {
+        job->progs[j] = eyrCompile(threadSource(job->first + j, buf), OUT &job->errMsgs[j]);
+    }
+    return null;
+}
+
+
+private void
+threadTests(TestContext* ct) {
+// Compiles on several threads at once, then again on this one, which must give the same results.
+// Runs before anything else has called "initCompiler", so the threads race to do it
+    CompileJob* jobs = allocateArray(COUNT_COMPILE_THREADS, CompileJob, ct->a);
+    pthread_t threads[COUNT_COMPILE_THREADS];
+    for (Int k = 0; k < COUNT_COMPILE_THREADS; k++) {
+        jobs[k].first = k*COUNT_COMPILES;
+        pthread_create(&threads[k], null, &compileMany, &jobs[k]);
+    }
+    for (Int k = 0; k < COUNT_COMPILE_THREADS; k++) {
+        pthread_join(threads[k], null);
+    }
+
+    Bool isOk = true;
+    Int countGood = 0;
+    char buf[THREAD_SOURCE_CAP];
+    for (Int k = 0; k < COUNT_COMPILE_THREADS; k++) {
+        for (Int j = 0; j < COUNT_COMPILES; j++) {
+            Int const n = jobs[k].first + j;
+            String errMsg = empty;
+            EyrProgram* expected = eyrCompile(threadSource(n, buf), OUT &errMsg);
+            EyrProgram* prog = jobs[k].progs[j];
+            if (n % 3 == 0) {
+                isOk = isOk && expected != null && prog != null && jobs[k].errMsgs[j].len == 0
+                       && equalityLexer(*prog->cm, *expected->cm) == -2
+                       && equalityParser(prog->cm, expected->cm, false) == -2;
+                countGood += prog != null;
+            } else {
+                isOk = isOk && expected == null && prog == null
+                       && equal(jobs[k].errMsgs[j], s(n % 3 == 1 ? "lexer error" : "parse error"))
+                       && equal(jobs[k].errMsgs[j], errMsg);
+            }
+            if (prog != null) {
+                eyrFreeProgram(prog);
+            }
+            if (expected != null) {
+                eyrFreeProgram(expected);
+            }
+        }
+    }
+    expectTrue("Compiling good and broken programs on several threads at once",
+               isOk && countGood == COUNT_COMPILE_THREADS*COUNT_COMPILES/3, ct);
+}
+
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  EMBEDDING TEST  --\n");
+    printf("----------------------------\n");
+
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+
+    threadTests(&ct); // first, see there
+    callTests(&ct);
+    reuseTests(&ct);
+    poolTests(&ct);
+
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
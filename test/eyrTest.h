@@ -12,6 +12,18 @@ typedef struct {
     Arena* a;
 } TestContext;
 
+private Bool
+expectTrue(char const* name, Bool cond, TestContext* ct) { //:expectTrue
+// Counts a test, and prints its name if it failed
+    ct->countTests += 1;
+    if (cond) {
+        ct->countPassed += 1;
+    } else {
+        printf("ERROR IN [%s]\n", name);
+    }
+    return cond;
+}
+
 String prepareInput(char const* content, Arena* a);
 Compiler* lexicallyAnalyze(String input, Arena*);
 void printLexer(Compiler* a);
@@ -90,7 +102,7 @@ Arr(Int) createOverloads(Compiler* restrict cm);
 CompStats getStats(Compiler* restrict cm);
 void setStats(CompStats stats, Compiler* restrict cm);
 Int getBinding(Int id, Compiler* restrict cm);
-void setLoc(SourceLoc loc, CM);
+void setLoc(Int j, SourceLoc loc, CM);
 void addTypeHeaderForTestFunction(Int arity, CM);
 void pushIntypes(Int v, CM);
 Int equalityParser(Compiler* a, Compiler* b, Bool compareLocsToo);
@@ -0,0 +1,350 @@
+// Tests of the bytecode images: writing a compiled program, mapping it and running it, and the
+// checks of broken images. The program is hand-assembled bytecode, like in the embedding tests.
+// Also tests the compilation cache, which stores the images of compiled source files
+#include "../eyr.c"
+#include "eyrTest.h"
+#include <dirent.h>
+
+//{{{ Utils
+
+#define I3(op, a, b, c) bcInstr3(op, a, b, c)
+#define I2(op, a, k) bcInstr2(op, a, k)
+
+
+private Compiler*
+buildProgram(String source, Arena* a) {
+// Two functions after the entry one: add(x Int, y Int) Int and bbcc() String = "BBCC".
+// The source is only lexed, for the image's header
+    Compiler* cm = lexicallyAnalyze(source, a);
+    initializeParser(cm, a);
+    Ulong code[] = {
+        1, I2(iReturn, 3, 0),
+        2, I3(iPlus, 3, 3, 4), I2(iReturn, 3, 1),
+        3, I2(iSetLocal, 4, 4), I3(iNewstring, 3, 4, 4), I2(iReturn, 3, 1) };
+    Int ptrMaps[] = { 0, 0,  0, 0,  1, 0, 3 };
+    cm->bytecode = createInListUlong(sizeof(code)/sizeof(Ulong), a);
+    for (Int j = 0; j < (Int)(sizeof(code)/sizeof(Ulong)); j++) {
+        pushInbytecode(code[j], cm);
+    }
+    cm->ptrMaps = createInListInt(sizeof(ptrMaps)/sizeof(Int), a);
+    for (Int j = 0; j < (Int)(sizeof(ptrMaps)/sizeof(Int)); j++) {
+        pushInptrMaps(ptrMaps[j], cm);
+    }
+    cm->staticText = createStringBuilder(16, a);
+    sbAppend(s("asdfBBCC"), cm->staticText);
+    return cm;
+}
+
+
+private String
+readFile(String fName, Arena* a) {
+// Empty if it can't be read
+    FILE* file = fopen(fName.cont, "rb");
+    if (file == null) {
+        return empty;
+    }
+    fseek(file, 0, SEEK_END);
+    Long const len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* content = allocateOnArena(len + 1, a);
+    Long const countRead = fread(content, 1, len, file);
+    fclose(file);
+    return (String){ .cont = content, .len = countRead == len ? len : 0 };
+}
+
+
+private void
+writeFile(String fName, Byte const* content, Long len) {
+    FILE* file = fopen(fName.cont, "wb");
+    fwrite(content, 1, len, file);
+    fclose(file);
+}
+
+
+private void
+writeResealed(String fName, Byte* content, Long len) {
+// Writes an image with its checksums made right again, so that only the other checks can fail
+    ImageHeader* hdr = (ImageHeader*)content;
+    hdr->checksum = hashFnv(content + sizeof(ImageHeader), len - sizeof(ImageHeader), FNV_BASIS);
+    hdr->headerChecksum = hashFnv(content, sizeof(ImageHeader) - sizeof(Ulong), FNV_BASIS);
+    writeFile(fName, content, len);
+}
+
+
+private String
+loadError(String fName) {
+    Interpreter rt = loadImage(fName);
+    String result = rt.errMsg;
+    freeInterpreter(&rt);
+    return result;
+}
+
+//}}}
+//{{{ Images
+
+private void
+runTests(String dir, TestContext* ct) {
+    Compiler* cm = buildProgram(s("a = 1"), ct->a);
+    String fName = stringOfFormat(ct->a, "%s/prog.eyri", dir.cont);
+    if (!expectTrue("Writing an image", writeImage(fName, cm), ct)) {
+        return;
+    }
+    String const content = readFile(fName, ct->a);
+
+    Interpreter rt = loadImage(fName);
+    if (!expectTrue("Loading an image", rt.errMsg.len == 0, ct)) {
+        printString(rt.errMsg);
+        return;
+    }
+    expectTrue("The code is run from the mapping", rt.image != null
+               && (Byte*)rt.code >= rt.image && (Byte*)rt.code < rt.image + rt.imageLen
+               && rt.textStart > (char*)rt.code
+               && rt.textStart < (char*)rt.image + rt.imageLen, ct);
+    interpretCode(&rt);
+    expectTrue("Running the entry function", rt.errMsg.len == 0, ct);
+    Unt result = rtCallFunction(1, (Unt[]){ 40, 2 }, 2, &rt);
+    expectTrue("Calling a function", rt.errMsg.len == 0 && result == 42, ct);
+    result = rtCallFunction(2, null, 0, &rt);
+    expectTrue("A string from the static text", rt.errMsg.len == 0 && rtDeref0(result, &rt) == 4
+               && memcmp(rtStringChars(result, &rt), "BBCC", 4) == 0, ct);
+    freeInterpreter(&rt);
+    expectTrue("Running an image doesn't change the file",
+               content.len > 0 && equal(readFile(fName, ct->a), content), ct);
+
+    // Only constants, which are baked into the code that uses them: so no functions at all
+    cm->bytecode.len = 0;
+    cm->ptrMaps.len = 0;
+    writeImage(fName, cm);
+    rt = loadImage(fName);
+    expectTrue("An image without code", rt.errMsg.len == 0 && rt.countFns == 0, ct);
+    interpretCode(&rt);
+    freeInterpreter(&rt);
+}
+
+
+private void
+brokenImageTests(String dir, TestContext* ct) {
+    Compiler* cm = buildProgram(s("a = 1"), ct->a);
+    String fName = stringOfFormat(ct->a, "%s/broken.eyri", dir.cont);
+    writeImage(fName, cm);
+    String const content = readFile(fName, ct->a);
+    Byte* bytes = allocateOnArena(content.len, ct->a);
+
+    memcpy(bytes, content.cont, content.len);
+    bytes[content.len - 3] ^= 1; // in the static text
+    writeFile(fName, bytes, content.len);
+    expectTrue("A changed byte", equal(loadError(fName), str(errImageCorrupt)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    ((ImageHeader*)bytes)->version += 1;
+    writeFile(fName, bytes, content.len);
+    expectTrue("Another version", equal(loadError(fName), str(errImageVersion)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    ((ImageHeader*)bytes)->magic = 0;
+    writeFile(fName, bytes, content.len);
+    expectTrue("Not an image", equal(loadError(fName), str(errImageVersion)), ct);
+
+    writeFile(fName, (Byte const*)content.cont, content.len - 8);
+    expectTrue("A truncated image", equal(loadError(fName), str(errImageCorrupt)), ct);
+    writeFile(fName, (Byte const*)content.cont, 4);
+    expectTrue("An image shorter than its header",
+               equal(loadError(fName), str(errImageRead)), ct);
+    unlink(fName.cont);
+    expectTrue("A missing image", equal(loadError(fName), str(errImageRead)), ct);
+
+    // The tables, with good checksums
+    ImageHeader hdr = *(ImageHeader*)content.cont;
+    Ulong codeOffset;
+    Ulong ptrMapsOffset;
+    Ulong textOffset;
+    imgLayout(hdr, OUT &codeOffset, OUT &ptrMapsOffset, OUT &textOffset);
+    Arr(Int) fns = (Arr(Int))(bytes + sizeof(ImageHeader));
+    Arr(Ulong) code = (Arr(Ulong))(bytes + codeOffset);
+    Arr(Int) ptrMaps = (Arr(Int))(bytes + ptrMapsOffset);
+
+    memcpy(bytes, content.cont, content.len);
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A resealed image is fine", loadError(fName).len == 0, ct);
+
+    memcpy(bytes, content.cont, content.len);
+    fns[2] = hdr.codeLen + 100;
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A function outside the code", equal(loadError(fName), str(errImageCorrupt)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    fns[1] = 1; // inside the entry function
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A function not at a function start",
+               equal(loadError(fName), str(errImageCorrupt)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    code[fns[2]] = 1000; // the last function's length
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A function running past the code",
+               equal(loadError(fName), str(errImageCorrupt)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    ptrMaps[4] = 2; // the last map has only one slot
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A pointer map running past its section",
+               equal(loadError(fName), str(errImageCorrupt)), ct);
+
+    memcpy(bytes, content.cont, content.len);
+    ptrMaps[6] = -1;
+    writeResealed(fName, bytes, content.len);
+    expectTrue("A pointer map with a negative slot",
+               equal(loadError(fName), str(errImageCorrupt)), ct);
+    unlink(fName.cont);
+}
+
+//}}}
+//{{{ Cache
+
+#define CACHED_SOURCE "not compiled, because its image is in the cache"
+#define COMPILED_SOURCE "x = 9;\ny = x*2 + 1;"
+
+
+private Bool
+isSha256(char const* data, char const* hex) {
+    Byte digest[32];
+    sha256((Byte const*)data, strlen(data), OUT digest);
+    char result[65];
+    for (Int k = 0; k < 32; k++) {
+        sprintf(result + 2*k, "%02x", digest[k]);
+    }
+    return strcmp(result, hex) == 0;
+}
+
+
+private void
+sha256Tests(TestContext* ct) {
+// The FIPS 180-2 examples, and lengths around the end of a block
+    expectTrue("SHA-256 of nothing", isSha256("",
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"), ct);
+    expectTrue("SHA-256 of one block", isSha256("abc",
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), ct);
+    expectTrue("SHA-256 of two blocks", isSha256(
+            "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), ct);
+    expectTrue("SHA-256 of 64 bytes", isSha256(
+            "0123456701234567012345670123456701234567012345670123456701234567",
+            "8182cadb21af0e37c06414ece08e19c65bdb22c396d48ba7341012eea9ffdfdd"), ct);
+}
+
+
+
+private Int
+countFiles(String dir, OUT String* lastName, Arena* a) {
+// The number of files in a dir, and the path of the last one listed
+    DIR* d = opendir(dir.cont);
+    Int result = 0;
+    for (struct dirent* entry = readdir(d); entry != null; entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            result += 1;
+            *lastName = stringOfFormat(a, "%s/%s", dir.cont, entry->d_name);
+        }
+    }
+    closedir(d);
+    return result;
+}
+
+
+private void
+cacheTests(String dir, TestContext* ct) {
+// The parts of the cache that don't need the front end: the source file's image is stored by hand
+    String const cacheDir = stringOfFormat(ct->a, "%s/cache", dir.cont);
+    mkdir(cacheDir.cont, 0755);
+    String const fName = stringOfFormat(ct->a, "%s/prog.eyr", dir.cont);
+    writeFile(fName, (Byte const*)CACHED_SOURCE, sizeof(CACHED_SOURCE) - 1);
+
+    setenv("EYR_CACHE_DIR", "", 1);
+    expectTrue("An empty cache dir turns the cache off",
+               imgCachePath(CACHED_SOURCE, sizeof(CACHED_SOURCE) - 1, ct->a).len == 0, ct);
+    setenv("EYR_CACHE_DIR", cacheDir.cont, 1);
+    String const path = imgCachePath(CACHED_SOURCE, sizeof(CACHED_SOURCE) - 1, ct->a);
+    expectTrue("Cache files are named by the source", path.len > cacheDir.len
+               && equal(imgCachePath(CACHED_SOURCE, sizeof(CACHED_SOURCE) - 1, ct->a), path)
+               && !equal(imgCachePath(CACHED_SOURCE " ", sizeof(CACHED_SOURCE), ct->a), path),
+               ct);
+
+    Compiler* cm = buildProgram(s(CACHED_SOURCE), ct->a);
+    imgCacheStore(path, cm);
+    imgCacheStore(path, cm);
+    String stored = empty;
+    expectTrue("Storing an image leaves no temp files",
+               countFiles(cacheDir, OUT &stored, ct->a) == 1 && equal(stored, path), ct);
+
+    Interpreter rt = compileFile(fName);
+    Bool isOk = rt.errMsg.len == 0 && rt.image != null;
+    if (isOk) {
+        interpretCode(&rt);
+        isOk = rt.errMsg.len == 0 && rtCallFunction(1, (Unt[]){ 40, 2 }, 2, &rt) == 42;
+    }
+    expectTrue("A hit runs the stored image", isOk, ct);
+    freeInterpreter(&rt);
+
+    String const image = readFile(path, ct->a);
+    writeFile(path, (Byte const*)image.cont, image.len - 1);
+    rt = compileFile(fName);
+    expectTrue("A broken image in the cache isn't used", rt.image == null, ct);
+    freeInterpreter(&rt);
+
+    // As if another source had the same file name
+    imgCacheStore(path, buildProgram(s("a = 1"), ct->a));
+    rt = compileFile(fName);
+    expectTrue("An image of another source isn't used", rt.image == null, ct);
+    freeInterpreter(&rt);
+    unlink(path.cont);
+
+    writeFile(fName, (Byte const*)COMPILED_SOURCE, sizeof(COMPILED_SOURCE) - 1);
+    rt = compileFile(fName);
+    expectTrue("A miss is run from the image it stores", rt.errMsg.len == 0 && rt.image != null
+               && rt.aCompiler == null && countFiles(cacheDir, OUT &stored, ct->a) == 1, ct);
+    freeInterpreter(&rt);
+    unlink(stored.cont);
+
+    setenv("EYR_CACHE_DIR", "", 1);
+    rt = compileFile(fName);
+    expectTrue("Without the cache, the interpreter owns the compiler's arena",
+               rt.errMsg.len == 0 && rt.image == null && rt.aCompiler != null, ct);
+    freeInterpreter(&rt);
+
+    unlink(path.cont);
+    rmdir(cacheDir.cont);
+    unlink(fName.cont);
+}
+
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  IMAGE TEST  --\n");
+    printf("----------------------------\n");
+
+    initCompiler();
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+    char dirName[] = "/tmp/eyrImageTestXXXXXX";
+    if (mkdtemp(dirName) == null) {
+        print("Could not create a temp dir");
+        return 1;
+    }
+    String const dir = str(dirName);
+
+    sha256Tests(&ct);
+    runTests(dir, &ct);
+    brokenImageTests(dir, &ct);
+    cacheTests(dir, &ct);
+
+    unlink(stringOfFormat(ct.a, "%s/prog.eyri", dirName).cont);
+    rmdir(dirName);
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
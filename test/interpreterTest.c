@@ -0,0 +1,460 @@
+#include "../eyr.c"
+#include "eyrTest.h"
+
+// The programs here are hand-assembled bytecode, so these tests don't depend on the parser.
+// The Makefile builds this file with each dispatch mode of "interpretCode"
+
+typedef struct { //:InterpreterTest
+    String name;
+    Arr(Ulong) code;
+    Int codeLen;
+    Int expectedResult;      // the first word of the entry function's return value
+    char const* expectedErr; // or null if the run must succeed
+} InterpreterTest;
+
+//{{{ Utils
+
+#define I3(op, a, b, c) bcInstr3(op, a, b, c)
+#define I2(op, a, k) bcInstr2(op, a, k)
+#define program(instrs) .code = instrs, .codeLen = sizeof(instrs)/sizeof(Ulong)
+
+
+private Compiler*
+buildProgram(Arr(Ulong) code, Int codeLen, Arr(Int) ptrMaps, Int ptrMapsLen, Arena* a) {
+// A compiler with just the bytecode, its pointer maps and a static text of "asdfBBCC"
+    Compiler* cm = allocateOnArena(sizeof(Compiler), a);
+    (*cm) = (Compiler){ .a = a, .aTmp = a };
+    cm->bytecode = createInListUlong(codeLen, a);
+    cm->ptrMaps = createInListInt(ptrMapsLen > 0 ? ptrMapsLen : 1, a);
+    cm->staticText = createStringBuilder(16, a);
+    sbAppend(s("asdfBBCC"), cm->staticText);
+    for (Int j = 0; j < codeLen; j++) {
+        pushInbytecode(code[j], cm);
+    }
+    for (Int j = 0; j < ptrMapsLen; j++) {
+        pushInptrMaps(ptrMaps[j], cm);
+    }
+    return cm;
+}
+
+
+private void
+runInterpreterTest(InterpreterTest test, TestContext* ct) {
+    ct->countTests += 1;
+    Compiler* cm = buildProgram(test.code, test.codeLen, null, 0, ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    Int const result = (Int)rt.memory[0];
+    Bool const isOk = test.expectedErr == null
+                    ? rt.errMsg.len == 0 && result == test.expectedResult
+                    : equal(rt.errMsg, str(test.expectedErr));
+    if (isOk) {
+        ct->countPassed += 1;
+    } else {
+        printf("ERROR IN [");
+        printStringNoLn(test.name);
+        printf("]\nResult %d, error \"", result);
+        printStringNoLn(rt.errMsg);
+        printf("\"\nBut expected %d, error \"%s\"\n", test.expectedResult,
+               test.expectedErr != null ? test.expectedErr : "");
+    }
+    freeInterpreter(&rt);
+}
+
+
+private void
+runInterpreterTests(Int count, Arr(InterpreterTest) tests, TestContext* ct) {
+    for (Int j = 0; j < count; j++) {
+        runInterpreterTest(tests[j], ct);
+    }
+}
+
+#define runTests(tests, ct) runInterpreterTests(sizeof(tests)/sizeof(InterpreterTest), tests, ct)
+
+// Function 1 of some programs: the sum of 1..n by a loop. The arg is in slot 3
+#define LOOP_SUM \
+    5, \
+    I2(iSetLocal, 4, 0), I3(iPlus, 4, 4, 3), I2(iMinusConst, 3, 1), \
+    I2(iBranchGt, 3, 11), /* back to the iPlus, when it's right after an 8-instruction main */ \
+    I2(iReturn, 4, 1)
+
+// Function 1 of some programs: the sum of 1..n by recursion. The callee's frame is at slot 5, so
+// its arg is in slot 8. Must be right after a 3-instruction main
+#define RECURSIVE_SUM \
+    7, \
+    I2(iBranchGt, 3, 7), I2(iReturn, 3, 1), \
+    I3(iMove, 8, 3, 0), I2(iMinusConst, 8, 1), I2(iCall, 5, 1), I3(iPlus, 3, 3, 5), \
+    I2(iReturn, 3, 1)
+
+//}}}
+//{{{ Dispatch
+
+private void
+dispatchTests(TestContext* ct) {
+    Ulong loopWithCalls[] = {
+        8, // 2000 times, add up the results of a call
+        I2(iSetLocal, 3, 2000), I2(iSetLocal, 4, 0), I2(iSetLocal, 13, 100), I2(iCall, 10, 1),
+        I3(iPlus, 4, 4, 10), I2(iMinusConst, 3, 1), I2(iBranchGt, 3, 3), I2(iReturn, 4, 1),
+        LOOP_SUM };
+    Ulong recursion[] = {
+        3, I2(iSetLocal, 6, 1000), I2(iCall, 3, 1), I2(iReturn, 3, 1),
+        RECURSIVE_SUM };
+    Ulong divByZero[] = {
+        4, I2(iSetLocal, 3, 7), I2(iSetLocal, 4, 0), I3(iDivBy, 5, 3, 4), I2(iReturn, 5, 1) };
+    Ulong jumps[] = {
+        7, // the 3rd branch is taken
+        I2(iSetLocal, 3, -5), I2(iBranchGt, 3, 6), I2(iBranchEq, 3, 6), I2(iBranchLt, 3, 6),
+        I2(iReturn, 3, 1), I2(iSetLocal, 3, 1), I2(iReturn, 3, 1) };
+    Ulong builtinCall[] = { 2, I2(iBuiltinCall, 0, 0), I2(iReturn, 3, 1) };
+
+    InterpreterTest tests[] = {
+        (InterpreterTest){ .name = s("Loop with calls"), program(loopWithCalls),
+                           .expectedResult = 2000*5050 },
+        (InterpreterTest){ .name = s("Deep recursion"), program(recursion),
+                           .expectedResult = 500500 },
+        (InterpreterTest){ .name = s("Division by zero"), program(divByZero),
+                           .expectedErr = errDivisionByZero },
+        (InterpreterTest){ .name = s("Branches"), program(jumps), .expectedResult = 1 },
+        (InterpreterTest){ .name = s("A builtin call"), program(builtinCall),
+                           .expectedErr = errBuiltinCall }
+    };
+    runTests(tests, ct);
+
+    Ulong strings[] = {
+        7, // "asdf" ++ "BBCC", reversed
+        I2(iSetLocal, 5, 0), I3(iNewstring, 4, 5, 4), I2(iSetLocal, 6, 4), I3(iNewstring, 7, 6, 4),
+        I3(iConcatStrs, 4, 4, 7), I3(iReverseString, 4, 4, 0), I2(iReturn, 4, 1) };
+    Compiler* cm = buildProgram(strings, sizeof(strings)/sizeof(Ulong), null, 0, ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    EyrPtr result = rt.memory[0];
+    expectTrue("Strings", rt.errMsg.len == 0 && rt.memory[result] == 8
+                          && memcmp(rtStringChars(result, &rt), "CCBBfdsa", 8) == 0, ct);
+    freeInterpreter(&rt);
+
+    cm = buildProgram(recursion, sizeof(recursion)/sizeof(Ulong), null, 0, ct->a);
+    initInterpreter(cm, &rt);
+    Unt const sum = rtCallFunction(1, (Unt[]){ 10 }, 1, &rt);
+    expectTrue("Calling a function with args", rt.errMsg.len == 0 && sum == 55, ct);
+    freeInterpreter(&rt);
+}
+
+//}}}
+//{{{ Superinstructions
+
+private void
+runFusionTest(char const* name, Arr(Ulong) code, Int codeLen, Int expectedFusions,
+              Int expectedResult, TestContext* ct) {
+// Runs a program as is and after fusing, which must give the same result
+    Compiler* cm = buildProgram(code, codeLen, null, 0, ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    Int const plainResult = (Int)rt.memory[0];
+    freeInterpreter(&rt);
+
+    fuseSuperinstructions(cm);
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    Int const fusedResult = (Int)rt.memory[0];
+    Bool const isOk = rt.errMsg.len == 0 && cm->stats.countFusions == expectedFusions
+                      && plainResult == expectedResult && fusedResult == expectedResult;
+    if (!expectTrue(name, isOk, ct)) {
+        printf("%d fusions, results %d and %d\n", cm->stats.countFusions, plainResult,
+               fusedResult);
+    }
+    freeInterpreter(&rt);
+}
+
+#define fusionTest(name, code, fusions, result) \
+    runFusionTest(name, code, sizeof(code)/sizeof(Ulong), fusions, result, ct)
+
+private void
+superinstructionTests(TestContext* ct) {
+    Ulong countdown[] = {
+        7, // the iSetLocal doesn't fuse because the iPlusConst is a jump target
+        I2(iSetLocal, 3, 10), I2(iSetLocal, 4, 1), I2(iSetLocal, 5, 0), I2(iPlusConst, 5, 3),
+        I3(iMinus, 3, 3, 4), I2(iBranchGt, 3, 4), I2(iReturn, 5, 1) };
+    fusionTest("Minus and branch", countdown, 1, 30);
+
+    Ulong mismatch[] = {
+        8, // the branch tests another slot than the one the iMinus sets
+        I2(iSetLocal, 3, 5), I2(iPlusConst, 3, 2), I2(iSetLocal, 5, 7), I3(iMinus, 4, 3, 5),
+        I2(iBranchEq, 3, 7), I2(iReturn, 3, 1), I2(iSetLocal, 3, -1), I2(iReturn, 3, 1) };
+    fusionTest("Set local and add, no fusion on another slot", mismatch, 1, 7);
+
+    Ulong loopWithCalls[] = {
+        8,
+        I2(iSetLocal, 3, 2000), I2(iSetLocal, 4, 0), I2(iSetLocal, 13, 100), I2(iCall, 10, 1),
+        I3(iPlus, 4, 4, 10), I2(iMinusConst, 3, 1), I2(iBranchGt, 3, 3), I2(iReturn, 4, 1),
+        LOOP_SUM };
+    fusionTest("Set local and call", loopWithCalls, 1, 2000*5050);
+}
+
+//}}}
+//{{{ Arithmetic and GC
+
+private void
+arithmeticTests(TestContext* ct) {
+// Integers wrap around, and INT_MIN / -1 is INT_MIN rather than a crash
+    Ulong plus[] = {
+        4, I2(iSetLocal, 3, INT_MAX), I2(iSetLocal, 4, 1), I3(iPlus, 5, 3, 4), I2(iReturn, 5, 1) };
+    Ulong plusConst[] = {
+        3, I2(iSetLocal, 3, INT_MAX), I2(iPlusConst, 3, 1), I2(iReturn, 3, 1) };
+    Ulong times[] = {
+        4, I2(iSetLocal, 3, INT_MIN), I2(iSetLocal, 4, -1), I3(iTimes, 5, 3, 4), I2(iReturn, 5, 1) };
+    Ulong divBy[] = {
+        4, I2(iSetLocal, 3, INT_MIN), I2(iSetLocal, 4, -1), I3(iDivBy, 5, 3, 4), I2(iReturn, 5, 1) };
+    Ulong divByConst[] = {
+        3, I2(iSetLocal, 3, INT_MIN), I2(iDivByConst, 3, -1), I2(iReturn, 3, 1) };
+    Ulong divByMinusOne[] = {
+        4, I2(iSetLocal, 3, 7), I2(iSetLocal, 4, -1), I3(iDivBy, 5, 3, 4), I2(iReturn, 5, 1) };
+
+    InterpreterTest tests[] = {
+        (InterpreterTest){ .name = s("Addition wraps around"), program(plus),
+                           .expectedResult = INT_MIN },
+        (InterpreterTest){ .name = s("Addition of a constant wraps around"), program(plusConst),
+                           .expectedResult = INT_MIN },
+        (InterpreterTest){ .name = s("Multiplication wraps around"), program(times),
+                           .expectedResult = INT_MIN },
+        (InterpreterTest){ .name = s("INT_MIN / -1"), program(divBy), .expectedResult = INT_MIN },
+        (InterpreterTest){ .name = s("INT_MIN / constant -1"), program(divByConst),
+                           .expectedResult = INT_MIN },
+        (InterpreterTest){ .name = s("Division by -1"), program(divByMinusOne),
+                           .expectedResult = -7 }
+    };
+    runTests(tests, ct);
+}
+
+
+private void
+gcTests(TestContext* ct) {
+    Ulong garbage[] = {
+        8, // 100000 times, concatenate and reverse two new strings
+        I2(iSetLocal, 3, 100000), I2(iSetLocal, 4, 0), I3(iNewstring, 5, 4, 4),
+        I3(iNewstring, 6, 4, 8), I3(iConcatStrs, 6, 6, 5), I3(iReverseString, 6, 6, 0),
+        I2(iMinusConst, 3, 1), I2(iBranchGt, 3, 3), I2(iReturn, 6, 1) };
+    Int ptrMaps[] = { 2, 0, 5, 6 }; // slots 5 and 6 of main hold strings
+    Compiler* cm = buildProgram(garbage, sizeof(garbage)/sizeof(Ulong), ptrMaps,
+                                sizeof(ptrMaps)/sizeof(Int), ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    EyrPtr const result = rt.memory[0];
+    Bool const isOk = rt.errMsg.len == 0 && rt.countCollections > 0
+                      && rt.memory[result] == 12
+                      && memcmp(rtStringChars(result, &rt), "fdsaCCBBfdsa", 12) == 0;
+    if (!expectTrue("Garbage gets collected", isOk, ct)) {
+        printf("%d collections, heap of %d words\n", rt.countCollections,
+               rt.heapEnd - rt.heapStart);
+    }
+    expectTrue("The heap doesn't grow", rt.heapEnd - rt.heapStart == VM_HEAP_INIT_SIZE, ct);
+
+    if (setjmp(rt.excBuf) == 0) {
+        rtAllocate(GC_SIZE_MASK + 1, false, &rt);
+    }
+    expectTrue("Object too large for the header", equal(rt.errMsg, s(errObjectTooLarge)), ct);
+    rt.errMsg = empty;
+    if (setjmp(rt.excBuf) == 0) {
+        rtNewString(0xFFFFFFFF, &rt);
+    }
+    expectTrue("String too large for the header", equal(rt.errMsg, s(errObjectTooLarge)), ct);
+    freeInterpreter(&rt);
+}
+
+//}}}
+//{{{ Regions
+
+private Bool
+isResident(void* addr) {
+    Long const pageSize = sysconf(_SC_PAGESIZE);
+    unsigned char residency = 0;
+    mincore((void*)((Long)addr & ~(pageSize - 1)), pageSize, &residency);
+    return (residency & 1) != 0;
+}
+
+
+private void
+regionTests(TestContext* ct) {
+    Ulong requests[] = {
+        1, I2(iReturn, 3, 0),
+        5, // the request: a 24-char string made from the config
+        I2(iSetLocal, 5, 0), I3(iNewstring, 4, 5, 8), I3(iConcatStrs, 4, 4, 3),
+        I3(iConcatStrs, 4, 4, 3), I2(iReturn, 4, 1),
+        3, // the config, a 4-char string
+        I2(iSetLocal, 5, 0), I3(iNewstring, 4, 5, 4), I2(iReturn, 4, 1) };
+    Int ptrMaps[] = { 0, 0,  2, 1, 3, 4,  1, 0, 4 };
+    Compiler* cm = buildProgram(requests, sizeof(requests)/sizeof(Ulong), ptrMaps,
+                                sizeof(ptrMaps)/sizeof(Int), ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    EyrPtr const config = rtCallFunction(2, null, 0, &rt);
+    rtPin(config, &rt);
+    RtRegion region = rtRegionMark(&rt);
+    EyrPtr const top = rt.heapTop;
+    Bool isOk = true;
+    for (Int j = 0; j < 100000 && isOk; j++) {
+        EyrPtr result = rtCallFunction(1, (Unt[]){ config }, 1, &rt);
+        isOk = rt.errMsg.len == 0 && rt.memory[result] == 16;
+        rtRegionReset(region, &rt);
+    }
+    expectTrue("Resets free the region", isOk && rt.heapTop == top && rt.countCollections == 0,
+               ct);
+
+    for (Int j = 0; j < 600000 && isOk; j++) {
+        EyrPtr result = rtCallFunction(1, (Unt[]){ config }, 1, &rt);
+        isOk = rt.errMsg.len == 0 && rt.memory[result] == 16;
+    }
+    Bool const isBounded = rt.heapEnd - rt.heapStart <= 2*VM_REGION_HEAP_LIMIT;
+    if (!expectTrue("Past the limit, a region collects", isOk && isBounded
+                                                         && rt.countCollections > 0, ct)) {
+        printf("%d collections, heap of %d words\n", rt.countCollections,
+               rt.heapEnd - rt.heapStart);
+    }
+    EyrPtr const spilledTop = rt.heapTop;
+    rtRegionReset(region, &rt);
+    expectTrue("Reset gives the pages back", rt.heapTop <= spilledTop
+               && !isResident(rt.memory + spilledTop - 4096), ct);
+    expectTrue("The config outlives the resets", rt.memory[config] == 4
+               && memcmp(rtStringChars(config, &rt), "asdf", 4) == 0, ct);
+    rtRegionEnd(region, &rt);
+    freeInterpreter(&rt);
+}
+
+//}}}
+//{{{ VM memory
+
+private volatile sig_atomic_t _countForeignFaults = 0;
+
+private void
+foreignSegvHandler(int sig, siginfo_t* info, void* context) {
+// Stands for the handler of the host app. Makes the page writable so the faulting write can rerun
+    _countForeignFaults += 1;
+    Long const pageSize = sysconf(_SC_PAGESIZE);
+    mprotect((void*)((Long)info->si_addr & ~(pageSize - 1)), pageSize, PROT_READ | PROT_WRITE);
+}
+
+
+private void
+installForeignSegvHandler(void) {
+// Must run before any interpreter is created, because that's when the VM's handler goes in
+    struct sigaction action = { .sa_sigaction = &foreignSegvHandler, .sa_flags = SA_SIGINFO };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, null);
+}
+
+
+private void
+vmTests(TestContext* ct) {
+    Ulong endlessRecursion[] = {
+        2, I2(iCall, 10, 1), I2(iReturn, 3, 1),
+        3, I2(iSetLocal, 4, 7), I2(iCall, 10, 1), I2(iReturn, 3, 1) };
+    Ulong bigFrames[] = {
+        2, I2(iCall, 0x7FF0, 1), I2(iReturn, 3, 1), // frames as big as the slot operands allow
+        2, I2(iCall, 0x7FF0, 1), I2(iReturn, 3, 1) };
+    InterpreterTest tests[] = {
+        (InterpreterTest){ .name = s("Stack overflow"), program(endlessRecursion),
+                           .expectedErr = errStackOverflow },
+        (InterpreterTest){ .name = s("Big frames don't skip over the guard"), program(bigFrames),
+                           .expectedErr = errStackOverflow }
+    };
+    runTests(tests, ct);
+
+    Interpreter rt;
+    Compiler* cm = buildProgram(endlessRecursion, sizeof(endlessRecursion)/sizeof(Ulong),
+                                null, 0, ct->a);
+    initInterpreter(cm, &rt);
+    Long const pageSize = sysconf(_SC_PAGESIZE);
+    volatile Int* page = mmap(null, pageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    page[0] = 42; // not the VM's fault, so it goes to the previous handler
+    expectTrue("Foreign faults go to the previous handler",
+               _countForeignFaults == 1 && page[0] == 42, ct);
+    munmap((void*)page, pageSize);
+    freeInterpreter(&rt);
+}
+
+//}}}
+//{{{ JIT
+#ifdef JIT
+
+private void
+jitTests(TestContext* ct) {
+    Ulong loopWithCalls[] = {
+        8,
+        I2(iSetLocal, 3, 2000), I2(iSetLocal, 4, 0), I2(iSetLocal, 13, 100), I2(iCall, 10, 1),
+        I3(iPlus, 4, 4, 10), I2(iMinusConst, 3, 1), I2(iBranchGt, 3, 3), I2(iReturn, 4, 1),
+        LOOP_SUM };
+    Compiler* cm = buildProgram(loopWithCalls, sizeof(loopWithCalls)/sizeof(Ulong), null, 0,
+                                ct->a);
+    Interpreter rt;
+    initInterpreter(cm, &rt);
+    interpretCode(&rt);
+    expectTrue("A hot function gets compiled", rt.errMsg.len == 0 && rt.fns[1] == -1
+                                               && (Int)rt.memory[0] == 2000*5050, ct);
+    freeInterpreter(&rt);
+
+    Ulong division[] = {
+        1, I2(iReturn, 0, 0),
+        2, I3(iDivBy, 5, 3, 4), I2(iReturn, 5, 1),
+        2, I2(iDivByConst, 3, -1), I2(iReturn, 3, 1),
+        1, I2(iReturn, 3, 60) }; // returns its 60 params
+    cm = buildProgram(division, sizeof(division)/sizeof(Ulong), null, 0, ct->a);
+    initInterpreter(cm, &rt);
+    Bool const isCompiled = jitCompile(1, &rt) && jitCompile(2, &rt) && jitCompile(3, &rt);
+    expectTrue("Compiling the division functions", isCompiled, ct);
+    if (!isCompiled) {
+        freeInterpreter(&rt);
+        return;
+    }
+    expectTrue("Native division", (Int)rtCallFunction(1, (Unt[]){ -7, 2 }, 2, &rt) == -3, ct);
+    expectTrue("Native division by -1", (Int)rtCallFunction(1, (Unt[]){ 7, -1 }, 2, &rt) == -7, ct);
+    expectTrue("Native INT_MIN / -1 wraps",
+               (Int)rtCallFunction(1, (Unt[]){ INT_MIN, -1 }, 2, &rt) == INT_MIN, ct);
+    expectTrue("Native INT_MIN / constant -1 wraps",
+               (Int)rtCallFunction(2, (Unt[]){ INT_MIN }, 1, &rt) == INT_MIN, ct);
+    rtCallFunction(1, (Unt[]){ 7, 0 }, 2, &rt);
+    expectTrue("Native division by zero", equal(rt.errMsg, s(errDivisionByZero)), ct);
+
+    Unt params[60];
+    for (Int j = 0; j < 60; j++) {
+        params[j] = 1000 + j;
+    }
+    rtCallFunction(3, params, 60, &rt);
+    expectTrue("Native return of many slots", rt.errMsg.len == 0
+               && memcmp(rt.memory, params, sizeof(params)) == 0, ct);
+    freeInterpreter(&rt);
+}
+
+#endif
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  INTERPRETER TEST  --\n");
+    printf("----------------------------\n");
+
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+    installForeignSegvHandler();
+
+    dispatchTests(&ct);
+    superinstructionTests(&ct);
+    arithmeticTests(&ct);
+    gcTests(&ct);
+    regionTests(&ct);
+    vmTests(&ct);
+#ifdef JIT
+    jitTests(&ct);
+#endif
+
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+// Tests of the lexer's input: source files mapped with "mapSourceFile" must lex exactly like the
+// same text prepared by "prepareInput", at every file size relative to the page size. Also tests
+// the lexer's window into inputs over 2 GB, with the window made small enough for a test, and the
+// SIMD scanners against the scalar ones
+static int lexRebaseAt = 1 << 30;
+#define LEX_REBASE_AT lexRebaseAt
+#include "../eyr.c"
+#include "eyrTest.h"
+
+//{{{ Utils
+
+#define SNIPPET "def main = {{}\n    x~ = `foo`;\n    x = `bar`; // a comment\n};\n"
+
+
+private char*
+makeSource(Int len, Arena* a) {
+// Snippets over and over, cut at @len bytes
+    char* result = allocateOnArena(len + 1, a);
+    Int const lenSnippet = sizeof(SNIPPET) - 1;
+    for (Int j = 0; j < len; j++) {
+        result[j] = SNIPPET[j % lenSnippet];
+    }
+    result[len] = '\0';
+    return result;
+}
+
+
+private void
+writeFile(String fName, char const* content, Int len) {
+    FILE* file = fopen(fName.cont, "wb");
+    fwrite(content, 1, len, file);
+    fclose(file);
+}
+
+//}}}
+//{{{ Mapped files
+
+private Bool
+mappedLexesLikePrepared(String fName, Int len, Arena* a) {
+// Maps a file of @len bytes and compares it, and the result of lexing it, to "prepareInput"
+    char* content = makeSource(len, a);
+    writeFile(fName, content, len);
+    SourceMap sourceMap = mapSourceFile(fName);
+    String prepared = prepareInput(content, a);
+    Int const lenStandard = sizeof(standardText) - 1;
+    Ulong const pageSize = (Ulong)sysconf(_SC_PAGESIZE);
+    Bool result = sourceMap.inpLength == lenStandard + len
+                  && memcmp(sourceMap.input, prepared.cont, sourceMap.inpLength + 1) == 0
+                  && (Ulong)(sourceMap.input + lenStandard) % pageSize == 0; // not copied
+    if (result) {
+        Compiler* mapped = lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, a);
+        Compiler* copied = lexicallyAnalyze(str(content), a);
+        result = equalityLexer(*mapped, *copied) == -2
+                 && mapped->newlines.len == copied->newlines.len
+                 && memcmp(mapped->newlines.cont, copied->newlines.cont,
+                           mapped->newlines.len*sizeof(Unt)) == 0;
+    }
+    unmapSourceFile(sourceMap);
+    return result;
+}
+
+
+private void
+mapTests(String dir, TestContext* ct) {
+    String const fName = stringOfFormat(ct->a, "%s/src.eyr", dir.cont);
+    Int const pageSize = (Int)sysconf(_SC_PAGESIZE);
+    Int const lens[] = { 1, 100, pageSize - 1, pageSize, pageSize + 1, 3*pageSize, 3*pageSize + 5 };
+    for (Int k = 0; k < (Int)(sizeof(lens)/sizeof(Int)); k++) {
+        if (!expectTrue("A mapped file lexes like a copied one",
+                        mappedLexesLikePrepared(fName, lens[k], ct->a), ct)) {
+            printf("The file length was %d\n", lens[k]);
+        }
+    }
+
+    char* content = makeSource(pageSize, ct->a);
+    writeFile(fName, content, pageSize);
+    SourceMap sourceMap = mapSourceFile(fName);
+    lexicallyAnalyzeInput(sourceMap.input, sourceMap.inpLength, ct->a);
+    unmapSourceFile(sourceMap);
+    FILE* file = fopen(fName.cont, "rb");
+    char* after = allocateOnArena(pageSize + 1, ct->a);
+    Bool const isRead = (Int)fread(after, 1, pageSize + 1, file) == pageSize;
+    fclose(file);
+    expectTrue("Lexing doesn't change the file",
+               isRead && memcmp(after, content, pageSize) == 0, ct);
+
+    writeFile(fName, "", 0);
+    expectTrue("An empty file", mapSourceFile(fName).inpLength == 0, ct);
+    unlink(fName.cont);
+    expectTrue("A missing file", mapSourceFile(fName).inpLength == 0, ct);
+}
+
+//}}}
+//{{{ Windows
+
+private Compiler*
+lexInWindows(char const* content, Int rebaseAt, Arena* a) {
+    lexRebaseAt = rebaseAt;
+    Compiler* result = lexicallyAnalyze(str(content), a);
+    lexRebaseAt = 1 << 30;
+    return result;
+}
+
+
+private Bool
+lexesLikeWhole(char const* content, Int rebaseAt, Arena* a) {
+// Lexing through small windows gives the same tokens, names and newlines as lexing the input whole
+    Compiler* whole = lexInWindows(content, 1 << 30, a);
+    Compiler* windowed = lexInWindows(content, rebaseAt, a);
+    if (whole->stats.wasLexerError || whole->tokenBases.len > 0
+            || windowed->tokenBases.len < 2 || equalityLexer(*windowed, *whole) != -2) {
+        return false;
+    }
+    for (Int j = 0; j < windowed->tokens.len; j++) {
+        windowed->i = j;
+        if (tokStartBt(j, windowed) != whole->tokens.cont[j].startBt
+                || startBtOf(windowed->tokens.cont[j], windowed) != whole->tokens.cont[j].startBt) {
+            return false;
+        }
+    }
+    return windowed->stringTable->len == whole->stringTable->len
+           && memcmp(windowed->stringTable->cont, whole->stringTable->cont,
+                     whole->stringTable->len*sizeof(NameSpan)) == 0
+           && windowed->newlines.len == whole->newlines.len
+           && memcmp(windowed->newlines.cont, whole->newlines.cont,
+                     whole->newlines.len*sizeof(Unt)) == 0;
+}
+
+
+private void
+windowTests(TestContext* ct) {
+    Int const lenSource = 80*(sizeof(SNIPPET) - 1);
+    Int const rebaseAts[] = { 512, 513, 600, 1000 };
+    for (Int k = 0; k < (Int)(sizeof(rebaseAts)/sizeof(Int)); k++) {
+        if (!expectTrue("Lexing in windows", lexesLikeWhole(makeSource(lenSource, ct->a),
+                                                            rebaseAts[k], ct->a), ct)) {
+            printf("The window moved every %d bytes\n", rebaseAts[k]);
+        }
+    }
+
+    // The windows are 1023 bytes long
+    char* content = makeSource(lenSource, ct->a);
+    memcpy(content + 2000, "\n//", 3);
+    memset(content + 2003, 'a', 1200);
+    content[3203] = '\n';
+    expectTrue("A comment longer than the window", equal(
+            lexInWindows(content, 512, ct->a)->stats.errMsg, str(errLexemeLengthExceeded)), ct);
+    memset(content + 2001, ' ', 1202);
+    expectTrue("Spaces longer than the window", equal(
+            lexInWindows(content, 512, ct->a)->stats.errMsg, str(errLexemeLengthExceeded)), ct);
+
+    Int const lenHalf = lenSource/2;
+    content = allocateOnArena(2*lenHalf + 403, ct->a);
+    memcpy(content, makeSource(lenHalf, ct->a), lenHalf);
+    memcpy(content + lenHalf, "//", 2);
+    memset(content + lenHalf + 2, 'a', 399);
+    content[lenHalf + 401] = '\n';
+    memcpy(content + lenHalf + 402, makeSource(lenHalf, ct->a), lenHalf + 1);
+    expectTrue("A comment that fits the window", lexesLikeWhole(content, 512, ct->a), ct);
+}
+
+
+private void
+offsetTests(TestContext* ct) {
+// Offsets past 4 GB, which only the windows' starts have in full
+    Compiler* cm = lexicallyAnalyze(s("a = 1"), ct->a);
+    Long const base = 5LL << 30;
+    Long const starts[] = { 7, 0x7FFFFFFF, base + 10, base - 3 };
+    cm->tokenBases.len = 0;
+    pushIntokenBases((TokenBase){ .tokenInd = 2, .startBt = base }, cm);
+    for (Int j = 0; j < 4; j++) {
+        cm->tokens.cont[j].startBt = (Unt)starts[j];
+    }
+    Bool isOk = cm->tokens.len >= 4;
+    for (Int j = 0; j < 4; j++) {
+        isOk = isOk && tokStartBt(j, cm) == starts[j];
+    }
+    cm->i = 2;
+    expectTrue("Offsets past 4 GB", isOk && startBtOf(cm->tokens.cont[3], cm) == base - 3, ct);
+    SourceLoc const loc = locOf(cm->tokens.cont[2], cm);
+    expectTrue("Node locations past 4 GB", locStartBt(loc) == base + 10
+               && locStartBt(locAt(0x7FFFFFFF, 1)) == 0x7FFFFFFF, ct);
+    NameSpan const name = nameSpanOf(base + 0x7FFFFFFFLL, 255);
+    expectTrue("Names past 4 GB", nameSpanStart(name) == base + 0x7FFFFFFFLL
+               && nameSpanLen(name) == 255, ct);
+}
+
+//}}}
+//{{{ Scanners
+
+private char*
+makeScannerInput(Int len, Arena* a) {
+// Pseudo-random runs of spaces, LFs, alphanumerics, backticks and bytes over 127, mostly longer
+// than a vector, with an LF at byte 31 of a run
+    char const bytes[] = { ' ', '\n', 'a', 'Z', '5', '`', (char)0x80, (char)0xD0, (char)0xFF, '_' };
+    char* result = allocateOnArena(len + 1, a);
+    memset(result, ' ', 31);
+    result[31] = '\n';
+    Unt seed = 12345;
+    for (Int j = 32; j < len; ) {
+        seed = seed*1103515245 + 12345;
+        Int const runLen = (seed >> 16) % 70;
+        char const bt = bytes[(seed >> 8) % sizeof(bytes)];
+        for (Int k = 0; k < runLen && j < len; k++, j++) {
+            result[j] = bt;
+        }
+    }
+    result[len] = '\0';
+    return result;
+}
+
+
+private Bool
+scannersAgree(LexScanners sc, char const* inp, Int len) {
+// Scanners give the same results as the scalar ones from every start and for several ends
+    for (Int i = 0; i < len; i++) {
+        Int const ends[] = { len, len - 7, i + 15, i + 16, i + 31, i + 32, i + 33, i + 48 };
+        for (Int k = 0; k < (Int)(sizeof(ends)/sizeof(Int)); k++) {
+            Int const end = ends[k] < len ? ends[k] : len;
+            if (end < i) {
+                continue;
+            }
+            if (sc.spaceRunEnd(inp, i, end) != spaceRunEndScalar(inp, i, end)
+                    || sc.wordRunEnd(inp, i, end) != wordRunEndScalar(inp, i, end)
+                    || sc.byteFind(inp, i, end, aNewline) != byteFindScalar(inp, i, end, aNewline)
+                    || sc.byteFind(inp, i, end, aBacktick)
+                       != byteFindScalar(inp, i, end, aBacktick)) {
+                printf("Scanning from %d to %d\n", i, end);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+private char*
+makeLexerInput(Arena* a) {
+// Statements with words, string literals, comments and runs of spaces and LFs of every length up
+// to 70 bytes, and with bytes over 127 in the literals and comments
+    StringBuilder* sb = createStringBuilder(64, a);
+    for (Int k = 0; k < 70; k++) {
+        sbAppend(s("x"), sb);
+        for (Int j = 0; j < k; j++) {
+            sbAppend((String){ .cont = "abcdefghijklmnopqrstuvwxyz" + j % 26, .len = 1 }, sb);
+        }
+        sbAppend(s(" = `"), sb);
+        for (Int j = 0; j < k; j++) {
+            sbAppend(j % 3 == 0 ? s("\xD0\xBC") : s("s"), sb);
+        }
+        sbAppend(s("`; // \xC3\xA9\xFF"), sb);
+        for (Int j = 0; j < k; j++) {
+            sbAppend(s(j % 2 == 0 ? " " : "\x80"), sb);
+        }
+        sbAppend(s("\n"), sb);
+        for (Int j = 0; j < k; j++) {
+            sbAppend(s(j % 16 == 15 ? "\n" : " "), sb);
+        }
+    }
+    sbAppend((String){ .cont = "", .len = 1 }, sb); // the \0
+    return sb->cont;
+}
+
+
+private Bool
+lexesLikeScalar(char const* content, LexScanners sc, Arena* a) {
+// Lexing with a set of scanners gives the same tokens, names and newlines as with the scalar ones
+    LexScanners const chosen = _lexScanners;
+    _lexScanners = (LexScanners){ .spaceRunEnd = &spaceRunEndScalar,
+                                  .wordRunEnd = &wordRunEndScalar, .byteFind = &byteFindScalar };
+    Compiler* scalar = lexicallyAnalyze(str(content), a);
+    _lexScanners = sc;
+    Compiler* lx = lexicallyAnalyze(str(content), a);
+    _lexScanners = chosen;
+    return !scalar->stats.wasLexerError && equalityLexer(*lx, *scalar) == -2
+           && lx->stringTable->len == scalar->stringTable->len
+           && memcmp(lx->stringTable->cont, scalar->stringTable->cont,
+                     lx->stringTable->len*sizeof(NameSpan)) == 0
+           && lx->newlines.len == scalar->newlines.len
+           && memcmp(lx->newlines.cont, scalar->newlines.cont,
+                     lx->newlines.len*sizeof(Unt)) == 0;
+}
+
+
+private void
+scannerTests(TestContext* ct) {
+    LexScanners const frontEnds = { .spaceRunEnd = &spaceRunEnd, .wordRunEnd = &wordRunEnd,
+                                     .byteFind = &byteFind };
+    Int const len = 3000;
+    char const* inp = makeScannerInput(len, ct->a);
+    char const* program = makeLexerInput(ct->a);
+    expectTrue("The scanners", scannersAgree(frontEnds, inp, len), ct);
+    expectTrue("Lexing with the chosen scanners", lexesLikeScalar(program, _lexScanners, ct->a),
+               ct);
+#ifdef LEX_SIMD
+    LexScanners const sse2 = { .spaceRunEnd = &spaceRunEnd16, .wordRunEnd = &wordRunEnd16,
+                               .byteFind = &byteFind16 };
+    expectTrue("The SSE2 scanners", scannersAgree(sse2, inp, len), ct);
+    expectTrue("Lexing with the SSE2 scanners", lexesLikeScalar(program, sse2, ct->a), ct);
+    if (__builtin_cpu_supports("avx2")) {
+        LexScanners const avx2 = { .spaceRunEnd = &spaceRunEnd32, .wordRunEnd = &wordRunEnd32,
+                                   .byteFind = &byteFind32 };
+        expectTrue("The AVX2 scanners", scannersAgree(avx2, inp, len), ct);
+        expectTrue("Lexing with the AVX2 scanners", lexesLikeScalar(program, avx2, ct->a), ct);
+    } else {
+        print("No AVX2 on this CPU, so its scanners aren't tested");
+    }
+#endif
+
+    Compiler* lx = lexicallyAnalyze(s("a = 1;\n\n  \nb = 2;\n"), ct->a);
+    Ulong const lenStandard = sizeof(standardText) - 1;
+    expectTrue("A run of LFs and spaces is recorded as its first LF", lx->newlines.len == 2
+               && lx->newlines.cont[0] == lenStandard + 6
+               && lx->newlines.cont[1] == lenStandard + 17, ct);
+}
+
+//}}}
+
+int main() {
+    printf("----------------------------\n");
+    printf("--  LEXER INPUT TEST  --\n");
+    printf("----------------------------\n");
+
+    initCompiler();
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+    char dirName[] = "/tmp/eyrLexerInputTestXXXXXX";
+    if (mkdtemp(dirName) == null) {
+        print("Could not create a temp dir");
+        return 1;
+    }
+    String const dir = str(dirName);
+
+    mapTests(dir, &ct);
+    windowTests(&ct);
+    offsetTests(&ct);
+    scannerTests(&ct);
+
+    rmdir(dirName);
+    if (ct.countTests == 0) {
+        print("\nThere were no tests to run!");
+    } else if (ct.countPassed == ct.countTests) {
+        print("\nAll %d tests passed!", ct.countTests);
+    } else {
+        print("\nFailed %d tests out of %d!", (ct.countTests - ct.countPassed), ct.countTests);
+    }
+    deleteArena(ct.a);
+    return ct.countPassed == ct.countTests ? 0 : 1;
+}
@@ -1,10 +1,4 @@
-#include <stdio.h>
-#include <stdbool.h>
-#include <string.h>
-#include <stdarg.h>
-#include <stdint.h>
-#include "../include/eyr.h"
-#include "../eyr.internal.h"
+#include "../eyr.c"
 #include "eyrTest.h"
 
 
@@ -23,8 +17,8 @@ typedef struct {
 
 //{{{ Utils
 
-#define S   70000000 // A constant larger than the largest allowed file size. Separates parsed
-                     // names from others
+#define S   BIG // Above any count of names, like in the compiler. Separates parsed names
+                // from others
 
 private Compiler* buildExpectedLexer(Arena *a, int totalTokens, Arr(Token) tokens) {
     Compiler* result = createLexer(empty, a);
@@ -1081,7 +1075,7 @@ int main(int argc, char** argv) {
     printf("--  LEXER TEST  --\n");
     printf("----------------------------\n");
 
-    auto ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
+    TestContext ct = (TestContext){.countTests = 0, .countPassed = 0, .a = createArena() };
 
     runATestSet(&wordTests, &ct);
     runATestSet(&stringTests, &ct);
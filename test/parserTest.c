@@ -28,8 +28,8 @@ typedef struct { // :TestEntityImport
     Int typeInd; // index in the intermediary array of types that is imported alongside
 } TestEntityImport;
 
-#define S   70000000 // A constant larger than the largest allowed file size.
-                     // Separates parsed entities from others
+#define S   BIG // Above any count of entities, like in the compiler. Separates parsed entities
+                // from others
 #define I  140000000 // The base index for imported entities/overloads
 #define S2 210000000 // A constant larger than the largest allowed file size.
                      //  Separates parsed entities from others
@@ -207,7 +207,7 @@ private ParserTest createTestWithLocs0(String name, String input, Arr(Node) node
     for (Int j = 0; j < countLocs; ++j) {
         SourceLoc loc = locs[j];
         loc.startBt += stText.len;
-        setLoc(loc, theTest.control);
+        setLoc(j, loc, theTest.control);
     }
     theTest.compareLocsToo = true;
     return theTest;